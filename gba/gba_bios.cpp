@@ -4,38 +4,43 @@
 // 2013
 //*************************************************************************************************
 
-#include <fstream>
 #include "../emulator.h"
 #include "gba_bios.h"
 
-namespace gbaBIOS {
 const u32 m_biossize = 0x4000;
+const u8  m_none[m_biossize] = {};
 
-u8   m_BIOS[m_biossize];
-bool m_ready = false;
+gbaBIOS::gbaBIOS() {
+    m_image = 0;
+    m_BIOS  = m_none;
+    m_ready = false;
+}
+
+gbaBIOS::~gbaBIOS() {
+    gbaImage::Release(m_image);
+}
 
-bool Load(char const *filename) {
+bool gbaBIOS::Load(char const *filename) {
     Emulator::LogMessage("Cargando BIOS");
     if (filename == 0) {
         Emulator::LogMessage("Error nombre de archivo no especificado");
         return false;
     }
     Emulator::LogMessage("Abriendo archivo: %s", filename);
-    std::ifstream biosfile(filename, std::ios::binary);
-    if (!biosfile) {
-        Emulator::LogMessage("Error al abrir el archivo");
-        return false;
-    }
-    m_ready = false;
-    biosfile.read((char *)m_BIOS, sizeof(m_BIOS));
-    if (!biosfile) {
-        Emulator::LogMessage("Error al leer el archivo (%d / %d bytes)", (u32)biosfile.gcount(), sizeof(m_BIOS));
+    gbaImage::Image const *image = gbaImage::Acquire(filename, m_biossize, m_biossize);
+    if (image == 0) {return false;}
+    if (image->filesize < m_biossize) {
+        Emulator::LogMessage("Error al leer el archivo (%d / %d bytes)", image->filesize, m_biossize);
+        gbaImage::Release(image);
         return false;
     }
+    gbaImage::Release(m_image);
+    m_image = image;
+    m_BIOS  = image->map;
     m_ready = true;
     t32 data;
     u32 cs = 0;
-    for (u32 i = 0; i < sizeof(m_BIOS); i += 4) {
+    for (u32 i = 0; i < m_biossize; i += 4) {
         Read(i, &data, gbaMemory::TYPE_WORD);
         cs += data.d;
     }
@@ -46,13 +51,16 @@ bool Load(char const *filename) {
     return true;
 }
 
-bool IsLoaded() {
+bool gbaBIOS::IsLoaded() const {
     return m_ready;
 }
 
-void Read(u32 address, t32 *data, gbaMemory::DataType width) {
+void gbaBIOS::Read(u32 address, t32 *data, gbaMemory::DataType width) const {
     u32 base = ALIGN(address, width);
     if (base < m_biossize) {READ(m_BIOS, base, data, width);}
 }
+
+u8 const *gbaBIOS::GetMemory() const {
+    return m_BIOS;
 }
 //*************************************************************************************************
\ No newline at end of file
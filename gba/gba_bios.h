@@ -7,11 +7,23 @@
 #pragma once
 
 #include "../types.h"
+#include "gba_image.h"
 #include "gba_memory.h"
 
-namespace gbaBIOS {
-bool Load(char const *filename);
-bool IsLoaded();
-void Read(u32 address, t32 *data, gbaMemory::DataType width);
-}
+class gbaBIOS {
+public:
+    gbaBIOS();
+    ~gbaBIOS();
+
+    bool Load(char const *filename);
+    bool IsLoaded() const;
+    void Read(u32 address, t32 *data, gbaMemory::DataType width) const;
+    u8 const *GetMemory() const;
+
+private:
+    // Imagen del archivo compartida con las demas instancias, m_none antes de cargar
+    gbaImage::Image const *m_image;
+    u8 const              *m_BIOS;
+    bool                   m_ready;
+};
 //*************************************************************************************************
\ No newline at end of file
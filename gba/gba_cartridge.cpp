@@ -7,35 +7,10 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <fstream>
-#include <ctime>
-#include <vector>
+#include <cstring>
 #include "../emulator.h"
 #include "gba_cartridge.h"
 
-namespace gbaCartridge {
-enum FlashMode {
-    MODE_NONE,
-    MODE_ID,
-    MODE_ERASE,
-    MODE_WRITE,
-    MODE_BANK
-};
-
-struct ROMHeader {
-    u8 ROMentrypoint[4];
-    u8 logo[156];
-    u8 gametitle[12];
-    u8 gamecode[4];
-    u8 makercode[2];
-    u8 v0x96;
-    u8 unitcode;
-    u8 devicetype;
-    u8 reserved1[7];
-    u8 softwareversion;
-    u8 headerchecksum;
-    u8 reserved2[2];
-};
-
 char const * const m_backupstrings[5] = {
     "EEPROM_V",
     "SRAM_V",
@@ -58,49 +33,26 @@ const u32    m_backuptypesizes[6]     = {8192, 32768, 65536, 131072, 0, 0};
 const u16    m_flash512id             = 0x1CC2;
 const u16    m_flash1Mid              = 0x09C2;
 
-bool m_ready = false;
-
-u8   *m_ROM;
-u8   *m_backup;
-u8   *m_flash;
-char *m_savfilename;
-
-u32        m_romsize;
-u32        m_backupsize;
-BackupType m_backuptype;
-
-FlashMode  m_flashmode;
-t16        m_flashid;
-u8         m_flash0x5555;
-u8         m_flash0x2AAA;
-
-bool            m_eepromdetect;
-std::vector<u8> m_eeprombits;
-bool            m_eepromread;
-u32             m_eeprombitsleft;
-u32             m_eepromreadadr;
-
-char m_title[13];
-char m_code[9];
-u32  m_headerchecksum;
-char m_backupid[14];
-
-u32 m_GPIODIR;
-u32 m_GPIOCNT;
-
-bool            m_rtcenable;
-std::vector<u8> m_rtcbits;
-u32             m_rtcSCK;
-u32             m_rtcCS;
-u32             m_rtcSIO;
-bool            m_rtcincommand;
-u32             m_rtcstatus;
-tm              m_rtcstr;
-u32             m_rtcbitsleft;
-u32             m_rtcbit;
-
-void Release() {
-    if (m_ROM         != 0) {delete [] m_ROM;         m_ROM         = 0;}
+gbaCartridge::gbaCartridge() {
+    m_ready       = false;
+    m_image       = 0;
+    m_backup      = 0;
+    m_flash       = 0;
+    m_savfilename = 0;
+    m_romsize     = 0;
+    m_backuptype  = BACKUP_NONE;
+    m_GPIODIR     = 0;
+    m_GPIOCNT     = 0;
+    m_rtcenable   = false;
+}
+
+gbaCartridge::~gbaCartridge() {
+    Release();
+}
+
+void gbaCartridge::Release() {
+    gbaImage::Release(m_image);
+    m_image = 0;
     if (m_backup      != 0) {delete [] m_backup;      m_backup      = 0;}
     if (m_savfilename != 0) {delete [] m_savfilename; m_savfilename = 0;}
 
@@ -113,41 +65,24 @@ void CorrectAscii7BitString(char *str, u32 size) {
     }
 }
 
-bool LoadROM(char const *filename) {
+u8 const *gbaCartridge::GetROMData(u32 base, u32 size, u8 *temp) {
+    return gbaImage::GetData(m_image, base, size, temp);
+}
+
+bool gbaCartridge::LoadROM(char const *filename) {
     Emulator::LogMessage("Cargando ROM");
     if (filename == 0) {
         Emulator::LogMessage("Nombre de archivo no especificado");
         return false;
     }
     Emulator::LogMessage("Abriendo archivo: %s", filename);
-    std::ifstream romfile(filename, std::ios::ate | std::ios::binary);
-    if (!romfile) {
-        Emulator::LogMessage("Error al abrir el archivo");
-        return false;
-    }
-    u32 romfilesize = (u32)romfile.tellg();
-    Emulator::LogMessage("Tama\xC3\xB1o de archivo: %d bytes", romfilesize);
-    if (romfilesize > 33554432) {
-        Emulator::LogMessage("Solo se utilizaran los primeros 32 MB del archivo");
-        romfilesize = 33554432;
-    }
-    m_romsize = (romfilesize & 3) != 0 ? (romfilesize + 4) & ~3 : romfilesize;
-    if (m_romsize < 256) {m_romsize = 256;}
-    m_ROM = new(std::nothrow) u8[m_romsize];
-    if (m_ROM == 0) {
-        Emulator::LogMessage("Error al asignar memoria para ROM (%d bytes)", m_romsize);
-        return false;
-    }
-    memset(m_ROM, 0xFF, m_romsize);
-    romfile.seekg(0, romfile.beg);
-    romfile.read((char *)m_ROM, m_romsize);
-    if (!romfile) {
-        Emulator::LogMessage("Error al leer el archivo (%d / %d bytes)", (u32)romfile.gcount(), m_romsize);
-        return false;
-    }
-    Emulator::LogMessage("ROM cargado en %d bytes", m_romsize);
+    m_image = gbaImage::Acquire(filename, 256, 33554432);
+    if (m_image == 0) {return false;}
+    m_romsize = m_image->size;
+    Emulator::LogMessage("ROM mapeado en %d bytes (%d del archivo)", m_romsize, m_image->mapsize);
     Emulator::LogMessage("Informacion de ROM");
-    ROMHeader *rh = (ROMHeader *)m_ROM;
+    memcpy(&m_header, GetROMData(0, sizeof(ROMHeader), (u8 *)&m_header), sizeof(ROMHeader));
+    ROMHeader *rh = &m_header;
     memcpy(m_title, rh->gametitle, 12);
     m_title[12] = '\0';
     CorrectAscii7BitString(m_title, 12);
@@ -158,23 +93,24 @@ bool LoadROM(char const *filename) {
     CorrectAscii7BitString(m_code, 8);
     Emulator::LogMessage("Codigo: %s", m_code);
     u32 cs = 0;
-    for (s32 i = 0xA0; i < 0xBD; i++) {cs -= m_ROM[i];}
+    for (s32 i = 0xA0; i < 0xBD; i++) {cs -= ((u8 const *)rh)[i];}
     m_headerchecksum = (cs - 0x19) & 0xFF;
     Emulator::LogMessage("Checksum: %s (0x%X / 0x%X)", m_headerchecksum == rh->headerchecksum ? "OK" : "Incorrecto", m_headerchecksum, rh->headerchecksum);
     return true;
 }
 
-void GetBackupID() {
+void gbaCartridge::GetBackupID() {
     bool backupidfound = false;
     u32  bx;
     u32  cmplen;
     u32  fullen;
+    u8   temp[16];
 
     for (bx = 0; bx < m_romsize && !backupidfound; bx += 4) {
         for (u32 i = 0; i < 5; i++) {
             cmplen = m_backupstringslength[i];
             fullen = cmplen + 3;
-            if ((bx + fullen) <= m_romsize && memcmp(&m_ROM[bx], m_backupstrings[i], cmplen) == 0) {
+            if ((bx + fullen) <= m_romsize && memcmp(GetROMData(bx, fullen, temp), m_backupstrings[i], cmplen) == 0) {
                 backupidfound = true;
                 switch (i) {
                 case 0: m_backuptype = BACKUP_EEPROM;   break;
@@ -183,7 +119,7 @@ void GetBackupID() {
                 case 3: m_backuptype = BACKUP_FLASH512; break;
                 case 4: m_backuptype = BACKUP_FLASH1M;  break;
                 }
-                memcpy(m_backupid, &m_ROM[bx], fullen);
+                memcpy(m_backupid, GetROMData(bx, fullen, temp), fullen);
                 m_backupid[fullen] = '\0';
                 CorrectAscii7BitString(m_backupid, fullen);
                 break;
@@ -199,7 +135,7 @@ void GetBackupID() {
     Emulator::LogMessage("Backup ID: %s (%s)", m_backuptypestr[m_backuptype], m_backupid);
 }
 
-bool LoadBackup(char const *filename, BackupType forcedtype) {
+bool gbaCartridge::LoadBackup(char const *filename, BackupType forcedtype) {
     Emulator::LogMessage("Cargando backup");
     if (forcedtype != BACKUP_NOID) {
         m_backuptype = forcedtype;
@@ -258,7 +194,7 @@ bool LoadBackup(char const *filename, BackupType forcedtype) {
     return true;
 }
 
-void StoreBackup() {
+void gbaCartridge::StoreBackup() {
     if (m_backup == 0) {
         Emulator::LogMessage("No hay datos para almacenar");
         return;
@@ -277,14 +213,19 @@ void StoreBackup() {
     Emulator::LogMessage(!savfile ? "Error al escribir al archivo" : "Backup almacenado");
 }
 
-bool IsLoaded() {return m_ready;}
+bool gbaCartridge::IsLoaded() const {return m_ready;}
+
+void gbaCartridge::GetGameCode(char code[5]) const {
+    if (m_image != 0) {memcpy(code, m_header.gamecode, 4);} else {memset(code, 0, 4);}
+    code[4] = 0;
+}
 
-void WriteSRAM(u32 address, u8 data) {m_backup[address] = data;}
-u8 ReadSRAM(u32 address) {return m_backup[address];}
+void gbaCartridge::WriteSRAM(u32 address, u8 data) {m_backup[address] = data;}
+u8 gbaCartridge::ReadSRAM(u32 address) {return m_backup[address];}
 
-bool CommandFlash() {return m_flash0x5555 == 0xAA && m_flash0x2AAA == 0x55;}
+bool gbaCartridge::CommandFlash() {return m_flash0x5555 == 0xAA && m_flash0x2AAA == 0x55;}
 
-void WriteFlashROM(u32 address, u8 data) {
+void gbaCartridge::WriteFlashROM(u32 address, u8 data) {
     if (m_flashmode == MODE_WRITE) {
         m_flash[address] = data;
         m_flashmode      = MODE_NONE;
@@ -320,7 +261,7 @@ void WriteFlashROM(u32 address, u8 data) {
     }
 }
 
-u8 ReadFlashROM(u32 address) {
+u8 gbaCartridge::ReadFlashROM(u32 address) {
     u8 ret;
     switch (address) {
     case 0:  ret = (m_flashmode == MODE_ID) ? m_flashid.b.b0.b : m_flash[address]; break;
@@ -330,7 +271,7 @@ u8 ReadFlashROM(u32 address) {
     return ret;
 }
 
-void WriteSRAMRegion(u32 address, u8 data) {
+void gbaCartridge::WriteSRAMRegion(u32 address, u8 data) {
     switch (m_backuptype) {
     case BACKUP_SRAM:     WriteSRAM(address & 0x7FFF, data);     break;
     case BACKUP_FLASH512:
@@ -338,7 +279,7 @@ void WriteSRAMRegion(u32 address, u8 data) {
     }
 }
 
-u8 ReadSRAMRegion(u32 address) {
+u8 gbaCartridge::ReadSRAMRegion(u32 address) {
     u8 ret;
     switch (m_backuptype) {
     case BACKUP_SRAM:     ret = ReadSRAM(address & 0x7FFF);     break;
@@ -351,14 +292,14 @@ u8 ReadSRAMRegion(u32 address) {
 
 u8 ToBCD8(u32 byte) {return (byte % 10) | (((byte / 10) % 10) << 4);}
 
-u32 GetEEPROMAddress(u32 buswidth) {
+u32 gbaCartridge::GetEEPROMAddress(u32 buswidth) {
     u32 adr = 0;
     for (u32 i = 0; i < buswidth; i++) {adr |= m_eeprombits[2 + i] << (buswidth - 1 - i);}
     if (buswidth == 14) {adr &= 0x3FF;}
     return adr * 8;
 }
 
-void SetEEPROMWrite(u32 buswidth) {
+void gbaCartridge::SetEEPROMWrite(u32 buswidth) {
     u32 eepromwriteadr = GetEEPROMAddress(buswidth);
     u8  byte;
 
@@ -369,18 +310,18 @@ void SetEEPROMWrite(u32 buswidth) {
     }
 }
 
-void SetEEPROMRead(u32 buswidth) {
+void gbaCartridge::SetEEPROMRead(u32 buswidth) {
     m_eepromread     = true;
     m_eepromreadadr  = GetEEPROMAddress(buswidth);
     m_eeprombitsleft = 67;    
 }
 
-void WriteEEPROM(u32 data) {
+void gbaCartridge::WriteEEPROM(u32 data) {
     m_eeprombits.push_back(data & 1);
     if (m_eeprombits.size() > 81) {m_eeprombits.clear();}
 }
 
-u32 ReadEEPROM() {
+u32 gbaCartridge::ReadEEPROM() {
     u32 bit;
     u32 size;
 
@@ -407,7 +348,7 @@ u32 ReadEEPROM() {
     return bit;
 }
 
-void UpdateRTCRegisters() {
+void gbaCartridge::UpdateRTCRegisters() {
     time_t t;
 
     t        = time(0);
@@ -425,12 +366,12 @@ void UpdateRTCRegisters() {
     m_rtcstr.tm_sec  = ToBCD8(m_rtcstr.tm_sec);
 }
 
-void EnterRTCCommand(u32 bytes) {
+void gbaCartridge::EnterRTCCommand(u32 bytes) {
     m_rtcbitsleft  = bytes * 8;
     m_rtcincommand = true;
 }
 
-void WriteRTC(u32 bits) {
+void gbaCartridge::WriteRTC(u32 bits) {
     u32 prevSCK;
     u32 cmd;
 
@@ -494,7 +435,7 @@ void WriteRTC(u32 bits) {
     }
 }
 
-void InitRTC(bool enable) {
+void gbaCartridge::InitRTC(bool enable) {
     m_GPIODIR      = 0;
     m_GPIOCNT      = 0;
     m_rtcenable    = enable;
@@ -503,7 +444,7 @@ void InitRTC(bool enable) {
     m_rtcbits.clear();
 }
 
-void WriteGPIO(u32 address, u32 bits) {
+void gbaCartridge::WriteGPIO(u32 address, u32 bits) {
     switch (address) {
     case 0x080000C4: WriteRTC(bits & 7);     break;
     case 0x080000C6: m_GPIODIR = bits & 0xF; break;
@@ -511,7 +452,7 @@ void WriteGPIO(u32 address, u32 bits) {
     }
 }
 
-void ReadGPIO(u32 address, u8 *data) {
+void gbaCartridge::ReadGPIO(u32 address, u8 *data) {
     switch (address) {
     case 0x080000C4: *data = (m_rtcSCK | (!BITTEST(m_GPIODIR, 1) ? m_rtcbit : m_rtcSIO) | m_rtcCS) & 0xFF; break;
     case 0x080000C5: *data = 0;                                                                            break;
@@ -522,16 +463,17 @@ void ReadGPIO(u32 address, u8 *data) {
     }
 }
 
-bool Load(char const *filename, BackupType type, bool usertc) {
+bool gbaCartridge::Load(char const *filename, BackupType type, bool usertc) {
     if (!LoadROM(filename)) {return false;}
-    GetBackupID();
+    // Con el tipo de backup forzado no hace falta recorrer todo el ROM
+    if (type == BACKUP_NOID) {GetBackupID();} else {strcpy(m_backupid, "-");}
     if (!LoadBackup(filename, type)) {return false;}
     InitRTC(usertc);
     m_ready = true;    
     return m_ready;
 }
 
-void WriteROMRegion(u32 address, t32 const *data, gbaMemory::DataType width) {
+void gbaCartridge::WriteROMRegion(u32 address, t32 const *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
 
     if (m_backuptype == BACKUP_EEPROM && base >= (m_romsize <= 16777216 ? 0x0D000000U : 0x0DFFFF00U) && base < 0x0E000000) {
@@ -550,16 +492,29 @@ void WriteROMRegion(u32 address, t32 const *data, gbaMemory::DataType width) {
     }    
 }
 
-void ReadROMRegion(u32 address, t32 *data, gbaMemory::DataType width) {
+// Memoria del ROM para una pagina que se lee directamente, o 0 si la pagina incluye GPIO, EEPROM o
+// datos fuera del ROM
+u8 const *gbaCartridge::GetROMPage(u32 address, u32 size) {
+    u32 base = address & 0x01FFFFFF;
+
+    if (m_image == 0 || base + size > m_romsize) {return 0;}
+    if (m_rtcenable && address < 0x080000CA && address + size > 0x080000C4) {return 0;}
+    if (m_backuptype == BACKUP_EEPROM && address + size > (m_romsize <= 16777216 ? 0x0D000000U : 0x0DFFFF00U)) {return 0;}
+
+    return GetROMData(base, size, 0);
+}
+
+void gbaCartridge::ReadROMRegion(u32 address, t32 *data, gbaMemory::DataType width) {
     u32 port = ALIGN(address, width);
     u32 base = port & 0x01FFFFFF;
 
     if (base < m_romsize) {
+        u8 const *rom = GetROMData(base, width, 0);
         switch (width) {
-        case gbaMemory::TYPE_WORD:     data->w.w1.b.b1.b = m_ROM[base | 3];
-                                       data->w.w1.b.b0.b = m_ROM[base | 2];
-        case gbaMemory::TYPE_HALFWORD: data->w.w0.b.b1.b = m_ROM[base | 1];
-        case gbaMemory::TYPE_BYTE:     data->w.w0.b.b0.b = m_ROM[base | 0];
+        case gbaMemory::TYPE_WORD:     data->w.w1.b.b1.b = rom[3];
+                                       data->w.w1.b.b0.b = rom[2];
+        case gbaMemory::TYPE_HALFWORD: data->w.w0.b.b1.b = rom[1];
+        case gbaMemory::TYPE_BYTE:     data->w.w0.b.b0.b = rom[0];
         }
     }
     else {
@@ -587,5 +542,4 @@ void ReadROMRegion(u32 address, t32 *data, gbaMemory::DataType width) {
         }
     }
 }
-}
 //*************************************************************************************************
\ No newline at end of file
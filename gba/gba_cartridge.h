@@ -6,26 +6,125 @@
 
 #pragma once
 
+#include <ctime>
+#include <vector>
 #include "../types.h"
+#include "gba_image.h"
 #include "gba_memory.h"
 
-namespace gbaCartridge {
-enum BackupType {
-    BACKUP_EEPROM,
-    BACKUP_SRAM,
-    BACKUP_FLASH512,
-    BACKUP_FLASH1M,
-    BACKUP_NOID,
-    BACKUP_NONE,
-};
+class gbaCartridge {
+public:
+    enum BackupType {
+        BACKUP_EEPROM,
+        BACKUP_SRAM,
+        BACKUP_FLASH512,
+        BACKUP_FLASH1M,
+        BACKUP_NOID,
+        BACKUP_NONE,
+    };
+
+    gbaCartridge();
+    ~gbaCartridge();
+
+    void Release();
+    void StoreBackup();
+    bool IsLoaded() const;
+    void GetGameCode(char code[5]) const;
+    void WriteSRAMRegion(u32 address, u8 data);
+    u8 ReadSRAMRegion(u32 address);
+    bool Load(char const *filename, BackupType type, bool usertc);
+    void WriteROMRegion(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadROMRegion(u32 address, t32 *data, gbaMemory::DataType width);
+    u8 const *GetROMPage(u32 address, u32 size);
+
+private:
+    enum FlashMode {
+        MODE_NONE,
+        MODE_ID,
+        MODE_ERASE,
+        MODE_WRITE,
+        MODE_BANK
+    };
+
+    struct ROMHeader {
+        u8 ROMentrypoint[4];
+        u8 logo[156];
+        u8 gametitle[12];
+        u8 gamecode[4];
+        u8 makercode[2];
+        u8 v0x96;
+        u8 unitcode;
+        u8 devicetype;
+        u8 reserved1[7];
+        u8 softwareversion;
+        u8 headerchecksum;
+        u8 reserved2[2];
+    };
+
+    bool m_ready;
+
+    // El ROM se mapea del archivo (solo lectura) y se comparte con las demas instancias del mismo
+    // juego
+    gbaImage::Image const *m_image;
+    ROMHeader              m_header;
+
+    u8   *m_backup;
+    u8   *m_flash;
+    char *m_savfilename;
 
-void Release();
-void StoreBackup();
-bool IsLoaded();
-void WriteSRAMRegion(u32 address, u8 data);
-u8 ReadSRAMRegion(u32 address);
-bool Load(char const *filename, BackupType type, bool usertc);
-void WriteROMRegion(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadROMRegion(u32 address, t32 *data, gbaMemory::DataType width);
-}
+    u32        m_romsize;
+    u32        m_backupsize;
+    BackupType m_backuptype;
+
+    FlashMode  m_flashmode;
+    t16        m_flashid;
+    u8         m_flash0x5555;
+    u8         m_flash0x2AAA;
+
+    bool            m_eepromdetect;
+    std::vector<u8> m_eeprombits;
+    bool            m_eepromread;
+    u32             m_eeprombitsleft;
+    u32             m_eepromreadadr;
+
+    char m_title[13];
+    char m_code[9];
+    u32  m_headerchecksum;
+    char m_backupid[14];
+
+    u32 m_GPIODIR;
+    u32 m_GPIOCNT;
+
+    bool            m_rtcenable;
+    std::vector<u8> m_rtcbits;
+    u32             m_rtcSCK;
+    u32             m_rtcCS;
+    u32             m_rtcSIO;
+    bool            m_rtcincommand;
+    u32             m_rtcstatus;
+    tm              m_rtcstr;
+    u32             m_rtcbitsleft;
+    u32             m_rtcbit;
+
+    u8 const *GetROMData(u32 base, u32 size, u8 *temp);
+    bool LoadROM(char const *filename);
+    void GetBackupID();
+    bool LoadBackup(char const *filename, BackupType forcedtype);
+    void WriteSRAM(u32 address, u8 data);
+    u8 ReadSRAM(u32 address);
+    bool CommandFlash();
+    void WriteFlashROM(u32 address, u8 data);
+    u8 ReadFlashROM(u32 address);
+    u32 GetEEPROMAddress(u32 buswidth);
+    void SetEEPROMWrite(u32 buswidth);
+    void SetEEPROMRead(u32 buswidth);
+    void WriteEEPROM(u32 data);
+    u32 ReadEEPROM();
+    void UpdateRTCRegisters();
+    void EnterRTCCommand(u32 bytes);
+    void WriteRTC(u32 bits);
+    void InitRTC(bool enable);
+    void WriteGPIO(u32 address, u32 bits);
+    void ReadGPIO(u32 address, u8 *data);
+};
 //*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,135 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#include <cstring>
+#include "gba_console.h"
+#include "../emulator.h"
+
+// Juegos (codigo de 4 letras del cartucho) en los que no se adelantan los ciclos ociosos
+char const * const m_idleoverride[] =
+{
+    0
+};
+
+gbaConsole::gbaConsole() :
+    control(this),
+    cpu(this),
+    display(this),
+    dma(this),
+    keyinput(this),
+    memory(this),
+    scheduler(this),
+    sound(this),
+    timer(this),
+    m_run(false),
+    m_end(true),
+    m_idleenable(true),
+    m_idleskip(false),
+    m_userdata(0)
+{
+}
+
+void gbaConsole::SetUserData(void *data)
+{
+    m_userdata = data;
+}
+
+void *gbaConsole::GetUserData() const
+{
+    return m_userdata;
+}
+
+void gbaConsole::Reset()
+{
+    scheduler.Reset();
+    control.Reset();
+    display.Reset();
+    dma.Reset();
+    keyinput.Reset();
+    memory.Reset();
+    sio.Reset();
+    sound.Reset();
+    timer.Reset();
+    cpu.Reset();
+}
+
+void gbaConsole::Run()
+{
+    s32 next = scheduler.GetNextEvent();
+
+    s32 t;
+    s32 ticks = 0;
+    s32 limit;
+
+    switch (control.IsHalted()) {
+    case gbaControl::POWERDOWN_NONE:
+        // Con IRQ o DMA pendientes solo se ejecuta una instruccion antes de atenderlos
+        limit = (control.Sync() || dma.IsSyncPending()) ? 0 : next;
+        cpu.ResetIdleLoop();
+        do {
+            t = cpu.Execute(limit - ticks);
+            ticks += t;
+            if (m_idleskip) {ticks += cpu.SkipIdleLoop(ticks, limit);}
+        } while (ticks < next && (!control.Sync()) && !dma.IsSyncPending() && control.IsHalted() == gbaControl::POWERDOWN_NONE);
+        break;
+    case gbaControl::POWERDOWN_HALT:
+        ticks = next;
+        break;
+    case gbaControl::POWERDOWN_STOP:
+        keyinput.Sync();
+        scheduler.Skip(gbaScheduler::EVENT_DISPLAY);
+        return;
+    }
+    
+    scheduler.Advance(ticks);
+
+    ticks = 0;
+    next = scheduler.GetNextEvent();
+
+    while (dma.IsSyncPending()) {        
+        ticks += dma.Sync(next);
+        if (ticks >= next) {scheduler.Advance(ticks); ticks = 0; next = scheduler.GetNextEvent();}
+    }
+
+    scheduler.Advance(ticks);
+
+    if (control.Sync()) {cpu.RequestInterrupt();}
+}
+
+void gbaConsole::EnableIdleLoopSkip(bool enable)
+{
+    m_idleenable = enable;
+}
+
+void gbaConsole::StartEmulation()
+{
+    Reset();
+    if (!bios.IsLoaded() || !cartridge.IsLoaded()) {return;}
+
+    char code[5];
+    cartridge.GetGameCode(code);
+    m_idleskip = m_idleenable;
+    for (u32 i = 0; m_idleoverride[i] != 0; i++) {if (strcmp(code, m_idleoverride[i]) == 0) {m_idleskip = false; Emulator::LogMessage("Ciclos ociosos desactivados para %s", code);}}
+    m_run = true;
+    m_end = false;
+    while (m_run) {Run();}
+    sound.Flush();
+    display.Release();
+    cartridge.StoreBackup();
+    cartridge.Release();
+    m_end = true;
+}
+
+bool gbaConsole::IsRunning() const
+{
+    return !m_end;
+}
+
+void gbaConsole::StopEmulation()
+{
+    m_run = false;
+}
+//*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,61 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+    
+#pragma once
+
+#include "gba_bios.h"
+#include "gba_cartridge.h"
+#include "gba_control.h"
+#include "gba_cpu.h"
+#include "gba_display.h"
+#include "gba_dma.h"
+#include "gba_keyinput.h"
+#include "gba_memory.h"
+#include "gba_scheduler.h"
+#include "gba_sio.h"
+#include "gba_sound.h"
+#include "gba_timer.h"
+
+// Una maquina completa; cada instancia es independiente y puede ejecutarse en su propio hilo
+class gbaConsole
+{
+public:
+    gbaBIOS      bios;
+    gbaCartridge cartridge;
+    gbaControl   control;
+    gbaCPU       cpu;
+    gbaDisplay   display;
+    gbaDMA       dma;
+    gbaKeyInput  keyinput;
+    gbaMemory    memory;
+    gbaScheduler scheduler;
+    gbaSIO       sio;
+    gbaSound     sound;
+    gbaTimer     timer;
+
+    gbaConsole();
+
+    void SetUserData(void *data);
+    void *GetUserData() const;
+    void EnableIdleLoopSkip(bool enable);
+    void StartEmulation();
+    bool IsRunning() const;
+    void StopEmulation();
+
+private:
+    volatile bool m_run;
+    volatile bool m_end;
+
+    bool m_idleenable;
+    bool m_idleskip;
+
+    void *m_userdata; // Dato del frontend para sus funciones de Emulator
+
+    void Reset();
+    void Run();
+};
+
+//*************************************************************************************************
\ No newline at end of file
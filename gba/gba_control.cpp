@@ -6,83 +6,111 @@
 
 #include "../emulator.h"
 #include "gba_control.h"
+#include "gba_console.h"
 
-namespace gbaControl {
 const s32 m_PHIfrequency[4]    = {0, 4194304, 8388608, 16777216};
 const s32 m_firstaccess[4]     = {5, 4, 3, 9};
 const s32 m_WS0secondaccess[2] = {3, 2};
 const s32 m_WS1secondaccess[2] = {5, 2};
 const s32 m_WS2secondaccess[2] = {9, 2};
 
-t8   m_IME;
-t16  m_IE;
-t16  m_IF;
-t16  m_WAITCNT;
-t8   m_POSTFLG;
-t8   m_u0x04000410;
-t32  m_u0x04000800;
-
-PowerDownMode m_halt;
+gbaControl::gbaControl(gbaConsole *console) : m_console(console) {
+    Reset();
+}
 
-PowerDownMode IsHalted() {return m_halt;}
-void WakeUp() {m_halt = POWERDOWN_NONE;}
+gbaControl::PowerDownMode gbaControl::IsHalted() const {return m_halt;}
+void gbaControl::WakeUp() {m_halt = POWERDOWN_NONE;}
 
-void RequestInterrupt(InterruptFlag irq) {if (m_halt != POWERDOWN_STOP) {m_IF.w |= irq;} else if ((irq & (IRQ_KEYPAD | IRQ_GAMEPAK | IRQ_SIO) & m_IE.w) != 0) {WakeUp();}}
+void gbaControl::RequestInterrupt(InterruptFlag irq) {if (m_halt != POWERDOWN_STOP) {m_IF.w |= irq;} else if ((irq & (IRQ_KEYPAD | IRQ_GAMEPAK | IRQ_SIO) & m_IE.w) != 0) {WakeUp();}}
 
-bool Sync() {
+bool gbaControl::Sync() {
     bool irqcause = (m_IE.w & m_IF.w & IRQ_ALL) != 0;
     if (irqcause) {WakeUp();}
     return irqcause && BITTEST(m_IME.b, 0);
 }
 
-s32 GetPHITerminalFrequency() {return m_PHIfrequency[SUBVAL(m_WAITCNT.w, 11, 3)];}
-bool IsGamePakPrefetchEnabled() {return BITTEST(m_WAITCNT.w, 14);}
-
-bool IsWRAMEnabled()     {return !BITTEST(m_u0x04000800.d, 0);}
-bool IsWRAM256KEnabled() {return  BITTEST(m_u0x04000800.d, 5);}
+s32 gbaControl::GetPHITerminalFrequency() const {return m_PHIfrequency[SUBVAL(m_WAITCNT.w, 11, 3)];}
+bool gbaControl::IsGamePakPrefetchEnabled() const {return m_prefetch;}
+
+bool gbaControl::IsWRAMEnabled() const     {return !BITTEST(m_u0x04000800.d, 0);}
+bool gbaControl::IsWRAM256KEnabled() const {return  BITTEST(m_u0x04000800.d, 5);}
+
+void gbaControl::UpdateWaitTable() {
+    s32 WS[3][2] = {
+        {m_firstaccess[SUBVAL(m_WAITCNT.w, 2, 3)], m_WS0secondaccess[SUBVAL(m_WAITCNT.w,  4, 1)]},
+        {m_firstaccess[SUBVAL(m_WAITCNT.w, 5, 3)], m_WS1secondaccess[SUBVAL(m_WAITCNT.w,  7, 1)]},
+        {m_firstaccess[SUBVAL(m_WAITCNT.w, 8, 3)], m_WS2secondaccess[SUBVAL(m_WAITCNT.w, 10, 1)]}
+    };
+    bool wram256k = IsWRAMEnabled() && IsWRAM256KEnabled();
+    s32  wram     = wram256k ? (16 - SUBVAL(m_u0x04000800.d, 24, 0xF)) : 1;
+    s32 sram = m_firstaccess[SUBVAL(m_WAITCNT.w, 0, 3)];
+
+    for (u32 region = 0; region < 16; region++) {
+        for (u32 i = 0; i < 3; i++) {
+            RegionWait *wait = &m_regionwait[region][i];
+            bool        word = i == 2;
+            switch (region) {
+            case 0x02: wait->N = wait->S = (word && wram256k) ? (wram << 1) : wram; break;
+            case 0x05:
+            case 0x06: wait->N = wait->S = word ? 2 : 1;              break;
+            case 0x08:
+            case 0x09:
+            case 0x0A:
+            case 0x0B:
+            case 0x0C:
+            case 0x0D:
+                wait->N = WS[(region - 0x08) >> 1][0];
+                wait->S = WS[(region - 0x08) >> 1][1];
+                if (word) {
+                    wait->N += wait->S;
+                    wait->S += wait->S;
+                }
+                break;
+            case 0x0E:
+            case 0x0F: wait->N = wait->S = sram;                      break;
+            default:   wait->N = wait->S = 1;
+            }
+        }
+    }
 
-void GetWRAM256KRegionWait(gbaMemory::DataType width, s32 *N_access, s32 *S_access) {*N_access = *S_access = (16 - SUBVAL(m_u0x04000800.d, 24, 0xF)) << (width >> 2);}
+    m_prefetch = BITTEST(m_WAITCNT.w, 14);
+}
 
-void GetROMRegionWait(u32 address, gbaMemory::DataType width, s32 *N_access, s32 *S_access) {
-    u32 base = ALIGN(address, width);
-    s32 N, S;
-
-         if (base < 0x0A000000) {N = m_firstaccess[SUBVAL(m_WAITCNT.w, 2, 3)]; S = m_WS0secondaccess[SUBVAL(m_WAITCNT.w,  4, 1)];}
-    else if (base < 0x0C000000) {N = m_firstaccess[SUBVAL(m_WAITCNT.w, 5, 3)]; S = m_WS1secondaccess[SUBVAL(m_WAITCNT.w,  7, 1)];}
-    else                        {N = m_firstaccess[SUBVAL(m_WAITCNT.w, 8, 3)]; S = m_WS2secondaccess[SUBVAL(m_WAITCNT.w, 10, 1)];}
-    
-    if (width == gbaMemory::TYPE_WORD) {
-        N += S;
-        S += S;
-    }
+void gbaControl::GetRegionWait(u32 address, gbaMemory::DataType width, s32 *N_access, s32 *S_access) const {
+    RegionWait const *wait = &m_regionwait[SUBVAL(address, 24, 0xF)][width >> 1];
+    *N_access = wait->N;
+    *S_access = wait->S;
+}
 
-    if ((base & 0x0001FFFF) == 0) {S = N;}
+void gbaControl::GetWRAM256KRegionWait(gbaMemory::DataType width, s32 *N_access, s32 *S_access) const {GetRegionWait(0x02000000, width, N_access, S_access);}
 
-    *N_access = N;
-    *S_access = S;
+void gbaControl::GetROMRegionWait(u32 address, gbaMemory::DataType width, s32 *N_access, s32 *S_access) const {
+    u32 base = ALIGN(address, width);
+    GetRegionWait(base, width, N_access, S_access);
+    if ((base & 0x0001FFFF) == 0) {*S_access = *N_access;}
 }
 
-void GetSRAMRegionWait(s32 *N_access, s32 *S_access) {*N_access = *S_access = m_firstaccess[SUBVAL(m_WAITCNT.w, 0, 3)];}
+void gbaControl::GetSRAMRegionWait(s32 *N_access, s32 *S_access) const {GetRegionWait(0x0E000000, gbaMemory::TYPE_BYTE, N_access, S_access);}
 
-void WriteIE_B0(u8 byte) {m_IE.b.b0.b = byte;}
-void WriteIE_B1(u8 byte) {m_IE.b.b1.b = byte & 0x3F;}
+void gbaControl::WriteIE_B0(u8 byte) {m_IE.b.b0.b = byte;}
+void gbaControl::WriteIE_B1(u8 byte) {m_IE.b.b1.b = byte & 0x3F;}
 
-void WriteIF_B0(u8 byte) {m_IF.b.b0.b &=        ~byte;}
-void WriteIF_B1(u8 byte) {m_IF.b.b1.b &= 0x3F & ~byte;}
+void gbaControl::WriteIF_B0(u8 byte) {m_IF.b.b0.b &=        ~byte;}
+void gbaControl::WriteIF_B1(u8 byte) {m_IF.b.b1.b &= 0x3F & ~byte;}
 
-void WriteIME(u8 byte) {m_IME.b = byte & 0x01;}
+void gbaControl::WriteIME(u8 byte) {m_IME.b = byte & 0x01;}
 
-void WriteWAITCNT_B0(u8 byte) {m_WAITCNT.b.b0.b = byte;}
-void WriteWAITCNT_B1(u8 byte) {m_WAITCNT.b.b1.b = byte & ~(BIT(5) | BIT(7));}
+void gbaControl::WriteWAITCNT_B0(u8 byte) {m_WAITCNT.b.b0.b = byte;                      UpdateWaitTable(); m_console->memory.UpdatePageTable(); m_console->cpu.FlushCodeCache();}
+void gbaControl::WriteWAITCNT_B1(u8 byte) {m_WAITCNT.b.b1.b = byte & ~(BIT(5) | BIT(7)); UpdateWaitTable(); m_console->memory.UpdatePageTable(); m_console->cpu.FlushCodeCache();}
 
-void WritePOSTFLG(u8 byte) {m_POSTFLG.b = byte & 1;}
+void gbaControl::WritePOSTFLG(u8 byte) {m_POSTFLG.b = byte & 1;}
 
-void WriteHALTCNT(u8 byte) {m_halt = BITTEST(byte, 7) ? POWERDOWN_STOP : POWERDOWN_HALT;}
+void gbaControl::WriteHALTCNT(u8 byte) {m_halt = BITTEST(byte, 7) ? POWERDOWN_STOP : POWERDOWN_HALT;}
 
-void Write0x04000800(u8 byte) {m_u0x04000800.w.w0.b.b0.b = byte & ~(BIT(4) | BIT(6) | BIT(7));}
-void Write0x04000803(u8 byte) {m_u0x04000800.w.w1.b.b1.b = byte;}
+void gbaControl::Write0x04000800(u8 byte) {m_u0x04000800.w.w0.b.b0.b = byte & ~(BIT(4) | BIT(6) | BIT(7)); UpdateWaitTable(); m_console->memory.UpdatePageTable(); m_console->cpu.FlushCodeCache();}
+void gbaControl::Write0x04000803(u8 byte) {m_u0x04000800.w.w1.b.b1.b = byte;                              UpdateWaitTable(); m_console->memory.UpdatePageTable(); m_console->cpu.FlushCodeCache();}
 
-void Reset() {
+void gbaControl::Reset() {
     m_IME.b         = 0;
     m_IE.w          = 0;
     m_IF.w          = 0;
@@ -91,9 +119,10 @@ void Reset() {
     m_u0x04000410.b = 0;
     m_u0x04000800.d = 0x0D000020;
     m_halt          = POWERDOWN_NONE;
+    UpdateWaitTable();
 }
 
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
+void gbaControl::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     if ((base & 0xFF00FFFC) == 0x04000800) {base &= 0xFF00FFFF;}
     UNPACK_IO_BYTES(data)
@@ -113,7 +142,7 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     END_IO_TABLE()
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
+void gbaControl::ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     if ((base & 0xFF00FFFC) == 0x04000800) {base &= 0xFF00FFFF;}
     UNPACK_IO_POINTERS(data)
@@ -141,5 +170,4 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
         IO_READ_DIRECT(0x04000803, m_u0x04000800.w.w1.b.b1.b)
     END_IO_TABLE()
 }
-}
 //*************************************************************************************************
\ No newline at end of file
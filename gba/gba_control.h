@@ -9,43 +9,86 @@
 #include "../types.h"
 #include "gba_memory.h"
 
-namespace gbaControl {
-enum InterruptFlag {
-    IRQ_VBLANK   = BIT(0),
-    IRQ_HBLANK   = BIT(1),
-    IRQ_VCOUNTER = BIT(2),
-    IRQ_TIMER0   = BIT(3),
-    IRQ_TIMER1   = BIT(4),
-    IRQ_TIMER2   = BIT(5),
-    IRQ_TIMER3   = BIT(6),
-    IRQ_SIO      = BIT(7),
-    IRQ_DMA0     = BIT(8),
-    IRQ_DMA1     = BIT(9),
-    IRQ_DMA2     = BIT(10),
-    IRQ_DMA3     = BIT(11),
-    IRQ_KEYPAD   = BIT(12),
-    IRQ_GAMEPAK  = BIT(13),
-    IRQ_ALL      = BIT(14) - 1
-};
+class gbaConsole;
 
-enum PowerDownMode {
-    POWERDOWN_NONE,
-    POWERDOWN_HALT,
-    POWERDOWN_STOP
-};
+class gbaControl {
+public:
+    enum InterruptFlag {
+        IRQ_VBLANK   = BIT(0),
+        IRQ_HBLANK   = BIT(1),
+        IRQ_VCOUNTER = BIT(2),
+        IRQ_TIMER0   = BIT(3),
+        IRQ_TIMER1   = BIT(4),
+        IRQ_TIMER2   = BIT(5),
+        IRQ_TIMER3   = BIT(6),
+        IRQ_SIO      = BIT(7),
+        IRQ_DMA0     = BIT(8),
+        IRQ_DMA1     = BIT(9),
+        IRQ_DMA2     = BIT(10),
+        IRQ_DMA3     = BIT(11),
+        IRQ_KEYPAD   = BIT(12),
+        IRQ_GAMEPAK  = BIT(13),
+        IRQ_ALL      = BIT(14) - 1
+    };
+
+    enum PowerDownMode {
+        POWERDOWN_NONE,
+        POWERDOWN_HALT,
+        POWERDOWN_STOP
+    };
+
+    gbaControl(gbaConsole *console);
+
+    void Reset();
+    PowerDownMode IsHalted() const;
+    void RequestInterrupt(InterruptFlag irq);
+    bool Sync();
+    s32 GetPHITerminalFrequency() const;
+    bool IsGamePakPrefetchEnabled() const;
+    bool IsWRAMEnabled() const;
+    bool IsWRAM256KEnabled() const;
+    void GetRegionWait(u32 address, gbaMemory::DataType width, s32 *N_access, s32 *S_access) const;
+    void GetWRAM256KRegionWait(gbaMemory::DataType width, s32 *N_access, s32 *S_access) const;
+    void GetROMRegionWait(u32 address, gbaMemory::DataType width, s32 *N_access, s32 *S_access) const;
+    void GetSRAMRegionWait(s32 *N_access, s32 *S_access) const;
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
+
+private:
+    // Espera por region (bits 27 a 24 de la direccion) y ancho (byte, halfword, word), se recalcula
+    // al escribir WAITCNT o 0x04000800
+    struct RegionWait {
+        s32 N;
+        s32 S;
+    };
 
-void Reset();
-PowerDownMode IsHalted();
-void RequestInterrupt(InterruptFlag irq);
-bool Sync();
-s32 GetPHITerminalFrequency();
-bool IsGamePakPrefetchEnabled();
-bool IsWRAMEnabled();
-bool IsWRAM256KEnabled();
-void GetWRAM256KRegionWait(gbaMemory::DataType width, s32 *N_access, s32 *S_access);
-void GetROMRegionWait(u32 address, gbaMemory::DataType width, s32 *N_access, s32 *S_access);
-void GetSRAMRegionWait(s32 *N_access, s32 *S_access);
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-}
+    gbaConsole *m_console;
+
+    t8   m_IME;
+    t16  m_IE;
+    t16  m_IF;
+    t16  m_WAITCNT;
+    t8   m_POSTFLG;
+    t8   m_u0x04000410;
+    t32  m_u0x04000800;
+
+    PowerDownMode m_halt;
+
+    RegionWait m_regionwait[16][3];
+    bool       m_prefetch;
+
+    void WakeUp();
+    void UpdateWaitTable();
+    void WriteIE_B0(u8 byte);
+    void WriteIE_B1(u8 byte);
+    void WriteIF_B0(u8 byte);
+    void WriteIF_B1(u8 byte);
+    void WriteIME(u8 byte);
+    void WriteWAITCNT_B0(u8 byte);
+    void WriteWAITCNT_B1(u8 byte);
+    void WritePOSTFLG(u8 byte);
+    void WriteHALTCNT(u8 byte);
+    void Write0x04000800(u8 byte);
+    void Write0x04000803(u8 byte);
+};
 //*************************************************************************************************
\ No newline at end of file
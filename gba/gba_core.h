@@ -1,16 +0,0 @@
-//*************************************************************************************************
-// Project Heron - GBA Emulator
-// jcds (jdibenes@outlook.com)
-// 2013
-//*************************************************************************************************
-    
-#pragma once
-
-namespace gbaCore
-{
-void StartEmulation();
-bool IsRunning();
-void StopEmulation();
-}
-
-//*************************************************************************************************
\ No newline at end of file
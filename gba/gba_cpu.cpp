@@ -4,22 +4,22 @@
 // 2013
 //*************************************************************************************************
 
-#include "gba_memory.h"
+#include <cstring>
+#include <mutex>
+#include "gba_console.h"
 #include "gba_cpu.h"
 #include "../emulator.h"
 
-namespace gbaCPU
-{
-enum Exception
-{
-    EXCEPTION_RESET,
-    EXCEPTION_DATAABORT,
-    EXCEPTION_FIQ,
-    EXCEPTION_IRQ,
-    EXCEPTION_PREFETCHABORT,
-    EXCEPTION_SOFTWAREINTERRUPT,
-    EXCEPTION_UNDEFINEDINSTRUCTION
-};
+#if defined(_M_X64) || defined(__x86_64__)
+#define GBA_RECOMPILER
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
 
 enum ExceptionVector
 {
@@ -90,39 +90,33 @@ const bool truthtable[16][16] =
     {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}  // F -- X           reservado
 };
 
-s32 (*DecodeAndExecute)();
-
-t32  opcode[3];
-s32  N_cycle, S_cycle;
-bool exceptionlock;
-
-gbaMemory::DataType instructionlength;
-
-t8 * const prefetch32[4] = {&opcode[2].w.w0.b.b0, &opcode[2].w.w0.b.b1, &opcode[2].w.w1.b.b0, &opcode[2].w.w1.b.b1};
-t8 * const prefetch16[4] = {&opcode[2].w.w0.b.b0, &opcode[2].w.w0.b.b1, &opcode[2].w.w0.b.b0, &opcode[2].w.w0.b.b1};
-
-t8 * const *prefetch;
+#define HANDLER(name) &gbaCPU::Dispatch<&gbaCPU::name>
 
-t32 R0, R1, R2, R3, R4, R5, R6, R7, R8, R9, R10, R11, R12, R13, R14, R15, CPSR, SPSR;
-t32 R8_fiq, R9_fiq, R10_fiq, R11_fiq, R12_fiq;
-t32 R13_fiq, R14_fiq, SPSR_fiq;
-t32 R13_svc, R14_svc, SPSR_svc;
-t32 R13_abt, R14_abt, SPSR_abt;
-t32 R13_irq, R14_irq, SPSR_irq;
-t32 R13_und, R14_und, SPSR_und;
+// Las tablas de manejadores solo dependen del opcode y se comparten entre todos los CPU
+gbaCPU::InstructionHandler gbaCPU::ARM_Handler[4096];
+gbaCPU::InstructionHandler gbaCPU::THUMB_Handler[1024];
 
-t32 * const RX[16]     = {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13,     &R14,     &R15};
-t32 * const RX_fiq[16] = {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8_fiq, &R9_fiq, &R10_fiq, &R11_fiq, &R12_fiq, &R13_fiq, &R14_fiq, &R15};
-t32 * const RX_svc[16] = {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_svc, &R14_svc, &R15};
-t32 * const RX_abt[16] = {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_abt, &R14_abt, &R15};
-t32 * const RX_irq[16] = {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_irq, &R14_irq, &R15};
-t32 * const RX_und[16] = {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_und, &R14_und, &R15};
+std::once_flag handlertables;
 
-t32 * const *RX_xxx;
-t32         *SPSR_xxx;
-
-s32   ARM_DecodeAndExecute();
-s32 THUMB_DecodeAndExecute();
+gbaCPU::gbaCPU(gbaConsole *console) :
+    m_console(console),
+    engine(ENGINE_INTERPRETER),
+    currentblock(0),
+    prefetch32{&opcode[2].w.w0.b.b0, &opcode[2].w.w0.b.b1, &opcode[2].w.w1.b.b0, &opcode[2].w.w1.b.b1},
+    prefetch16{&opcode[2].w.w0.b.b0, &opcode[2].w.w0.b.b1, &opcode[2].w.w0.b.b0, &opcode[2].w.w0.b.b1},
+    RX    {&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13,     &R14,     &R15},
+    RX_fiq{&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8_fiq, &R9_fiq, &R10_fiq, &R11_fiq, &R12_fiq, &R13_fiq, &R14_fiq, &R15},
+    RX_svc{&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_svc, &R14_svc, &R15},
+    RX_abt{&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_abt, &R14_abt, &R15},
+    RX_irq{&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_irq, &R14_irq, &R15},
+    RX_und{&R0, &R1, &R2, &R3, &R4, &R5, &R6, &R7, &R8,     &R9,     &R10,     &R11,     &R12,     &R13_und, &R14_und, &R15},
+    jitbuffer(0),
+    jitused(0),
+    jitcode(0)
+{
+    std::call_once(handlertables, [] {ARM_BuildHandlerTable(); THUMB_BuildHandlerTable();});
+    FlushCodeCache();
+}
 
 #define BIC_CPSR(f)          (CPSR.d & ~(f))
 
@@ -132,7 +126,64 @@ s32 THUMB_DecodeAndExecute();
 #define SET_V_ADD(o1, o2, r) (BITTEST(((o1) ^ (r)) & ( (o2) ^ (r)), 31) ? FLAG_V : 0)
 #define SET_V_SUB(o1, o2, r) (BITTEST(((o1) ^ (r)) & (~(o2) ^ (r)), 31) ? FLAG_V : 0)
 
-void EnterOperatingMode(u32 mode)
+// Banderas diferidas -------------------------------------------------------------------------------
+// Las instrucciones solo guardan el resultado y los operandos de la ultima operacion que afecto
+// las banderas; N, Z, C y V se calculan en CPSR cuando alguien las lee (UpdateFlags)
+void gbaCPU::UpdateCarryOverflow()
+{
+    u32 c;
+    u32 v;
+
+    switch (lazy.cv)
+    {
+    case FLAGOP_ADD: c = SET_C(lazy.ret < lazy.rs);                             v = SET_V_ADD(lazy.rs, lazy.rn, lazy.ret); break;
+    case FLAGOP_ADC: c = SET_C((lazy.par < lazy.rn) || (lazy.ret < lazy.rs));   v = SET_V_ADD(lazy.rs, lazy.rn, lazy.ret); break;
+    case FLAGOP_SUB: c = SET_C(lazy.rn <= lazy.rs);                             v = SET_V_SUB(lazy.rs, lazy.rn, lazy.ret); break;
+    case FLAGOP_SBC: c = SET_C((lazy.par <= lazy.rs) && (lazy.ret <= lazy.par)); v = SET_V_SUB(lazy.rs, lazy.rn, lazy.ret); break;
+    default: return;
+    }
+
+    CPSR.d  = BIC_CPSR(FLAG_C | FLAG_V) | c | v;
+    lazy.cv = FLAGOP_NONE;
+}
+
+void gbaCPU::UpdateFlags()
+{
+    if (lazy.nz) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(lazy.result) | SET_Z(lazy.result); lazy.nz = false;}
+    UpdateCarryOverflow();
+}
+
+bool gbaCPU::GetCarry()
+{
+    UpdateCarryOverflow();
+    return (CPSR.d & FLAG_C) != 0;
+}
+
+void gbaCPU::SetNZ(u32 result)
+{
+    lazy.nz     = true;
+    lazy.result = result;
+}
+
+void gbaCPU::SetNZC(u32 result, bool c)
+{
+    UpdateCarryOverflow();
+    CPSR.d = BIC_CPSR(FLAG_C) | SET_C(c);
+    SetNZ(result);
+}
+
+void gbaCPU::SetNZCV(FlagOperation cv, u32 rs, u32 rn, u32 par, u32 ret)
+{
+    lazy.nz     = true;
+    lazy.result = ret;
+    lazy.cv     = cv;
+    lazy.rs     = rs;
+    lazy.rn     = rn;
+    lazy.par    = par;
+    lazy.ret    = ret;
+}
+
+void gbaCPU::EnterOperatingMode(u32 mode)
 {
     switch (mode)
     {
@@ -149,26 +200,123 @@ void EnterOperatingMode(u32 mode)
     CPSR.d = (CPSR.d & ~MODE_BITS) | mode;
 }
 
-void EnterOperatingState(u32 tbit)
+void gbaCPU::EnterOperatingState(u32 tbit)
 {
     if (tbit != 0)
     {
         CPSR.d           |=  FLAG_T;
         instructionlength =  gbaMemory::TYPE_HALFWORD;
         prefetch          =  prefetch16;
-        DecodeAndExecute  = &THUMB_DecodeAndExecute;
+        DecodeAndExecute  = HANDLER(THUMB_DecodeAndExecute);
     }
     else
     {
         CPSR.d           &= ~FLAG_T;
         instructionlength =  gbaMemory::TYPE_WORD;
         prefetch          =  prefetch32;
-        DecodeAndExecute  = &ARM_DecodeAndExecute;
+        DecodeAndExecute  = HANDLER(ARM_DecodeAndExecute);
+    }
+}
+
+gbaCPU::InstructionHandler gbaCPU::Decode(u32 op)
+{
+    return (instructionlength == gbaMemory::TYPE_WORD) ? ARM_Handler[SUBVAL(op, 16, 0xFF0) | SUBVAL(op, 4, 0xF)] : THUMB_Handler[SUBVAL(op, 6, 0x3FF)];
+}
+
+bool gbaCPU::IsBranch(u32 op)
+{
+    if (instructionlength == gbaMemory::TYPE_WORD)
+    {
+        return ((op & 0x0E000000) == 0x0A000000) || // B, BL
+               ((op & 0x0F000000) == 0x0F000000) || // SWI
+               ((op & 0x0FFFFFF0) == 0x012FFF10) || // BX
+               ((op & 0x0E108000) == 0x08108000) || // LDM con PC
+               ((op & 0x0C10F000) == 0x0410F000) || // LDR PC
+               ((op & 0x0C00F000) == 0x0000F000);   // Data Processing con PC como destino
+    }
+    else
+    {
+        return ((op & 0xF000) == 0xD000) || // Bcc, SWI
+               ((op & 0xE000) == 0xE000) || // B, BL
+               ((op & 0xFF00) == 0x4700) || // BX
+               ((op & 0xFF00) == 0xBD00) || // POP con PC
+               ((op & 0xFD87) == 0x4487);   // ADD/MOV con PC como destino
+    }
+}
+
+void gbaCPU::FlushCodeCache()
+{
+    // La direccion invalida evita que un bloque en ejecucion por el recompilador se reutilice al salir
+    for (u32 i = 0; i < BLOCK_CACHESIZE; i++) {codeblock[i].address = 1; codeblock[i].length = 0; codeblock[i].closed = false;}
+    currentblock = 0;
+    DiscardCompiledCode();
+}
+
+gbaCPU::CodeBlock *gbaCPU::FindCodeBlock(u32 address)
+{
+    u32 const *writes = m_console->memory.GetPageWriteCount(address);
+    if (writes == 0) {return 0;}
+
+    CodeBlock *block = &codeblock[((address >> 1) ^ (address >> 12)) & (BLOCK_CACHESIZE - 1)];
+
+    if (block->address != address || block->width != instructionlength || block->writes != writes || block->stamp != *writes)
+    {
+        block->address = address;
+        block->length  = 0;
+        block->width   = instructionlength;
+        block->closed  = false;
+        block->writes  = writes;
+        block->stamp   = *writes;
+        block->hits    = 0;
+        block->code    = 0;
+    }
+
+    return block;
+}
+
+// Captura la siguiente instruccion desde el bloque actual o desde memoria
+void gbaCPU::FetchOpcode(u32 address, u32 slot, s32 *N_access, s32 *S_access)
+{
+    CodeBlock *block = currentblock;
+    u32        index = currententry;
+
+    if (block == 0 || block->width != instructionlength || address != block->address + (index * instructionlength) || block->stamp != *block->writes)
+    {
+        block = FindCodeBlock(address);
+        index = 0;
+    }
+
+    if (block != 0 && index < block->length)
+    {
+        CodeEntry const *entry = &block->entry[index];
+        opcode[slot].d = entry->opcode;
+        decoded[slot]  = entry->handler;
+        *N_access      = entry->N;
+        *S_access      = entry->S;
+        currentblock   = block;
+        currententry   = index + 1;
+        return;
     }
+
+    opcode[slot].d = (instructionlength == gbaMemory::TYPE_WORD) ? m_console->memory.Fetch32(address, N_access, S_access) : m_console->memory.Fetch16(address, N_access, S_access);
+    decoded[slot] = Decode(opcode[slot].d);
+
+    if (block == 0 || block->closed) {currentblock = 0; return;}
+
+    CodeEntry *entry = &block->entry[index];
+    entry->opcode  = opcode[slot].d;
+    entry->handler = decoded[slot];
+    entry->N       = *N_access;
+    entry->S       = *S_access;
+    block->length  = index + 1;
+    block->closed  = IsBranch(entry->opcode) || (block->length >= BLOCK_MAXLENGTH) || (((address + instructionlength) & 0xFF) == 0);
+    currentblock   = block;
+    currententry   = index + 1;
 }
 
-s32 BranchAbsolute(u32 address, bool bx, bool bl, u32 link)
+s32 gbaCPU::BranchAbsolute(u32 address, bool bx, bool bl, u32 link)
 {
+    u32 source = R15.d;
     u32 target;
     s32 N[2];
     s32 S[2];
@@ -179,22 +327,20 @@ s32 BranchAbsolute(u32 address, bool bx, bool bl, u32 link)
     target = address & ~(instructionlength - 1);
     R15.d  = target + instructionlength;
 
-    gbaMemory::Read(target, &opcode[1], instructionlength, &N[0], &S[0]);
-    gbaMemory::Read(R15.d,  &opcode[2], instructionlength, &N[1], &S[1]);
+    idlebranch = target <= source && (source - target) <= IDLE_MAXLENGTH;
+
+    FetchOpcode(target, 1, &N[0], &S[0]);
+    FetchOpcode(R15.d,  2, &N[1], &S[1]);
 
     return N[0] + S[1];
 }
 
-u32 GetNextPC()
+u32 gbaCPU::GetNextPC()
 {
     return R15.d - instructionlength;
 }
 
-bool IsOpcodeFetch(t32 const *data) {
-    return data == &opcode[0] || data == &opcode[1] || data == &opcode[2];
-}
-
-u32 GetPrefetch()
+u32 gbaCPU::GetPrefetch() const
 {
     t32 p;
     p.w.w0.b.b0.b = prefetch[0]->b;
@@ -204,7 +350,7 @@ u32 GetPrefetch()
     return p.d;
 }
 
-s32 EnterException(Exception id)
+s32 gbaCPU::EnterException(Exception id)
 {
     u32 vector;
     u32 link;
@@ -212,6 +358,7 @@ s32 EnterException(Exception id)
     OperatingMode mode;
     s32 I;
 
+    UpdateFlags();
     spsr = CPSR.d;
 
     switch (id)
@@ -229,33 +376,73 @@ s32 EnterException(Exception id)
     CPSR.d |= FLAG_I;
     SPSR_xxx->d = spsr;
 
+    idlevalid = false;
+
     return BranchAbsolute(vector, false, true, link) + I;
 }
 
-bool TestCondition(u32 cc) 
+bool gbaCPU::TestCondition(u32 cc) 
 {
+    UpdateFlags();
     return truthtable[cc][SUBVAL(CPSR.d, 28, 0xF)];
 }
 
-s32 SingleStep()
+s32 gbaCPU::SingleStep()
 {
     exceptionlock = false;
 
-    opcode[0] = opcode[1];
-    opcode[1] = opcode[2];
+    opcode[0]  = opcode[1];
+    opcode[1]  = opcode[2];
+    decoded[0] = decoded[1];
+    decoded[1] = decoded[2];
 
     R15.d += instructionlength;
-    gbaMemory::Read(R15.d, &opcode[2], instructionlength, &N_cycle, &S_cycle);
+    FetchOpcode(R15.d, 2, &N_cycle, &S_cycle);
+
+    return DecodeAndExecute(this);
+}
+
+void gbaCPU::ResetIdleLoop()
+{
+    idlebranch = false;
+    idlevalid  = false;
+}
+
+// Ciclos de las vueltas completas del ciclo ocioso que caben antes de limit, la ultima vuelta se
+// ejecuta normalmente para terminar en el mismo punto
+s32 gbaCPU::SkipIdleLoop(s32 ticks, s32 limit)
+{
+    IdleState state;
+    s32       skip = 0;
+
+    if (!idlebranch) {return 0;}
+    idlebranch = false;
+
+    UpdateFlags();
+    state.address     = R15.d;
+    state.cpsr        = CPSR.d;
+    state.sideeffects = m_console->memory.GetSideEffectCount();
+    for (u32 i = 0; i < 15; i++) {state.registers[i] = RX_xxx[i]->d;}
+
+    if (idlevalid && memcmp(&state, &idlestate, sizeof(state)) == 0)
+    {
+        s32 period = ticks - idleticks;
+        if (period > 0 && limit > ticks) {skip = ((limit - ticks - 1) / period) * period;}
+    }
+
+    idlestate = state;
+    idleticks = ticks + skip;
+    idlevalid = true;
 
-    return DecodeAndExecute();
+    return skip;
 }
 
-s32 RequestInterrupt()
+s32 gbaCPU::RequestInterrupt()
 {
     return ((CPSR.d & FLAG_I) != 0 || exceptionlock) ? 0 : EnterException(EXCEPTION_IRQ);
 }
 
-s32 Reset()
+s32 gbaCPU::Reset()
 {
     R0.d = R1.d = R2.d = R3.d = R4.d = R5.d = R6.d = R7.d = R8.d = R9.d = R10.d = R11.d = R12.d = R13.d = R14.d = R15.d = CPSR.d = SPSR.d = 0;
     R8_fiq.d = R9_fiq.d = R10_fiq.d = R11_fiq.d = R12_fiq.d = 0;
@@ -265,21 +452,23 @@ s32 Reset()
     R13_irq.d = R14_irq.d = SPSR_irq.d = 0;
     R13_und.d = R14_und.d = SPSR_und.d = 0;
 
+    lazy.nz = false;
+    lazy.cv = FLAGOP_NONE;
+
     exceptionlock = false;
 
+    ResetIdleLoop();
+    FlushCodeCache();
+
     // Fast boot?
     /*
-    t32 data;
-    data.d = 1;
     s32 N, S;
-    gbaMemory::Write(0x04000300, &data, gbaMemory::TYPE_BYTE, &N, &S);
-    data.d = 0x8000;
-    gbaMemory::Write(0x04000134, &data, gbaMemory::TYPE_HALFWORD, &N, &S);
-    data.d = 0;
-    gbaMemory::Write(0x04000128, &data, gbaMemory::TYPE_HALFWORD, &N, &S);
+    m_console->memory.Write8(0x04000300, 1, &N, &S);
+    m_console->memory.Write16(0x04000134, 0x8000, &N, &S);
+    m_console->memory.Write16(0x04000128, 0, &N, &S);
     
     for (u32 address = 0x03007E00; address < 0x03008000; address += 4) {
-        gbaMemory::Write(address, &data, gbaMemory::TYPE_WORD, &N, &S);
+        m_console->memory.Write32(address, 0, &N, &S);
     }
 
 
@@ -293,30 +482,31 @@ s32 Reset()
     return EnterException(EXCEPTION_RESET);
 }
 
-void WriteCPSR()
+void gbaCPU::WriteCPSR()
 {
     EnterOperatingMode(CPSR.d & MODE_BITS);
     EnterOperatingState(CPSR.d & FLAG_T);
 }
 
-void RestoreCPSR()
+void gbaCPU::RestoreCPSR()
 {
+    UpdateFlags();
     CPSR.d = SPSR_xxx->d;
     WriteCPSR();
 }
 
-s32 WritePC(bool s)
+s32 gbaCPU::WritePC(bool s)
 {
     if (s) {RestoreCPSR();}
     return BranchAbsolute(R15.d, false, false, 0);
 }
 
-u32 CountLeadingZerosOrOnes(u32 value, bool ones)
+u32 gbaCPU::CountLeadingZerosOrOnes(u32 value, bool ones)
 {
     return 0; // TODO
 }
 
-s32 MultiplierArrayCycles(u32 rs, bool sign)
+s32 gbaCPU::MultiplierArrayCycles(u32 rs, bool sign)
 {
     u32 lz = CountLeadingZerosOrOnes(rs, false);
     u32 az = lz / 8;
@@ -334,176 +524,183 @@ s32 MultiplierArrayCycles(u32 rs, bool sign)
     //return 3;
 }
 
-u32 LSL(u32 rs, u32 rn, bool s)
+u32 gbaCPU::LSL(u32 rs, u32 rn, bool s)
 {
     u32 ret = (rn < 32) ? (rs << rn) : 0;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C) | SET_N(ret) | SET_Z(ret) | ((rn == 0) ? (CPSR.d & FLAG_C) : SET_C((rn <= 32) ? BITTEST(rs, 32 - rn) : false));}
+    if (s) {if (rn == 0) {SetNZ(ret);} else {SetNZC(ret, (rn <= 32) ? BITTEST(rs, 32 - rn) : false);}}
     return ret;
 }
 
-u32 LSR(u32 rs, u32 rn, bool s)
+u32 gbaCPU::LSR(u32 rs, u32 rn, bool s)
 {
     u32 ret = (rn < 32) ? (rs >> rn) : 0;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C) | SET_N(ret) | SET_Z(ret) | ((rn == 0) ? (CPSR.d & FLAG_C) : SET_C((rn <= 32) ? BITTEST(rs, rn -  1) : false));}
+    if (s) {if (rn == 0) {SetNZ(ret);} else {SetNZC(ret, (rn <= 32) ? BITTEST(rs, rn -  1) : false);}}
     return ret;
 }
 
-u32 ASR(s32 rs, u32 rn, bool s)
+u32 gbaCPU::ASR(u32 rs, u32 rn, bool s)
 {
-    u32 ret = (rn < 32) ? (rs >> rn) : (rs >> 31);
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C) | SET_N(ret) | SET_Z(ret) | ((rn == 0) ? (CPSR.d & FLAG_C) : SET_C((rn <= 32) ? BITTEST(rs, rn - 1) : BITTEST(rs, 31)));}
+    u32 ret = (rn < 32) ? ((s32)rs >> rn) : ((s32)rs >> 31);
+    if (s) {if (rn == 0) {SetNZ(ret);} else {SetNZC(ret, (rn <= 32) ? BITTEST(rs, rn - 1) : BITTEST(rs, 31));}}
     return ret;
 }
 
-u32 ROR(u32 rs, u32 rn, bool s)
+u32 gbaCPU::ROR(u32 rs, u32 rn, bool s)
 {
     u32 sh  = rn & 0x1F;
     u32 ret = (rs >> sh) | (rs << (32 - sh));
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C) | SET_N(ret) | SET_Z(ret) | ((rn == 0) ? (CPSR.d & FLAG_C) : SET_C(BITTEST(ret, 31)));}
+    if (s) {if (rn == 0) {SetNZ(ret);} else {SetNZC(ret, BITTEST(ret, 31));}}
     return ret;    
 }
 
-u32 RRX(u32 rs, bool s)
+u32 gbaCPU::RRX(u32 rs, bool s)
 {
-    u32 ret = (rs >> 1) | ((CPSR.d & FLAG_C) != 0 ? BIT(31) : 0);
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C) | SET_N(ret) | SET_Z(ret) | SET_C(BITTEST(rs, 0));}
+    u32 ret = (rs >> 1) | (GetCarry() ? BIT(31) : 0);
+    if (s) {SetNZC(ret, BITTEST(rs, 0));}
     return ret;
 }
 
-u32 AND(u32 rs, u32 rn, bool s)
+u32 gbaCPU::AND(u32 rs, u32 rn, bool s)
 {    
     u32 ret = rs & rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;    
 }
 
-u32 EOR(u32 rs, u32 rn, bool s)
+u32 gbaCPU::EOR(u32 rs, u32 rn, bool s)
 {
     u32 ret = rs ^ rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u32 ORR(u32 rs, u32 rn, bool s)
+u32 gbaCPU::ORR(u32 rs, u32 rn, bool s)
 {
     u32 ret = rs | rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u32 BIC(u32 rs, u32 rn, bool s)
+u32 gbaCPU::BIC(u32 rs, u32 rn, bool s)
 {
     u32 ret = rs & ~rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u32 ADD(u32 rs, u32 rn, bool s)
+u32 gbaCPU::ADD(u32 rs, u32 rn, bool s)
 {
     u32 ret = rs + rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C | FLAG_V) | SET_N(ret) | SET_Z(ret) | SET_C(ret < rs) | SET_V_ADD(rs, rn, ret);}
+    if (s) {SetNZCV(FLAGOP_ADD, rs, rn, 0, ret);}
     return ret;
 }
 
-u32 ADC(u32 rs, u32 rn, bool s)
+u32 gbaCPU::ADC(u32 rs, u32 rn, bool s)
 {
-    u32 par = rn + (((CPSR.d & FLAG_C) != 0) ? 1 : 0);
+    u32 par = rn + (GetCarry() ? 1 : 0);
     u32 ret = rs + par;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C | FLAG_V) | SET_N(ret) | SET_Z(ret) | SET_C((par < rn) || (ret < rs)) | SET_V_ADD(rs, rn, ret);}
+    if (s) {SetNZCV(FLAGOP_ADC, rs, rn, par, ret);}
     return ret;
 }
 
-u32 SUB(u32 rs, u32 rn, bool s)
+u32 gbaCPU::SUB(u32 rs, u32 rn, bool s)
 {
     u32 ret = rs - rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C | FLAG_V) | SET_N(ret) | SET_Z(ret) | SET_C(rn <= rs) | SET_V_SUB(rs, rn, ret);}
+    if (s) {SetNZCV(FLAGOP_SUB, rs, rn, 0, ret);}
     return ret;
 }
 
-u32 SBC(u32 rs, u32 rn, bool s)
+u32 gbaCPU::SBC(u32 rs, u32 rn, bool s)
 {
-    u32 par = rs - (((CPSR.d & FLAG_C) != 0) ? 0 : 1);
+    u32 par = rs - (GetCarry() ? 0 : 1);
     u32 ret = par - rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z | FLAG_C | FLAG_V) | SET_N(ret) | SET_Z(ret) | SET_C((par <= rs) && (ret <= par)) | SET_V_SUB(rs, rn, ret);}
+    if (s) {SetNZCV(FLAGOP_SBC, rs, rn, par, ret);}
     return ret;
 }
 
-u32 MOV(u32 rs, bool s)
+u32 gbaCPU::MOV(u32 rs, bool s)
 {
     u32 ret = rs;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u32 MVN(u32 rs, bool s)
+u32 gbaCPU::MVN(u32 rs, bool s)
 {
     u32 ret = ~rs;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u32 MUL(u32 rm, u32 rs, bool s)
+u32 gbaCPU::MUL(u32 rm, u32 rs, bool s)
 {
     u32 ret = rm * rs;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u32 MLA(u32 rm, u32 rs, u32 rn, bool s)
+u32 gbaCPU::MLA(u32 rm, u32 rs, u32 rn, bool s)
 {
     u32 ret = (rm * rs) + rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret) | SET_Z(ret);}
+    if (s) {SetNZ(ret);}
     return ret;
 }
 
-u64 UMULL(u32 rm, u32 rs, bool s)
+u64 gbaCPU::UMULL(u32 rm, u32 rs, bool s)
 {
     t64 ret;
     ret.q = (u64)rm * (u64)rs;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret.d.d1.d) | SET_Z(ret.q);}
+    if (s) {SetNZ(ret.d.d1.d | ((ret.d.d0.d != 0) ? 1 : 0));}
     return ret.q;
 }
 
-u64 UMLAL(u32 rm, u32 rs, u64 rn, bool s)
+u64 gbaCPU::UMLAL(u32 rm, u32 rs, u64 rn, bool s)
 {
     t64 ret;
     ret.q = ((u64)rm * (u64)rs) + rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret.d.d1.d) | SET_Z(ret.q);}
+    if (s) {SetNZ(ret.d.d1.d | ((ret.d.d0.d != 0) ? 1 : 0));}
     return ret.q;
 }
 
-u64 SMULL(s32 rm, s32 rs, bool s)
+u64 gbaCPU::SMULL(s32 rm, s32 rs, bool s)
 {
     t64 ret;
     ret.l = (s64)rm * (s64)rs;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret.d.d1.d) | SET_Z(ret.q);}
+    if (s) {SetNZ(ret.d.d1.d | ((ret.d.d0.d != 0) ? 1 : 0));}
     return ret.l;
 }
 
-u64 SMLAL(s32 rm, s32 rs, s64 rn, bool s)
+u64 gbaCPU::SMLAL(s32 rm, s32 rs, s64 rn, bool s)
 {
     t64 ret;
     ret.l = ((s64)rm * (s64)rs) + rn;
-    if (s) {CPSR.d = BIC_CPSR(FLAG_N | FLAG_Z) | SET_N(ret.d.d1.d) | SET_Z(ret.q);}
+    if (s) {SetNZ(ret.d.d1.d | ((ret.d.d0.d != 0) ? 1 : 0));}
     return ret.l;
 }
 
-void STR(u32 address, t32 const *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access)
+void gbaCPU::STR(u32 address, t32 const *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access)
 {
     u32 base = address & ~(width - 1);
-    gbaMemory::Write(base, data, width, N_access, S_access);
+    switch (width)
+    {
+    case gbaMemory::TYPE_WORD:     m_console->memory.Write32(base, data->d,           N_access, S_access); break;
+    case gbaMemory::TYPE_HALFWORD: m_console->memory.Write16(base, data->w.w0.w,      N_access, S_access); break;
+    case gbaMemory::TYPE_BYTE:     m_console->memory.Write8 (base, data->w.w0.b.b0.b, N_access, S_access); break;
+    }
 }
 
-void LDR(u32 address, t32 *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access, bool ror, bool sx)
+void gbaCPU::LDR(u32 address, t32 *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access, bool ror, bool sx)
 {
-    static const u32 mask[3] = {0x000000FF, 0x0000FFFF, 0xFFFFFFFF};
     u32 align      = width - 1;
     u32 misaligned = address &  align;
     u32 base       = address & ~align;
 
-    data->d = 0;
-    gbaMemory::Read(base, data, width, N_access, S_access);
-    data->d &= mask[width >> 1];
+    switch (width)
+    {
+    case gbaMemory::TYPE_WORD:     data->d = m_console->memory.Read32(base, N_access, S_access); break;
+    case gbaMemory::TYPE_HALFWORD: data->d = m_console->memory.Read16(base, N_access, S_access); break;
+    case gbaMemory::TYPE_BYTE:     data->d = m_console->memory.Read8 (base, N_access, S_access); break;
+    }
 
     if (ror && (misaligned != 0))
     {
@@ -514,7 +711,7 @@ void LDR(u32 address, t32 *data, gbaMemory::DataType width, s32 *N_access, s32 *
     if (sx && (width != gbaMemory::TYPE_WORD)) {data->d = (width == gbaMemory::TYPE_HALFWORD) ? SIGNEX(data->d, 15) : SIGNEX(data->d, 7);}
 }
 
-u32 ShiftGroup(u32 op, u32 value, u32 sh, bool s, bool imm)
+u32 gbaCPU::ShiftGroup(u32 op, u32 value, u32 sh, bool s, bool imm)
 {
     bool special = imm && (sh == 0);
     u32  ret;
@@ -530,7 +727,7 @@ u32 ShiftGroup(u32 op, u32 value, u32 sh, bool s, bool imm)
     return ret;
 }
     
-s32 SingleDataTransfer(bool load, u32 address, u32 rd, gbaMemory::DataType width, bool ror, bool sx)
+s32 gbaCPU::SingleDataTransfer(bool load, u32 address, u32 rd, gbaMemory::DataType width, bool ror, bool sx)
 {
     s32 N;
     s32 S;
@@ -553,7 +750,7 @@ s32 SingleDataTransfer(bool load, u32 address, u32 rd, gbaMemory::DataType width
     return NSI;
 }
 
-s32 SingleDataTransfer(bool load, u32 rn, u32 offset, u32 rd, gbaMemory::DataType width, bool ror, bool sx, bool p, bool u, bool w)
+s32 gbaCPU::SingleDataTransfer(bool load, u32 rn, u32 offset, u32 rd, gbaMemory::DataType width, bool ror, bool sx, bool p, bool u, bool w)
 {
     u32 final   = RX_xxx[rn]->d + (u ? offset : NEGATE(offset));
     u32 address = p ? final : RX_xxx[rn]->d;
@@ -563,7 +760,7 @@ s32 SingleDataTransfer(bool load, u32 rn, u32 offset, u32 rd, gbaMemory::DataTyp
     return NSI;
 }
 
-s32 MultipleDataTransfer(bool load, u32 rlist, u32 rn, bool p, bool u, bool w, bool s)
+s32 gbaCPU::MultipleDataTransfer(bool load, u32 rlist, u32 rn, bool p, bool u, bool w, bool s)
 {
     gbaMemory::DataType width = gbaMemory::TYPE_WORD;
     
@@ -623,14 +820,14 @@ s32 MultipleDataTransfer(bool load, u32 rlist, u32 rn, bool p, bool u, bool w, b
 // Set de instrucciones ARM (32 bits)
 //-------------------------------------------------------------------------------------------------
 // Formato 3: Branch and Exchange (BX) ------------------------------------------------------------
-s32 ARM_Format3()
+s32 gbaCPU::ARM_Format3()
 {
     u32 rn = SUBVAL(opcode->d, 0, 0xF);
     return S_cycle + BranchAbsolute(RX_xxx[rn]->d, true, false, 0);
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 4: Branch and Branch with Link (B, BL) -------------------------------------------------
-s32 ARM_Format4()
+s32 gbaCPU::ARM_Format4()
 {
     u32  offset = SUBVAL(opcode->d, 0, 0xFFFFFF);
     u32  target = RX_xxx[REGISTER_PC]->d + (SIGNEX(offset, 23) << 2);
@@ -640,7 +837,7 @@ s32 ARM_Format4()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 5: Data Processing ---------------------------------------------------------------------
-s32 ARM_Format5() 
+s32 gbaCPU::ARM_Format5() 
 {
     static const bool write[16] = {1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1};
     bool s   = BITTEST(opcode->d, 20);
@@ -648,7 +845,9 @@ s32 ARM_Format5()
     bool usePC12;
     u32  op2;
 
-    u32 old_cpsr = CPSR.d;
+    // Las operaciones aritmeticas sobreescriben el acarreo del desplazamiento
+    u32  operation = SUBVAL(opcode->d, 21, 0xF);
+    bool logical   = s && (operation <= 0x1 || operation == 0x8 || operation == 0x9 || operation >= 0xC);
 
     if (!BITTEST(opcode->d, 25))
     {
@@ -669,23 +868,18 @@ s32 ARM_Format5()
         
         u32 rm = SUBVAL(opcode->d, 0, 0xF);
         u32 op = SUBVAL(opcode->d, 5, 0x3);
-        op2 = ShiftGroup(op, RX_xxx[rm]->d, sh, s, !usePC12);
+        op2 = ShiftGroup(op, RX_xxx[rm]->d, sh, logical, !usePC12);
     }
     else
     {
         usePC12 = false;
         u32 imm = SUBVAL(opcode->d, 0, 0xFF);
         u32 ror = SUBVAL(opcode->d, 8, 0xF);
-        op2 = ROR(imm, ror * 2, s);
+        op2 = ROR(imm, ror * 2, logical);
     }
 
-    u32 new_cpsr = CPSR.d;
-
-    u32 operation = SUBVAL(opcode->d, 21, 0xF);
-    u32 rn        = SUBVAL(opcode->d, 16, 0xF);
-    u32 rd        = SUBVAL(opcode->d, 12, 0xF);
-
-    if (operation >= 5 && operation <= 7) {CPSR.d = (CPSR.d & ~FLAG_C) | (old_cpsr & FLAG_C);}
+    u32 rn = SUBVAL(opcode->d, 16, 0xF);
+    u32 rd = SUBVAL(opcode->d, 12, 0xF);
 
     switch (operation)
     {
@@ -712,10 +906,12 @@ s32 ARM_Format5()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 6: PSR Transfer (MRS, MSR) -------------------------------------------------------------
-s32 ARM_Format6()
+s32 gbaCPU::ARM_Format6()
 {
     bool useSPSR = BITTEST(opcode->d, 22);
 
+    UpdateFlags();
+
     if (!BITTEST(opcode->d, 21))
     {
         u32 rd = SUBVAL(opcode->d, 12, 0xF);
@@ -750,7 +946,7 @@ s32 ARM_Format6()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 7: Multiply and Multiply-Accumulate (MUL, MLA) -----------------------------------------
-s32 ARM_Format7()
+s32 gbaCPU::ARM_Format7()
 {
     u32  rm         = SUBVAL(opcode->d,  0, 0xF);
     u32  rs         = SUBVAL(opcode->d,  8, 0xF);
@@ -766,7 +962,7 @@ s32 ARM_Format7()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 8: Multiply Long and Multiply-Accumulate Long (MULL, MLAL) -----------------------------
-s32 ARM_Format8()
+s32 gbaCPU::ARM_Format8()
 {
     u32  rm         = SUBVAL(opcode->d,  0, 0xF);
     u32  rs         = SUBVAL(opcode->d,  8, 0xF);
@@ -790,7 +986,7 @@ s32 ARM_Format8()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 9: Single Data Transfer (LDR, STR) -----------------------------------------------------
-s32 ARM_Format9()
+s32 gbaCPU::ARM_Format9()
 {
     u32 offset;
 
@@ -819,7 +1015,7 @@ s32 ARM_Format9()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 10: Halfword and Signed Data Transfer (LDRH/STRH/LDRSB/LDRSH) --------------------------
-s32 ARM_Format10()
+s32 gbaCPU::ARM_Format10()
 {
     u32 offset;
 
@@ -849,7 +1045,7 @@ s32 ARM_Format10()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 11: Block Data Transfer (LDM, STM) -----------------------------------------------------
-s32 ARM_Format11()
+s32 gbaCPU::ARM_Format11()
 {
     u32  rlist = SUBVAL(opcode->d,  0, 0xFFFF);
     u32  rn    = SUBVAL(opcode->d, 16, 0xF);
@@ -863,7 +1059,7 @@ s32 ARM_Format11()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 12: Single Data Swap (SWP) -------------------------------------------------------------
-s32 ARM_Format12()
+s32 gbaCPU::ARM_Format12()
 {
     u32 rm = SUBVAL(opcode->d,  0, 0xF);
     u32 rd = SUBVAL(opcode->d, 12, 0xF);
@@ -883,25 +1079,25 @@ s32 ARM_Format12()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 13: Software Interrupt (SWI) -----------------------------------------------------------
-s32 ARM_Format13()
+s32 gbaCPU::ARM_Format13()
 {
     return S_cycle + EnterException(EXCEPTION_SOFTWAREINTERRUPT);
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 14: Coprocessor Data Operations (CDP) --------------------------------------------------
-s32 ARM_Format14()
+s32 gbaCPU::ARM_Format14()
 {
     return S_cycle + EnterException(EXCEPTION_UNDEFINEDINSTRUCTION);
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 15: Coprocessor Data Transfers (LDC, STC) ----------------------------------------------
-s32 ARM_Format15()
+s32 gbaCPU::ARM_Format15()
 {
     return S_cycle + EnterException(EXCEPTION_UNDEFINEDINSTRUCTION);
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 16: Coprocessor Register Transfers (MRC, MCR) ------------------------------------------
-s32 ARM_Format16()
+s32 gbaCPU::ARM_Format16()
 {
     u32 cp = SUBVAL(opcode->d,  8, 0xF);
     u32 rd = SUBVAL(opcode->d, 12, 0xF);
@@ -916,7 +1112,7 @@ s32 ARM_Format16()
         else
         {
             u32 data = GetPrefetch();
-            if (rd == REGISTER_PC) {CPSR.d = (CPSR.d & 0xFFFFFFF) | (data & ~0xFFFFFFF);} else {RX_xxx[rd]->d = data;}
+            if (rd == REGISTER_PC) {UpdateFlags(); CPSR.d = (CPSR.d & 0xFFFFFFF) | (data & ~0xFFFFFFF);} else {RX_xxx[rd]->d = data;}
             NSI = 3;            
         }
     }
@@ -929,197 +1125,232 @@ s32 ARM_Format16()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 17: Undefined Instruction --------------------------------------------------------------
-s32 ARM_Format17()
+s32 gbaCPU::ARM_Format17()
 {
     return S_cycle + EnterException(EXCEPTION_UNDEFINEDINSTRUCTION);
 }
 //-------------------------------------------------------------------------------------------------
-// Decodificar y ejecutar instruccion ARM ---------------------------------------------------------
-s32 ARM_DecodeAndExecute()
+// Formatos 3, 6, 10 y 12 con verificacion de los bits que no forman parte del indice ------------
+s32 gbaCPU::ARM_Format3X()
 {
-    u32 cc = SUBVAL(opcode->d, 28, 0xF);
+    return ((opcode->d & 0xFFF00) == 0xFFF00) ? ARM_Format3() : ARM_Format17();
+}
 
-    if (!TestCondition(cc)) {return S_cycle;}
+s32 gbaCPU::ARM_Format6X()
+{
+    return ((opcode->d & 0xF00) == 0x000) ? ARM_Format6() : ARM_Format17();
+}
+
+s32 gbaCPU::ARM_Format10X()
+{
+    return ((opcode->d & 0xF00) == 0x000) ? ARM_Format10() : ARM_Format17();
+}
 
-    switch (SUBVAL(opcode->d, 25, 7))
+s32 gbaCPU::ARM_Format12X()
+{
+    return ((opcode->d & 0xF00) == 0x000) ? ARM_Format12() : ARM_Format17();
+}
+//-------------------------------------------------------------------------------------------------
+// Tabla de decodificacion ARM --------------------------------------------------------------------
+// Indice: bits 27 a 20 y 7 a 4 de la instruccion
+void gbaCPU::ARM_BuildHandlerTable()
+{
+    for (u32 index = 0; index < 4096; index++)
     {
-    case 0:
-        if ((opcode->d & 0xFFFFFF0) == 0x12FFF10) {return ARM_Format3();}
+        u32 op = (SUBVAL(index, 4, 0xFF) << 20) | (SUBVAL(index, 0, 0xF) << 4);
+        InstructionHandler handler;
 
-        switch (SUBVAL(opcode->d, 4, 0xF))
+        switch (SUBVAL(op, 25, 7))
         {
-        case 0x0:
-        case 0x1:
-        case 0x2:
-        case 0x3:
-        case 0x4:
-        case 0x5:
-        case 0x6:
-        case 0x7:
-        case 0x8:
-        case 0xA:        
-        case 0xC:        
-        case 0xE:
-            if (BITTEST(opcode->d, 24) && !BITTEST(opcode->d, 23) && !BITTEST(opcode->d, 20))
-            {
-                return ((opcode->d & 0xFF0) == 0x000) ? ARM_Format6() : ARM_Format17();
-            }
-            else
+        case 0:
+            switch (SUBVAL(op, 4, 0xF))
             {
-                return ARM_Format5();
-            }
-        case 0x9:
-            if (BITTEST(opcode->d, 24))
-            {
-                return ((opcode->d & 0xB00F00) == 0x000000) ? ARM_Format12() : ARM_Format17();
-            }
-            else
-            {
-                if (BITTEST(opcode->d, 23))
+            case 0x0:
+            case 0x1:
+            case 0x2:
+            case 0x3:
+            case 0x4:
+            case 0x5:
+            case 0x6:
+            case 0x7:
+            case 0x8:
+            case 0xA:
+            case 0xC:
+            case 0xE:
+                if (BITTEST(op, 24) && !BITTEST(op, 23) && !BITTEST(op, 20))
+                {
+                    if      ((op & 0xFF000F0) == 0x1200010) {handler = HANDLER(ARM_Format3X);}
+                    else if ((op & 0x00000F0) == 0x0000000) {handler = HANDLER(ARM_Format6X);}
+                    else                                    {handler = HANDLER(ARM_Format17);}
+                }
+                else
+                {
+                    handler = HANDLER(ARM_Format5);
+                }
+                break;
+            case 0x9:
+                if (BITTEST(op, 24))
                 {
-                    return ARM_Format8();
+                    handler = ((op & 0xB00000) == 0x000000) ? HANDLER(ARM_Format12X) : HANDLER(ARM_Format17);
                 }
                 else
                 {
-                    return BITTEST(opcode->d, 22) ? ARM_Format17() : ARM_Format7();
+                    if (BITTEST(op, 23))
+                    {
+                        handler = HANDLER(ARM_Format8);
+                    }
+                    else
+                    {
+                        handler = BITTEST(op, 22) ? HANDLER(ARM_Format17) : HANDLER(ARM_Format7);
+                    }
                 }
+                break;
+            case 0xB:
+            case 0xD:
+            default:
+                handler = BITTEST(op, 22) ? HANDLER(ARM_Format10) : HANDLER(ARM_Format10X);
+            }
+            break;
+        case 1:
+            if (BITTEST(op, 24) && !BITTEST(op, 23) && !BITTEST(op, 20))
+            {
+                handler = BITTEST(op, 21) ? HANDLER(ARM_Format6) : HANDLER(ARM_Format17);
+            }
+            else
+            {
+                handler = HANDLER(ARM_Format5);
             }
-        case 0xB:
-        case 0xD:
+            break;
+        case 2: handler = HANDLER(ARM_Format9);                                 break;
+        case 3: handler = BITTEST(op, 4) ? HANDLER(ARM_Format17) : HANDLER(ARM_Format9); break;
+        case 4: handler = HANDLER(ARM_Format11);                                break;
+        case 5: handler = HANDLER(ARM_Format4);                                 break;
+        case 6: handler = HANDLER(ARM_Format15);                                break;
         default:
-            if (BITTEST(opcode->d, 22))
+            if (BITTEST(op, 24))
             {
-                return ARM_Format10();
+                handler = HANDLER(ARM_Format13);
             }
             else
             {
-                return ((opcode->d & 0xF00) == 0x000) ? ARM_Format10() : ARM_Format17();
+                handler = BITTEST(op, 4) ? HANDLER(ARM_Format16) : HANDLER(ARM_Format14);
             }
         }
-    case 1:
-        if (BITTEST(opcode->d, 24) && !BITTEST(opcode->d, 23) && !BITTEST(opcode->d, 20))
-        {
-            return BITTEST(opcode->d, 21) ? ARM_Format6() : ARM_Format17();
-        }
-        else
-        {
-            return ARM_Format5();
-        }
-    case 2: return ARM_Format9();
-    case 3: return BITTEST(opcode->d, 4) ? ARM_Format17() : ARM_Format9();
-    case 4: return ARM_Format11();
-    case 5: return ARM_Format4();
-    case 6: return ARM_Format15();
-    default:
-        if (BITTEST(opcode->d, 24))
-        {
-            return ARM_Format13();
-        }
-        else
-        {
-            return BITTEST(opcode->d, 4) ? ARM_Format16() : ARM_Format14();
-        }
+
+        ARM_Handler[index] = handler;
     }
 }
 //-------------------------------------------------------------------------------------------------
+// Decodificar y ejecutar instruccion ARM ---------------------------------------------------------
+s32 gbaCPU::ARM_DecodeAndExecute()
+{
+    u32 cc = SUBVAL(opcode->d, 28, 0xF);
+
+    if (!TestCondition(cc)) {return S_cycle;}
+
+    return decoded[0](this);
+}
+//-------------------------------------------------------------------------------------------------
 
 //-------------------------------------------------------------------------------------------------
 // Set de instrucciones THUMB (16 bits)
 //-------------------------------------------------------------------------------------------------
 // Formato 1: move shifted register ---------------------------------------------------------------
-s32 THUMB_Format1() 
-{
-    u32 rd     = SUBVAL(opcode->d,  0, 0x7);
-    u32 rs     = SUBVAL(opcode->d,  3, 0x7);
-    u32 offset = SUBVAL(opcode->d,  6, 0x1F);
-    u32 op     = SUBVAL(opcode->d, 11, 0x3);
-
-    RX_xxx[rd]->d = ShiftGroup(op, RX_xxx[rs]->d, offset, true, true);
-    
-    return S_cycle;
-}
+#define THUMB_FORMAT1(name, sh) \
+s32 gbaCPU::THUMB_Format1_##name() \
+{ \
+    t32 *rd     = RX_xxx[SUBVAL(opcode->d, 0, 0x7)]; \
+    t32 *rs     = RX_xxx[SUBVAL(opcode->d, 3, 0x7)]; \
+    u32  offset = SUBVAL(opcode->d, 6, 0x1F); \
+    rd->d = name(rs->d, sh, true); \
+    return S_cycle; \
+}
+
+THUMB_FORMAT1(LSL, offset)
+THUMB_FORMAT1(LSR, (offset == 0) ? 32 : offset)
+THUMB_FORMAT1(ASR, (offset == 0) ? 32 : offset)
 //-------------------------------------------------------------------------------------------------
 // Formato 2: add/subtract ------------------------------------------------------------------------
-s32 THUMB_Format2() 
-{
-    u32 rd      = SUBVAL(opcode->d, 0, 0x7);        
-    u32 rs      = SUBVAL(opcode->d, 3, 0x7);
-    u32 rn      = SUBVAL(opcode->d, 6, 0x7);
-    u32 operand = BITTEST(opcode->d, 10) ? rn : RX_xxx[rn]->d;
-
-    RX_xxx[rd]->d = BITTEST(opcode->d, 9) ? SUB(RX_xxx[rs]->d, operand, true) :
-                                            ADD(RX_xxx[rs]->d, operand, true);
-
-    return S_cycle;
-}
+#define THUMB_FORMAT2(name, operation, operand) \
+s32 gbaCPU::THUMB_Format2_##name() \
+{ \
+    t32 *rd = RX_xxx[SUBVAL(opcode->d, 0, 0x7)]; \
+    t32 *rs = RX_xxx[SUBVAL(opcode->d, 3, 0x7)]; \
+    u32  rn = SUBVAL(opcode->d, 6, 0x7); \
+    rd->d = operation(rs->d, operand, true); \
+    return S_cycle; \
+}
+
+THUMB_FORMAT2(ADD,    ADD, RX_xxx[rn]->d)
+THUMB_FORMAT2(SUB,    SUB, RX_xxx[rn]->d)
+THUMB_FORMAT2(ADDIMM, ADD, rn)
+THUMB_FORMAT2(SUBIMM, SUB, rn)
 //-------------------------------------------------------------------------------------------------
 // Formato 3: move/compare/add/subtract immediate -------------------------------------------------
-s32 THUMB_Format3()
-{
-    u32 imm = SUBVAL(opcode->d, 0, 0xFF);
-    u32 rd  = SUBVAL(opcode->d, 8, 0x7);
-
-    switch (SUBVAL(opcode->d, 11, 3))
-    {
-    case 0:  RX_xxx[rd]->d = MOV(               imm, true); break;
-    case 1:  (void)          SUB(RX_xxx[rd]->d, imm, true); break;
-    case 2:  RX_xxx[rd]->d = ADD(RX_xxx[rd]->d, imm, true); break;
-    default: RX_xxx[rd]->d = SUB(RX_xxx[rd]->d, imm, true);
-    }
-
-    return S_cycle;
-}
+#define THUMB_FORMAT3(name, operation) \
+s32 gbaCPU::THUMB_Format3_##name() \
+{ \
+    u32  imm = SUBVAL(opcode->d, 0, 0xFF); \
+    t32 *rd  = RX_xxx[SUBVAL(opcode->d, 8, 0x7)]; \
+    operation; \
+    return S_cycle; \
+}
+
+THUMB_FORMAT3(MOV, rd->d = MOV(       imm, true))
+THUMB_FORMAT3(CMP, (void)  SUB(rd->d, imm, true))
+THUMB_FORMAT3(ADD, rd->d = ADD(rd->d, imm, true))
+THUMB_FORMAT3(SUB, rd->d = SUB(rd->d, imm, true))
 //-------------------------------------------------------------------------------------------------
 // Formato 4: ALU operations ----------------------------------------------------------------------
-s32 THUMB_Format4()
-{
-    u32 rd = SUBVAL(opcode->d, 0, 0x7);
-    u32 rs = SUBVAL(opcode->d, 3, 0x7);
-    s32 I;
-
-    switch (SUBVAL(opcode->d, 6, 0xF))
-    {
-    case 0x0: RX_xxx[rd]->d = AND(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0x1: RX_xxx[rd]->d = EOR(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0x2: RX_xxx[rd]->d = LSL(RX_xxx[rd]->d, RX_xxx[rs]->d & 0xFF, true); I = 1;                                          break;
-    case 0x3: RX_xxx[rd]->d = LSR(RX_xxx[rd]->d, RX_xxx[rs]->d & 0xFF, true); I = 1;                                          break;
-    case 0x4: RX_xxx[rd]->d = ASR(RX_xxx[rd]->d, RX_xxx[rs]->d & 0xFF, true); I = 1;                                          break;
-    case 0x5: RX_xxx[rd]->d = ADC(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0x6: RX_xxx[rd]->d = SBC(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0x7: RX_xxx[rd]->d = ROR(RX_xxx[rd]->d, RX_xxx[rs]->d & 0xFF, true); I = 1;                                          break;
-    case 0x8: (void)          AND(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0x9: RX_xxx[rd]->d = SUB(0,             RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0xA: (void)          SUB(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0xB: (void)          ADD(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0xC: RX_xxx[rd]->d = ORR(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    case 0xD: RX_xxx[rd]->d = MUL(RX_xxx[rs]->d, RX_xxx[rd]->d,        true); I = MultiplierArrayCycles(RX_xxx[rd]->d, true); break;
-    case 0xE: RX_xxx[rd]->d = BIC(RX_xxx[rd]->d, RX_xxx[rs]->d,        true); I = 0;                                          break;
-    default:  RX_xxx[rd]->d = MVN(               RX_xxx[rs]->d,        true); I = 0;
-    }
-
-    return S_cycle + I;
-}
+#define THUMB_FORMAT4(name, operation, I) \
+s32 gbaCPU::THUMB_Format4_##name() \
+{ \
+    t32 *rd = RX_xxx[SUBVAL(opcode->d, 0, 0x7)]; \
+    t32 *rs = RX_xxx[SUBVAL(opcode->d, 3, 0x7)]; \
+    operation; \
+    return S_cycle + (I); \
+}
+
+THUMB_FORMAT4(AND, rd->d = AND(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(EOR, rd->d = EOR(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(LSL, rd->d = LSL(rd->d, rs->d & 0xFF, true), 1)
+THUMB_FORMAT4(LSR, rd->d = LSR(rd->d, rs->d & 0xFF, true), 1)
+THUMB_FORMAT4(ASR, rd->d = ASR(rd->d, rs->d & 0xFF, true), 1)
+THUMB_FORMAT4(ADC, rd->d = ADC(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(SBC, rd->d = SBC(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(ROR, rd->d = ROR(rd->d, rs->d & 0xFF, true), 1)
+THUMB_FORMAT4(TST, (void)  AND(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(NEG, rd->d = SUB(0,     rs->d,        true), 0)
+THUMB_FORMAT4(CMP, (void)  SUB(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(CMN, (void)  ADD(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(ORR, rd->d = ORR(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(MUL, rd->d = MUL(rs->d, rd->d,        true), MultiplierArrayCycles(rd->d, true))
+THUMB_FORMAT4(BIC, rd->d = BIC(rd->d, rs->d,        true), 0)
+THUMB_FORMAT4(MVN, rd->d = MVN(       rs->d,        true), 0)
 //-------------------------------------------------------------------------------------------------
 // Formato 5: Hi register operations/branch exchange ----------------------------------------------
-s32 THUMB_Format5()
-{
-    u32 rd = SUBVAL(opcode->d, 0, 0x7) | (BITTEST(opcode->d, 7) ? 0x8 : 0);
-    u32 rs = SUBVAL(opcode->d, 3, 0xF);
-    s32 NS = 0;
+#define THUMB_FORMAT5(name, operation) \
+s32 gbaCPU::THUMB_Format5_##name() \
+{ \
+    u32 rd = SUBVAL(opcode->d, 0, 0x7) | (BITTEST(opcode->d, 7) ? 0x8 : 0); \
+    u32 rs = SUBVAL(opcode->d, 3, 0xF); \
+    s32 NS = 0; \
+    operation; \
+    return S_cycle + NS; \
+}
 
-    switch (SUBVAL(opcode->d, 8, 3))
-    {
-    case 0:  RX_xxx[rd]->d = ADD(RX_xxx[rd]->d, RX_xxx[rs]->d, false); if (rd == REGISTER_PC) {NS += WritePC(false);} break;
-    case 1:  (void)          SUB(RX_xxx[rd]->d, RX_xxx[rs]->d, true);                                                 break;
-    case 2:  RX_xxx[rd]->d = MOV(               RX_xxx[rs]->d, false); if (rd == REGISTER_PC) {NS += WritePC(false);} break;
-    default: NS += BranchAbsolute(RX_xxx[rs]->d, true, false, 0);
-    }
+THUMB_FORMAT5(ADD, RX_xxx[rd]->d = ADD(RX_xxx[rd]->d, RX_xxx[rs]->d, false); if (rd == REGISTER_PC) {NS += WritePC(false);})
+THUMB_FORMAT5(CMP, (void)          SUB(RX_xxx[rd]->d, RX_xxx[rs]->d, true))
+THUMB_FORMAT5(MOV, RX_xxx[rd]->d = MOV(               RX_xxx[rs]->d, false); if (rd == REGISTER_PC) {NS += WritePC(false);})
 
-    return S_cycle + NS;
+s32 gbaCPU::THUMB_Format5_BX()
+{
+    u32 rs = SUBVAL(opcode->d, 3, 0xF);
+    return S_cycle + BranchAbsolute(RX_xxx[rs]->d, true, false, 0);
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 6: PC-relative load --------------------------------------------------------------------
-s32 THUMB_Format6()
+s32 gbaCPU::THUMB_Format6()
 {
     u32 offset = SUBVAL(opcode->d, 0, 0xFF);
     u32 rd     = SUBVAL(opcode->d, 8, 0x7);
@@ -1131,7 +1362,7 @@ s32 THUMB_Format6()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 7: load/store with register offset -----------------------------------------------------
-s32 THUMB_Format7()
+s32 gbaCPU::THUMB_Format7()
 {
     u32  rd      = SUBVAL(opcode->d, 0, 0x7);
     u32  rb      = SUBVAL(opcode->d, 3, 0x7);
@@ -1145,7 +1376,7 @@ s32 THUMB_Format7()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 8: load/store sign-extended byte/halfword ----------------------------------------------
-s32 THUMB_Format8()
+s32 gbaCPU::THUMB_Format8()
 {
     u32  rd      = SUBVAL(opcode->d, 0, 0x7);
     u32  rb      = SUBVAL(opcode->d, 3, 0x7);
@@ -1167,7 +1398,7 @@ s32 THUMB_Format8()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 9: load/store with immediate offset ----------------------------------------------------
-s32 THUMB_Format9()
+s32 gbaCPU::THUMB_Format9()
 {
     u32  rd     = SUBVAL(opcode->d, 0, 0x7);
     u32  rb     = SUBVAL(opcode->d, 3, 0x7);
@@ -1181,7 +1412,7 @@ s32 THUMB_Format9()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 10: load/store halfword ----------------------------------------------------------------
-s32 THUMB_Format10()
+s32 gbaCPU::THUMB_Format10()
 {
     u32  rd      = SUBVAL(opcode->d, 0, 0x7);
     u32  rb      = SUBVAL(opcode->d, 3, 0x7);
@@ -1195,7 +1426,7 @@ s32 THUMB_Format10()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 11: SP-relative load/store -------------------------------------------------------------
-s32 THUMB_Format11()
+s32 gbaCPU::THUMB_Format11()
 {
     u32  offset = SUBVAL(opcode->d, 0, 0xFF);
     u32  rd     = SUBVAL(opcode->d, 8, 0x7);    
@@ -1208,7 +1439,7 @@ s32 THUMB_Format11()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 12: load address -----------------------------------------------------------------------
-s32 THUMB_Format12()
+s32 gbaCPU::THUMB_Format12()
 {
     u32 offset = SUBVAL(opcode->d, 0, 0xFF);
     u32 rd     = SUBVAL(opcode->d, 8, 0x7);
@@ -1219,7 +1450,7 @@ s32 THUMB_Format12()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 13: add offset to Stack Pointer --------------------------------------------------------
-s32 THUMB_Format13()
+s32 gbaCPU::THUMB_Format13()
 {
     u32 offset    = SUBVAL(opcode->d, 0, 0x7F);
     u32 magnitude = offset * gbaMemory::TYPE_WORD;
@@ -1231,7 +1462,7 @@ s32 THUMB_Format13()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 14: push/pop registers -----------------------------------------------------------------
-s32 THUMB_Format14()
+s32 gbaCPU::THUMB_Format14()
 {
     u32  rlist = SUBVAL(opcode->d, 0, 0xFF);
     bool pclr  = BITTEST(opcode->d, 8);
@@ -1256,7 +1487,7 @@ s32 THUMB_Format14()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 15: multiple load/store ----------------------------------------------------------------
-s32 THUMB_Format15()
+s32 gbaCPU::THUMB_Format15()
 {
     u32  rlist = SUBVAL(opcode->d, 0, 0xFF);
     u32  rn    = SUBVAL(opcode->d, 8, 0x7);
@@ -1266,7 +1497,7 @@ s32 THUMB_Format15()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 16: conditional branch -----------------------------------------------------------------
-s32 THUMB_Format16()
+s32 gbaCPU::THUMB_Format16()
 {
     u32 offset = SUBVAL(opcode->d, 0, 0xFF);
     u32 cc     = SUBVAL(opcode->d, 8, 0xF);
@@ -1276,13 +1507,13 @@ s32 THUMB_Format16()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 17: software interrupt -----------------------------------------------------------------
-s32 THUMB_Format17()
+s32 gbaCPU::THUMB_Format17()
 {
     return S_cycle + EnterException(EXCEPTION_SOFTWAREINTERRUPT);
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 18: unconditional branch ---------------------------------------------------------------
-s32 THUMB_Format18()
+s32 gbaCPU::THUMB_Format18()
 {
     u32 offset = SUBVAL(opcode->d, 0, 0x7FF);
     u32 target = RX_xxx[REGISTER_PC]->d + (SIGNEX(offset, 10) << 1);
@@ -1291,11 +1522,13 @@ s32 THUMB_Format18()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato 19: long branch with link --------------------------------------------------------------
-s32 THUMB_Format19()
+s32 gbaCPU::THUMB_Format19()
 {
     u32 offset = SUBVAL(opcode->d, 0, 0x7FF);
     s32 NS;
 
+    exceptionlock = !BITTEST(opcode->d, 11);
+
     if (!BITTEST(opcode->d, 11))
     {
         RX_xxx[REGISTER_LR]->d = RX_xxx[REGISTER_PC]->d + (SIGNEX(offset, 10) << 12);
@@ -1312,75 +1545,856 @@ s32 THUMB_Format19()
 }
 //-------------------------------------------------------------------------------------------------
 // Formato U: undefined instruction (ARM9) --------------------------------------------------------
-s32 THUMB_FormatU()
+s32 gbaCPU::THUMB_FormatU()
 {
     return S_cycle + EnterException(EXCEPTION_UNDEFINEDINSTRUCTION);
 }
 //-------------------------------------------------------------------------------------------------
+// Tabla de decodificacion THUMB ------------------------------------------------------------------
+// Indice: bits 15 a 6 de la instruccion
+void gbaCPU::THUMB_BuildHandlerTable()
+{
+    static InstructionHandler const format1[3]  = {HANDLER(THUMB_Format1_LSL), HANDLER(THUMB_Format1_LSR), HANDLER(THUMB_Format1_ASR)};
+    static InstructionHandler const format2[4]  = {HANDLER(THUMB_Format2_ADD), HANDLER(THUMB_Format2_SUB), HANDLER(THUMB_Format2_ADDIMM), HANDLER(THUMB_Format2_SUBIMM)};
+    static InstructionHandler const format3[4]  = {HANDLER(THUMB_Format3_MOV), HANDLER(THUMB_Format3_CMP), HANDLER(THUMB_Format3_ADD), HANDLER(THUMB_Format3_SUB)};
+    static InstructionHandler const format5[4]  = {HANDLER(THUMB_Format5_ADD), HANDLER(THUMB_Format5_CMP), HANDLER(THUMB_Format5_MOV), HANDLER(THUMB_Format5_BX)};
+    static InstructionHandler const format4[16] =
+    {
+        HANDLER(THUMB_Format4_AND), HANDLER(THUMB_Format4_EOR), HANDLER(THUMB_Format4_LSL), HANDLER(THUMB_Format4_LSR),
+        HANDLER(THUMB_Format4_ASR), HANDLER(THUMB_Format4_ADC), HANDLER(THUMB_Format4_SBC), HANDLER(THUMB_Format4_ROR),
+        HANDLER(THUMB_Format4_TST), HANDLER(THUMB_Format4_NEG), HANDLER(THUMB_Format4_CMP), HANDLER(THUMB_Format4_CMN),
+        HANDLER(THUMB_Format4_ORR), HANDLER(THUMB_Format4_MUL), HANDLER(THUMB_Format4_BIC), HANDLER(THUMB_Format4_MVN)
+    };
+
+    for (u32 index = 0; index < 1024; index++)
+    {
+        u32 op = index << 6;
+        InstructionHandler handler;
+
+        switch (SUBVAL(op, 13, 7))
+        {
+        case 0:  handler = (SUBVAL(op, 11, 3) == 3) ? format2[SUBVAL(op, 9, 3)] : format1[SUBVAL(op, 11, 3)]; break;
+        case 1:  handler = format3[SUBVAL(op, 11, 3)];                                                        break;
+        case 2:
+            if (BITTEST(op, 12))
+            {
+                handler = BITTEST(op, 9) ? HANDLER(THUMB_Format8) : HANDLER(THUMB_Format7);
+            }
+            else
+            {
+                if (BITTEST(op, 11))
+                {
+                    handler = HANDLER(THUMB_Format6);
+                }
+                else
+                {
+                    handler = BITTEST(op, 10) ? format5[SUBVAL(op, 8, 3)] : format4[SUBVAL(op, 6, 0xF)];
+                }
+            }
+            break;
+        case 3:  handler = HANDLER(THUMB_Format9);                                       break;
+        case 4:  handler = BITTEST(op, 12) ? HANDLER(THUMB_Format11) : HANDLER(THUMB_Format10); break;
+        case 5:
+            if (BITTEST(op, 12))
+            {
+                if (BITTEST(op, 10))
+                {
+                    handler = BITTEST(op, 9) ? HANDLER(THUMB_FormatU) : HANDLER(THUMB_Format14);
+                }
+                else
+                {
+                    handler = ((op & 0xF00) == 0x000) ? HANDLER(THUMB_Format13) : HANDLER(THUMB_FormatU);
+                }
+            }
+            else
+            {
+                handler = HANDLER(THUMB_Format12);
+            }
+            break;
+        case 6:
+            if (BITTEST(op, 12))
+            {
+                u32 icc = SUBVAL(op, 8, 0xF);
+                handler = (icc == 0xE) ? HANDLER(THUMB_FormatU) : ((icc == 0xF) ? HANDLER(THUMB_Format17) : HANDLER(THUMB_Format16));
+            }
+            else
+            {
+                handler = HANDLER(THUMB_Format15);
+            }
+            break;
+        default:
+            if (BITTEST(op, 12))
+            {
+                handler = HANDLER(THUMB_Format19);
+            }
+            else
+            {
+                handler = BITTEST(op, 11) ? HANDLER(THUMB_FormatU) : HANDLER(THUMB_Format18);
+            }
+        }
+
+        THUMB_Handler[index] = handler;
+    }
+}
+//-------------------------------------------------------------------------------------------------
 // Decodificar y ejecutar instruction THUMB -------------------------------------------------------
-s32 THUMB_DecodeAndExecute()
+s32 gbaCPU::THUMB_DecodeAndExecute()
+{
+    return decoded[0](this);
+}
+//-------------------------------------------------------------------------------------------------
+// Recompilador x86-64
+//-------------------------------------------------------------------------------------------------
+// Cada bloque cerrado se traduce a un paso por instruccion. Durante la ejecucion rbx lleva los
+// ciclos consumidos, r12 el limite y r13 la direccion del CPU, base para direccionar sus miembros y
+// primer argumento de cada llamada. Las operaciones de ALU se traducen directamente o como llamadas
+// a las funciones de banderas; el resto llama al manejador del interprete. Los pasos no mantienen el pipeline en memoria salvo
+// cuando llaman a un manejador; al salir del bloque se escribe el estado completo.
+#ifdef GBA_RECOMPILER
+const u32 JIT_BUFFERSIZE = 0x1000000;
+const u32 JIT_BLOCKSIZE  = 0x8000;
+const u32 JIT_THRESHOLD  = 4;
+
+enum X64Register
+{
+    X64_RAX, X64_RCX, X64_RDX, X64_RBX, X64_RSP, X64_RBP, X64_RSI, X64_RDI,
+    X64_R8,  X64_R9,  X64_R10, X64_R11, X64_R12, X64_R13, X64_R14, X64_R15
+};
+
+enum X64Condition
+{
+    X64_JE  = 0x4,
+    X64_JNE = 0x5,
+    X64_JGE = 0xD,
+    X64_JMP = 0x10
+};
+
+enum X64Operation
+{
+    X64_ADD = 0x01,
+    X64_OR  = 0x09,
+    X64_AND = 0x21,
+    X64_SUB = 0x29,
+    X64_XOR = 0x31,
+    X64_MOV = 0x89,
+    X64_LOAD = 0x8B
+};
+
+#ifdef _WIN32
+const u32 ARG0 = X64_RCX, ARG1 = X64_RDX, ARG2 = X64_R8, ARG3 = X64_R9;
+#else
+const u32 ARG0 = X64_RDI, ARG1 = X64_RSI, ARG2 = X64_RDX, ARG3 = X64_RCX;
+#endif
+
+typedef s32 (*CompiledBlock)(s32 cycles);
+
+void gbaCPU::Emit8(u32 value)
+{
+    *jitcode++ = (u8)value;
+}
+
+void gbaCPU::Emit32(u32 value)
+{
+    memcpy(jitcode, &value, sizeof(value));
+    jitcode += sizeof(value);
+}
+
+void gbaCPU::Emit64(u64 value)
+{
+    memcpy(jitcode, &value, sizeof(value));
+    jitcode += sizeof(value);
+}
+
+void gbaCPU::EmitREX(bool w, u32 reg, u32 base)
+{
+    u32 rex = 0x40 | (w ? 8 : 0) | (BITTEST(reg, 3) ? 4 : 0) | (BITTEST(base, 3) ? 1 : 0);
+    if (rex != 0x40) {Emit8(rex);}
+}
+
+// mov reg, imm
+void gbaCPU::EmitLoadImm(u32 reg, u32 imm)
+{
+    EmitREX(false, 0, reg);
+    Emit8(0xB8 | (reg & 7));
+    Emit32(imm);
+}
+
+void gbaCPU::EmitLoadImm64(u32 reg, u64 imm)
+{
+    EmitREX(true, 0, reg);
+    Emit8(0xB8 | (reg & 7));
+    Emit64(imm);
+}
+
+// op reg, [base + disp8] (base no puede ser rsp, rbp, r12 ni r13)
+void gbaCPU::EmitMemory(u32 op, bool w, u32 reg, u32 base, u32 disp)
+{
+    EmitREX(w, reg, base);
+    Emit8(op);
+    if (disp == 0) {Emit8(((reg & 7) << 3) | (base & 7));} else {Emit8(0x40 | ((reg & 7) << 3) | (base & 7)); Emit8(disp);}
+}
+
+// op reg, [r13 + disp32] con r13 apuntando a este CPU
+void gbaCPU::EmitGlobal(u32 op, bool w, u32 reg, void const *address)
+{
+    EmitREX(w, reg, X64_R13);
+    Emit8(op);
+    Emit8(0x80 | ((reg & 7) << 3) | (X64_R13 & 7));
+    Emit32((u32)((u8 const *)address - (u8 const *)this));
+}
+
+void gbaCPU::EmitStoreImm(void const *address, u32 imm)
+{
+    EmitGlobal(0xC7, false, 0, address);
+    Emit32(imm);
+}
+
+void gbaCPU::EmitStoreImm8(void const *address, u32 imm)
+{
+    EmitGlobal(0xC6, false, 0, address);
+    Emit8(imm);
+}
+
+void gbaCPU::EmitStoreImm64(void const *address, u64 imm)
+{
+    EmitLoadImm64(X64_RAX, imm);
+    EmitGlobal(X64_MOV, true, X64_RAX, address);
+}
+
+// op dst, src
+void gbaCPU::EmitALU(u32 op, u32 dst, u32 src)
+{
+    EmitREX(false, src, dst);
+    Emit8(op);
+    Emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+// op reg, imm (extension: 0 add, 4 and, 5 sub)
+void gbaCPU::EmitALUImm(u32 extension, u32 reg, u32 imm)
+{
+    EmitREX(false, 0, reg);
+    Emit8(0x81);
+    Emit8(0xC0 | (extension << 3) | (reg & 7));
+    Emit32(imm);
+}
+
+// shift reg, imm (extension: 1 ror, 4 shl, 5 shr, 7 sar)
+void gbaCPU::EmitShift(u32 extension, u32 reg, u32 imm)
+{
+    EmitREX(false, 0, reg);
+    Emit8(0xC1);
+    Emit8(0xC0 | (extension << 3) | (reg & 7));
+    Emit8(imm);
+}
+
+void gbaCPU::EmitNot(u32 reg)
+{
+    EmitREX(false, 0, reg);
+    Emit8(0xF7);
+    Emit8(0xD0 | (reg & 7));
+}
+
+// Las funciones llamadas reciben el CPU en ARG0 y los operandos desde ARG1
+void gbaCPU::EmitCall(u64 function)
 {
-    switch (SUBVAL(opcode->d, 13, 7))
+    EmitREX(true, X64_R13, ARG0);  // mov ARG0, r13
+    Emit8(X64_MOV);
+    Emit8(0xC0 | ((X64_R13 & 7) << 3) | (ARG0 & 7));
+    EmitLoadImm64(X64_RAX, function);
+    Emit8(0xFF);
+    Emit8(0xD0);
+}
+
+// Devuelve la posicion del desplazamiento para corregirlo con PatchJump
+u8 *gbaCPU::EmitJump(u32 cc)
+{
+    if (cc == X64_JMP) {Emit8(0xE9);} else {Emit8(0x0F); Emit8(0x80 | cc);}
+    u8 *field = jitcode;
+    Emit32(0);
+    return field;
+}
+
+void gbaCPU::PatchJump(u8 *field, u8 const *target)
+{
+    u32 rel = (u32)(target - (field + 4));
+    memcpy(field, &rel, sizeof(rel));
+}
+
+void gbaCPU::EmitJumpTo(u32 cc, u8 const *target)
+{
+    PatchJump(EmitJump(cc), target);
+}
+
+void gbaCPU::EmitReadRegister(u32 reg, u32 r, u32 pc)
+{
+    if (r == REGISTER_PC) {EmitLoadImm(reg, pc); return;}
+    if (r < 8) {EmitGlobal(X64_LOAD, false, reg, RX[r]); return;}
+    EmitGlobal(X64_LOAD, true, reg, &RX_xxx);
+    EmitMemory(X64_LOAD, true, reg, reg, r * sizeof(t32 *));
+    EmitMemory(X64_LOAD, false, reg, reg, 0);
+}
+
+void gbaCPU::EmitWriteRegister(u32 r, u32 reg)
+{
+    if (r < 8) {EmitGlobal(X64_MOV, false, reg, RX[r]); return;}
+    EmitGlobal(X64_LOAD, true, X64_R11, &RX_xxx);
+    EmitMemory(X64_LOAD, true, X64_R11, X64_R11, r * sizeof(t32 *));
+    EmitMemory(X64_MOV, false, reg, X64_R11, 0);
+}
+
+// Llama a una funcion de ALU con los operandos en ARG1 y ARG2
+void gbaCPU::EmitOperation(u64 function, u32 rd, bool write, bool s)
+{
+    EmitLoadImm(ARG3, s ? 1 : 0);
+    EmitCall(function);
+    if (write) {EmitWriteRegister(rd, X64_RAX);}
+}
+
+void gbaCPU::EmitAddCycles(bool dynamic, s32 S, s32 I)
+{
+    if (dynamic) {EmitGlobal(0x03, false, X64_RBX, &S_cycle); if (I != 0) {EmitALUImm(0, X64_RBX, I);}} else {EmitALUImm(0, X64_RBX, S + I);}
+}
+
+void gbaCPU::EmitPrologue()
+{
+    Emit8(0x53);                   // push rbx
+    Emit8(0x41); Emit8(0x54);      // push r12
+    Emit8(0x41); Emit8(0x55);      // push r13
+#ifdef _WIN32
+    Emit8(0x48); Emit8(0x83); Emit8(0xEC); Emit8(0x20); // sub rsp, 32
+#endif
+    EmitALU(X64_MOV, X64_R12, ARG0);
+    EmitALU(X64_XOR, X64_RBX, X64_RBX);
+    EmitLoadImm64(X64_R13, (u64)this);
+}
+
+void gbaCPU::EmitEpilogue()
+{
+    EmitALU(X64_MOV, X64_RAX, X64_RBX);
+#ifdef _WIN32
+    Emit8(0x48); Emit8(0x83); Emit8(0xC4); Emit8(0x20); // add rsp, 32
+#endif
+    Emit8(0x41); Emit8(0x5D);      // pop r13
+    Emit8(0x41); Emit8(0x5C);      // pop r12
+    Emit8(0x5B);                   // pop rbx
+    Emit8(0xC3);                   // ret
+}
+
+void gbaCPU::DiscardCompiledCode()
+{
+    for (u32 i = 0; i < BLOCK_CACHESIZE; i++) {codeblock[i].code = 0;}
+    jitused = 0;
+}
+
+bool gbaCPU::JIT_TestCondition(gbaCPU *cpu, u32 cc)
+{
+    return cpu->TestCondition(cc);
+}
+
+void gbaCPU::JIT_FetchOpcode(gbaCPU *cpu, u32 address)
+{
+    cpu->FetchOpcode(address, 2, &cpu->N_cycle, &cpu->S_cycle);
+}
+//-------------------------------------------------------------------------------------------------
+// Traduccion de instrucciones --------------------------------------------------------------------
+// Devuelven los ciclos internos de la instruccion o -1 si debe ejecutarse con el manejador
+s32 gbaCPU::ARM_Translate(u32 op, InstructionHandler handler, u32 pc)
+{
+    if (handler != HANDLER(ARM_Format5)) {return -1;}
+
+    bool s         = BITTEST(op, 20);
+    bool imm       = BITTEST(op, 25);
+    u32  operation = SUBVAL(op, 21, 0xF);
+    u32  rn        = SUBVAL(op, 16, 0xF);
+    u32  rd        = SUBVAL(op, 12, 0xF);
+    u32  rm        = SUBVAL(op,  0, 0xF);
+    u32  shift     = SUBVAL(op,  5, 0x3);
+    u32  sh        = SUBVAL(op,  7, 0x1F);
+    u32  rotate    = SUBVAL(op,  8, 0xF) * 2;
+    u32  value     = imm ? ROR(SUBVAL(op, 0, 0xFF), rotate, false) : 0;
+    bool write     = operation < 0x8 || operation >= 0xC;
+    bool direct    = !s && (operation < 0x5 || operation >= 0xC);
+
+    if (write && rd == REGISTER_PC)                      {return -1;}
+    if (!imm && BITTEST(op, 4))                          {return -1;}
+    if (!imm && shift == 3 && sh == 0)                   {return -1;}
+    if (!imm && !direct && (shift != 0 || sh != 0))      {return -1;}
+
+    if (direct)
     {
-    case 0: return (SUBVAL(opcode->d, 11, 3) == 3) ? THUMB_Format2() : THUMB_Format1();
-    case 1: return THUMB_Format3();
-    case 2:
-        if (BITTEST(opcode->d, 12))
+        if (imm)
         {
-            return BITTEST(opcode->d, 9) ? THUMB_Format8() : THUMB_Format7();
+            EmitLoadImm(X64_RCX, value);
         }
         else
         {
-            if (BITTEST(opcode->d, 11))
+            EmitReadRegister(X64_RCX, rm, pc);
+            switch (shift)
             {
-                return THUMB_Format6();
-            }
-            else
-            {
-                return BITTEST(opcode->d, 10) ? THUMB_Format5() : THUMB_Format4();
+            case 0:  if (sh != 0) {EmitShift(4, X64_RCX, sh);}                          break;
+            case 1:  if (sh != 0) {EmitShift(5, X64_RCX, sh);} else {EmitLoadImm(X64_RCX, 0);} break;
+            case 2:  EmitShift(7, X64_RCX, (sh != 0) ? sh : 31);                         break;
+            default: EmitShift(1, X64_RCX, sh);
             }
         }
-    case 3: return THUMB_Format9();
-    case 4: return BITTEST(opcode->d, 12) ? THUMB_Format11() : THUMB_Format10();
-    case 5:
-        if (BITTEST(opcode->d, 12))
+
+        if (operation != 0xD && operation != 0xF) {EmitReadRegister(X64_RAX, rn, pc);}
+
+        switch (operation)
         {
-            if (BITTEST(opcode->d, 10))
+        case 0x0: EmitALU(X64_AND, X64_RAX, X64_RCX);                                    break;
+        case 0x1: EmitALU(X64_XOR, X64_RAX, X64_RCX);                                    break;
+        case 0x2: EmitALU(X64_SUB, X64_RAX, X64_RCX);                                    break;
+        case 0x3: EmitALU(X64_SUB, X64_RCX, X64_RAX); EmitALU(X64_MOV, X64_RAX, X64_RCX); break;
+        case 0x4: EmitALU(X64_ADD, X64_RAX, X64_RCX);                                    break;
+        case 0xC: EmitALU(X64_OR,  X64_RAX, X64_RCX);                                    break;
+        case 0xD: EmitALU(X64_MOV, X64_RAX, X64_RCX);                                    break;
+        case 0xE: EmitNot(X64_RCX); EmitALU(X64_AND, X64_RAX, X64_RCX);                  break;
+        default:  EmitALU(X64_MOV, X64_RAX, X64_RCX); EmitNot(X64_RAX);
+        }
+
+        EmitWriteRegister(rd, X64_RAX);
+        return 0;
+    }
+
+    // El acarreo del operando solo sobrevive en las operaciones logicas
+    bool logical = operation <= 0x1 || operation == 0x8 || operation == 0x9 || operation >= 0xC;
+    if (s && imm && logical && rotate != 0)
+    {
+        EmitLoadImm(ARG1, SUBVAL(op, 0, 0xFF));
+        EmitLoadImm(ARG2, rotate);
+        EmitLoadImm(ARG3, 1);
+        EmitCall((u64)&JIT_ALU<&gbaCPU::ROR>);
+    }
+
+    u64  function;
+    bool swap   = false;
+    bool single = false;
+
+    switch (operation)
+    {
+    case 0x0: case 0x8: function = (u64)&JIT_ALU<&gbaCPU::AND>;                break;
+    case 0x1: case 0x9: function = (u64)&JIT_ALU<&gbaCPU::EOR>;                break;
+    case 0x2: case 0xA: function = (u64)&JIT_ALU<&gbaCPU::SUB>;                break;
+    case 0x3:           function = (u64)&JIT_ALU<&gbaCPU::SUB>; swap   = true; break;
+    case 0x4: case 0xB: function = (u64)&JIT_ALU<&gbaCPU::ADD>;                break;
+    case 0x5:           function = (u64)&JIT_ALU<&gbaCPU::ADC>;                break;
+    case 0x6:           function = (u64)&JIT_ALU<&gbaCPU::SBC>;                break;
+    case 0x7:           function = (u64)&JIT_ALU<&gbaCPU::SBC>; swap   = true; break;
+    case 0xC:           function = (u64)&JIT_ALU<&gbaCPU::ORR>;                break;
+    case 0xD:           function = (u64)&JIT_Move<&gbaCPU::MOV>; single = true; break;
+    case 0xE:           function = (u64)&JIT_ALU<&gbaCPU::BIC>;                break;
+    default:            function = (u64)&JIT_Move<&gbaCPU::MVN>; single = true;
+    }
+
+    u32 op2 = (single || swap) ? ARG1 : ARG2;
+    if (imm) {EmitLoadImm(op2, value);} else {EmitReadRegister(op2, rm, pc);}
+
+    if (single)
+    {
+        EmitLoadImm(ARG2, s ? 1 : 0);
+        EmitCall(function);
+        EmitWriteRegister(rd, X64_RAX);
+    }
+    else
+    {
+        EmitReadRegister(swap ? ARG2 : ARG1, rn, pc);
+        EmitOperation(function, rd, write, s);
+    }
+
+    return 0;
+}
+
+s32 gbaCPU::THUMB_Translate(u32 op, u32 pc)
+{
+    u32 rd = SUBVAL(op, 0, 0x7);
+    u32 rs = SUBVAL(op, 3, 0x7);
+
+    // Formato 2: add/subtract
+    if ((op & 0xF800) == 0x1800)
+    {
+        u32 rn = SUBVAL(op, 6, 0x7);
+        EmitReadRegister(ARG1, rs, pc);
+        if (BITTEST(op, 10)) {EmitLoadImm(ARG2, rn);} else {EmitReadRegister(ARG2, rn, pc);}
+        EmitOperation(BITTEST(op, 9) ? (u64)&JIT_ALU<&gbaCPU::SUB> : (u64)&JIT_ALU<&gbaCPU::ADD>, rd, true, true);
+        return 0;
+    }
+
+    // Formato 1: move shifted register
+    if ((op & 0xE000) == 0x0000)
+    {
+        static u64 const function[3] = {(u64)&JIT_ALU<&gbaCPU::LSL>, (u64)&JIT_ALU<&gbaCPU::LSR>, (u64)&JIT_ALU<&gbaCPU::ASR>};
+        u32 shift  = SUBVAL(op, 11, 0x3);
+        u32 offset = SUBVAL(op,  6, 0x1F);
+        EmitReadRegister(ARG1, rs, pc);
+        EmitLoadImm(ARG2, (shift == 0 || offset != 0) ? offset : 32);
+        EmitOperation(function[shift], rd, true, true);
+        return 0;
+    }
+
+    // Formato 3: move/compare/add/subtract immediate
+    if ((op & 0xE000) == 0x2000)
+    {
+        u32 imm = SUBVAL(op, 0, 0xFF);
+        rd = SUBVAL(op, 8, 0x7);
+
+        switch (SUBVAL(op, 11, 0x3))
+        {
+        case 0:
+            EmitLoadImm(ARG1, imm);
+            EmitLoadImm(ARG2, 1);
+            EmitCall((u64)&JIT_Move<&gbaCPU::MOV>);
+            EmitWriteRegister(rd, X64_RAX);
+            break;
+        case 1:  EmitReadRegister(ARG1, rd, pc); EmitLoadImm(ARG2, imm); EmitOperation((u64)&JIT_ALU<&gbaCPU::SUB>, rd, false, true); break;
+        case 2:  EmitReadRegister(ARG1, rd, pc); EmitLoadImm(ARG2, imm); EmitOperation((u64)&JIT_ALU<&gbaCPU::ADD>, rd, true,  true); break;
+        default: EmitReadRegister(ARG1, rd, pc); EmitLoadImm(ARG2, imm); EmitOperation((u64)&JIT_ALU<&gbaCPU::SUB>, rd, true,  true);
+        }
+
+        return 0;
+    }
+
+    // Formato 4: ALU operations (MUL depende del operando)
+    if ((op & 0xFC00) == 0x4000)
+    {
+        u32 operation = SUBVAL(op, 6, 0xF);
+        if (operation == 0xD) {return -1;}
+
+        switch (operation)
+        {
+        case 0x9:
+            EmitLoadImm(ARG1, 0);
+            EmitReadRegister(ARG2, rs, pc);
+            EmitOperation((u64)&JIT_ALU<&gbaCPU::SUB>, rd, true, true);
+            return 0;
+        case 0xF:
+            EmitReadRegister(ARG1, rs, pc);
+            EmitLoadImm(ARG2, 1);
+            EmitCall((u64)&JIT_Move<&gbaCPU::MVN>);
+            EmitWriteRegister(rd, X64_RAX);
+            return 0;
+        }
+
+        static u64 const function[16] =
+        {
+            (u64)&JIT_ALU<&gbaCPU::AND>, (u64)&JIT_ALU<&gbaCPU::EOR>, (u64)&JIT_ALU<&gbaCPU::LSL>, (u64)&JIT_ALU<&gbaCPU::LSR>, (u64)&JIT_ALU<&gbaCPU::ASR>, (u64)&JIT_ALU<&gbaCPU::ADC>, (u64)&JIT_ALU<&gbaCPU::SBC>, (u64)&JIT_ALU<&gbaCPU::ROR>,
+            (u64)&JIT_ALU<&gbaCPU::AND>, 0,         (u64)&JIT_ALU<&gbaCPU::SUB>, (u64)&JIT_ALU<&gbaCPU::ADD>, (u64)&JIT_ALU<&gbaCPU::ORR>, 0,         (u64)&JIT_ALU<&gbaCPU::BIC>, 0
+        };
+        bool shift = operation == 0x2 || operation == 0x3 || operation == 0x4 || operation == 0x7;
+        bool write = operation < 0x8 || operation >= 0xC;
+
+        EmitReadRegister(ARG1, rd, pc);
+        EmitReadRegister(ARG2, rs, pc);
+        if (shift) {EmitALUImm(4, ARG2, 0xFF);}
+        EmitOperation(function[operation], rd, write, true);
+        return shift ? 1 : 0;
+    }
+
+    // Formato 5: Hi register operations (sin BX ni escrituras a PC)
+    if ((op & 0xFC00) == 0x4400)
+    {
+        rd = SUBVAL(op, 0, 0x7) | (BITTEST(op, 7) ? 0x8 : 0);
+        rs = SUBVAL(op, 3, 0xF);
+
+        switch (SUBVAL(op, 8, 0x3))
+        {
+        case 0:
+            if (rd == REGISTER_PC) {return -1;}
+            EmitReadRegister(X64_RAX, rd, pc);
+            EmitReadRegister(X64_RCX, rs, pc);
+            EmitALU(X64_ADD, X64_RAX, X64_RCX);
+            EmitWriteRegister(rd, X64_RAX);
+            return 0;
+        case 1:
+            EmitReadRegister(ARG1, rd, pc);
+            EmitReadRegister(ARG2, rs, pc);
+            EmitOperation((u64)&JIT_ALU<&gbaCPU::SUB>, rd, false, true);
+            return 0;
+        case 2:
+            if (rd == REGISTER_PC) {return -1;}
+            EmitReadRegister(X64_RAX, rs, pc);
+            EmitWriteRegister(rd, X64_RAX);
+            return 0;
+        default:
+            return -1;
+        }
+    }
+
+    // Formato 12: load address
+    if ((op & 0xF000) == 0xA000)
+    {
+        u32 offset = SUBVAL(op, 0, 0xFF) * gbaMemory::TYPE_WORD;
+        rd = SUBVAL(op, 8, 0x7);
+        if (BITTEST(op, 11)) {EmitReadRegister(X64_RAX, REGISTER_SP, pc); EmitALUImm(0, X64_RAX, offset);} else {EmitLoadImm(X64_RAX, (pc & ~BIT(1)) + offset);}
+        EmitWriteRegister(rd, X64_RAX);
+        return 0;
+    }
+
+    // Formato 13: add offset to Stack Pointer
+    if ((op & 0xFF00) == 0xB000)
+    {
+        u32 magnitude = SUBVAL(op, 0, 0x7F) * gbaMemory::TYPE_WORD;
+        EmitReadRegister(X64_RAX, REGISTER_SP, pc);
+        EmitALUImm(0, X64_RAX, BITTEST(op, 7) ? NEGATE(magnitude) : magnitude);
+        EmitWriteRegister(REGISTER_SP, X64_RAX);
+        return 0;
+    }
+
+    return -1;
+}
+
+// Instrucciones tras las que se sale del bloque: escrituras a memoria o al CPSR, para que la consola
+// atienda IRQ y DMA, y las que pueden reiniciar el pipeline
+bool gbaCPU::ARM_IsBlockExit(u32 op, InstructionHandler handler)
+{
+    bool load = BITTEST(op, 20);
+    u32  rd   = SUBVAL(op, 12, 0xF);
+
+    if (handler == HANDLER(ARM_Format5))                                                          {return rd == REGISTER_PC;}
+    if (handler == HANDLER(ARM_Format4) || handler == HANDLER(ARM_Format7) || handler == HANDLER(ARM_Format8))    {return false;}
+    if (handler == HANDLER(ARM_Format9) || handler == HANDLER(ARM_Format10) || handler == HANDLER(ARM_Format10X)) {return !load || rd == REGISTER_PC;}
+    if (handler == HANDLER(ARM_Format11))                                                         {return !load || BITTEST(op, 15) || BITTEST(op, 22);}
+    if (handler == HANDLER(ARM_Format16))                                                         {return SUBVAL(op, 8, 0xF) != COPROCESSOR_14;}
+    return true;
+}
+
+bool gbaCPU::THUMB_IsBlockExit(u32 op, InstructionHandler handler)
+{
+    bool load = BITTEST(op, 11);
+
+    if (handler == HANDLER(THUMB_Format5_ADD) || handler == HANDLER(THUMB_Format5_MOV)) {return (op & 0x87) == 0x87;}
+    if (handler == HANDLER(THUMB_Format5_BX)  || handler == HANDLER(THUMB_Format17) || handler == HANDLER(THUMB_FormatU)) {return true;}
+    if (handler == HANDLER(THUMB_Format7) || handler == HANDLER(THUMB_Format9) || handler == HANDLER(THUMB_Format10) || handler == HANDLER(THUMB_Format11) || handler == HANDLER(THUMB_Format15)) {return !load;}
+    if (handler == HANDLER(THUMB_Format8))  {return SUBVAL(op, 10, 0x3) == 0;}
+    if (handler == HANDLER(THUMB_Format14)) {return !load || BITTEST(op, 8);}
+    return false;
+}
+//-------------------------------------------------------------------------------------------------
+// Traduccion de bloques --------------------------------------------------------------------------
+// El paso j captura la entrada j y ejecuta la entrada j - 2. Los dos ultimos pasos capturan fuera
+// del bloque con FetchOpcode y ejecutan el salto final, dejando el pipeline completo en memoria.
+void gbaCPU::EmitExitState(CodeBlock const *block, u32 j)
+{
+    CodeEntry const *entry = block->entry;
+    u32 pc = block->address + (j * block->width);
+
+    EmitStoreImm(&opcode[0], entry[j - 2].opcode);
+    EmitStoreImm(&opcode[1], entry[j - 1].opcode);
+    EmitStoreImm(&opcode[2], entry[j].opcode);
+    EmitStoreImm64(&decoded[0], (u64)entry[j - 2].handler);
+    EmitStoreImm64(&decoded[1], (u64)entry[j - 1].handler);
+    EmitStoreImm64(&decoded[2], (u64)entry[j].handler);
+    EmitStoreImm(&N_cycle, entry[j].N);
+    EmitStoreImm(&S_cycle, entry[j].S);
+    EmitStoreImm(&R15, pc);
+    EmitStoreImm64(&currentblock, (u64)block);
+    EmitStoreImm(&currententry, j + 1);
+    EmitStoreImm8(&exceptionlock, 0);
+}
+
+void gbaCPU::CompileBlock(CodeBlock *block)
+{
+    if (block->length <= 2) {return;}
+    if (jitused + JIT_BLOCKSIZE > JIT_BUFFERSIZE) {DiscardCompiledCode();}
+
+    CodeEntry const *entry = block->entry;
+    bool arm   = block->width == gbaMemory::TYPE_WORD;
+    u32  steps = block->length + 2;
+
+    u8 *start = jitbuffer + jitused;
+    u8 *step[BLOCK_MAXLENGTH + 2];
+    u8 *stub[BLOCK_MAXLENGTH];
+    u8 *patch[BLOCK_MAXLENGTH * 2];
+    u32 target[BLOCK_MAXLENGTH * 2];
+    u32 patches = 0;
+
+    jitcode = start;
+    u8 *epilogue = jitcode;
+    EmitEpilogue();
+
+    for (u32 j = 2; j < steps; j++)
+    {
+        step[j] = jitcode;
+
+        bool               tail    = j >= block->length;
+        u32                op      = entry[j - 2].opcode;
+        InstructionHandler handler = entry[j - 2].handler;
+        u32                pc      = block->address + (j * block->width);
+        s32                S       = tail ? 0 : entry[j].S;
+        u8                *skip    = 0;
+
+        if (tail)
+        {
+            if (j == block->length)
             {
-                return BITTEST(opcode->d, 9) ? THUMB_FormatU() : THUMB_Format14();
+                EmitStoreImm(&opcode[1], entry[j - 1].opcode);
+                EmitStoreImm64(&decoded[1], (u64)entry[j - 1].handler);
             }
             else
             {
-                return ((opcode->d & 0xF00) == 0x000) ? THUMB_Format13() : THUMB_FormatU();
+                EmitGlobal(X64_LOAD, false, X64_RAX, &opcode[2]);
+                EmitGlobal(X64_MOV,  false, X64_RAX, &opcode[1]);
+                EmitGlobal(X64_LOAD, true,  X64_RAX, &decoded[2]);
+                EmitGlobal(X64_MOV,  true,  X64_RAX, &decoded[1]);
             }
+
+            EmitStoreImm(&opcode[0], op);
+            EmitStoreImm64(&decoded[0], (u64)handler);
+            EmitStoreImm(&R15, pc);
+            EmitStoreImm64(&currentblock, (u64)block);
+            EmitStoreImm(&currententry, j);
+            EmitStoreImm8(&exceptionlock, 0);
+            EmitLoadImm(ARG1, pc);
+            EmitCall((u64)&JIT_FetchOpcode);
         }
-        else
+
+        u32 cc = SUBVAL(op, 28, 0xF);
+        if (arm && cc < 0xE)
         {
-            return THUMB_Format12();
+            EmitLoadImm(ARG1, cc);
+            EmitCall((u64)&JIT_TestCondition);
+            Emit8(0x84); Emit8(0xC0); // test al, al
+            skip = EmitJump(X64_JE);
         }
-    case 6:
-        if (BITTEST(opcode->d, 12))
+
+        s32 I = arm ? ARM_Translate(op, handler, pc) : THUMB_Translate(op, pc);
+
+        if (I >= 0)
         {
-            u32 icc = SUBVAL(opcode->d, 8, 0xF);
-            return (icc == 0xE) ? THUMB_FormatU() : ((icc == 0xF) ? THUMB_Format17() : THUMB_Format16());
+            EmitAddCycles(tail, S, I);
         }
         else
         {
-            return THUMB_Format15();
-        }
-    default:
-        if (BITTEST(opcode->d, 12))
-        {
-            exceptionlock = !BITTEST(opcode->d, 11);
-            return THUMB_Format19();
+            if (!tail)
+            {
+                EmitStoreImm(&opcode[0], op);
+                EmitStoreImm(&opcode[2], entry[j].opcode);
+                EmitStoreImm(&N_cycle, entry[j].N);
+                EmitStoreImm(&S_cycle, entry[j].S);
+                EmitStoreImm(&R15, pc);
+                EmitStoreImm8(&exceptionlock, 0);
+            }
+
+            EmitCall((u64)handler);
+            EmitALU(X64_ADD, X64_RBX, X64_RAX);
+
+            // Si R15 cambio el manejador ya reinicio el pipeline
+            EmitGlobal(0x81, false, 7, &R15); // cmp dword [R15], pc
+            Emit32(pc);
+            EmitJumpTo(X64_JNE, epilogue);
+
+            if (arm ? ARM_IsBlockExit(op, handler) : THUMB_IsBlockExit(op, handler))
+            {
+                if (tail) {EmitJumpTo(X64_JMP, epilogue);} else {patch[patches] = EmitJump(X64_JMP); target[patches++] = j;}
+            }
         }
-        else
+
+        if (skip != 0)
         {
-            return BITTEST(opcode->d, 11) ? THUMB_FormatU() : THUMB_Format18();
+            u8 *done = EmitJump(X64_JMP);
+            PatchJump(skip, jitcode);
+            EmitAddCycles(tail, S, 0);
+            PatchJump(done, jitcode);
         }
+
+        EmitALU(0x39, X64_RBX, X64_R12); // cmp ebx, r12d
+        if (tail) {EmitJumpTo(X64_JGE, epilogue);} else {patch[patches] = EmitJump(X64_JGE); target[patches++] = j;}
+    }
+
+    EmitJumpTo(X64_JMP, epilogue);
+
+    for (u32 j = 2; j < block->length; j++)
+    {
+        stub[j] = jitcode;
+        EmitExitState(block, j);
+        EmitJumpTo(X64_JMP, epilogue);
+    }
+
+    for (u32 i = 0; i < patches; i++) {PatchJump(patch[i], stub[target[i]]);}
+
+    for (u32 j = 2; j < block->length; j++)
+    {
+        block->offset[j] = (u16)(jitcode - start);
+        EmitPrologue();
+        EmitJumpTo(X64_JMP, step[j]);
     }
+
+    block->code = start;
+    jitused = ((u32)(jitcode - jitbuffer) + 15) & ~15;
+}
+
+bool gbaCPU::EnableRecompiler()
+{
+    if (jitbuffer == 0)
+    {
+#ifdef _WIN32
+        void *buffer = VirtualAlloc(0, JIT_BUFFERSIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+        if (buffer == 0) {return false;}
+#else
+        void *buffer = mmap(0, JIT_BUFFERSIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED) {return false;}
+#endif
+        jitbuffer = (u8 *)buffer;
+        DiscardCompiledCode();
+    }
+
+    return true;
 }
+
+gbaCPU::~gbaCPU()
+{
+    if (jitbuffer == 0) {return;}
+#ifdef _WIN32
+    VirtualFree(jitbuffer, 0, MEM_RELEASE);
+#else
+    munmap(jitbuffer, JIT_BUFFERSIZE);
+#endif
+}
+#else
+void gbaCPU::DiscardCompiledCode()
+{
+}
+
+gbaCPU::~gbaCPU()
+{
+}
+#endif
 //-------------------------------------------------------------------------------------------------
+// Seleccion del motor de ejecucion ---------------------------------------------------------------
+bool gbaCPU::SetExecutionEngine(ExecutionEngine id)
+{
+    if (id == ENGINE_RECOMPILER)
+    {
+#ifdef GBA_RECOMPILER
+        if (!EnableRecompiler()) {Emulator::LogMessage("No se pudo reservar memoria ejecutable para el recompilador"); return false;}
+#else
+        Emulator::LogMessage("Recompilador no disponible en esta plataforma");
+        return false;
+#endif
+    }
+
+    engine = id;
+    return true;
 }
 
+// Ejecuta al menos una instruccion y se detiene al alcanzar los ciclos indicados, al escribir en
+// memoria o al salir de un bloque traducido
+s32 gbaCPU::Execute(s32 cycles)
+{
+#ifdef GBA_RECOMPILER
+    if (engine == ENGINE_RECOMPILER)
+    {
+        CodeBlock *block = currentblock;
+        u32        index = currententry;
+
+        if (block != 0 && block->closed && index >= 2 && index < block->length && block->width == instructionlength && block->stamp == *block->writes && R15.d + instructionlength == block->address + (index * instructionlength))
+        {
+            if (block->code == 0 && ++block->hits >= JIT_THRESHOLD) {CompileBlock(block);}
+            if (block->code != 0) {return ((CompiledBlock)(block->code + block->offset[index]))(cycles);}
+        }
+    }
+#endif
+    return SingleStep();
+}
+//-------------------------------------------------------------------------------------------------
 //*************************************************************************************************
\ No newline at end of file
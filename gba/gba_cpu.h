@@ -7,14 +7,326 @@
 #pragma once
 
 #include "../types.h"
+#include "gba_memory.h"
 
-namespace gbaCPU
+class gbaConsole;
+
+class gbaCPU
 {
-bool IsOpcodeFetch(t32 const *data);
-s32 Reset();
-s32 SingleStep();
-s32 RequestInterrupt();
-u32 GetPrefetch();
-}
+public:
+    enum ExecutionEngine
+    {
+        ENGINE_INTERPRETER,
+        ENGINE_RECOMPILER
+    };
+
+    gbaCPU(gbaConsole *console);
+    ~gbaCPU();
+
+    bool SetExecutionEngine(ExecutionEngine id);
+    s32 Reset();
+    s32 SingleStep();
+    s32 Execute(s32 cycles);
+    void ResetIdleLoop();
+    s32 SkipIdleLoop(s32 ticks, s32 limit);
+    s32 RequestInterrupt();
+    u32 GetPrefetch() const;
+    void FlushCodeCache();
+
+private:
+    enum Exception
+    {
+        EXCEPTION_RESET,
+        EXCEPTION_DATAABORT,
+        EXCEPTION_FIQ,
+        EXCEPTION_IRQ,
+        EXCEPTION_PREFETCHABORT,
+        EXCEPTION_SOFTWAREINTERRUPT,
+        EXCEPTION_UNDEFINEDINSTRUCTION
+    };
+
+    enum FlagOperation
+    {
+        FLAGOP_NONE,
+        FLAGOP_ADD,
+        FLAGOP_ADC,
+        FLAGOP_SUB,
+        FLAGOP_SBC
+    };
+
+    // Banderas diferidas: resultado y operandos de la ultima operacion que afecto las banderas
+    struct LazyFlags
+    {
+        bool          nz;        // N y Z pendientes, a partir de result
+        u32           result;
+        FlagOperation cv;        // C y V pendientes, a partir de rs, rn, par y ret
+        u32           rs;
+        u32           rn;
+        u32           par;
+        u32           ret;
+    };
+
+    // Los manejadores son funciones libres para guardarlos en tablas compartidas y llamarlos desde
+    // el codigo recompilado con el CPU como unico argumento
+    typedef s32 (*InstructionHandler)(gbaCPU *cpu);
+
+    template <s32 (gbaCPU::*handler)()> static s32 Dispatch(gbaCPU *cpu) {return (cpu->*handler)();}
+
+    // Cache de bloques: secuencias de instrucciones capturadas hasta el siguiente salto
+    static const u32 BLOCK_CACHESIZE = 2048;
+    static const u32 BLOCK_MAXLENGTH = 32;
+
+    struct CodeEntry
+    {
+        u32                opcode;
+        InstructionHandler handler;
+        s32                N;
+        s32                S;
+    };
+
+    struct CodeBlock
+    {
+        u32        address;
+        u32        length;
+        u32        width;
+        bool       closed;
+        u32 const *writes;
+        u32        stamp;
+        u32        hits;
+        u8        *code;
+        u16        offset[BLOCK_MAXLENGTH];
+        CodeEntry  entry[BLOCK_MAXLENGTH];
+    };
+
+    // Ciclos ociosos: estado visible del CPU cada vez que se toma un salto corto hacia atras. Si se
+    // repite sin efectos en memoria las vueltas siguientes son identicas hasta el proximo evento
+    static const u32 IDLE_MAXLENGTH = 64;
+
+    struct IdleState
+    {
+        u32 address;
+        u32 cpsr;
+        u32 sideeffects;
+        u32 registers[15];
+    };
+
+    static InstructionHandler ARM_Handler[4096];
+    static InstructionHandler THUMB_Handler[1024];
+
+    gbaConsole *m_console;
+
+    ExecutionEngine engine;
+
+    InstructionHandler DecodeAndExecute;
+
+    CodeBlock  codeblock[BLOCK_CACHESIZE];
+    CodeBlock *currentblock;
+    u32        currententry;
+
+    t32                opcode[3];
+    InstructionHandler decoded[3];
+    s32  N_cycle, S_cycle;
+    bool exceptionlock;
+
+    bool      idlebranch;
+    bool      idlevalid;
+    s32       idleticks;
+    IdleState idlestate;
+
+    gbaMemory::DataType instructionlength;
+
+    t8 * const prefetch32[4];
+    t8 * const prefetch16[4];
+
+    t8 * const *prefetch;
+
+    t32 R0, R1, R2, R3, R4, R5, R6, R7, R8, R9, R10, R11, R12, R13, R14, R15, CPSR, SPSR;
+    t32 R8_fiq, R9_fiq, R10_fiq, R11_fiq, R12_fiq;
+    t32 R13_fiq, R14_fiq, SPSR_fiq;
+    t32 R13_svc, R14_svc, SPSR_svc;
+    t32 R13_abt, R14_abt, SPSR_abt;
+    t32 R13_irq, R14_irq, SPSR_irq;
+    t32 R13_und, R14_und, SPSR_und;
+
+    t32 * const RX[16];
+    t32 * const RX_fiq[16];
+    t32 * const RX_svc[16];
+    t32 * const RX_abt[16];
+    t32 * const RX_irq[16];
+    t32 * const RX_und[16];
+
+    t32 * const *RX_xxx;
+    t32         *SPSR_xxx;
+
+    LazyFlags lazy;
+
+    // Recompilador: cada CPU tiene su propio buffer de codigo
+    u8 *jitbuffer;
+    u32 jitused;
+    u8 *jitcode;
+
+    void UpdateCarryOverflow();
+    void UpdateFlags();
+    bool GetCarry();
+    void SetNZ(u32 result);
+    void SetNZC(u32 result, bool c);
+    void SetNZCV(FlagOperation cv, u32 rs, u32 rn, u32 par, u32 ret);
+
+    void EnterOperatingMode(u32 mode);
+    void EnterOperatingState(u32 tbit);
+    InstructionHandler Decode(u32 op);
+    bool IsBranch(u32 op);
+    CodeBlock *FindCodeBlock(u32 address);
+    void FetchOpcode(u32 address, u32 slot, s32 *N_access, s32 *S_access);
+    s32 BranchAbsolute(u32 address, bool bx, bool bl, u32 link);
+    u32 GetNextPC();
+    s32 EnterException(Exception id);
+    bool TestCondition(u32 cc);
+    void WriteCPSR();
+    void RestoreCPSR();
+    s32 WritePC(bool s);
+
+    u32 CountLeadingZerosOrOnes(u32 value, bool ones);
+    s32 MultiplierArrayCycles(u32 rs, bool sign);
+    u32 LSL(u32 rs, u32 rn, bool s);
+    u32 LSR(u32 rs, u32 rn, bool s);
+    u32 ASR(u32 rs, u32 rn, bool s);
+    u32 ROR(u32 rs, u32 rn, bool s);
+    u32 RRX(u32 rs, bool s);
+    u32 AND(u32 rs, u32 rn, bool s);
+    u32 EOR(u32 rs, u32 rn, bool s);
+    u32 ORR(u32 rs, u32 rn, bool s);
+    u32 BIC(u32 rs, u32 rn, bool s);
+    u32 ADD(u32 rs, u32 rn, bool s);
+    u32 ADC(u32 rs, u32 rn, bool s);
+    u32 SUB(u32 rs, u32 rn, bool s);
+    u32 SBC(u32 rs, u32 rn, bool s);
+    u32 MOV(u32 rs, bool s);
+    u32 MVN(u32 rs, bool s);
+    u32 MUL(u32 rm, u32 rs, bool s);
+    u32 MLA(u32 rm, u32 rs, u32 rn, bool s);
+    u64 UMULL(u32 rm, u32 rs, bool s);
+    u64 UMLAL(u32 rm, u32 rs, u64 rn, bool s);
+    u64 SMULL(s32 rm, s32 rs, bool s);
+    u64 SMLAL(s32 rm, s32 rs, s64 rn, bool s);
+
+    void STR(u32 address, t32 const *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access);
+    void LDR(u32 address, t32 *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access, bool ror, bool sx);
+    u32 ShiftGroup(u32 op, u32 value, u32 sh, bool s, bool imm);
+    s32 SingleDataTransfer(bool load, u32 address, u32 rd, gbaMemory::DataType width, bool ror, bool sx);
+    s32 SingleDataTransfer(bool load, u32 rn, u32 offset, u32 rd, gbaMemory::DataType width, bool ror, bool sx, bool p, bool u, bool w);
+    s32 MultipleDataTransfer(bool load, u32 rlist, u32 rn, bool p, bool u, bool w, bool s);
+
+    s32 ARM_Format3();
+    s32 ARM_Format4();
+    s32 ARM_Format5();
+    s32 ARM_Format6();
+    s32 ARM_Format7();
+    s32 ARM_Format8();
+    s32 ARM_Format9();
+    s32 ARM_Format10();
+    s32 ARM_Format11();
+    s32 ARM_Format12();
+    s32 ARM_Format13();
+    s32 ARM_Format14();
+    s32 ARM_Format15();
+    s32 ARM_Format16();
+    s32 ARM_Format17();
+    s32 ARM_Format3X();
+    s32 ARM_Format6X();
+    s32 ARM_Format10X();
+    s32 ARM_Format12X();
+    s32 ARM_DecodeAndExecute();
+    static void ARM_BuildHandlerTable();
+
+    s32 THUMB_Format1_LSL();
+    s32 THUMB_Format1_LSR();
+    s32 THUMB_Format1_ASR();
+    s32 THUMB_Format2_ADD();
+    s32 THUMB_Format2_SUB();
+    s32 THUMB_Format2_ADDIMM();
+    s32 THUMB_Format2_SUBIMM();
+    s32 THUMB_Format3_MOV();
+    s32 THUMB_Format3_CMP();
+    s32 THUMB_Format3_ADD();
+    s32 THUMB_Format3_SUB();
+    s32 THUMB_Format4_AND();
+    s32 THUMB_Format4_EOR();
+    s32 THUMB_Format4_LSL();
+    s32 THUMB_Format4_LSR();
+    s32 THUMB_Format4_ASR();
+    s32 THUMB_Format4_ADC();
+    s32 THUMB_Format4_SBC();
+    s32 THUMB_Format4_ROR();
+    s32 THUMB_Format4_TST();
+    s32 THUMB_Format4_NEG();
+    s32 THUMB_Format4_CMP();
+    s32 THUMB_Format4_CMN();
+    s32 THUMB_Format4_ORR();
+    s32 THUMB_Format4_MUL();
+    s32 THUMB_Format4_BIC();
+    s32 THUMB_Format4_MVN();
+    s32 THUMB_Format5_ADD();
+    s32 THUMB_Format5_CMP();
+    s32 THUMB_Format5_MOV();
+    s32 THUMB_Format5_BX();
+    s32 THUMB_Format6();
+    s32 THUMB_Format7();
+    s32 THUMB_Format8();
+    s32 THUMB_Format9();
+    s32 THUMB_Format10();
+    s32 THUMB_Format11();
+    s32 THUMB_Format12();
+    s32 THUMB_Format13();
+    s32 THUMB_Format14();
+    s32 THUMB_Format15();
+    s32 THUMB_Format16();
+    s32 THUMB_Format17();
+    s32 THUMB_Format18();
+    s32 THUMB_Format19();
+    s32 THUMB_FormatU();
+    s32 THUMB_DecodeAndExecute();
+    static void THUMB_BuildHandlerTable();
+
+    // Puntos de entrada del codigo recompilado, reciben el CPU en el primer argumento
+    template <u32 (gbaCPU::*operation)(u32, u32, bool)> static u32 JIT_ALU(gbaCPU *cpu, u32 rs, u32 rn, bool s) {return (cpu->*operation)(rs, rn, s);}
+    template <u32 (gbaCPU::*operation)(u32, bool)> static u32 JIT_Move(gbaCPU *cpu, u32 rs, bool s) {return (cpu->*operation)(rs, s);}
+    static bool JIT_TestCondition(gbaCPU *cpu, u32 cc);
+    static void JIT_FetchOpcode(gbaCPU *cpu, u32 address);
+
+    void Emit8(u32 value);
+    void Emit32(u32 value);
+    void Emit64(u64 value);
+    void EmitREX(bool w, u32 reg, u32 base);
+    void EmitLoadImm(u32 reg, u32 imm);
+    void EmitLoadImm64(u32 reg, u64 imm);
+    void EmitMemory(u32 op, bool w, u32 reg, u32 base, u32 disp);
+    void EmitGlobal(u32 op, bool w, u32 reg, void const *address);
+    void EmitStoreImm(void const *address, u32 imm);
+    void EmitStoreImm8(void const *address, u32 imm);
+    void EmitStoreImm64(void const *address, u64 imm);
+    void EmitALU(u32 op, u32 dst, u32 src);
+    void EmitALUImm(u32 extension, u32 reg, u32 imm);
+    void EmitShift(u32 extension, u32 reg, u32 imm);
+    void EmitNot(u32 reg);
+    void EmitCall(u64 function);
+    u8 *EmitJump(u32 cc);
+    void PatchJump(u8 *field, u8 const *target);
+    void EmitJumpTo(u32 cc, u8 const *target);
+    void EmitReadRegister(u32 reg, u32 r, u32 pc);
+    void EmitWriteRegister(u32 r, u32 reg);
+    void EmitOperation(u64 function, u32 rd, bool write, bool s);
+    void EmitAddCycles(bool dynamic, s32 S, s32 I);
+    void EmitPrologue();
+    void EmitEpilogue();
+    void DiscardCompiledCode();
+    s32 ARM_Translate(u32 op, InstructionHandler handler, u32 pc);
+    s32 THUMB_Translate(u32 op, u32 pc);
+    bool ARM_IsBlockExit(u32 op, InstructionHandler handler);
+    bool THUMB_IsBlockExit(u32 op, InstructionHandler handler);
+    void EmitExitState(CodeBlock const *block, u32 j);
+    void CompileBlock(CodeBlock *block);
+    bool EnableRecompiler();
+};
 
 //*************************************************************************************************
\ No newline at end of file
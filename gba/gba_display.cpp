@@ -6,95 +6,59 @@
 
 #include <cstring>
 #include "../emulator.h"
-#include "gba_control.h"
+#include "gba_console.h"
 #include "gba_display.h"
-#include "gba_dma.h"
-#include "gba_keyinput.h"
 
-namespace gbaDisplay
-{
+#if defined(_M_X64) || defined(__x86_64__)
+#define GBA_DISPLAY_SSE2
+#include <emmintrin.h>
+#endif
+
 const s32 m_lineclk = 960;
 const s32 m_hblankclk = 272;
-s32 m_ticks;
-s32 m_mode;
-
-const u32  m_screenwidth  = 240;
-const u32  m_screenheight = 160;
-
-u8 m_PaletteRAM[0x400];
-u8 m_VRAM[0x18000];
-u8 m_OAM[0x400];
-bool m_bitmapmode;
-t16 m_DISPCNT;
-t8 m_u0x04000002;
-t16 m_DISPSTAT;
-t8 m_VCOUNT;
-
-u16 m_framebuffer[GBA_SCREENHEIGHT][GBA_SCREENWIDTH];
-
-u32 m_bgmode;
-
-t16 m_BGXCNT[4];
-t16 m_BGXHOFS[4];
-t16 m_BGXVOFS[4];
-t16 m_BG2PA;
-t16 m_BG2PB;
-t16 m_BG2PC;
-t16 m_BG2PD;
-t16 m_BG2X_L;
-t16 m_BG2X_H;
-t16 m_BG2Y_L;
-t16 m_BG2Y_H;
-t16 m_BG3PA;
-t16 m_BG3PB;
-t16 m_BG3PC;
-t16 m_BG3PD;
-t16 m_BG3X_L;
-t16 m_BG3X_H;
-t16 m_BG3Y_L;
-t16 m_BG3Y_H;
-t16 m_WININ;
-t16 m_WINOUT;
-t16 m_MOSAIC;
-t16 m_BLDCNT;
-
-u32  GetDisplayFrame()         {return SUBVAL(m_DISPCNT.w, 4, 1);}
-bool IsHblankFree()            {return BITTEST(m_DISPCNT.w,  5);}
-bool IsOBJModeOneDimensional() {return BITTEST(m_DISPCNT.w,  6);}
-bool IsForcedBlank()           {return BITTEST(m_DISPCNT.w,  7);}
-
-bool IsBGEnabled(u32 bg)       {return BITTEST(m_DISPCNT.w, 8 + (bg & 3));}
-
-bool IsOBJEnabled()            {return BITTEST(m_DISPCNT.w, 12);}
-bool IsWindow0Enabled()        {return BITTEST(m_DISPCNT.w, 13);}
-bool IsWindow1Enabled()        {return BITTEST(m_DISPCNT.w, 14);}
-bool IsOBJWindowEnabled()      {return BITTEST(m_DISPCNT.w, 15);}
-bool IsOutsideWindowEnabled()  {return IsWindow0Enabled() || IsWindow1Enabled() || IsOBJWindowEnabled();}
-
-bool IsBGModeBitmap() {return m_bitmapmode;}
-
-class Palette
-{
-private:
-    static const u16 *m_bgpalette;
-    static const u16 *m_objpalette;
-
-public:
-    static u16 GetBackdropColor();
-    static u16 GetBGColor16x16(u32 palette, u32 color);
-    static u16 GetOBJColor16x16(u32 palette, u32 color);
-    static u16 GetBGColor256x1(u32 index);
-    static u16 GetOBJColor256x1(u32 index);
-};
 
-const u16 *Palette::m_bgpalette  = ((u16 *)&m_PaletteRAM[0]);
-const u16 *Palette::m_objpalette = ((u16 *)&m_PaletteRAM[0x200]);
+gbaDisplay::gbaDisplay(gbaConsole *console) :
+    m_palette(this), m_tilecache(this), m_obj(this), m_window(this), m_bg0(this), m_bg1(this), m_bg2(this), m_bg3(this), m_painter(this), m_renderer(this)
+{
+    m_console      = console;
+    m_simd         = true;
+    m_batch        = true;
+    m_renderthread = false;
+    m_threaded     = false;
+    m_frameskip    = 1;
+}
+
+gbaDisplay::~gbaDisplay()
+{
+    Release();
+}
+
+u32  gbaDisplay::GetDisplayFrame() const         {return SUBVAL(m_DISPCNT.w, 4, 1);}
+bool gbaDisplay::IsHblankFree() const            {return BITTEST(m_DISPCNT.w,  5);}
+bool gbaDisplay::IsOBJModeOneDimensional() const {return BITTEST(m_DISPCNT.w,  6);}
+bool gbaDisplay::IsForcedBlank() const           {return BITTEST(m_DISPCNT.w,  7);}
+
+bool gbaDisplay::IsBGEnabled(u32 bg) const       {return BITTEST(m_DISPCNT.w, 8 + (bg & 3));}
 
-u16 Palette::GetBackdropColor()                       {return m_bgpalette [0];}
-u16 Palette::GetBGColor16x16(u32 palette, u32 color)  {return m_bgpalette [((palette & 0xF) * 16) + (color & 0xF)];}
-u16 Palette::GetOBJColor16x16(u32 palette, u32 color) {return m_objpalette[((palette & 0xF) * 16) + (color & 0xF)];}
-u16 Palette::GetBGColor256x1(u32 index)               {return m_bgpalette [index & 0xFF];}
-u16 Palette::GetOBJColor256x1(u32 index)              {return m_objpalette[index & 0xFF];}
+bool gbaDisplay::IsOBJEnabled() const            {return BITTEST(m_DISPCNT.w, 12);}
+bool gbaDisplay::IsWindow0Enabled() const        {return BITTEST(m_DISPCNT.w, 13);}
+bool gbaDisplay::IsWindow1Enabled() const        {return BITTEST(m_DISPCNT.w, 14);}
+bool gbaDisplay::IsOBJWindowEnabled() const      {return BITTEST(m_DISPCNT.w, 15);}
+bool gbaDisplay::IsOutsideWindowEnabled() const  {return IsWindow0Enabled() || IsWindow1Enabled() || IsOBJWindowEnabled();}
+
+bool gbaDisplay::IsBGModeBitmap() const {return m_bitmapmode;}
+
+gbaDisplay::Palette::Palette(gbaDisplay *display)
+{
+    m_bgpalette  = (u16 const *)&display->m_PaletteRAM[0];
+    m_objpalette = (u16 const *)&display->m_PaletteRAM[0x200];
+}
+
+u16 gbaDisplay::Palette::GetBackdropColor() const                       {return m_bgpalette [0];}
+u16 gbaDisplay::Palette::GetBGColor16x16(u32 palette, u32 color) const  {return m_bgpalette [((palette & 0xF) * 16) + (color & 0xF)];}
+u16 gbaDisplay::Palette::GetOBJColor16x16(u32 palette, u32 color) const {return m_objpalette[((palette & 0xF) * 16) + (color & 0xF)];}
+u16 gbaDisplay::Palette::GetBGColor256x1(u32 index) const               {return m_bgpalette [index & 0xFF];}
+u16 gbaDisplay::Palette::GetOBJColor256x1(u32 index) const              {return m_objpalette[index & 0xFF];}
 
 enum DotType
 {
@@ -126,37 +90,79 @@ enum DotType
     DOT_WINDOWUSEALL  = DOT_WINDOWUSEBG0 | DOT_WINDOWUSEBG1 | DOT_WINDOWUSEBG2 | DOT_WINDOWUSEBG3 | DOT_WINDOWUSEOBJ | DOT_WINDOWUSECSE
 };
 
+//-------------------------------------------------------------------------------------------------
+// Cache de tiles ---------------------------------------------------------------------------------
+// Tiles de 8x8 decodificados a un byte por punto (indice de paleta), normales y volteados en
+// horizontal; cada tile se decodifica de nuevo cuando cambia el contador de escrituras de su bloque
+
+gbaDisplay::TileCache::TileCache(gbaDisplay *display) {m_display = display;}
+
+void gbaDisplay::TileCache::Reset()
+{
+    memset(m_display->m_VRAMwrites, 0,    sizeof(m_display->m_VRAMwrites));
+    memset(m_stamp16,    0xFF, sizeof(m_stamp16));
+    memset(m_stamp256,   0xFF, sizeof(m_stamp256));
+}
+
+u8 const *gbaDisplay::TileCache::GetTile16(u32 address, bool hflip)
+{
+    u32 index = address >> 5;
+    u32 stamp = m_display->m_VRAMwrites[address >> 8];
+
+    if (m_stamp16[index] != stamp)
+    {
+        u8 const *source = &m_display->m_VRAM[index << 5];
+        u8       *tile   = m_tile16[index][0];
+        u8       *flip   = m_tile16[index][1];
+
+        for (u32 i = 0; i < 32; ++i)
+        {
+            tile[((i << 1) | 0)]     = source[i] & 15;
+            tile[((i << 1) | 1)]     = source[i] >> 4;
+            flip[((i << 1) | 0) ^ 7] = source[i] & 15;
+            flip[((i << 1) | 1) ^ 7] = source[i] >> 4;
+        }
+
+        m_stamp16[index] = stamp;
+    }
+
+    return m_tile16[index][hflip ? 1 : 0];
+}
+
+// Los BGs con charblock 3 en 256x1 pueden apuntar mas alla de la VRAM, esos tiles son transparentes
+u8 const *gbaDisplay::TileCache::GetTile256(u32 address, bool hflip)
+{
+    if (address >= sizeof(m_display->m_VRAM)) {return m_blank;}
+
+    u32 index = address >> 6;
+    u32 stamp = m_display->m_VRAMwrites[address >> 8];
+
+    if (m_stamp256[index] != stamp)
+    {
+        u8 const *source = &m_display->m_VRAM[index << 6];
+        u8       *tile   = m_tile256[index][0];
+        u8       *flip   = m_tile256[index][1];
+
+        for (u32 i = 0; i < 64; ++i)
+        {
+            tile[i]     = source[i];
+            flip[i ^ 7] = source[i];
+        }
+
+        m_stamp256[index] = stamp;
+    }
+
+    return m_tile256[index][hflip ? 1 : 0];
+}
+
 namespace ReferencePoint
 {
 u32 FixedPointToInteger(u32 f) {return (s32)f >> 8;}
 }
 
 // Procesamiento de OBJs --------------------------------------------------------------------------
-class OBJ
-{
-private:
-    static const u32 m_dimension[3][4][2];
-    static u8 const * const m_tilebase;
-
-    static u16 m_line[m_screenwidth];
-    static u16 m_attr[m_screenwidth];
-    static u16 m_objw[m_screenwidth];
-    static u32 m_hmosaic;
-    static u32 m_vmosaic;
-    static u16 m_objwflags;
-    static u16 m_outwflags;
-
-public:
-    static void Reset();
-    static void SetMosaic(u32 h, u32 v);
-    static void SetOBJWindowFlags(u16 objwflags);
-    static void SetOutsideWindowFlags(u16 outwflags);
-    static void RenderLine();    
-    static void GetLine(u16 const *&line, u16 const *&attr);
-    static void GetWindowLine(u16 *&objw);
-};
 
-const u32 OBJ::m_dimension[3][4][2] =
+const u32 gbaDisplay::OBJ::m_dimension[3][4][2] =
 {
 // Longitud: x en 0, y en 1 (2 dimensiones)   // Forma: 0 a 2 (3 formas)
     {{ 8,  8}, {16, 16}, {32, 32}, {64, 64}}, // Cuadrado
@@ -165,32 +171,60 @@ const u32 OBJ::m_dimension[3][4][2] =
 // Tamao: 0 a 3 (4 tamaos)
 };
 
-u8 const * const OBJ::m_tilebase = &m_VRAM[0x10000];
-
-u16 OBJ::m_line[m_screenwidth];
-u16 OBJ::m_attr[m_screenwidth];
-u16 OBJ::m_objw[m_screenwidth];
-u32 OBJ::m_hmosaic;
-u32 OBJ::m_vmosaic;
-u16 OBJ::m_objwflags;
-u16 OBJ::m_outwflags;
+gbaDisplay::OBJ::OBJ(gbaDisplay *display) {m_display = display;}
 
-void OBJ::Reset()
+void gbaDisplay::OBJ::Reset()
 {
     m_hmosaic = 1;
     m_vmosaic = 1;
 }
 
-void OBJ::SetMosaic(u32 h, u32 v)
+void gbaDisplay::OBJ::SetMosaic(u32 h, u32 v)
 {
     m_hmosaic = h;
     m_vmosaic = v;
 }
 
-void OBJ::SetOBJWindowFlags(u16 objwflags)     {m_objwflags = objwflags;}
-void OBJ::SetOutsideWindowFlags(u16 outwflags) {m_outwflags = outwflags;}
+void gbaDisplay::OBJ::SetOBJWindowFlags(u16 objwflags)     {m_objwflags = objwflags;}
+void gbaDisplay::OBJ::SetOutsideWindowFlags(u16 outwflags) {m_outwflags = outwflags;}
+
+// Fila del tile que contiene al punto (row, col) del OBJ, los numeros de tile se repiten cada 32 KiB
+u8 const *gbaDisplay::OBJ::GetTileRow(u32 chr, bool use256x1, bool onedimensional, u32 hsize, u32 row, u32 col, bool hflip)
+{
+    u32 address;
+
+    if (use256x1)
+    {
+        address = ((chr & ~1) << 5) +
+                  (onedimensional ? (((hsize >> 3) * (row >> 3)) << 6) : ((row & ~7) << 7)) +
+                  ((col & ~7) << 3);
+        return m_display->m_tilecache.GetTile256(0x10000 + (address & 0x7FFF), hflip) + ((row & 7) << 3);
+    }
+    else
+    {
+        address = (chr << 5) +
+                  (onedimensional ? (((hsize >> 3) * (row >> 3)) << 5) : ((row & ~7) << 7)) +
+                  ((col & ~7) << 2);
+        return m_display->m_tilecache.GetTile16(0x10000 + (address & 0x7FFF), hflip) + ((row & 7) << 3);
+    }
+}
+
+void gbaDisplay::OBJ::WriteDot(u32 dot, u32 mode, u32 color, u16 pixel, u16 attr)
+{
+    if (color == 0) {return;}
 
-void OBJ::RenderLine()
+    if (mode == 2)
+    {
+        m_objw[dot] = m_objwflags;
+    }
+    else if ((m_attr[dot] == DOT_TRANSPARENT) || ((m_attr[dot] & DOT_PRIORITYBITS) > (attr & DOT_PRIORITYBITS)))
+    {
+        m_line[dot] = pixel;
+        m_attr[dot] = attr;
+    }
+}
+
+void gbaDisplay::OBJ::RenderLine()
 {
     u32  objbase;
     u32  ypos;
@@ -233,6 +267,9 @@ void OBJ::RenderLine()
     u16  priority;
     u16  extraflag;
     u16  pixel;
+    u16  attr;
+    bool hflip;
+    u8 const *row;
     t16  attribute[3];
     bool objenabled;
     bool objwindowenabled;
@@ -242,10 +279,10 @@ void OBJ::RenderLine()
     u32  hmosaic;
     u32  vmosaic;
 
-    objenabled       = IsOBJEnabled();
-    objwindowenabled = IsOBJWindowEnabled();
+    objenabled       = m_display->IsOBJEnabled();
+    objwindowenabled = m_display->IsOBJWindowEnabled();
 
-    winxflags = IsOutsideWindowEnabled() ? m_outwflags : DOT_WINDOWUSEALL;
+    winxflags = m_display->IsOutsideWindowEnabled() ? m_outwflags : DOT_WINDOWUSEALL;
 
     for (u32 i = 0; i < m_screenwidth; ++i)
     {
@@ -271,8 +308,7 @@ void OBJ::RenderLine()
     {
         objbase = entry << 3;
 
-        attribute[0].b.b0.b = m_OAM[objbase + 0];
-        attribute[0].b.b1.b = m_OAM[objbase + 1];
+        attribute[0].w = *(u16 *)&m_display->m_OAM[objbase + 0];
         
         users = BITTEST(attribute[0].w, 8);
         use2x = BITTEST(attribute[0].w, 9);
@@ -291,8 +327,7 @@ void OBJ::RenderLine()
         shape = SUBVAL(attribute[0].w, 14, 3);
         if (shape == 3) {continue;}
 
-        attribute[1].b.b0.b = m_OAM[objbase + 2];
-        attribute[1].b.b1.b = m_OAM[objbase + 3];
+        attribute[1].w = *(u16 *)&m_display->m_OAM[objbase + 2];
 
         size  = SUBVAL(attribute[1].w, 14, 3);
 
@@ -306,13 +341,13 @@ void OBJ::RenderLine()
 
         if (vend > vstart)
         {
-            if ((m_VCOUNT.b < vstart) || (m_VCOUNT.b >= vend)) {continue;}
-            tilerow = m_VCOUNT.b - vstart;
+            if ((m_display->m_renderline < vstart) || (m_display->m_renderline >= vend)) {continue;}
+            tilerow = m_display->m_renderline - vstart;
         }
         else
         {
-            if ((m_VCOUNT.b < vstart) && (m_VCOUNT.b >= vend)) {continue;}
-            tilerow = (256 - vstart) + m_VCOUNT.b;
+            if ((m_display->m_renderline < vstart) && (m_display->m_renderline >= vend)) {continue;}
+            tilerow = (256 - vstart) + m_display->m_renderline;
         }
         
         xpos  = attribute[1].w & 511;
@@ -334,11 +369,10 @@ void OBJ::RenderLine()
             tilecol = 512 - hstart;
         }
 
-        attribute[2].b.b0.b = m_OAM[objbase + 4];
-        attribute[2].b.b1.b = m_OAM[objbase + 5];
+        attribute[2].w = *(u16 *)&m_display->m_OAM[objbase + 4];
 
         chr       = attribute[2].w & 1023;
-        if (IsBGModeBitmap() && chr < 512) {continue;}
+        if (m_display->IsBGModeBitmap() && chr < 512) {continue;}
         usemosaic = BITTEST(attribute[0].w, 12);
         use256x1  = BITTEST(attribute[0].w, 13);
         priority  = SUBVAL(attribute[2].w, 10, 3);
@@ -347,20 +381,16 @@ void OBJ::RenderLine()
         dot      = (xpos + tilecol) & 511;
         htileofs = tilecol;        
 
-        onedimensional = IsOBJModeOneDimensional();
+        onedimensional = m_display->IsOBJModeOneDimensional();
 
         if (users)
         {
             pxbase = SUBVAL(attribute[1].w, 9, 31) << 5;
 
-            PA.w.w0.b.b0.b = m_OAM[pxbase + 0x06];
-            PA.w.w0.b.b1.b = m_OAM[pxbase + 0x07];
-            PB.w.w0.b.b0.b = m_OAM[pxbase + 0x0E];
-            PB.w.w0.b.b1.b = m_OAM[pxbase + 0x0F];
-            PC.w.w0.b.b0.b = m_OAM[pxbase + 0x16];
-            PC.w.w0.b.b1.b = m_OAM[pxbase + 0x17];
-            PD.w.w0.b.b0.b = m_OAM[pxbase + 0x1E];
-            PD.w.w0.b.b1.b = m_OAM[pxbase + 0x1F];
+            PA.w.w0.w = *(u16 *)&m_display->m_OAM[pxbase + 0x06];
+            PB.w.w0.w = *(u16 *)&m_display->m_OAM[pxbase + 0x0E];
+            PC.w.w0.w = *(u16 *)&m_display->m_OAM[pxbase + 0x16];
+            PD.w.w0.w = *(u16 *)&m_display->m_OAM[pxbase + 0x1E];
 
             PA.d = SIGNEX(PA.d, 15);
             PB.d = SIGNEX(PB.d, 15);
@@ -373,10 +403,12 @@ void OBJ::RenderLine()
 
             objhcenter = hsize >> 1;
             objvcenter = vsize >> 1;
+            hflip      = false;
         }
         else
         {
-            if (BITTEST(attribute[1].w, 12))
+            hflip = BITTEST(attribute[1].w, 12);
+            if (hflip)
             {
                 tilecol = (hsize - 1) - tilecol;
                 hdelta  = NEGATE(1U);
@@ -399,6 +431,29 @@ void OBJ::RenderLine()
             vmosaic = 1;
         }
 
+        attr = DOT_OPAQUE | priority | extraflag;
+
+        if (!users && (hmosaic == 1))
+        {
+            // Sin rotacion ni mosaico horizontal se recorre cada fila de tile en orden, usando el
+            // tile volteado si hace falta
+            mosaicrow = (tilerow / vmosaic) * vmosaic;
+
+            for (u32 h = htileofs; (h < hlim) && (dot < m_screenwidth);)
+            {
+                row = GetTileRow(chr, use256x1, onedimensional, hsize, mosaicrow, hflip ? ((hsize - 1) - h) : h, hflip);
+
+                for (u32 i = h & 7; (i < 8) && (h < hlim) && (dot < m_screenwidth); ++i, ++h, ++dot)
+                {
+                    color = row[i];
+                    pixel = use256x1 ? m_display->m_palette.GetOBJColor256x1(color) : m_display->m_palette.GetOBJColor16x16(palette, color);
+                    WriteDot(dot, mode, color, pixel, attr);
+                }
+            }
+
+            continue;
+        }
+
         for (u32 h = htileofs; (h < hlim) && (dot < m_screenwidth); ++h, ++dot)
         {
             mosaicrow = (tilerow / vmosaic) * vmosaic;
@@ -415,86 +470,36 @@ void OBJ::RenderLine()
                 if ((mosaiccol >= hsize) || (mosaicrow >= vsize)) {continue;}
             }
 
-            if (use256x1)
-            {
-                color = m_tilebase[((chr & ~1) << 5) +
-                                   (onedimensional ? (((hsize >> 3) * (mosaicrow >> 3)) << 6) : ((mosaicrow & ~7) << 7)) +
-                                   ((mosaicrow &  7) << 3) +
-                                   ((mosaiccol & ~7) << 3) +
-                                    (mosaiccol &  7)];
-                pixel = Palette::GetOBJColor256x1(color);
-            }
-            else
-            {
-                color = m_tilebase[(chr << 5) +
-                                   (onedimensional ? (((hsize >> 3) * (mosaicrow >> 3)) << 5) : ((mosaicrow & ~7) << 7)) +
-                                   ((mosaicrow &  7) << 2) +
-                                   ((mosaiccol & ~7) << 2) +
-                                   ((mosaiccol &  7) >> 1)];
-                color = SUBVAL(color, (mosaiccol & 1) << 2, 15);
-                pixel = Palette::GetOBJColor16x16(palette, color);
-            }
-
-            if (color == 0) {continue;}
-
-            if (mode == 2)
-            {
-                m_objw[dot] = m_objwflags;
-            }
-            else if ((m_attr[dot] == DOT_TRANSPARENT) || ((m_attr[dot] & DOT_PRIORITYBITS) > priority))
-            {
-                m_line[dot] = pixel;
-                m_attr[dot] = DOT_OPAQUE | priority | extraflag;
-            }
+            color = GetTileRow(chr, use256x1, onedimensional, hsize, mosaicrow, mosaiccol, false)[mosaiccol & 7];
+            pixel = use256x1 ? m_display->m_palette.GetOBJColor256x1(color) : m_display->m_palette.GetOBJColor16x16(palette, color);
+            WriteDot(dot, mode, color, pixel, attr);
         }
     }
 }
 
-void OBJ::GetLine(u16 const *&line, u16 const *&attr)
+void gbaDisplay::OBJ::GetLine(u16 const *&line, u16 const *&attr)
 {
     line = m_line;
     attr = m_attr;
 }
 
-void OBJ::GetWindowLine(u16 *&objw)
+void gbaDisplay::OBJ::GetWindowLine(u16 *&objw)
 {
     objw = m_objw;
 }
 
 //-------------------------------------------------------------------------------------------------
 // Procesamiento de Ventanas ----------------------------------------------------------------------
-class WindowRectangular
-{
-private:
-    t16  m_WINH;
-    t16  m_WINV;
-    u32  m_x1;
-    u32  m_x2;
-    u32  m_y1;
-    u32  m_y2;
-    bool m_invertx;
-    bool m_inverty;
-    u16  m_flags;
-
-    void UpdateCoordinates();
-
-public:
-    void Reset();
-    void RenderLine(u16 *target);
-    void SetFlags(u16 flags);    
-    void WriteWINH_B0(u8 byte);
-    void WriteWINH_B1(u8 byte);
-    void WriteWINV_B0(u8 byte);
-    void WriteWINV_B1(u8 byte);
-};
 
-void WindowRectangular::UpdateCoordinates()
+gbaDisplay::WindowRectangular::WindowRectangular(gbaDisplay *display) {m_display = display;}
+
+void gbaDisplay::WindowRectangular::UpdateCoordinates()
 {
     m_invertx = m_x1 > m_x2;
     m_inverty = m_y1 > m_y2;
 }
 
-void WindowRectangular::Reset()
+void gbaDisplay::WindowRectangular::Reset()
 {
     m_WINH.w = 0;
     m_WINV.w = 0;
@@ -510,9 +515,9 @@ void WindowRectangular::Reset()
     m_flags = 0;
 }
 
-void WindowRectangular::RenderLine(u16 *target)
+void gbaDisplay::WindowRectangular::RenderLine(u16 *target)
 {
-    if ((m_inverty && ((m_VCOUNT.b < m_y2) || (m_VCOUNT.b >= m_y1))) || (!m_inverty && ((m_VCOUNT.b >= m_y1) && (m_VCOUNT.b < m_y2))))
+    if ((m_inverty && ((m_display->m_renderline < m_y2) || (m_display->m_renderline >= m_y1))) || (!m_inverty && ((m_display->m_renderline >= m_y1) && (m_display->m_renderline < m_y2))))
     {
         if (m_invertx)
         {
@@ -526,63 +531,19 @@ void WindowRectangular::RenderLine(u16 *target)
     }
 }
 
-void WindowRectangular::SetFlags(u16 flags)
+void gbaDisplay::WindowRectangular::SetFlags(u16 flags)
 {
     m_flags = flags;
 }
 
-void WindowRectangular::WriteWINH_B0(u8 byte) {m_WINH.b.b0.b = byte; m_x2 = (byte > m_screenwidth ) ? m_screenwidth  : byte; UpdateCoordinates();}
-void WindowRectangular::WriteWINH_B1(u8 byte) {m_WINH.b.b1.b = byte; m_x1 = (byte > m_screenwidth ) ? m_screenwidth  : byte; UpdateCoordinates();}
-void WindowRectangular::WriteWINV_B0(u8 byte) {m_WINV.b.b0.b = byte; m_y2 = (byte > m_screenheight) ? m_screenheight : byte; UpdateCoordinates();}
-void WindowRectangular::WriteWINV_B1(u8 byte) {m_WINV.b.b1.b = byte; m_y1 = (byte > m_screenheight) ? m_screenheight : byte; UpdateCoordinates();}
-
-class Window
-{
-private:
-    static WindowRectangular m_win0;
-    static WindowRectangular m_win1;
-
-    static t16 m_WININ;
-    static t16 m_WINOUT;
-    static u16 m_outwflags;
-    static u16 m_objwflags;
-    static u16 m_win1flags;
-    static u16 m_win0flags;
-
-    static void ProcessFlags(u16 &flags, u8 byte);
-
-public:
-    static void Reset();
-    static void RenderLine(u16 *target);
-    static void WriteWIN0H_B0(u8 byte);
-    static void WriteWIN0H_B1(u8 byte);
-    static void WriteWIN1H_B0(u8 byte);
-    static void WriteWIN1H_B1(u8 byte);
-    static void WriteWIN0V_B0(u8 byte);
-    static void WriteWIN0V_B1(u8 byte);
-    static void WriteWIN1V_B0(u8 byte);
-    static void WriteWIN1V_B1(u8 byte);
-    static void WriteWININ_B0(u8 byte);
-    static void WriteWININ_B1(u8 byte);
-    static void WriteWINOUT_B0(u8 byte);
-    static void WriteWINOUT_B1(u8 byte);
-    static u8 ReadWININ_B0();
-    static u8 ReadWININ_B1();
-    static u8 ReadWINOUT_B0();
-    static u8 ReadWINOUT_B1();
-};
-
-WindowRectangular Window::m_win0;
-WindowRectangular Window::m_win1;
+void gbaDisplay::WindowRectangular::WriteWINH_B0(u8 byte) {m_WINH.b.b0.b = byte; m_x2 = (byte > m_screenwidth ) ? m_screenwidth  : byte; UpdateCoordinates();}
+void gbaDisplay::WindowRectangular::WriteWINH_B1(u8 byte) {m_WINH.b.b1.b = byte; m_x1 = (byte > m_screenwidth ) ? m_screenwidth  : byte; UpdateCoordinates();}
+void gbaDisplay::WindowRectangular::WriteWINV_B0(u8 byte) {m_WINV.b.b0.b = byte; m_y2 = (byte > m_screenheight) ? m_screenheight : byte; UpdateCoordinates();}
+void gbaDisplay::WindowRectangular::WriteWINV_B1(u8 byte) {m_WINV.b.b1.b = byte; m_y1 = (byte > m_screenheight) ? m_screenheight : byte; UpdateCoordinates();}
 
-t16 Window::m_WININ;
-t16 Window::m_WINOUT;
-u16 Window::m_outwflags;
-u16 Window::m_objwflags;
-u16 Window::m_win1flags;
-u16 Window::m_win0flags;
+gbaDisplay::Window::Window(gbaDisplay *display) : m_win0(display), m_win1(display) {m_display = display;}
 
-void Window::ProcessFlags(u16 &flags, u8 byte)
+void gbaDisplay::Window::ProcessFlags(u16 &flags, u8 byte)
 {
     if (BITTEST(byte, 0)) {flags |= DOT_WINDOWUSEBG0;} else {flags &= ~DOT_WINDOWUSEBG0;}
     if (BITTEST(byte, 1)) {flags |= DOT_WINDOWUSEBG1;} else {flags &= ~DOT_WINDOWUSEBG1;}
@@ -592,7 +553,7 @@ void Window::ProcessFlags(u16 &flags, u8 byte)
     if (BITTEST(byte, 5)) {flags |= DOT_WINDOWUSECSE;} else {flags &= ~DOT_WINDOWUSECSE;}
 }
 
-void Window::Reset()
+void gbaDisplay::Window::Reset()
 {
     m_win0.Reset();
     m_win1.Reset();
@@ -607,103 +568,63 @@ void Window::Reset()
 
     m_win0.SetFlags(m_win0flags);
     m_win1.SetFlags(m_win1flags);
-    OBJ::SetOBJWindowFlags(m_objwflags);
-    OBJ::SetOutsideWindowFlags(m_outwflags);
+    m_display->m_obj.SetOBJWindowFlags(m_objwflags);
+    m_display->m_obj.SetOutsideWindowFlags(m_outwflags);
 }
 
-void Window::RenderLine(u16 *target)
+void gbaDisplay::Window::RenderLine(u16 *target)
 {
-    if (IsWindow1Enabled()) {m_win1.RenderLine(target);}
-    if (IsWindow0Enabled()) {m_win0.RenderLine(target);}
+    if (m_display->IsWindow1Enabled()) {m_win1.RenderLine(target);}
+    if (m_display->IsWindow0Enabled()) {m_win0.RenderLine(target);}
 }
 
-void Window::WriteWIN0H_B0(u8 byte) {m_win0.WriteWINH_B0(byte);}
-void Window::WriteWIN0H_B1(u8 byte) {m_win0.WriteWINH_B1(byte);}
-void Window::WriteWIN1H_B0(u8 byte) {m_win1.WriteWINH_B0(byte);}
-void Window::WriteWIN1H_B1(u8 byte) {m_win1.WriteWINH_B1(byte);}
-void Window::WriteWIN0V_B0(u8 byte) {m_win0.WriteWINV_B0(byte);}
-void Window::WriteWIN0V_B1(u8 byte) {m_win0.WriteWINV_B1(byte);}
-void Window::WriteWIN1V_B0(u8 byte) {m_win1.WriteWINV_B0(byte);}
-void Window::WriteWIN1V_B1(u8 byte) {m_win1.WriteWINV_B1(byte);}
+void gbaDisplay::Window::WriteWIN0H_B0(u8 byte) {m_win0.WriteWINH_B0(byte);}
+void gbaDisplay::Window::WriteWIN0H_B1(u8 byte) {m_win0.WriteWINH_B1(byte);}
+void gbaDisplay::Window::WriteWIN1H_B0(u8 byte) {m_win1.WriteWINH_B0(byte);}
+void gbaDisplay::Window::WriteWIN1H_B1(u8 byte) {m_win1.WriteWINH_B1(byte);}
+void gbaDisplay::Window::WriteWIN0V_B0(u8 byte) {m_win0.WriteWINV_B0(byte);}
+void gbaDisplay::Window::WriteWIN0V_B1(u8 byte) {m_win0.WriteWINV_B1(byte);}
+void gbaDisplay::Window::WriteWIN1V_B0(u8 byte) {m_win1.WriteWINV_B0(byte);}
+void gbaDisplay::Window::WriteWIN1V_B1(u8 byte) {m_win1.WriteWINV_B1(byte);}
 
-void Window::WriteWININ_B0(u8 byte)
+void gbaDisplay::Window::WriteWININ_B0(u8 byte)
 {
     m_WININ.b.b0.b = byte;
     ProcessFlags(m_win0flags, byte);
     m_win0.SetFlags(m_win0flags);
 }
 
-void Window::WriteWININ_B1(u8 byte)
+void gbaDisplay::Window::WriteWININ_B1(u8 byte)
 {
     m_WININ.b.b1.b = byte;
     ProcessFlags(m_win1flags, byte);
     m_win1.SetFlags(m_win1flags);
 }
 
-void Window::WriteWINOUT_B0(u8 byte)
+void gbaDisplay::Window::WriteWINOUT_B0(u8 byte)
 {
     m_WINOUT.b.b0.b = byte;
     ProcessFlags(m_outwflags, byte);
-    OBJ::SetOutsideWindowFlags(m_outwflags);
+    m_display->m_obj.SetOutsideWindowFlags(m_outwflags);
 }
 
-void Window::WriteWINOUT_B1(u8 byte)
+void gbaDisplay::Window::WriteWINOUT_B1(u8 byte)
 {
     m_WINOUT.b.b1.b = byte;
     ProcessFlags(m_objwflags, byte);
-    OBJ::SetOBJWindowFlags(m_objwflags);
+    m_display->m_obj.SetOBJWindowFlags(m_objwflags);
 }
 
-u8 Window::ReadWININ_B0() {return m_WININ.b.b0.b;}
-u8 Window::ReadWININ_B1() {return m_WININ.b.b1.b;}
+u8 gbaDisplay::Window::ReadWININ_B0() {return m_WININ.b.b0.b;}
+u8 gbaDisplay::Window::ReadWININ_B1() {return m_WININ.b.b1.b;}
 
-u8 Window::ReadWINOUT_B0() {return m_WINOUT.b.b0.b;}
-u8 Window::ReadWINOUT_B1() {return m_WINOUT.b.b1.b;}
+u8 gbaDisplay::Window::ReadWINOUT_B0() {return m_WINOUT.b.b0.b;}
+u8 gbaDisplay::Window::ReadWINOUT_B1() {return m_WINOUT.b.b1.b;}
 
 //-------------------------------------------------------------------------------------------------
 // Procesamiento de Efectos Especiales ------------------------------------------------------------
-class ColorSpecialEffect
-{
-private:
-    static const u16 m_1stflags[4];
-
-    static t16  m_BLDCNT;
-    static t16  m_BLDALPHA;
-    static t8   m_BLDY;
-    static u32  m_cse;
-    static u32  m_evanum;
-    static u32  m_evbnum;
-    static u32  m_evynum;
-    static u16  m_bgflags[4];
-    static u16  m_objflags;
-    static u16  m_bdflags;
-    static bool m_swapgreen;
-
-    static void UnpackColor(u16 color, u32 &red, u32 &green, u32 &blue);
-    static u16 PackColor(u32 red, u32 green, u32 blue);
-    static u16 AlphaBlend(u16 color1st, u16 color2nd);
-    static u16 BrightnessIncrease(u16 color1st);
-    static u16 BrightnessDecrease(u16 color1st);
-    static void GreenSwap(u16 *target);
-
-public:
-    static void Reset();
-    static void Blend(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd);
-    static void SetGreenSwap(bool swapgreen);
-    static u16 GetBGFlags(u32 bg);
-    static u16 GetOBJFlags();
-    static u16 GetBackdropFlags();
-    static void UpdateFlags();
-    static void WriteBLDCNT_B0(u8 byte);
-    static void WriteBLDCNT_B1(u8 byte);
-    static void WriteBLDALPHA_B0(u8 byte);
-    static void WriteBLDALPHA_B1(u8 byte);
-    static void WriteBLDY(u8 byte);
-    static u8 ReadBLDCNT_B0();
-    static u8 ReadBLDCNT_B1();
-};
 
-const u16 ColorSpecialEffect::m_1stflags[4] =
+const u16 gbaDisplay::ColorSpecialEffect::m_1stflags[4] =
 {
     DOT_CSENONE,
     DOT_CSEALPHABLEND1ST,
@@ -711,31 +632,19 @@ const u16 ColorSpecialEffect::m_1stflags[4] =
     DOT_CSELESSBRIGHT1ST
 };
 
-t16  ColorSpecialEffect::m_BLDCNT;
-t16  ColorSpecialEffect::m_BLDALPHA;
-t8   ColorSpecialEffect::m_BLDY;
-u32  ColorSpecialEffect::m_cse;
-u32  ColorSpecialEffect::m_evanum;
-u32  ColorSpecialEffect::m_evbnum;
-u32  ColorSpecialEffect::m_evynum;
-u16  ColorSpecialEffect::m_bgflags[4];
-u16  ColorSpecialEffect::m_objflags;
-u16  ColorSpecialEffect::m_bdflags;
-bool ColorSpecialEffect::m_swapgreen;
-
-void ColorSpecialEffect::UnpackColor(u16 color, u32 &red, u32 &green, u32 &blue)
+void gbaDisplay::ColorSpecialEffect::UnpackColor(u16 color, u32 &red, u32 &green, u32 &blue)
 {
     red   = color & 0x001F;
     green = color & 0x03E0;
     blue  = color & 0x7C00;
 }
 
-u16 ColorSpecialEffect::PackColor(u32 red, u32 green, u32 blue)
+u16 gbaDisplay::ColorSpecialEffect::PackColor(u32 red, u32 green, u32 blue)
 {
     return ((red & 0x001F) | (green & 0x03E0) | (blue & 0x7C00)) & 0xFFFF;
 }
 
-u16 ColorSpecialEffect::AlphaBlend(u16 color1st, u16 color2nd)
+u16 gbaDisplay::ColorSpecialEffect::AlphaBlend(u16 color1st, u16 color2nd)
 {
     u32 red[3];
     u32 green[3];
@@ -755,7 +664,7 @@ u16 ColorSpecialEffect::AlphaBlend(u16 color1st, u16 color2nd)
     return PackColor(red[2], green[2], blue[2]);
 }
 
-u16 ColorSpecialEffect::BrightnessIncrease(u16 color1st)
+u16 gbaDisplay::ColorSpecialEffect::BrightnessIncrease(u16 color1st)
 {
     u32 red;
     u32 green;
@@ -770,7 +679,7 @@ u16 ColorSpecialEffect::BrightnessIncrease(u16 color1st)
     return PackColor(red, green, blue);
 }
 
-u16 ColorSpecialEffect::BrightnessDecrease(u16 color1st)
+u16 gbaDisplay::ColorSpecialEffect::BrightnessDecrease(u16 color1st)
 {
     u32 red;
     u32 green;
@@ -785,7 +694,7 @@ u16 ColorSpecialEffect::BrightnessDecrease(u16 color1st)
     return PackColor(red, green, blue);
 }
 
-void ColorSpecialEffect::GreenSwap(u16 *target)
+void gbaDisplay::ColorSpecialEffect::GreenSwap(u16 *target)
 {
     u32 red[2];
     u32 green[2];
@@ -800,7 +709,7 @@ void ColorSpecialEffect::GreenSwap(u16 *target)
     }
 }
 
-void ColorSpecialEffect::Reset()
+void gbaDisplay::ColorSpecialEffect::Reset()
 {
     m_BLDCNT.w   = 0;
     m_BLDALPHA.w = 0;
@@ -821,7 +730,7 @@ void ColorSpecialEffect::Reset()
     m_swapgreen = false;
 }
 
-void ColorSpecialEffect::Blend(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd)
+void gbaDisplay::ColorSpecialEffect::BlendLineScalar(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd)
 {
     for (u32 i = 0; i < m_screenwidth; ++i)
     {
@@ -842,20 +751,103 @@ void ColorSpecialEffect::Blend(u16 *target, u16 const *line1st, u16 const *attr1
             target[i] = line1st[i];
         }
     }
+}
+
+#ifdef GBA_DISPLAY_SSE2
+// Toma a donde mask esta activo y b en el resto
+inline __m128i SelectSSE2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i PackColorSSE2(__m128i red, __m128i green, __m128i blue)
+{
+    return _mm_or_si128(red, _mm_or_si128(_mm_slli_epi16(green, 5), _mm_slli_epi16(blue, 10)));
+}
+
+// Mismo resultado que la version escalar, que trabaja con los campos sin desplazar: en la mezcla
+// alfa el rojo trunca cada termino por separado y verde y azul truncan la suma, y al reducir el
+// brillo verde y azul redondean la diferencia hacia arriba
+void gbaDisplay::ColorSpecialEffect::BlendLineSSE2(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd)
+{
+    __m128i zero     = _mm_setzero_si128();
+    __m128i max      = _mm_set1_epi16(0x1F);
+    __m128i round    = _mm_set1_epi16(15);
+    __m128i eva      = _mm_set1_epi16((s16)m_evanum);
+    __m128i evb      = _mm_set1_epi16((s16)m_evbnum);
+    __m128i evy      = _mm_set1_epi16((s16)m_evynum);
+    __m128i blend1st = _mm_set1_epi16(DOT_CSEALPHABLENDALL);
+    __m128i blend2nd = _mm_set1_epi16(DOT_CSEALPHABLEND2ND);
+    __m128i more1st  = _mm_set1_epi16(DOT_CSEMOREBRIGHT1ST);
+    __m128i less1st  = _mm_set1_epi16(DOT_CSELESSBRIGHT1ST);
+
+    for (u32 i = 0; i < m_screenwidth; i += 8)
+    {
+        __m128i color1st = _mm_loadu_si128((__m128i const *)&line1st[i]);
+        __m128i color2nd = _mm_loadu_si128((__m128i const *)&line2nd[i]);
+        __m128i flags1st = _mm_loadu_si128((__m128i const *)&attr1st[i]);
+        __m128i flags2nd = _mm_loadu_si128((__m128i const *)&attr2nd[i]);
+
+        __m128i red1st   = _mm_and_si128(color1st, max);
+        __m128i green1st = _mm_and_si128(_mm_srli_epi16(color1st, 5), max);
+        __m128i blue1st  = _mm_and_si128(_mm_srli_epi16(color1st, 10), max);
+        __m128i red2nd   = _mm_and_si128(color2nd, max);
+        __m128i green2nd = _mm_and_si128(_mm_srli_epi16(color2nd, 5), max);
+        __m128i blue2nd  = _mm_and_si128(_mm_srli_epi16(color2nd, 10), max);
+
+        __m128i alpha = PackColorSSE2(
+            _mm_min_epi16(_mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(red1st, eva), 4), _mm_srli_epi16(_mm_mullo_epi16(red2nd, evb), 4)), max),
+            _mm_min_epi16(_mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(green1st, eva), _mm_mullo_epi16(green2nd, evb)), 4), max),
+            _mm_min_epi16(_mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(blue1st,  eva), _mm_mullo_epi16(blue2nd,  evb)), 4), max));
+
+        __m128i more = PackColorSSE2(
+            _mm_add_epi16(red1st,   _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, red1st),   evy), 4)),
+            _mm_add_epi16(green1st, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, green1st), evy), 4)),
+            _mm_add_epi16(blue1st,  _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, blue1st),  evy), 4)));
+
+        __m128i less = PackColorSSE2(
+            _mm_sub_epi16(red1st,   _mm_srli_epi16(_mm_mullo_epi16(red1st, evy), 4)),
+            _mm_sub_epi16(green1st, _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(green1st, evy), round), 4)),
+            _mm_sub_epi16(blue1st,  _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(blue1st,  evy), round), 4)));
+
+        __m128i noalpha = _mm_or_si128(_mm_cmpeq_epi16(_mm_and_si128(flags1st, blend1st), zero), _mm_cmpeq_epi16(_mm_and_si128(flags2nd, blend2nd), zero));
+        __m128i nomore  = _mm_cmpeq_epi16(_mm_and_si128(flags1st, more1st), zero);
+        __m128i noless  = _mm_cmpeq_epi16(_mm_and_si128(flags1st, less1st), zero);
+
+        __m128i color = SelectSSE2(noless, color1st, less);
+        color = SelectSSE2(nomore,  color, more);
+        color = SelectSSE2(noalpha, color, alpha);
+
+        _mm_storeu_si128((__m128i *)&target[i], color);
+    }
+}
+#endif
 
+void gbaDisplay::ColorSpecialEffect::Blend(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd)
+{
+    (this->*BlendLine)(target, line1st, attr1st, line2nd, attr2nd);
     if (m_swapgreen) {GreenSwap(target);}
 }
 
-void ColorSpecialEffect::SetGreenSwap(bool swapgreen)
+void gbaDisplay::ColorSpecialEffect::SetSIMD(bool enable)
+{
+#ifdef GBA_DISPLAY_SSE2
+    BlendLine = enable ? &ColorSpecialEffect::BlendLineSSE2 : &ColorSpecialEffect::BlendLineScalar;
+#else
+    BlendLine = &ColorSpecialEffect::BlendLineScalar;
+#endif
+}
+
+void gbaDisplay::ColorSpecialEffect::SetGreenSwap(bool swapgreen)
 {
     m_swapgreen = swapgreen;
 }
 
-u16 ColorSpecialEffect::GetBGFlags(u32 bg) {return m_bgflags[bg & 3];}
-u16 ColorSpecialEffect::GetOBJFlags()      {return m_objflags;}
-u16 ColorSpecialEffect::GetBackdropFlags() {return m_bdflags ;}
+u16 gbaDisplay::ColorSpecialEffect::GetBGFlags(u32 bg) {return m_bgflags[bg & 3];}
+u16 gbaDisplay::ColorSpecialEffect::GetOBJFlags()      {return m_objflags;}
+u16 gbaDisplay::ColorSpecialEffect::GetBackdropFlags() {return m_bdflags ;}
 
-void ColorSpecialEffect::UpdateFlags()
+void gbaDisplay::ColorSpecialEffect::UpdateFlags()
 {
     u16 flag1st;
 
@@ -884,51 +876,25 @@ void ColorSpecialEffect::UpdateFlags()
     if (BITTEST(m_BLDCNT.w, 13)) {m_bdflags    |= DOT_CSEALPHABLEND2ND;}
 }
 
-void ColorSpecialEffect::WriteBLDCNT_B0(u8 byte) {m_BLDCNT.b.b0.b = byte; UpdateFlags();}
-void ColorSpecialEffect::WriteBLDCNT_B1(u8 byte) {m_BLDCNT.b.b1.b = byte; UpdateFlags();}
+void gbaDisplay::ColorSpecialEffect::WriteBLDCNT_B0(u8 byte) {m_BLDCNT.b.b0.b = byte; UpdateFlags();}
+void gbaDisplay::ColorSpecialEffect::WriteBLDCNT_B1(u8 byte) {m_BLDCNT.b.b1.b = byte; UpdateFlags();}
 
-void ColorSpecialEffect::WriteBLDALPHA_B0(u8 byte) {m_BLDALPHA.b.b0.b = byte; u32 eva = SUBVAL(byte, 0, 31); if (eva > 16) {eva = 16;} m_evanum = eva;}
-void ColorSpecialEffect::WriteBLDALPHA_B1(u8 byte) {m_BLDALPHA.b.b1.b = byte; u32 evb = SUBVAL(byte, 0, 31); if (evb > 16) {evb = 16;} m_evbnum = evb;}
-void ColorSpecialEffect::WriteBLDY(u8 byte)        {m_BLDY.b          = byte; u32 evy = SUBVAL(byte, 0, 31); if (evy > 16) {evy = 16;} m_evynum = evy;}
+void gbaDisplay::ColorSpecialEffect::WriteBLDALPHA_B0(u8 byte) {m_BLDALPHA.b.b0.b = byte; u32 eva = SUBVAL(byte, 0, 31); if (eva > 16) {eva = 16;} m_evanum = eva;}
+void gbaDisplay::ColorSpecialEffect::WriteBLDALPHA_B1(u8 byte) {m_BLDALPHA.b.b1.b = byte; u32 evb = SUBVAL(byte, 0, 31); if (evb > 16) {evb = 16;} m_evbnum = evb;}
+void gbaDisplay::ColorSpecialEffect::WriteBLDY(u8 byte)        {m_BLDY.b          = byte; u32 evy = SUBVAL(byte, 0, 31); if (evy > 16) {evy = 16;} m_evynum = evy;}
 
-u8 ColorSpecialEffect::ReadBLDCNT_B0() {return m_BLDCNT.b.b0.b;}
-u8 ColorSpecialEffect::ReadBLDCNT_B1() {return m_BLDCNT.b.b1.b;}
+u8 gbaDisplay::ColorSpecialEffect::ReadBLDCNT_B0() {return m_BLDCNT.b.b0.b;}
+u8 gbaDisplay::ColorSpecialEffect::ReadBLDCNT_B1() {return m_BLDCNT.b.b1.b;}
 
 //-------------------------------------------------------------------------------------------------
 // BG Modo Text -----------------------------------------------------------------------------------
-class BGText
-{
-private:
-    u16  m_line[m_screenwidth];
-    u16  m_attr[m_screenwidth];    
-    t16  m_BGHOFS;
-    t16  m_BGVOFS;
-    u8  *m_tilebase;
-    u8  *m_mapbase;
-    bool m_use256x1;
-    u32  m_hmask;
-    u32  m_vmask;
-    bool m_usemosaic;
-    u32  m_hmosaic;
-    u32  m_vmosaic;
-
-public:
-    void Reset();
-    void SetMosaic(u32 h, u32 v);
-    void RenderLine();
-    void GetLine(u16 const *&line, u16 const *&attr);    
-    void WriteBGCNT_B0(u8 byte);
-    void WriteBGCNT_B1(u8 byte);
-    void WriteBGHOFS_B0(u8 byte);
-    void WriteBGHOFS_B1(u8 byte);
-    void WriteBGVOFS_B0(u8 byte);
-    void WriteBGVOFS_B1(u8 byte);
-};
 
-void BGText::Reset()
+gbaDisplay::BGText::BGText(gbaDisplay *display) {m_display = display;}
+
+void gbaDisplay::BGText::Reset()
 {
-    m_tilebase = &m_VRAM[0];
-    m_mapbase  = &m_VRAM[0];
+    m_tilebase = 0;
+    m_mapbase  = &m_display->m_VRAM[0];
 
     m_use256x1 = false;
 
@@ -938,15 +904,15 @@ void BGText::Reset()
     m_vmosaic = 1;
 }
 
-void BGText::SetMosaic(u32 h, u32 v)
+void gbaDisplay::BGText::SetMosaic(u32 h, u32 v)
 {
     m_hmosaic = h;
     m_vmosaic = v;
 }
 
-void BGText::RenderLine()
+void gbaDisplay::BGText::RenderLine()
 {
-    u32  vpx      = (m_BGVOFS.w + m_VCOUNT.b) & m_vmask;
+    u32  vpx      = (m_BGVOFS.w + m_display->m_renderline) & m_vmask;
     u32  vscx256  = vpx & BIT(8) & m_vmask;
     u32  vmap     = (vpx & 0xF8) << 2;
     u32  vtileofs = vpx & 7;
@@ -966,11 +932,11 @@ void BGText::RenderLine()
     u32  tilerow;
     u32  tilecol;
     u32  hdelta;
-    u8  *tilebase;
+    bool hflip;
+    u8 const *row;
     u32  color;
     u32  palette;
     u32  mapindex;
-    u16  pixel;
 
     if (m_usemosaic)
     {
@@ -997,7 +963,14 @@ void BGText::RenderLine()
         mapentry.b.b1.b = mapbase[mapindex + 1];
 
         chr      = mapentry.w & 1023;
-        if (BITTEST(mapentry.w, 10))
+        tilerow  = BITTEST(mapentry.w, 11) ? (7 - vtileofs) : vtileofs;
+        palette  = SUBVAL(mapentry.w, 12, 0xF);
+
+        mosaicrow = (tilerow / vmosaic) * vmosaic;
+
+        // Sin mosaico horizontal el tile volteado se recorre en orden
+        hflip = BITTEST(mapentry.w, 10) && (hmosaic == 1);
+        if (BITTEST(mapentry.w, 10) && !hflip)
         {
             tilecol = 7 - htileofs;
             hdelta  = NEGATE(1U);
@@ -1007,31 +980,36 @@ void BGText::RenderLine()
             tilecol = htileofs;
             hdelta  = 1;
         }
-        tilerow  = BITTEST(mapentry.w, 11) ? (7 - vtileofs) : vtileofs;
 
-        mosaicrow = (tilerow / vmosaic) * vmosaic;
-        tilebase  = &m_tilebase[m_use256x1 ? ((chr << 6) + (mosaicrow << 3)) : ((chr << 5) + (mosaicrow << 2))];
-        palette   = SUBVAL(mapentry.w, 12, 0xF);
+        row = (m_use256x1 ? m_display->m_tilecache.GetTile256(m_tilebase + (chr << 6), hflip) : m_display->m_tilecache.GetTile16(m_tilebase + (chr << 5), hflip)) + (mosaicrow << 3);
+
+        if (hmosaic == 1)
+        {
+            for (u32 h = htileofs; h < 8; ++h)
+            {
+                color = row[h];
+
+                if (color != 0)
+                {
+                    m_line[dot] = m_use256x1 ? m_display->m_palette.GetBGColor256x1(color) : m_display->m_palette.GetBGColor16x16(palette, color);
+                    m_attr[dot] = DOT_OPAQUE;
+                }
+
+                if (++dot == m_screenwidth) {return;}
+            }
+            continue;
+        }
 
         for (u32 h = htileofs; h < 8; ++h)
         {
             mosaiccol = (tilecol / hmosaic) * hmosaic;
             tilecol += hdelta;
 
-            if (m_use256x1)
-            {
-                color = tilebase[mosaiccol];
-                pixel = Palette::GetBGColor256x1(color);
-            }
-            else
-            {
-                color = SUBVAL(tilebase[mosaiccol >> 1], (mosaiccol & 1) << 2, 15);
-                pixel = Palette::GetBGColor16x16(palette, color);
-            }
+            color = row[mosaiccol];
 
             if (color != 0)
             {
-                m_line[dot] = pixel;
+                m_line[dot] = m_use256x1 ? m_display->m_palette.GetBGColor256x1(color) : m_display->m_palette.GetBGColor16x16(palette, color);
                 m_attr[dot] = DOT_OPAQUE;
             }
 
@@ -1040,22 +1018,22 @@ void BGText::RenderLine()
     }
 }
 
-void BGText::GetLine(u16 const *&line, u16 const *&attr)
+void gbaDisplay::BGText::GetLine(u16 const *&line, u16 const *&attr)
 {
     line = m_line;
     attr = m_attr;
 }
 
-void BGText::WriteBGCNT_B0(u8 byte)
+void gbaDisplay::BGText::WriteBGCNT_B0(u8 byte)
 {
-    m_tilebase  = &m_VRAM[SUBVAL(byte, 2, 0x3) * 16 * 1024];
+    m_tilebase  = SUBVAL(byte, 2, 0x3) * 16 * 1024;
     m_usemosaic = BITTEST(byte, 6);
     m_use256x1  = BITTEST(byte, 7);
 }
 
-void BGText::WriteBGCNT_B1(u8 byte)
+void gbaDisplay::BGText::WriteBGCNT_B1(u8 byte)
 {
-    m_mapbase = &m_VRAM[SUBVAL(byte, 0, 0x1F) * 2 * 1024];
+    m_mapbase = &m_display->m_VRAM[SUBVAL(byte, 0, 0x1F) * 2 * 1024];
     switch (SUBVAL(byte, 6, 0x3))
     {
     case 0:  m_hmask = 255; m_vmask = 255; break;
@@ -1065,75 +1043,22 @@ void BGText::WriteBGCNT_B1(u8 byte)
     }
 }
 
-void BGText::WriteBGHOFS_B0(u8 byte) {m_BGHOFS.b.b0.b = byte;}
-void BGText::WriteBGHOFS_B1(u8 byte) {m_BGHOFS.b.b1.b = byte;}
-void BGText::WriteBGVOFS_B0(u8 byte) {m_BGVOFS.b.b0.b = byte;}
-void BGText::WriteBGVOFS_B1(u8 byte) {m_BGVOFS.b.b1.b = byte;}
+void gbaDisplay::BGText::WriteBGHOFS_B0(u8 byte) {m_BGHOFS.b.b0.b = byte;}
+void gbaDisplay::BGText::WriteBGHOFS_B1(u8 byte) {m_BGHOFS.b.b1.b = byte;}
+void gbaDisplay::BGText::WriteBGVOFS_B0(u8 byte) {m_BGVOFS.b.b0.b = byte;}
+void gbaDisplay::BGText::WriteBGVOFS_B1(u8 byte) {m_BGVOFS.b.b1.b = byte;}
 
 //-------------------------------------------------------------------------------------------------
 // Puntos de referencia para BG con parametros A, B, C y D ----------------------------------------
-class BGReferencePoint
-{
-protected:
-    u16  m_line[m_screenwidth];
-    u16  m_attr[m_screenwidth];
-    t32  m_BGX;
-    t32  m_BGY;
-    t16  m_BGPA;
-    t16  m_BGPB;
-    t16  m_BGPC;
-    t16  m_BGPD;
-    bool m_wrap;
-    u32  m_X;
-    u32  m_Y;
-    u32  m_dx;
-    u32  m_dmx;
-    u32  m_dy;
-    u32  m_dmy;
-    bool m_usemosaic;
-    u32  m_hmosaic;
-    u32  m_vmosaic;
-
-    void UpdateBGX();
-    void UpdateBGY();
-    void UpdatePA();
-    void UpdatePB();
-    void UpdatePC();
-    void UpdatePD();
-
-public:
-    void Reset();
-    void SetMosaic(u32 h, u32 v);
-    void GetLine(u16 const *&line, u16 const *&attr);    
-    void OnLeaveVblank();
-    void WriteBGCNT_B0(u8 byte);
-    void WriteBGCNT_B1(u8 byte);
-    void WriteBGX_L_B0(u8 byte);
-    void WriteBGX_L_B1(u8 byte);
-    void WriteBGX_H_B0(u8 byte);
-    void WriteBGX_H_B1(u8 byte);
-    void WriteBGY_L_B0(u8 byte);
-    void WriteBGY_L_B1(u8 byte);
-    void WriteBGY_H_B0(u8 byte);
-    void WriteBGY_H_B1(u8 byte);
-    void WriteBGPA_B0(u8 byte);
-    void WriteBGPA_B1(u8 byte);
-    void WriteBGPB_B0(u8 byte);
-    void WriteBGPB_B1(u8 byte);
-    void WriteBGPC_B0(u8 byte);
-    void WriteBGPC_B1(u8 byte);
-    void WriteBGPD_B0(u8 byte);
-    void WriteBGPD_B1(u8 byte);
-};
 
-void BGReferencePoint::UpdateBGX() {m_X   = SIGNEX(m_BGX.d,  27);}
-void BGReferencePoint::UpdateBGY() {m_Y   = SIGNEX(m_BGY.d,  27);}
-void BGReferencePoint::UpdatePA()  {m_dx  = SIGNEX(m_BGPA.w, 15);}
-void BGReferencePoint::UpdatePB()  {m_dmx = SIGNEX(m_BGPB.w, 15);}
-void BGReferencePoint::UpdatePC()  {m_dy  = SIGNEX(m_BGPC.w, 15);}
-void BGReferencePoint::UpdatePD()  {m_dmy = SIGNEX(m_BGPD.w, 15);}
+void gbaDisplay::BGReferencePoint::UpdateBGX() {m_X   = SIGNEX(m_BGX.d,  27);}
+void gbaDisplay::BGReferencePoint::UpdateBGY() {m_Y   = SIGNEX(m_BGY.d,  27);}
+void gbaDisplay::BGReferencePoint::UpdatePA()  {m_dx  = SIGNEX(m_BGPA.w, 15);}
+void gbaDisplay::BGReferencePoint::UpdatePB()  {m_dmx = SIGNEX(m_BGPB.w, 15);}
+void gbaDisplay::BGReferencePoint::UpdatePC()  {m_dy  = SIGNEX(m_BGPC.w, 15);}
+void gbaDisplay::BGReferencePoint::UpdatePD()  {m_dmy = SIGNEX(m_BGPD.w, 15);}
 
-void BGReferencePoint::Reset()
+void gbaDisplay::BGReferencePoint::Reset()
 {
     m_wrap = false;
 
@@ -1156,79 +1081,66 @@ void BGReferencePoint::Reset()
     m_vmosaic = 1;
 }
 
-void BGReferencePoint::SetMosaic(u32 h, u32 v)
+void gbaDisplay::BGReferencePoint::SetMosaic(u32 h, u32 v)
 {
     m_hmosaic = h;
     m_vmosaic = v;
 }
 
-void BGReferencePoint::GetLine(u16 const *&line, u16 const *&attr)
+void gbaDisplay::BGReferencePoint::GetLine(u16 const *&line, u16 const *&attr)
 {
     line = m_line;
     attr = m_attr;
 }
 
-void BGReferencePoint::OnLeaveVblank()
+void gbaDisplay::BGReferencePoint::OnLeaveVblank()
 {
     UpdateBGX();
     UpdateBGY();
 }
 
-void BGReferencePoint::WriteBGCNT_B0(u8 byte)
+void gbaDisplay::BGReferencePoint::WriteBGCNT_B0(u8 byte)
 {
     m_usemosaic = BITTEST(byte, 6);
 }
 
-void BGReferencePoint::WriteBGCNT_B1(u8 byte)
+void gbaDisplay::BGReferencePoint::WriteBGCNT_B1(u8 byte)
 {
     m_wrap = BITTEST(byte, 5);
 }
 
-void BGReferencePoint::WriteBGX_L_B0(u8 byte) {m_BGX.w.w0.b.b0.b = byte; UpdateBGX();}
-void BGReferencePoint::WriteBGX_L_B1(u8 byte) {m_BGX.w.w0.b.b1.b = byte; UpdateBGX();}
-void BGReferencePoint::WriteBGX_H_B0(u8 byte) {m_BGX.w.w1.b.b0.b = byte; UpdateBGX();}
-void BGReferencePoint::WriteBGX_H_B1(u8 byte) {m_BGX.w.w1.b.b1.b = byte; UpdateBGX();}
-void BGReferencePoint::WriteBGY_L_B0(u8 byte) {m_BGY.w.w0.b.b0.b = byte; UpdateBGY();}
-void BGReferencePoint::WriteBGY_L_B1(u8 byte) {m_BGY.w.w0.b.b1.b = byte; UpdateBGY();}
-void BGReferencePoint::WriteBGY_H_B0(u8 byte) {m_BGY.w.w1.b.b0.b = byte; UpdateBGY();}
-void BGReferencePoint::WriteBGY_H_B1(u8 byte) {m_BGY.w.w1.b.b1.b = byte; UpdateBGY();}
-void BGReferencePoint::WriteBGPA_B0(u8 byte)  {m_BGPA.b.b0.b     = byte; UpdatePA();}
-void BGReferencePoint::WriteBGPA_B1(u8 byte)  {m_BGPA.b.b1.b     = byte; UpdatePA();}
-void BGReferencePoint::WriteBGPB_B0(u8 byte)  {m_BGPB.b.b0.b     = byte; UpdatePB();}
-void BGReferencePoint::WriteBGPB_B1(u8 byte)  {m_BGPB.b.b1.b     = byte; UpdatePB();}
-void BGReferencePoint::WriteBGPC_B0(u8 byte)  {m_BGPC.b.b0.b     = byte; UpdatePC();}
-void BGReferencePoint::WriteBGPC_B1(u8 byte)  {m_BGPC.b.b1.b     = byte; UpdatePC();}
-void BGReferencePoint::WriteBGPD_B0(u8 byte)  {m_BGPD.b.b0.b     = byte; UpdatePD();}
-void BGReferencePoint::WriteBGPD_B1(u8 byte)  {m_BGPD.b.b1.b     = byte; UpdatePD();}
+void gbaDisplay::BGReferencePoint::WriteBGX_L_B0(u8 byte) {m_BGX.w.w0.b.b0.b = byte; UpdateBGX();}
+void gbaDisplay::BGReferencePoint::WriteBGX_L_B1(u8 byte) {m_BGX.w.w0.b.b1.b = byte; UpdateBGX();}
+void gbaDisplay::BGReferencePoint::WriteBGX_H_B0(u8 byte) {m_BGX.w.w1.b.b0.b = byte; UpdateBGX();}
+void gbaDisplay::BGReferencePoint::WriteBGX_H_B1(u8 byte) {m_BGX.w.w1.b.b1.b = byte; UpdateBGX();}
+void gbaDisplay::BGReferencePoint::WriteBGY_L_B0(u8 byte) {m_BGY.w.w0.b.b0.b = byte; UpdateBGY();}
+void gbaDisplay::BGReferencePoint::WriteBGY_L_B1(u8 byte) {m_BGY.w.w0.b.b1.b = byte; UpdateBGY();}
+void gbaDisplay::BGReferencePoint::WriteBGY_H_B0(u8 byte) {m_BGY.w.w1.b.b0.b = byte; UpdateBGY();}
+void gbaDisplay::BGReferencePoint::WriteBGY_H_B1(u8 byte) {m_BGY.w.w1.b.b1.b = byte; UpdateBGY();}
+void gbaDisplay::BGReferencePoint::WriteBGPA_B0(u8 byte)  {m_BGPA.b.b0.b     = byte; UpdatePA();}
+void gbaDisplay::BGReferencePoint::WriteBGPA_B1(u8 byte)  {m_BGPA.b.b1.b     = byte; UpdatePA();}
+void gbaDisplay::BGReferencePoint::WriteBGPB_B0(u8 byte)  {m_BGPB.b.b0.b     = byte; UpdatePB();}
+void gbaDisplay::BGReferencePoint::WriteBGPB_B1(u8 byte)  {m_BGPB.b.b1.b     = byte; UpdatePB();}
+void gbaDisplay::BGReferencePoint::WriteBGPC_B0(u8 byte)  {m_BGPC.b.b0.b     = byte; UpdatePC();}
+void gbaDisplay::BGReferencePoint::WriteBGPC_B1(u8 byte)  {m_BGPC.b.b1.b     = byte; UpdatePC();}
+void gbaDisplay::BGReferencePoint::WriteBGPD_B0(u8 byte)  {m_BGPD.b.b0.b     = byte; UpdatePD();}
+void gbaDisplay::BGReferencePoint::WriteBGPD_B1(u8 byte)  {m_BGPD.b.b1.b     = byte; UpdatePD();}
 
 //-------------------------------------------------------------------------------------------------
 // BG Modo Rotation and Scaling -------------------------------------------------------------------
-class BGRotationAndScaling : public BGReferencePoint
-{
-private:
-    u8  *m_mapbase;
-    u8  *m_tilebase;
-    u32  m_length;
-    u32  m_mask;
-    u32  m_rowshift;
-
-public:
-    void Reset();
-    void RenderLine();
-    void WriteBGCNT_B0(u8 byte);
-    void WriteBGCNT_B1(u8 byte);
-};
 
-void BGRotationAndScaling::Reset()
+gbaDisplay::BGRotationAndScaling::BGRotationAndScaling(gbaDisplay *display) {m_display = display;}
+
+void gbaDisplay::BGRotationAndScaling::Reset()
 {
-    m_tilebase = &m_VRAM[0];
-    m_mapbase  = &m_VRAM[0];
+    m_tilebase = &m_display->m_VRAM[0];
+    m_mapbase  = &m_display->m_VRAM[0];
     m_length   = 128;
     m_mask     = 127;
     m_rowshift = 4;    
 }
 
-void BGRotationAndScaling::RenderLine()
+void gbaDisplay::BGRotationAndScaling::RenderLine()
 {
     u32 fY = m_Y;
     u32 fX = m_X;
@@ -1266,7 +1178,7 @@ void BGRotationAndScaling::RenderLine()
         vmosaic = 1;
     }
 
-    vmodulus = m_VCOUNT.b % vmosaic;
+    vmodulus = m_display->m_renderline % vmosaic;
     dmyofs   = vmodulus * m_dmy;
     dmxofs   = vmodulus * m_dmx;
 
@@ -1294,21 +1206,21 @@ void BGRotationAndScaling::RenderLine()
     
         if (color != 0)
         {
-            m_line[dot] = Palette::GetBGColor256x1(color);
+            m_line[dot] = m_display->m_palette.GetBGColor256x1(color);
             m_attr[dot] = DOT_OPAQUE;
         }
     }
 }
 
-void BGRotationAndScaling::WriteBGCNT_B0(u8 byte)
+void gbaDisplay::BGRotationAndScaling::WriteBGCNT_B0(u8 byte)
 {
-    m_tilebase = &m_VRAM[SUBVAL(byte, 2, 3) * 16 * 1024];
+    m_tilebase = &m_display->m_VRAM[SUBVAL(byte, 2, 3) * 16 * 1024];
 }
 
-void BGRotationAndScaling::WriteBGCNT_B1(u8 byte)
+void gbaDisplay::BGRotationAndScaling::WriteBGCNT_B1(u8 byte)
 {
     u32 s      = SUBVAL(byte, 6, 3);
-    m_mapbase  = &m_VRAM[SUBVAL(byte, 0, 31) * 2 * 1024];  
+    m_mapbase  = &m_display->m_VRAM[SUBVAL(byte, 0, 31) * 2 * 1024];  
     m_length   = 128 << s;
     m_mask     = m_length - 1;
     m_rowshift = 4 + s;
@@ -1316,22 +1228,10 @@ void BGRotationAndScaling::WriteBGCNT_B1(u8 byte)
 
 //-------------------------------------------------------------------------------------------------
 // BG Modo Bitmap ---------------------------------------------------------------------------------
-class BGBitmap : public BGRotationAndScaling
-{
-private:
-    u32 m_offset;
 
-    void RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1);
+gbaDisplay::BGBitmap::BGBitmap(gbaDisplay *display) : BGRotationAndScaling(display) {}
 
-public:
-    void Reset();
-    void RenderLineMode3();
-    void RenderLineMode4();
-    void RenderLineMode5();
-    void SetFrame(u32 frame);
-};
-
-void BGBitmap::RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1)
+void gbaDisplay::BGBitmap::RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1)
 {
     u32 fY = m_Y;
     u32 fX = m_X;
@@ -1366,7 +1266,7 @@ void BGBitmap::RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1)
         vmosaic = 1;
     }
 
-    vmodulus = m_VCOUNT.b % vmosaic;
+    vmodulus = m_display->m_renderline % vmosaic;
     dmyofs   = vmodulus * m_dmy;
     dmxofs   = vmodulus * m_dmx;
 
@@ -1389,16 +1289,15 @@ void BGBitmap::RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1)
         if (use256x1)
         {
             dotbase += offset;
-            entry = m_VRAM[dotbase];
+            entry = m_display->m_VRAM[dotbase];
             if (entry == 0) {continue;}
-            color.w = Palette::GetBGColor256x1(entry);            
+            color.w = m_display->m_palette.GetBGColor256x1(entry);            
         }
         else
         {
             dotbase <<= 1;
             dotbase += offset;
-            color.b.b0.b = m_VRAM[dotbase + 0];
-            color.b.b1.b = m_VRAM[dotbase + 1];
+            color.w = *(u16 *)&m_display->m_VRAM[dotbase];
         }
 
         m_line[dot] = color.w;
@@ -1406,42 +1305,18 @@ void BGBitmap::RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1)
     }
 }
 
-void BGBitmap::Reset() {m_offset = 0x0000;}
+void gbaDisplay::BGBitmap::Reset() {m_offset = 0x0000;}
 
-void BGBitmap::RenderLineMode3() {RenderLine(0x0000,   160, 240, false);}
-void BGBitmap::RenderLineMode4() {RenderLine(m_offset, 160, 240, true);}
-void BGBitmap::RenderLineMode5() {RenderLine(m_offset, 128, 160, false);}
+void gbaDisplay::BGBitmap::RenderLineMode3() {RenderLine(0x0000,   160, 240, false);}
+void gbaDisplay::BGBitmap::RenderLineMode4() {RenderLine(m_offset, 160, 240, true);}
+void gbaDisplay::BGBitmap::RenderLineMode5() {RenderLine(m_offset, 128, 160, false);}
 
-void BGBitmap::SetFrame(u32 frame) {m_offset = (frame & 1) * 0xA000;}
+void gbaDisplay::BGBitmap::SetFrame(u32 frame) {m_offset = (frame & 1) * 0xA000;}
 
 //-------------------------------------------------------------------------------------------------
 // Orden y numero de capa para cada BG ------------------------------------------------------------
-class BGControl
-{
-private:
-    static u32 m_bgorder[2][4];
-
-    t16  m_BGCNT;
-    u32  m_priority;
-    u32  m_bgnumber;
-
-public:
-    static void ResetOrder();
-    static void NotifyPrioritySet(u32 bg, u32 priority);
-    static u32 const *GetBGOrder();
-
-    BGControl(u32 bgnumber);
-    void Reset();
-    u32 GetPriority();
-    void WriteBGCNT_B0(u8 byte);
-    void WriteBGCNT_B1(u8 byte);
-    u8 ReadBGCNT_B0();
-    u8 ReadBGCNT_B1();
-};
 
-u32 BGControl::m_bgorder[2][4];
-
-void BGControl::ResetOrder()
+void gbaDisplay::BGOrder::Reset()
 {
     m_bgorder[0][0] = 0;
     m_bgorder[1][0] = 0;
@@ -1453,38 +1328,42 @@ void BGControl::ResetOrder()
     m_bgorder[1][3] = 0;
 }
 
-u32 const *BGControl::GetBGOrder() {return m_bgorder[0];}
+u32 const *gbaDisplay::BGOrder::GetBGOrder() const {return m_bgorder[0];}
 
-BGControl::BGControl(u32 bgnumber) {m_bgnumber = bgnumber & 3;}
+gbaDisplay::BGControl::BGControl(BGOrder *order, u32 bgnumber)
+{
+    m_order    = order;
+    m_bgnumber = bgnumber & 3;
+}
 
-void BGControl::Reset()
+void gbaDisplay::BGControl::Reset()
 {
     m_BGCNT.w  = 0;
     m_priority = 0;
 }
 
-u32 BGControl::GetPriority() {return m_priority;}
+u32 gbaDisplay::BGControl::GetPriority() {return m_priority;}
 
-void BGControl::WriteBGCNT_B0(u8 byte)
+void gbaDisplay::BGControl::WriteBGCNT_B0(u8 byte)
 {
     u32 nextpriority;
     m_BGCNT.b.b0.b = byte;
     nextpriority   = SUBVAL(byte, 0, 3);
-    if (nextpriority != m_priority) {NotifyPrioritySet(m_bgnumber, nextpriority);}
+    if (nextpriority != m_priority) {m_order->NotifyPrioritySet(m_bgnumber, nextpriority);}
     m_priority     = nextpriority;
 }
 
-void BGControl::WriteBGCNT_B1(u8 byte)
+void gbaDisplay::BGControl::WriteBGCNT_B1(u8 byte)
 {
     m_BGCNT.b.b1.b = byte;
 }
 
-u8 BGControl::ReadBGCNT_B0() {return m_BGCNT.b.b0.b;}
-u8 BGControl::ReadBGCNT_B1() {return m_BGCNT.b.b1.b;}
+u8 gbaDisplay::BGControl::ReadBGCNT_B0() {return m_BGCNT.b.b0.b;}
+u8 gbaDisplay::BGControl::ReadBGCNT_B1() {return m_BGCNT.b.b1.b;}
 
 //-------------------------------------------------------------------------------------------------
 // Procesamiento de BG ----------------------------------------------------------------------------
-void BGControl::NotifyPrioritySet(u32 bg, u32 priority)
+void gbaDisplay::BGOrder::NotifyPrioritySet(u32 bg, u32 priority)
 {
     u32 oldlayerpos;
     u32 insert;
@@ -1548,89 +1427,171 @@ void BGControl::NotifyPrioritySet(u32 bg, u32 priority)
 
 //-------------------------------------------------------------------------------------------------
 
-class BG0 : public BGControl, public BGText
+gbaDisplay::BG0::BG0(gbaDisplay *display) : BGControl(&display->m_bgorder, 0), BGText(display) {}
+gbaDisplay::BG1::BG1(gbaDisplay *display) : BGControl(&display->m_bgorder, 1), BGText(display) {}
+gbaDisplay::BG2::BG2(gbaDisplay *display) : BGControl(&display->m_bgorder, 2), BGText(display), BGBitmap(display) {}
+gbaDisplay::BG3::BG3(gbaDisplay *display) : BGControl(&display->m_bgorder, 3), BGText(display), BGRotationAndScaling(display) {}
+
+gbaDisplay::Painter::Painter(gbaDisplay *display) {m_display = display;}
+
+void gbaDisplay::Painter::WriteBackRow(u32 dot, u16 color, u16 attr)
 {
-public:
-    BG0();
-};
+    m_linebuffer[1][dot] = color;
+    m_attrbuffer[1][dot] = attr;
+}
 
-class BG1 : public BGControl, public BGText
+void gbaDisplay::Painter::WriteFrontRow(u32 dot, u16 color, u16 attr)
 {
-public:
-    BG1();
-};
+    WriteBackRow(dot, m_linebuffer[0][dot], m_attrbuffer[0][dot]);
+    m_linebuffer[0][dot] = color;
+    m_attrbuffer[0][dot] = attr;
+}
 
-class BG2 : public BGControl, public BGText, public BGBitmap
+void gbaDisplay::Painter::FillBackdropScalar(u16 color, u16 attr)
 {
-public:
-    BG2();
-};
+    for (u32 i = 0; i < m_screenwidth; ++i)
+    {
+        m_attrbuffer[1][i] = DOT_TRANSPARENT | DOT_LOWESTPRIORITY;
+        m_linebuffer[0][i] = color;
+        m_attrbuffer[0][i] = attr;
+    }
+}
 
-class BG3 : public BGControl, public BGText, public BGRotationAndScaling
+void gbaDisplay::Painter::WriteBGFrontScalar(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx)
 {
-public:
-    BG3();
-};
+    for (u32 i = 0; i < m_screenwidth; ++i) {if (((attr[i] & DOT_TRANSPARENT) != DOT_TRANSPARENT) && ((m_winx[i] & xwinx) == xwinx)) {WriteFrontRow(i, line[i], attr[i] | xattr);}}
+}
 
-BG0::BG0() : BGControl(0) {}
-BG1::BG1() : BGControl(1) {}
-BG2::BG2() : BGControl(2) {}
-BG3::BG3() : BGControl(3) {}
-
-BG0 m_bg0;
-BG1 m_bg1;
-BG2 m_bg2;
-BG3 m_bg3;
-
-class Painter
-{
-private:
-    static u16  m_linebuffer[2][m_screenwidth];
-    static u16  m_attrbuffer[2][m_screenwidth];
-    static u16 *m_winx;
-    static void (*RenderLineBG)();
-
-    static void WriteBackRow(u32 dot, u16 color, u16 attr);
-    static void WriteFrontRow(u32 dot, u16 color, u16 attr);
-    static void WriteBGFront(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx);
-    static void RenderLineBGMode0();
-    static void RenderLineBGMode1();
-    static void RenderLineBGMode2();
-    static void RenderLineBGMode3();
-    static void RenderLineBGMode4();
-    static void RenderLineBGMode5();
-    
-public:
-    static void RenderLine();
-    static void SetBGMode(u32 mode);
-};
+void gbaDisplay::Painter::WriteOBJScalar(u16 const *line, u16 const *attr, u16 xattr)
+{
+    for (u32 i = 0; i < m_screenwidth; ++i)
+    {
+        if (((attr[i] & DOT_TRANSPARENT) == DOT_TRANSPARENT) || ((m_winx[i] & DOT_WINDOWUSEOBJ) != DOT_WINDOWUSEOBJ)) {continue;}
 
-u16    Painter::m_linebuffer[2][m_screenwidth];
-u16    Painter::m_attrbuffer[2][m_screenwidth];
-u16   *Painter::m_winx;
-void (*Painter::RenderLineBG)();
+        if      ((attr[i] & DOT_PRIORITYBITS) <= (m_attrbuffer[0][i] & DOT_PRIORITYBITS))
+        {
+            WriteFrontRow(i, line[i], attr[i] | xattr);
+        }
+        else if ((attr[i] & DOT_PRIORITYBITS) <= (m_attrbuffer[1][i] & DOT_PRIORITYBITS))
+        {
+            WriteBackRow(i, line[i], attr[i] | xattr);
+        }
+    }
+}
 
-void Painter::WriteBackRow(u32 dot, u16 color, u16 attr)
+void gbaDisplay::Painter::MaskCSEScalar()
 {
-    m_linebuffer[1][dot] = color;
-    m_attrbuffer[1][dot] = attr;
+    for (u32 i = 0; i < m_screenwidth; ++i) {if ((m_winx[i] & DOT_WINDOWUSECSE) != DOT_WINDOWUSECSE) {m_attrbuffer[0][i] &= ~DOT_CSEALL;}}
 }
 
-void Painter::WriteFrontRow(u32 dot, u16 color, u16 attr)
+#ifdef GBA_DISPLAY_SSE2
+// Las lineas son de 240 puntos, 30 grupos de 8 sin resto
+void gbaDisplay::Painter::FillBackdropSSE2(u16 color, u16 attr)
 {
-    WriteBackRow(dot, m_linebuffer[0][dot], m_attrbuffer[0][dot]);
-    m_linebuffer[0][dot] = color;
-    m_attrbuffer[0][dot] = attr;
+    __m128i back  = _mm_set1_epi16(DOT_TRANSPARENT | DOT_LOWESTPRIORITY);
+    __m128i line  = _mm_set1_epi16((s16)color);
+    __m128i flags = _mm_set1_epi16((s16)attr);
+
+    for (u32 i = 0; i < m_screenwidth; i += 8)
+    {
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[1][i], back);
+        _mm_storeu_si128((__m128i *)&m_linebuffer[0][i], line);
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[0][i], flags);
+    }
 }
 
-void Painter::WriteBGFront(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx)
+void gbaDisplay::Painter::WriteBGFrontSSE2(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx)
 {
-    for (u32 i = 0; i < m_screenwidth; ++i) {if (((attr[i] & DOT_TRANSPARENT) != DOT_TRANSPARENT) && ((m_winx[i] & xwinx) == xwinx)) {WriteFrontRow(i, line[i], attr[i] | xattr);}}
+    __m128i transparent = _mm_set1_epi16(DOT_TRANSPARENT);
+    __m128i window      = _mm_set1_epi16((s16)xwinx);
+    __m128i extra       = _mm_set1_epi16((s16)xattr);
+
+    for (u32 i = 0; i < m_screenwidth; i += 8)
+    {
+        __m128i color  = _mm_loadu_si128((__m128i const *)&line[i]);
+        __m128i flags  = _mm_loadu_si128((__m128i const *)&attr[i]);
+        __m128i winx   = _mm_loadu_si128((__m128i const *)&m_winx[i]);
+        __m128i front  = _mm_loadu_si128((__m128i const *)&m_linebuffer[0][i]);
+        __m128i frontf = _mm_loadu_si128((__m128i const *)&m_attrbuffer[0][i]);
+        __m128i back   = _mm_loadu_si128((__m128i const *)&m_linebuffer[1][i]);
+        __m128i backf  = _mm_loadu_si128((__m128i const *)&m_attrbuffer[1][i]);
+
+        __m128i write = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(flags, transparent), transparent), _mm_cmpeq_epi16(_mm_and_si128(winx, window), window));
+
+        _mm_storeu_si128((__m128i *)&m_linebuffer[1][i], SelectSSE2(write, front,  back));
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[1][i], SelectSSE2(write, frontf, backf));
+        _mm_storeu_si128((__m128i *)&m_linebuffer[0][i], SelectSSE2(write, color, front));
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[0][i], SelectSSE2(write, _mm_or_si128(flags, extra), frontf));
+    }
+}
+
+void gbaDisplay::Painter::WriteOBJSSE2(u16 const *line, u16 const *attr, u16 xattr)
+{
+    __m128i transparent = _mm_set1_epi16(DOT_TRANSPARENT);
+    __m128i window      = _mm_set1_epi16(DOT_WINDOWUSEOBJ);
+    __m128i priority    = _mm_set1_epi16(DOT_PRIORITYBITS);
+    __m128i extra       = _mm_set1_epi16((s16)xattr);
+
+    for (u32 i = 0; i < m_screenwidth; i += 8)
+    {
+        __m128i color  = _mm_loadu_si128((__m128i const *)&line[i]);
+        __m128i flags  = _mm_loadu_si128((__m128i const *)&attr[i]);
+        __m128i winx   = _mm_loadu_si128((__m128i const *)&m_winx[i]);
+        __m128i front  = _mm_loadu_si128((__m128i const *)&m_linebuffer[0][i]);
+        __m128i frontf = _mm_loadu_si128((__m128i const *)&m_attrbuffer[0][i]);
+        __m128i back   = _mm_loadu_si128((__m128i const *)&m_linebuffer[1][i]);
+        __m128i backf  = _mm_loadu_si128((__m128i const *)&m_attrbuffer[1][i]);
+
+        __m128i visible = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(flags, transparent), transparent), _mm_cmpeq_epi16(_mm_and_si128(winx, window), window));
+        __m128i level   = _mm_and_si128(flags, priority);
+        __m128i over1st = _mm_andnot_si128(_mm_cmpgt_epi16(level, _mm_and_si128(frontf, priority)), visible);
+        __m128i over2nd = _mm_andnot_si128(over1st, _mm_andnot_si128(_mm_cmpgt_epi16(level, _mm_and_si128(backf, priority)), visible));
+
+        flags = _mm_or_si128(flags, extra);
+
+        _mm_storeu_si128((__m128i *)&m_linebuffer[1][i], SelectSSE2(over1st, front,  SelectSSE2(over2nd, color, back)));
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[1][i], SelectSSE2(over1st, frontf, SelectSSE2(over2nd, flags, backf)));
+        _mm_storeu_si128((__m128i *)&m_linebuffer[0][i], SelectSSE2(over1st, color, front));
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[0][i], SelectSSE2(over1st, flags, frontf));
+    }
+}
+
+void gbaDisplay::Painter::MaskCSESSE2()
+{
+    __m128i window = _mm_set1_epi16((s16)DOT_WINDOWUSECSE);
+    __m128i cse    = _mm_set1_epi16(DOT_CSEALL);
+
+    for (u32 i = 0; i < m_screenwidth; i += 8)
+    {
+        __m128i winx  = _mm_loadu_si128((__m128i const *)&m_winx[i]);
+        __m128i flags = _mm_loadu_si128((__m128i const *)&m_attrbuffer[0][i]);
+        __m128i clear = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_and_si128(winx, window), window), cse);
+        _mm_storeu_si128((__m128i *)&m_attrbuffer[0][i], _mm_andnot_si128(clear, flags));
+    }
 }
+#endif
 
-void Painter::RenderLineBGMode0()
+void gbaDisplay::Painter::SetSIMD(bool enable)
 {
-    u32 const *bgorder = BGControl::GetBGOrder();
+#ifdef GBA_DISPLAY_SSE2
+    if (enable)
+    {
+        FillBackdrop = &Painter::FillBackdropSSE2;
+        WriteBGFront = &Painter::WriteBGFrontSSE2;
+        WriteOBJ     = &Painter::WriteOBJSSE2;
+        MaskCSE      = &Painter::MaskCSESSE2;
+        return;
+    }
+#endif
+    FillBackdrop = &Painter::FillBackdropScalar;
+    WriteBGFront = &Painter::WriteBGFrontScalar;
+    WriteOBJ     = &Painter::WriteOBJScalar;
+    MaskCSE      = &Painter::MaskCSEScalar;
+}
+
+void gbaDisplay::Painter::RenderLineBGMode0()
+{
+    u32 const *bgorder = m_display->m_bgorder.GetBGOrder();
     u16 const *line;
     u16 const *attr;
     u16 xattr;
@@ -1644,51 +1605,51 @@ void Painter::RenderLineBGMode0()
         switch (bgorder[--layer])
         {
         case 0:
-            if (!IsBGEnabled(0)) {continue;}
-            m_bg0.RenderLine();
-            m_bg0.GetLine(line, attr);
-            xattr = (m_bg0.GetPriority() | ColorSpecialEffect::GetBGFlags(0)) & 0xFFFF;
+            if (!m_display->IsBGEnabled(0)) {continue;}
+            m_display->m_bg0.RenderLine();
+            m_display->m_bg0.GetLine(line, attr);
+            xattr = (m_display->m_bg0.GetPriority() | m_display->m_cse.GetBGFlags(0)) & 0xFFFF;
             
             xwinx = DOT_WINDOWUSEBG0;
             break;
         case 1:
-            if (!IsBGEnabled(1)) {continue;}
-            m_bg1.RenderLine();
-            m_bg1.GetLine(line, attr);
-            xattr = (m_bg1.GetPriority() | ColorSpecialEffect::GetBGFlags(1)) & 0xFFFF;
+            if (!m_display->IsBGEnabled(1)) {continue;}
+            m_display->m_bg1.RenderLine();
+            m_display->m_bg1.GetLine(line, attr);
+            xattr = (m_display->m_bg1.GetPriority() | m_display->m_cse.GetBGFlags(1)) & 0xFFFF;
             
             xwinx = DOT_WINDOWUSEBG1;
             break;
         case 2:
-            if (!IsBGEnabled(2)) {continue;}
+            if (!m_display->IsBGEnabled(2)) {continue;}
 
-            m_bg2.BGText::RenderLine();
-            m_bg2.BGText::GetLine(line, attr);
+            m_display->m_bg2.BGText::RenderLine();
+            m_display->m_bg2.BGText::GetLine(line, attr);
 
-            xattr = (m_bg2.GetPriority() | ColorSpecialEffect::GetBGFlags(2)) & 0xFFFF;
+            xattr = (m_display->m_bg2.GetPriority() | m_display->m_cse.GetBGFlags(2)) & 0xFFFF;
 
             xwinx = DOT_WINDOWUSEBG2;
             break;
         case 3:
-            if (!IsBGEnabled(3)) {continue;}
+            if (!m_display->IsBGEnabled(3)) {continue;}
 
-            m_bg3.BGText::RenderLine();
-            m_bg3.BGText::GetLine(line, attr);
+            m_display->m_bg3.BGText::RenderLine();
+            m_display->m_bg3.BGText::GetLine(line, attr);
 
-            xattr = (m_bg3.GetPriority() | ColorSpecialEffect::GetBGFlags(3)) & 0xFFFF;
+            xattr = (m_display->m_bg3.GetPriority() | m_display->m_cse.GetBGFlags(3)) & 0xFFFF;
 
             xwinx = DOT_WINDOWUSEBG3;
             break;
         }
 
-        WriteBGFront(line, attr, xattr, xwinx);
+        (this->*WriteBGFront)(line, attr, xattr, xwinx);
     }
     while (layer != 0);
 }
 
-void Painter::RenderLineBGMode1()
+void gbaDisplay::Painter::RenderLineBGMode1()
 {
-    u32 const *bgorder = BGControl::GetBGOrder();
+    u32 const *bgorder = m_display->m_bgorder.GetBGOrder();
     u16 const *line;
     u16 const *attr;
     u16 xattr;
@@ -1701,26 +1662,26 @@ void Painter::RenderLineBGMode1()
         switch (bgorder[--layer])
         {
         case 0:
-            if (!IsBGEnabled(0)) {continue;}
-            m_bg0.RenderLine();
-            m_bg0.GetLine(line, attr);
-            xattr = (m_bg0.GetPriority() | ColorSpecialEffect::GetBGFlags(0)) & 0xFFFF;
+            if (!m_display->IsBGEnabled(0)) {continue;}
+            m_display->m_bg0.RenderLine();
+            m_display->m_bg0.GetLine(line, attr);
+            xattr = (m_display->m_bg0.GetPriority() | m_display->m_cse.GetBGFlags(0)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG0;
             break;
         case 1:
-            if (!IsBGEnabled(1)) {continue;}
-            m_bg1.RenderLine();
-            m_bg1.GetLine(line, attr);
-            xattr = (m_bg1.GetPriority() | ColorSpecialEffect::GetBGFlags(1)) & 0xFFFF;
+            if (!m_display->IsBGEnabled(1)) {continue;}
+            m_display->m_bg1.RenderLine();
+            m_display->m_bg1.GetLine(line, attr);
+            xattr = (m_display->m_bg1.GetPriority() | m_display->m_cse.GetBGFlags(1)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG1;
             break;
         case 2:
-            if (!IsBGEnabled(2)) {continue;}
+            if (!m_display->IsBGEnabled(2)) {continue;}
 
-            m_bg2.BGRotationAndScaling::RenderLine();
-            m_bg2.BGRotationAndScaling::GetLine(line, attr);
+            m_display->m_bg2.BGRotationAndScaling::RenderLine();
+            m_display->m_bg2.BGRotationAndScaling::GetLine(line, attr);
 
-            xattr = (m_bg2.GetPriority() | ColorSpecialEffect::GetBGFlags(2)) & 0xFFFF;
+            xattr = (m_display->m_bg2.GetPriority() | m_display->m_cse.GetBGFlags(2)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG2;
             break;
         case 3:
@@ -1728,14 +1689,14 @@ void Painter::RenderLineBGMode1()
             break;
         }
 
-        WriteBGFront(line, attr, xattr, xwinx);
+        (this->*WriteBGFront)(line, attr, xattr, xwinx);
     }
     while (layer != 0);
 }
 
-void Painter::RenderLineBGMode2()
+void gbaDisplay::Painter::RenderLineBGMode2()
 {
-    u32 const *bgorder = BGControl::GetBGOrder();
+    u32 const *bgorder = m_display->m_bgorder.GetBGOrder();
     u16 const *line;
     u16 const *attr;
     u16 xattr;
@@ -1754,33 +1715,33 @@ void Painter::RenderLineBGMode2()
             continue;
             break;
         case 2:
-            if (!IsBGEnabled(2)) {continue;}
+            if (!m_display->IsBGEnabled(2)) {continue;}
 
-            m_bg2.BGRotationAndScaling::RenderLine();
-            m_bg2.BGRotationAndScaling::GetLine(line, attr);
+            m_display->m_bg2.BGRotationAndScaling::RenderLine();
+            m_display->m_bg2.BGRotationAndScaling::GetLine(line, attr);
 
-            xattr = (m_bg2.GetPriority() | ColorSpecialEffect::GetBGFlags(2)) & 0xFFFF;
+            xattr = (m_display->m_bg2.GetPriority() | m_display->m_cse.GetBGFlags(2)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG2;
             break;
         case 3:
-            if (!IsBGEnabled(3)) {continue;}
+            if (!m_display->IsBGEnabled(3)) {continue;}
 
-            m_bg3.BGRotationAndScaling::RenderLine();
-            m_bg3.BGRotationAndScaling::GetLine(line, attr);
+            m_display->m_bg3.BGRotationAndScaling::RenderLine();
+            m_display->m_bg3.BGRotationAndScaling::GetLine(line, attr);
 
-            xattr = (m_bg3.GetPriority() | ColorSpecialEffect::GetBGFlags(3)) & 0xFFFF;
+            xattr = (m_display->m_bg3.GetPriority() | m_display->m_cse.GetBGFlags(3)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG3;
             break;
         }
 
-        WriteBGFront(line, attr, xattr, xwinx);
+        (this->*WriteBGFront)(line, attr, xattr, xwinx);
     }
     while (layer != 0);
 }
 
-void Painter::RenderLineBGMode3()
+void gbaDisplay::Painter::RenderLineBGMode3()
 {
-    u32 const *bgorder = BGControl::GetBGOrder();
+    u32 const *bgorder = m_display->m_bgorder.GetBGOrder();
     u16 const *line;
     u16 const *attr;
     u16 xattr;
@@ -1799,12 +1760,12 @@ void Painter::RenderLineBGMode3()
             continue;
             break;
         case 2:
-            if (!IsBGEnabled(2)) {continue;}
+            if (!m_display->IsBGEnabled(2)) {continue;}
 
-            m_bg2.BGBitmap::RenderLineMode3();
-            m_bg2.BGBitmap::GetLine(line, attr);
+            m_display->m_bg2.BGBitmap::RenderLineMode3();
+            m_display->m_bg2.BGBitmap::GetLine(line, attr);
 
-            xattr = (m_bg2.GetPriority() | ColorSpecialEffect::GetBGFlags(2)) & 0xFFFF;
+            xattr = (m_display->m_bg2.GetPriority() | m_display->m_cse.GetBGFlags(2)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG2;
             break;
         case 3:
@@ -1812,14 +1773,14 @@ void Painter::RenderLineBGMode3()
             break;
         }
 
-        WriteBGFront(line, attr, xattr, xwinx);
+        (this->*WriteBGFront)(line, attr, xattr, xwinx);
     }
     while (layer != 0);
 }
 
-void Painter::RenderLineBGMode4()
+void gbaDisplay::Painter::RenderLineBGMode4()
 {
-    u32 const *bgorder = BGControl::GetBGOrder();
+    u32 const *bgorder = m_display->m_bgorder.GetBGOrder();
     u16 const *line;
     u16 const *attr;
     u16 xattr;
@@ -1838,12 +1799,12 @@ void Painter::RenderLineBGMode4()
             continue;
             break;
         case 2:
-            if (!IsBGEnabled(2)) {continue;}
+            if (!m_display->IsBGEnabled(2)) {continue;}
 
-            m_bg2.BGBitmap::RenderLineMode4();
-            m_bg2.BGBitmap::GetLine(line, attr);
+            m_display->m_bg2.BGBitmap::RenderLineMode4();
+            m_display->m_bg2.BGBitmap::GetLine(line, attr);
 
-            xattr = (m_bg2.GetPriority() | ColorSpecialEffect::GetBGFlags(2)) & 0xFFFF;
+            xattr = (m_display->m_bg2.GetPriority() | m_display->m_cse.GetBGFlags(2)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG2;
             break;
         case 3:
@@ -1851,14 +1812,14 @@ void Painter::RenderLineBGMode4()
             break;
         }
 
-        WriteBGFront(line, attr, xattr, xwinx);
+        (this->*WriteBGFront)(line, attr, xattr, xwinx);
     }
     while (layer != 0);
 }
 
-void Painter::RenderLineBGMode5()
+void gbaDisplay::Painter::RenderLineBGMode5()
 {
-    u32 const *bgorder = BGControl::GetBGOrder();
+    u32 const *bgorder = m_display->m_bgorder.GetBGOrder();
     u16 const *line;
     u16 const *attr;
     u16 xattr;
@@ -1877,12 +1838,12 @@ void Painter::RenderLineBGMode5()
             continue;
             break;
         case 2:
-            if (!IsBGEnabled(2)) {continue;}
+            if (!m_display->IsBGEnabled(2)) {continue;}
 
-            m_bg2.BGBitmap::RenderLineMode5();
-            m_bg2.BGBitmap::GetLine(line, attr);
+            m_display->m_bg2.BGBitmap::RenderLineMode5();
+            m_display->m_bg2.BGBitmap::GetLine(line, attr);
 
-            xattr = (m_bg2.GetPriority() | ColorSpecialEffect::GetBGFlags(2)) & 0xFFFF;
+            xattr = (m_display->m_bg2.GetPriority() | m_display->m_cse.GetBGFlags(2)) & 0xFFFF;
             xwinx = DOT_WINDOWUSEBG2;
             break;
         case 3:
@@ -1890,89 +1851,147 @@ void Painter::RenderLineBGMode5()
             break;
         }
 
-        WriteBGFront(line, attr, xattr, xwinx);
+        (this->*WriteBGFront)(line, attr, xattr, xwinx);
     }
     while (layer != 0);
 }
 
-void Painter::RenderLine()
+void gbaDisplay::Painter::RenderLine()
 {
     u16 const *line;
     u16 const *attr;
 
-    OBJ::RenderLine();
-    OBJ::GetWindowLine(m_winx);
-    Window::RenderLine(m_winx);    
+    m_display->m_obj.RenderLine();
+    m_display->m_obj.GetWindowLine(m_winx);
+    m_display->m_window.RenderLine(m_winx);    
 
-    u16 bd   = IsForcedBlank() ? 0xFFFF : Palette::GetBackdropColor();
-    u16 bdfg = ColorSpecialEffect::GetBackdropFlags() | DOT_LOWESTPRIORITY;
+    u16 bd   = m_display->IsForcedBlank() ? 0xFFFF : m_display->m_palette.GetBackdropColor();
+    u16 bdfg = m_display->m_cse.GetBackdropFlags() | DOT_LOWESTPRIORITY;
 
-    for (u32 i = 0; i < m_screenwidth; ++i)
+    (this->*FillBackdrop)(bd, bdfg);
+
+    if (!m_display->IsForcedBlank())
     {
-        m_attrbuffer[1][i] = DOT_TRANSPARENT | DOT_LOWESTPRIORITY;
-        m_linebuffer[0][i] = bd;
-        m_attrbuffer[0][i] = bdfg;
+
+    // Render BG
+    (this->*RenderLineBG)();
+
+    if (m_display->IsOBJEnabled())
+    {
+        m_display->m_obj.GetLine(line, attr);
+        (this->*WriteOBJ)(line, attr, m_display->m_cse.GetOBJFlags());
     }
 
-    if (!IsForcedBlank())
+    (this->*MaskCSE)();
+    }
+
+    m_display->m_cse.Blend(m_display->m_framebuffer[m_display->m_renderline], m_linebuffer[0], m_attrbuffer[0], m_linebuffer[1], m_attrbuffer[1]);
+}
+
+void gbaDisplay::Painter::SetBGMode(u32 mode)
+{
+    switch (mode)
     {
+    case 0: RenderLineBG = &Painter::RenderLineBGMode0; break;
+    case 1: RenderLineBG = &Painter::RenderLineBGMode1; break;
+    case 2: RenderLineBG = &Painter::RenderLineBGMode2; break;
+    case 3: RenderLineBG = &Painter::RenderLineBGMode3; break;
+    case 4: RenderLineBG = &Painter::RenderLineBGMode4; break;
+    case 5: RenderLineBG = &Painter::RenderLineBGMode5; break;
+    default: RenderLineBG = &Painter::RenderLineBGMode0; break;
+    }
+}
 
-    // Render BG
-    RenderLineBG();
+//-------------------------------------------------------------------------------------------------
+// Hilo de dibujo ---------------------------------------------------------------------------------
+// Con el dibujo por lotes nada de lo que lee Painter cambia mientras haya lineas pendientes: cada
+// escritura que cambia la imagen espera antes a que se dibujen. El hilo avanza sobre las lineas
+// listas sin copiar el estado y el CPU solo lo espera en esas escrituras y en el VBlank
+const u32 m_spin = 1 << 14; // Vueltas antes de dormir, del orden de unas lineas
+
+gbaDisplay::RenderThread::RenderThread(gbaDisplay *display)
+{
+    m_display  = display;
+    m_sleeping = false;
+    m_exit     = false;
+}
 
+void gbaDisplay::RenderThread::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
 
-    if (IsOBJEnabled())
+    while (!m_exit)
     {
-        OBJ::GetLine(line, attr);
-    
-        for (u32 i = 0; i < m_screenwidth; ++i)
+        lock.unlock();
+        for (u32 spin = 0; spin < m_spin; ++spin)
         {
-            if (((attr[i] & DOT_TRANSPARENT) == DOT_TRANSPARENT) || ((m_winx[i] & DOT_WINDOWUSEOBJ) != DOT_WINDOWUSEOBJ)) {continue;}
-
-            if      ((attr[i] & DOT_PRIORITYBITS) <= (m_attrbuffer[0][i] & DOT_PRIORITYBITS))
-            {
-                WriteFrontRow(i, line[i], attr[i] | ColorSpecialEffect::GetOBJFlags());
-            }
-            else if ((attr[i] & DOT_PRIORITYBITS) <= (m_attrbuffer[1][i] & DOT_PRIORITYBITS))
+            if (m_display->m_renderline < m_display->m_readylines)
             {
-                WriteBackRow(i, line[i], attr[i] | ColorSpecialEffect::GetOBJFlags());
+                for (; m_display->m_renderline < m_display->m_readylines; ++m_display->m_renderline) {m_display->m_painter.RenderLine();}
+                spin = 0;
             }
         }
-    }
+        lock.lock();
 
-    for (u32 i = 0; i < m_screenwidth; ++i) {if ((m_winx[i] & DOT_WINDOWUSECSE) != DOT_WINDOWUSECSE) {m_attrbuffer[0][i] &= ~DOT_CSEALL;}}
+        m_sleeping = true;
+        if (!m_exit && (m_display->m_renderline == m_display->m_readylines)) {m_wake.wait(lock);}
+        m_sleeping = false;
     }
+}
 
-    ColorSpecialEffect::Blend(m_framebuffer[m_VCOUNT.b], m_linebuffer[0], m_attrbuffer[0], m_linebuffer[1], m_attrbuffer[1]);
+void gbaDisplay::RenderThread::Start()
+{
+    m_exit     = false;
+    m_sleeping = false;
+    m_thread   = std::thread(&RenderThread::Run, this);
 }
 
-void Painter::SetBGMode(u32 mode)
+void gbaDisplay::RenderThread::Stop()
 {
-    switch (mode)
+    if (!m_thread.joinable()) {return;}
     {
-    case 0: RenderLineBG = RenderLineBGMode0; break;
-    case 1: RenderLineBG = RenderLineBGMode1; break;
-    case 2: RenderLineBG = RenderLineBGMode2; break;
-    case 3: RenderLineBG = RenderLineBGMode3; break;
-    case 4: RenderLineBG = RenderLineBGMode4; break;
-    case 5: RenderLineBG = RenderLineBGMode5; break;
-    default: RenderLineBG = RenderLineBGMode0; break;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
     }
+    m_wake.notify_one();
+    m_thread.join();
 }
 
-s32 GetNextEvent()
+void gbaDisplay::RenderThread::Notify()
 {
-    return m_ticks;
+    if (!m_sleeping) {return;}
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wake.notify_one();
+}
+
+// El hilo nunca duerme con lineas pendientes, basta con esperar a que las termine
+void gbaDisplay::RenderThread::Wait()
+{
+    while (m_display->m_renderline != m_display->m_readylines) {std::this_thread::yield();}
+}
+
+// Dibuja las lineas cuyo HBlank ya paso, antes de cualquier escritura que cambie la imagen
+void gbaDisplay::RenderPendingLines()
+{
+    if (m_threaded) {m_renderer.Wait(); return;}
+    for (; m_renderline < m_readylines; ++m_renderline) {m_painter.RenderLine();}
+}
+
+// Elige si se dibuja el cuadro que empieza
+void gbaDisplay::StartFrame()
+{
+    m_drawframe = (m_frameskip != 0) && (m_framephase == 0);
+    if (++m_framephase >= m_frameskip) {m_framephase = 0;}
 }
 
-void CompareVCOUNT()
+void gbaDisplay::CompareVCOUNT()
 {
     if (m_DISPSTAT.b.b1.b == m_VCOUNT.b)
     {
         m_DISPSTAT.w |= BIT(2);
         if ((m_DISPSTAT.w & BIT(5)) != 0)
         {
-            gbaControl::RequestInterrupt(gbaControl::IRQ_VCOUNTER);
+            m_console->control.RequestInterrupt(gbaControl::IRQ_VCOUNTER);
         }
     }
     else
@@ -1981,7 +2000,9 @@ void CompareVCOUNT()
     }
 }
 
-void Sync(s32 ticks)
+// El estado visible (DISPSTAT, VCOUNT) solo cambia en los eventos, por lo que no hace falta
+// ponerse al dia al acceder a los registros
+s32 gbaDisplay::Sync(s32 ticks)
 {
     m_ticks -= ticks;
     while (m_ticks <= 0)
@@ -1995,12 +2016,25 @@ void Sync(s32 ticks)
 
             if ((m_DISPSTAT.w & BIT(4)) != 0)
             {
-                gbaControl::RequestInterrupt(gbaControl::IRQ_HBLANK);
+                m_console->control.RequestInterrupt(gbaControl::IRQ_HBLANK);
             }
             if (m_VCOUNT.b < 160)
             {
-                gbaDMA::OnHblank();
-                Painter::RenderLine();
+                m_console->dma.OnHblank();
+                if (m_drawframe)
+                {
+                    m_readylines = m_VCOUNT.b + 1;
+                    if (!m_batch)
+                    {
+                        RenderPendingLines();
+                    }
+                    else if (!m_deferring)
+                    {
+                        m_deferring = true;
+                        m_console->memory.UpdateDisplayPages();
+                    }
+                    if (m_threaded) {m_renderer.Notify();}
+                }
             }
 
             break;
@@ -2011,22 +2045,28 @@ void Sync(s32 ticks)
             m_mode = 0;
 
             if (m_VCOUNT.b >= 2 && m_VCOUNT.b <= 161) {
-                gbaDMA::OnCaptureRequest();
+                m_console->dma.OnCaptureRequest();
             }
             
             if (m_VCOUNT.b == 160)
             {
-                gbaDMA::OnVblank();
+                RenderPendingLines();
+                if (m_deferring)
+                {
+                    m_deferring = false;
+                    m_console->memory.UpdateDisplayPages();
+                }
+                m_console->dma.OnVblank();
                 if ((m_DISPSTAT.w & BIT(3)) != 0)
                 {
-                    gbaControl::RequestInterrupt(gbaControl::IRQ_VBLANK);
+                    m_console->control.RequestInterrupt(gbaControl::IRQ_VBLANK);
                 }
                 m_DISPSTAT.w |= BIT(0);
-                Emulator::SendVideoFrame(m_framebuffer);
+                Emulator::SendVideoFrame(m_console, m_framebuffer);
             }
 
             else if (m_VCOUNT.b == 162) {
-                gbaDMA::OnCaptureEnd();
+                m_console->dma.OnCaptureEnd();
             }
 
             else if (m_VCOUNT.b == 227)
@@ -2035,31 +2075,56 @@ void Sync(s32 ticks)
             }
             else if (m_VCOUNT.b >= 228)
             {
-                gbaKeyInput::Sync();
+                m_console->keyinput.Sync();
                 m_VCOUNT.b = 0;
+                m_readylines = 0;
+                m_renderline = 0;
+                StartFrame();
                 m_bg2.OnLeaveVblank();
                 m_bg3.OnLeaveVblank();
             }
             CompareVCOUNT();
         }
     }
+    return m_ticks;
+}
+
+s32 gbaDisplay::SyncEvent(gbaConsole *console, s32 ticks)
+{
+    return console->display.Sync(ticks);
 }
 
-void Reset()
+void gbaDisplay::Reset()
 {
+    Release();
     memset(m_PaletteRAM, 0, sizeof(m_PaletteRAM));
     memset(m_VRAM, 0, sizeof(m_VRAM));
     memset(m_OAM, 0, sizeof(m_OAM));
+    m_tilecache.Reset();
     m_bitmapmode = false;
     m_DISPCNT.w = 0;
     m_u0x04000002.b = 0;
     m_DISPSTAT.w = 0;
     m_VCOUNT.b = 0;
+    m_bgmode = 0;
+    memset(m_BGXCNT,  0, sizeof(m_BGXCNT));
+    memset(m_BGXHOFS, 0, sizeof(m_BGXHOFS));
+    memset(m_BGXVOFS, 0, sizeof(m_BGXVOFS));
+    m_WININ.w  = 0;
+    m_WINOUT.w = 0;
+    m_MOSAIC.w = 0;
+    m_BLDCNT.w = 0;
+    m_deferring = false;
+    m_renderline = 0;
+    m_readylines = 0;
+    m_framephase = 0;
+    StartFrame();
     m_ticks = m_lineclk;
     m_mode = 0;
+    m_console->scheduler.Register(gbaScheduler::EVENT_DISPLAY, SyncEvent, m_ticks);
 
-    BGControl::ResetOrder();
-    Painter::SetBGMode(0);
+    m_bgorder.Reset();
+    m_painter.SetBGMode(0);
     m_bg0.BGControl::Reset();
     m_bg0.BGText::Reset();
     m_bg1.BGControl::Reset();
@@ -2074,43 +2139,81 @@ void Reset()
     m_bg3.BGReferencePoint::Reset();
     m_bg3.BGRotationAndScaling::Reset();
     
-    OBJ::Reset();
-    Window::Reset();
-    ColorSpecialEffect::Reset();
+    m_obj.Reset();
+    m_window.Reset();
+    m_cse.Reset();
+    m_cse.SetSIMD(m_simd);
+    m_painter.SetSIMD(m_simd);
+
+    m_threaded = m_batch && m_renderthread;
+    if (m_threaded && std::thread::hardware_concurrency() < 2) {m_threaded = false; Emulator::LogMessage("Un solo nucleo, el dibujo sigue en el hilo del CPU");}
+    if (m_threaded) {m_renderer.Start();}
+}
+
+void gbaDisplay::Release()
+{
+    m_renderer.Stop();
+    m_threaded = false;
+}
+
+void gbaDisplay::EnableSIMD(bool enable)
+{
+    m_simd = enable;
+}
+
+void gbaDisplay::EnableBatchRendering(bool enable)
+{
+    m_batch = enable;
+}
+
+void gbaDisplay::EnableRenderThread(bool enable)
+{
+    m_renderthread = enable;
+}
+
+// Los cuadros que no se dibujan se envian igual, con el ultimo cuadro dibujado
+void gbaDisplay::SetFrameSkip(u32 frames)
+{
+    m_frameskip = frames;
 }
 
-void WriteDISPCNT_B0(u8 byte)
+bool gbaDisplay::IsDeferringLines() const
+{
+    return m_deferring;
+}
+
+void gbaDisplay::WriteDISPCNT_B0(u8 byte)
 {
     m_DISPCNT.b.b0.b = byte & ~BIT(3);
     m_bgmode = byte & 7;
     m_bitmapmode = m_bgmode >= 3;
     m_bg2.SetFrame(SUBVAL(m_DISPCNT.w, 4, 1));
-    Painter::SetBGMode(m_bgmode);
+    m_painter.SetBGMode(m_bgmode);
 }
 
-void WriteDISPCNT_B1(u8 byte)
+void gbaDisplay::WriteDISPCNT_B1(u8 byte)
 {
     m_DISPCNT.b.b1.b = byte;
 }
 
-void Write0x04000002(u8 byte)
+void gbaDisplay::Write0x04000002(u8 byte)
 {
     m_u0x04000002.b = byte;
-    ColorSpecialEffect::SetGreenSwap(BITTEST(byte, 0));
+    m_cse.SetGreenSwap(BITTEST(byte, 0));
 }
 
-void WriteDISPSTAT_B0(u8 byte)
+void gbaDisplay::WriteDISPSTAT_B0(u8 byte)
 {
     m_DISPSTAT.b.b0.b = (m_DISPSTAT.b.b0.b & 0x7) | (byte & 0xF8);
 }
 
-void WriteDISPSTAT_B1(u8 byte)
+void gbaDisplay::WriteDISPSTAT_B1(u8 byte)
 {
     m_DISPSTAT.b.b1.b = byte;
     CompareVCOUNT();
 }
 
-void WriteMOSAIC_B0(u8 byte)
+void gbaDisplay::WriteMOSAIC_B0(u8 byte)
 {
     u32 h;
     u32 v;
@@ -2125,14 +2228,15 @@ void WriteMOSAIC_B0(u8 byte)
     m_bg3.BGRotationAndScaling::SetMosaic(h, v);
 }
 
-void WriteMOSAIC_B1(u8 byte)
+void gbaDisplay::WriteMOSAIC_B1(u8 byte)
 {
     m_MOSAIC.b.b1.b = byte;
-    OBJ::SetMosaic(SUBVAL(byte, 0, 0xF) + 1, SUBVAL(byte, 4, 0xF) + 1);
+    m_obj.SetMosaic(SUBVAL(byte, 0, 0xF) + 1, SUBVAL(byte, 4, 0xF) + 1);
 }
 
-void WritePaletteRAM(u32 address, t32 const *data, gbaMemory::DataType width)
+void gbaDisplay::WritePaletteRAM(u32 address, t32 const *data, gbaMemory::DataType width)
 {
+    RenderPendingLines();
     u32 base = address & ~(width - 1) & ~BIT(0) & 0x3FF;
     switch (width)
     {
@@ -2149,8 +2253,9 @@ void WritePaletteRAM(u32 address, t32 const *data, gbaMemory::DataType width)
     }
 }
 
-void WriteVRAM(u32 address, t32 const *data, gbaMemory::DataType width)
+void gbaDisplay::WriteVRAM(u32 address, t32 const *data, gbaMemory::DataType width)
 {
+    RenderPendingLines();
     u32 base = address & ((address & 0x10000) != 0 ? 0x17FFF : 0xFFFF) & ~(width - 1);
     switch (width)
     {
@@ -2162,15 +2267,17 @@ void WriteVRAM(u32 address, t32 const *data, gbaMemory::DataType width)
         m_VRAM[base | 0] = data->w.w0.b.b0.b;
         break;
     case gbaMemory::TYPE_BYTE:
-        if (base > (m_bitmapmode ? 0x13FFFU : 0xFFFFU)) {break;}
+        if (base > (m_bitmapmode ? 0x13FFFU : 0xFFFFU)) {return;}
         base &= ~BIT(0);
         m_VRAM[base | 1] = data->w.w0.b.b0.b;
         m_VRAM[base | 0] = data->w.w0.b.b0.b;
     }
+    m_VRAMwrites[base >> 8]++;
 }
 
-void WriteOAM(u32 address, t32 const *data, gbaMemory::DataType width)
+void gbaDisplay::WriteOAM(u32 address, t32 const *data, gbaMemory::DataType width)
 {
+    RenderPendingLines();
     u32 base = address & ~(width - 1) & 0x3FF;
     switch (width)
     {
@@ -2184,11 +2291,14 @@ void WriteOAM(u32 address, t32 const *data, gbaMemory::DataType width)
     }
 }
 
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
+void gbaDisplay::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
 {
     u8 bytes[4] = {data->w.w0.b.b0.b, data->w.w0.b.b1.b, data->w.w1.b.b0.b, data->w.w1.b.b1.b};
     u32 base = address & ~(width - 1);
 
+    // DISPSTAT no cambia la imagen
+    if ((base & ~3) != 0x04000004) {RenderPendingLines();}
+
     for (u32 i = 0; i < (u32)width; i++)
     {
         switch (base + i)
@@ -2260,33 +2370,33 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
         case 0x0400003E: m_bg3.WriteBGY_H_B0(bytes[i]); break;
         case 0x0400003F: m_bg3.WriteBGY_H_B1(bytes[i]); break;
 
-        case 0x04000040: Window::WriteWIN0H_B0(bytes[i]); break;
-        case 0x04000041: Window::WriteWIN0H_B1(bytes[i]); break;
-        case 0x04000042: Window::WriteWIN1H_B0(bytes[i]); break;
-        case 0x04000043: Window::WriteWIN1H_B1(bytes[i]); break;
-        case 0x04000044: Window::WriteWIN0V_B0(bytes[i]); break;
-        case 0x04000045: Window::WriteWIN0V_B1(bytes[i]); break;
-        case 0x04000046: Window::WriteWIN1V_B0(bytes[i]); break;
-        case 0x04000047: Window::WriteWIN1V_B1(bytes[i]); break;
-
-        case 0x04000048: Window::WriteWININ_B0(bytes[i]); m_WININ.b.b0.b = bytes[i]; break;
-        case 0x04000049: Window::WriteWININ_B1(bytes[i]); m_WININ.b.b1.b = bytes[i]; break;
-        case 0x0400004A: Window::WriteWINOUT_B0(bytes[i]); m_WINOUT.b.b0.b = bytes[i]; break;
-        case 0x0400004B: Window::WriteWINOUT_B1(bytes[i]); m_WINOUT.b.b1.b = bytes[i]; break;
+        case 0x04000040: m_window.WriteWIN0H_B0(bytes[i]); break;
+        case 0x04000041: m_window.WriteWIN0H_B1(bytes[i]); break;
+        case 0x04000042: m_window.WriteWIN1H_B0(bytes[i]); break;
+        case 0x04000043: m_window.WriteWIN1H_B1(bytes[i]); break;
+        case 0x04000044: m_window.WriteWIN0V_B0(bytes[i]); break;
+        case 0x04000045: m_window.WriteWIN0V_B1(bytes[i]); break;
+        case 0x04000046: m_window.WriteWIN1V_B0(bytes[i]); break;
+        case 0x04000047: m_window.WriteWIN1V_B1(bytes[i]); break;
+
+        case 0x04000048: m_window.WriteWININ_B0(bytes[i]); m_WININ.b.b0.b = bytes[i]; break;
+        case 0x04000049: m_window.WriteWININ_B1(bytes[i]); m_WININ.b.b1.b = bytes[i]; break;
+        case 0x0400004A: m_window.WriteWINOUT_B0(bytes[i]); m_WINOUT.b.b0.b = bytes[i]; break;
+        case 0x0400004B: m_window.WriteWINOUT_B1(bytes[i]); m_WINOUT.b.b1.b = bytes[i]; break;
         
         case 0x0400004C: WriteMOSAIC_B0(bytes[i]); break;
         case 0x0400004D: WriteMOSAIC_B1(bytes[i]); break;
 
-        case 0x04000050: ColorSpecialEffect::WriteBLDCNT_B0(bytes[i]); m_BLDCNT.b.b0.b = bytes[i]; break;
-        case 0x04000051: ColorSpecialEffect::WriteBLDCNT_B1(bytes[i]); m_BLDCNT.b.b1.b = bytes[i]; break;
-        case 0x04000052: ColorSpecialEffect::WriteBLDALPHA_B0(bytes[i]); break;
-        case 0x04000053: ColorSpecialEffect::WriteBLDALPHA_B1(bytes[i]); break;
-        case 0x04000054: ColorSpecialEffect::WriteBLDY(bytes[i]); break;
+        case 0x04000050: m_cse.WriteBLDCNT_B0(bytes[i]); m_BLDCNT.b.b0.b = bytes[i]; break;
+        case 0x04000051: m_cse.WriteBLDCNT_B1(bytes[i]); m_BLDCNT.b.b1.b = bytes[i]; break;
+        case 0x04000052: m_cse.WriteBLDALPHA_B0(bytes[i]); break;
+        case 0x04000053: m_cse.WriteBLDALPHA_B1(bytes[i]); break;
+        case 0x04000054: m_cse.WriteBLDY(bytes[i]); break;
         }
     }
 }
 
-void ReadPaletteRAM(u32 address, t32 *data, gbaMemory::DataType width)
+void gbaDisplay::ReadPaletteRAM(u32 address, t32 *data, gbaMemory::DataType width)
 {
     u32 base = address & ~(width - 1) & 0x3FF;
     switch (width)
@@ -2301,7 +2411,7 @@ void ReadPaletteRAM(u32 address, t32 *data, gbaMemory::DataType width)
     }
 }
 
-void ReadVRAM(u32 address, t32 *data, gbaMemory::DataType width)
+void gbaDisplay::ReadVRAM(u32 address, t32 *data, gbaMemory::DataType width)
 {
     u32 base = address & ((address & 0x10000) != 0 ? 0x17FFF : 0xFFFF) & ~(width - 1);
     switch (width)
@@ -2316,7 +2426,7 @@ void ReadVRAM(u32 address, t32 *data, gbaMemory::DataType width)
     }
 }
 
-void ReadOAM(u32 address, t32 *data, gbaMemory::DataType width)
+void gbaDisplay::ReadOAM(u32 address, t32 *data, gbaMemory::DataType width)
 {
     u32 base = address & ~(width - 1) & 0x3FF;
     switch (width)
@@ -2331,7 +2441,27 @@ void ReadOAM(u32 address, t32 *data, gbaMemory::DataType width)
     }
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
+u8 *gbaDisplay::GetPaletteRAM()
+{
+    return m_PaletteRAM;
+}
+
+u8 *gbaDisplay::GetVRAM()
+{
+    return m_VRAM;
+}
+
+u32 *gbaDisplay::GetVRAMWriteCount()
+{
+    return m_VRAMwrites;
+}
+
+u8 *gbaDisplay::GetOAM()
+{
+    return m_OAM;
+}
+
+void gbaDisplay::ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
 {
     u8 *bytes[4] = {&data->w.w0.b.b0.b, &data->w.w0.b.b1.b, &data->w.w1.b.b0.b, &data->w.w1.b.b1.b};
     u32 base = address & ~(width - 1);
@@ -2365,4 +2495,3 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
         }
     }
 }
-}
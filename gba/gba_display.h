@@ -5,23 +5,505 @@
 //*************************************************************************************************
 
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "../types.h"
 #include "gba_memory.h"
 
 #define GBA_SCREENWIDTH  240
 #define GBA_SCREENHEIGHT 160
 
-namespace gbaDisplay
+class gbaConsole;
+
+class gbaDisplay
 {
-void Sync(s32 ticks);
-void Reset();
-void WritePaletteRAM(u32 address, t32 const *data, gbaMemory::DataType width);
-void WriteVRAM(u32 address, t32 const *data, gbaMemory::DataType width);
-void WriteOAM(u32 address, t32 const *data, gbaMemory::DataType width);
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadPaletteRAM(u32 address, t32 *data, gbaMemory::DataType width);
-void ReadVRAM(u32 address, t32 *data, gbaMemory::DataType width);
-void ReadOAM(u32 address, t32 *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-s32 GetNextEvent();
-}
+public:
+    gbaDisplay(gbaConsole *console);
+    ~gbaDisplay();
+
+    void Reset();
+    void Release();
+    void EnableSIMD(bool enable);
+    void EnableBatchRendering(bool enable);
+    void EnableRenderThread(bool enable);
+    void SetFrameSkip(u32 frames);
+    bool IsDeferringLines() const;
+    void WritePaletteRAM(u32 address, t32 const *data, gbaMemory::DataType width);
+    void WriteVRAM(u32 address, t32 const *data, gbaMemory::DataType width);
+    void WriteOAM(u32 address, t32 const *data, gbaMemory::DataType width);
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadPaletteRAM(u32 address, t32 *data, gbaMemory::DataType width);
+    void ReadVRAM(u32 address, t32 *data, gbaMemory::DataType width);
+    void ReadOAM(u32 address, t32 *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
+    u8 *GetPaletteRAM();
+    u8 *GetVRAM();
+    u32 *GetVRAMWriteCount();
+    u8 *GetOAM();
+
+private:
+    static const u32 m_screenwidth  = GBA_SCREENWIDTH;
+    static const u32 m_screenheight = GBA_SCREENHEIGHT;
+    static const u32 m_VRAMsize     = 0x18000;
+
+    class Palette
+    {
+    private:
+        u16 const *m_bgpalette;
+        u16 const *m_objpalette;
+
+    public:
+        Palette(gbaDisplay *display);
+        u16 GetBackdropColor() const;
+        u16 GetBGColor16x16(u32 palette, u32 color) const;
+        u16 GetOBJColor16x16(u32 palette, u32 color) const;
+        u16 GetBGColor256x1(u32 index) const;
+        u16 GetOBJColor256x1(u32 index) const;
+    };
+
+    class TileCache
+    {
+    private:
+        static const u32 m_count16  = m_VRAMsize / 32;
+        static const u32 m_count256 = m_VRAMsize / 64;
+
+        gbaDisplay *m_display;
+        u8  m_tile16[m_count16][2][64];
+        u8  m_tile256[m_count256][2][64];
+        u32 m_stamp16[m_count16];
+        u32 m_stamp256[m_count256];
+        u8  m_blank[64];
+
+    public:
+        TileCache(gbaDisplay *display);
+        void Reset();
+        u8 const *GetTile16(u32 address, bool hflip);
+        u8 const *GetTile256(u32 address, bool hflip);
+    };
+
+    class OBJ
+    {
+    private:
+        static const u32 m_dimension[3][4][2];
+
+        gbaDisplay *m_display;
+        u16 m_line[m_screenwidth];
+        u16 m_attr[m_screenwidth];
+        u16 m_objw[m_screenwidth];
+        u32 m_hmosaic;
+        u32 m_vmosaic;
+        u16 m_objwflags;
+        u16 m_outwflags;
+
+        u8 const *GetTileRow(u32 chr, bool use256x1, bool onedimensional, u32 hsize, u32 row, u32 col, bool hflip);
+        void WriteDot(u32 dot, u32 mode, u32 color, u16 pixel, u16 attr);
+
+    public:
+        OBJ(gbaDisplay *display);
+        void Reset();
+        void SetMosaic(u32 h, u32 v);
+        void SetOBJWindowFlags(u16 objwflags);
+        void SetOutsideWindowFlags(u16 outwflags);
+        void RenderLine();
+        void GetLine(u16 const *&line, u16 const *&attr);
+        void GetWindowLine(u16 *&objw);
+    };
+
+    class WindowRectangular
+    {
+    private:
+        gbaDisplay *m_display;
+        t16  m_WINH;
+        t16  m_WINV;
+        u32  m_x1;
+        u32  m_x2;
+        u32  m_y1;
+        u32  m_y2;
+        bool m_invertx;
+        bool m_inverty;
+        u16  m_flags;
+
+        void UpdateCoordinates();
+
+    public:
+        WindowRectangular(gbaDisplay *display);
+        void Reset();
+        void RenderLine(u16 *target);
+        void SetFlags(u16 flags);
+        void WriteWINH_B0(u8 byte);
+        void WriteWINH_B1(u8 byte);
+        void WriteWINV_B0(u8 byte);
+        void WriteWINV_B1(u8 byte);
+    };
+
+    class Window
+    {
+    private:
+        gbaDisplay *m_display;
+        WindowRectangular m_win0;
+        WindowRectangular m_win1;
+
+        t16 m_WININ;
+        t16 m_WINOUT;
+        u16 m_outwflags;
+        u16 m_objwflags;
+        u16 m_win1flags;
+        u16 m_win0flags;
+
+        void ProcessFlags(u16 &flags, u8 byte);
+
+    public:
+        Window(gbaDisplay *display);
+        void Reset();
+        void RenderLine(u16 *target);
+        void WriteWIN0H_B0(u8 byte);
+        void WriteWIN0H_B1(u8 byte);
+        void WriteWIN1H_B0(u8 byte);
+        void WriteWIN1H_B1(u8 byte);
+        void WriteWIN0V_B0(u8 byte);
+        void WriteWIN0V_B1(u8 byte);
+        void WriteWIN1V_B0(u8 byte);
+        void WriteWIN1V_B1(u8 byte);
+        void WriteWININ_B0(u8 byte);
+        void WriteWININ_B1(u8 byte);
+        void WriteWINOUT_B0(u8 byte);
+        void WriteWINOUT_B1(u8 byte);
+        u8 ReadWININ_B0();
+        u8 ReadWININ_B1();
+        u8 ReadWINOUT_B0();
+        u8 ReadWINOUT_B1();
+    };
+
+    class ColorSpecialEffect
+    {
+    private:
+        static const u16 m_1stflags[4];
+
+        t16  m_BLDCNT;
+        t16  m_BLDALPHA;
+        t8   m_BLDY;
+        u32  m_cse;
+        u32  m_evanum;
+        u32  m_evbnum;
+        u32  m_evynum;
+        u16  m_bgflags[4];
+        u16  m_objflags;
+        u16  m_bdflags;
+        bool m_swapgreen;
+
+        void UnpackColor(u16 color, u32 &red, u32 &green, u32 &blue);
+        u16 PackColor(u32 red, u32 green, u32 blue);
+        u16 AlphaBlend(u16 color1st, u16 color2nd);
+        u16 BrightnessIncrease(u16 color1st);
+        u16 BrightnessDecrease(u16 color1st);
+        void GreenSwap(u16 *target);
+        void BlendLineScalar(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd);
+        void BlendLineSSE2(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd);
+        void (ColorSpecialEffect::*BlendLine)(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd);
+
+    public:
+        void Reset();
+        void Blend(u16 *target, u16 const *line1st, u16 const *attr1st, u16 const *line2nd, u16 const *attr2nd);
+        void SetSIMD(bool enable);
+        void SetGreenSwap(bool swapgreen);
+        u16 GetBGFlags(u32 bg);
+        u16 GetOBJFlags();
+        u16 GetBackdropFlags();
+        void UpdateFlags();
+        void WriteBLDCNT_B0(u8 byte);
+        void WriteBLDCNT_B1(u8 byte);
+        void WriteBLDALPHA_B0(u8 byte);
+        void WriteBLDALPHA_B1(u8 byte);
+        void WriteBLDY(u8 byte);
+        u8 ReadBLDCNT_B0();
+        u8 ReadBLDCNT_B1();
+    };
+
+    class BGText
+    {
+    private:
+        gbaDisplay *m_display;
+        u16  m_line[m_screenwidth];
+        u16  m_attr[m_screenwidth];
+        t16  m_BGHOFS;
+        t16  m_BGVOFS;
+        u32  m_tilebase;
+        u8  *m_mapbase;
+        bool m_use256x1;
+        u32  m_hmask;
+        u32  m_vmask;
+        bool m_usemosaic;
+        u32  m_hmosaic;
+        u32  m_vmosaic;
+
+    public:
+        BGText(gbaDisplay *display);
+        void Reset();
+        void SetMosaic(u32 h, u32 v);
+        void RenderLine();
+        void GetLine(u16 const *&line, u16 const *&attr);
+        void WriteBGCNT_B0(u8 byte);
+        void WriteBGCNT_B1(u8 byte);
+        void WriteBGHOFS_B0(u8 byte);
+        void WriteBGHOFS_B1(u8 byte);
+        void WriteBGVOFS_B0(u8 byte);
+        void WriteBGVOFS_B1(u8 byte);
+    };
+
+    class BGReferencePoint
+    {
+    protected:
+        u16  m_line[m_screenwidth];
+        u16  m_attr[m_screenwidth];
+        t32  m_BGX;
+        t32  m_BGY;
+        t16  m_BGPA;
+        t16  m_BGPB;
+        t16  m_BGPC;
+        t16  m_BGPD;
+        bool m_wrap;
+        u32  m_X;
+        u32  m_Y;
+        u32  m_dx;
+        u32  m_dmx;
+        u32  m_dy;
+        u32  m_dmy;
+        bool m_usemosaic;
+        u32  m_hmosaic;
+        u32  m_vmosaic;
+
+        void UpdateBGX();
+        void UpdateBGY();
+        void UpdatePA();
+        void UpdatePB();
+        void UpdatePC();
+        void UpdatePD();
+
+    public:
+        void Reset();
+        void SetMosaic(u32 h, u32 v);
+        void GetLine(u16 const *&line, u16 const *&attr);
+        void OnLeaveVblank();
+        void WriteBGCNT_B0(u8 byte);
+        void WriteBGCNT_B1(u8 byte);
+        void WriteBGX_L_B0(u8 byte);
+        void WriteBGX_L_B1(u8 byte);
+        void WriteBGX_H_B0(u8 byte);
+        void WriteBGX_H_B1(u8 byte);
+        void WriteBGY_L_B0(u8 byte);
+        void WriteBGY_L_B1(u8 byte);
+        void WriteBGY_H_B0(u8 byte);
+        void WriteBGY_H_B1(u8 byte);
+        void WriteBGPA_B0(u8 byte);
+        void WriteBGPA_B1(u8 byte);
+        void WriteBGPB_B0(u8 byte);
+        void WriteBGPB_B1(u8 byte);
+        void WriteBGPC_B0(u8 byte);
+        void WriteBGPC_B1(u8 byte);
+        void WriteBGPD_B0(u8 byte);
+        void WriteBGPD_B1(u8 byte);
+    };
+
+    class BGRotationAndScaling : public BGReferencePoint
+    {
+    protected:
+        gbaDisplay *m_display;
+
+    private:
+        u8  *m_mapbase;
+        u8  *m_tilebase;
+        u32  m_length;
+        u32  m_mask;
+        u32  m_rowshift;
+
+    public:
+        BGRotationAndScaling(gbaDisplay *display);
+        void Reset();
+        void RenderLine();
+        void WriteBGCNT_B0(u8 byte);
+        void WriteBGCNT_B1(u8 byte);
+    };
+
+    class BGBitmap : public BGRotationAndScaling
+    {
+    private:
+        u32 m_offset;
+
+        void RenderLine(u32 offset, u32 vmax, u32 hmax, bool use256x1);
+
+    public:
+        BGBitmap(gbaDisplay *display);
+        void Reset();
+        void RenderLineMode3();
+        void RenderLineMode4();
+        void RenderLineMode5();
+        void SetFrame(u32 frame);
+    };
+
+    class BGOrder
+    {
+    private:
+        u32 m_bgorder[2][4];
+
+    public:
+        void Reset();
+        void NotifyPrioritySet(u32 bg, u32 priority);
+        u32 const *GetBGOrder() const;
+    };
+
+    class BGControl
+    {
+    private:
+        BGOrder *m_order;
+        t16  m_BGCNT;
+        u32  m_priority;
+        u32  m_bgnumber;
+
+    public:
+        BGControl(BGOrder *order, u32 bgnumber);
+        void Reset();
+        u32 GetPriority();
+        void WriteBGCNT_B0(u8 byte);
+        void WriteBGCNT_B1(u8 byte);
+        u8 ReadBGCNT_B0();
+        u8 ReadBGCNT_B1();
+    };
+
+    class BG0 : public BGControl, public BGText {public: BG0(gbaDisplay *display);};
+    class BG1 : public BGControl, public BGText {public: BG1(gbaDisplay *display);};
+    class BG2 : public BGControl, public BGText, public BGBitmap {public: BG2(gbaDisplay *display);};
+    class BG3 : public BGControl, public BGText, public BGRotationAndScaling {public: BG3(gbaDisplay *display);};
+
+    class Painter
+    {
+    private:
+        gbaDisplay *m_display;
+        u16  m_linebuffer[2][m_screenwidth];
+        u16  m_attrbuffer[2][m_screenwidth];
+        u16 *m_winx;
+        void (Painter::*RenderLineBG)();
+
+        void WriteBackRow(u32 dot, u16 color, u16 attr);
+        void WriteFrontRow(u32 dot, u16 color, u16 attr);
+        void FillBackdropScalar(u16 color, u16 attr);
+        void WriteBGFrontScalar(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx);
+        void WriteOBJScalar(u16 const *line, u16 const *attr, u16 xattr);
+        void MaskCSEScalar();
+        void FillBackdropSSE2(u16 color, u16 attr);
+        void WriteBGFrontSSE2(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx);
+        void WriteOBJSSE2(u16 const *line, u16 const *attr, u16 xattr);
+        void MaskCSESSE2();
+        void (Painter::*FillBackdrop)(u16 color, u16 attr);
+        void (Painter::*WriteBGFront)(u16 const *line, u16 const *attr, u16 xattr, u16 xwinx);
+        void (Painter::*WriteOBJ)(u16 const *line, u16 const *attr, u16 xattr);
+        void (Painter::*MaskCSE)();
+        void RenderLineBGMode0();
+        void RenderLineBGMode1();
+        void RenderLineBGMode2();
+        void RenderLineBGMode3();
+        void RenderLineBGMode4();
+        void RenderLineBGMode5();
+
+    public:
+        Painter(gbaDisplay *display);
+        void RenderLine();
+        void SetBGMode(u32 mode);
+        void SetSIMD(bool enable);
+    };
+
+    class RenderThread
+    {
+    private:
+        gbaDisplay             *m_display;
+        std::thread             m_thread;
+        std::mutex              m_mutex;
+        std::condition_variable m_wake;
+        std::atomic<bool>       m_sleeping;
+        bool                    m_exit;
+
+        void Run();
+
+    public:
+        RenderThread(gbaDisplay *display);
+        void Start();
+        void Stop();
+        void Notify();
+        void Wait();
+    };
+
+    gbaConsole *m_console;
+    s32 m_ticks;
+    s32 m_mode;
+
+    u8 m_PaletteRAM[0x400];
+    u8 m_VRAM[m_VRAMsize];
+    u8 m_OAM[0x400];
+    u32 m_VRAMwrites[m_VRAMsize >> 8]; // Escrituras por bloque de 256 bytes, invalidan el cache de tiles
+    bool m_simd; // Composicion de la linea con SSE2 cuando esta disponible
+    bool m_batch; // Dibujo de las lineas en lotes, hasta la siguiente escritura que cambie la imagen
+    bool m_renderthread; // Dibujo de los lotes en otro hilo, mientras el CPU sigue con las lineas siguientes
+    bool m_threaded;
+    u32 m_frameskip; // Se dibuja 1 de cada m_frameskip cuadros, ninguno con 0
+    u32 m_framephase;
+    bool m_drawframe;    // El cuadro actual se dibuja, los demas solo mantienen los eventos y el estado visible
+    bool m_deferring;    // Lineas pendientes en el cuadro, la paleta, VRAM y OAM se escriben por gbaDisplay
+    std::atomic<u32> m_renderline; // Linea que se dibuja, va detras de VCOUNT cuando se dibuja en lotes
+    std::atomic<u32> m_readylines; // Lineas que ya pasaron su HBlank en el cuadro
+    bool m_bitmapmode;
+    t16 m_DISPCNT;
+    t8 m_u0x04000002;
+    t16 m_DISPSTAT;
+    t8 m_VCOUNT;
+
+    u16 m_framebuffer[GBA_SCREENHEIGHT][GBA_SCREENWIDTH];
+
+    u32 m_bgmode;
+
+    t16 m_BGXCNT[4];
+    t16 m_BGXHOFS[4];
+    t16 m_BGXVOFS[4];
+    t16 m_WININ;
+    t16 m_WINOUT;
+    t16 m_MOSAIC;
+    t16 m_BLDCNT;
+
+    Palette            m_palette;
+    TileCache          m_tilecache;
+    OBJ                m_obj;
+    Window             m_window;
+    ColorSpecialEffect m_cse;
+    BGOrder            m_bgorder;
+    BG0                m_bg0;
+    BG1                m_bg1;
+    BG2                m_bg2;
+    BG3                m_bg3;
+    Painter            m_painter;
+    RenderThread       m_renderer;
+
+    static s32 SyncEvent(gbaConsole *console, s32 ticks);
+
+    u32  GetDisplayFrame() const;
+    bool IsHblankFree() const;
+    bool IsOBJModeOneDimensional() const;
+    bool IsForcedBlank() const;
+    bool IsBGEnabled(u32 bg) const;
+    bool IsOBJEnabled() const;
+    bool IsWindow0Enabled() const;
+    bool IsWindow1Enabled() const;
+    bool IsOBJWindowEnabled() const;
+    bool IsOutsideWindowEnabled() const;
+    bool IsBGModeBitmap() const;
+    void RenderPendingLines();
+    void StartFrame();
+    void CompareVCOUNT();
+    s32 Sync(s32 ticks);
+    void WriteDISPCNT_B0(u8 byte);
+    void WriteDISPCNT_B1(u8 byte);
+    void Write0x04000002(u8 byte);
+    void WriteDISPSTAT_B0(u8 byte);
+    void WriteDISPSTAT_B1(u8 byte);
+    void WriteMOSAIC_B0(u8 byte);
+    void WriteMOSAIC_B1(u8 byte);
+};
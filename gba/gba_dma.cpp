@@ -5,9 +5,9 @@
 //*************************************************************************************************
 
 #include "../emulator.h"
+#include "gba_console.h"
 #include "gba_dma.h"
 
-namespace gbaDMA {
 enum TransferTiming {
     TIMING_IMMEDIATE = 0,
     TIMING_VBLANK    = 1,
@@ -15,74 +15,8 @@ enum TransferTiming {
     TIMING_SPECIAL   = 3
 };
 
-class gbaDMAChannel {
-private:
-    gbaControl::InterruptFlag m_IRQ;
-    u32                       m_dstadrmask;
-    u32                       m_srcadrmask;
-    u32                       m_wordcountmask;
-
-    t32  m_DMAXSAD;
-    t32  m_DMAXDAD;
-    t32  m_DMAXCNT;
-    u32  m_srcadr;
-    u32  m_dstadr;    
-    u32  m_wordcount;
-    bool m_firstaccess;
-    bool m_active;
-
-    void ReloadDAD();
-    void ReloadSAD();
-    void ReloadCNT_L();
-    void ReloadOnStart();
-    void ReloadOnRepeat();    
-    void Disable();
-
-protected:
-    gbaDMAChannel(gbaControl::InterruptFlag irq, u32 dstadrmask, u32 srcadrmask, u32 wordcountmask);
-
-public:
-    void Reset();
-    void OnImmediate();
-    void OnVblank();
-    void OnHblank();
-    void OnFIFORequest(u32 fifo);
-    void OnCaptureRequest();
-    void OnCaptureEnd();
-    bool IsEnabled() const;
-    bool IsActive() const;
-    s32 GetTiming() const;
-    gbaMemory::DataType GetWidth() const;
-    bool IsFIFOMode() const;
-    bool IsCaptureMode() const;
-    s32 Transfer(s32 limit);
-    void WriteDMAXSAD_B0(u8 byte);
-    void WriteDMAXSAD_B1(u8 byte);
-    void WriteDMAXSAD_B2(u8 byte);
-    void WriteDMAXSAD_B3(u8 byte);
-    void WriteDMAXDAD_B0(u8 byte);
-    void WriteDMAXDAD_B1(u8 byte);
-    void WriteDMAXDAD_B2(u8 byte);
-    void WriteDMAXDAD_B3(u8 byte);
-    void WriteDMAXCNT_B0(u8 byte);
-    void WriteDMAXCNT_B1(u8 byte);
-    void WriteDMAXCNT_B2(u8 byte);
-    void WriteDMAXCNT_B3(u8 byte);
-    u8 ReadDMAXCNT_B2() const;
-    u8 ReadDMAXCNT_B3() const;
-};
-
-class gbaDMA0 : public gbaDMAChannel {public: gbaDMA0();};
-class gbaDMA1 : public gbaDMAChannel {public: gbaDMA1();};
-class gbaDMA2 : public gbaDMAChannel {public: gbaDMA2();};
-class gbaDMA3 : public gbaDMAChannel {public: gbaDMA3();};
-
-gbaDMA0 m_DMA0;
-gbaDMA1 m_DMA1;
-gbaDMA2 m_DMA2;
-gbaDMA3 m_DMA3;
-
-gbaDMAChannel::gbaDMAChannel(gbaControl::InterruptFlag irq, u32 dstadrmask, u32 srcadrmask, u32 wordcountmask) {
+gbaDMA::gbaDMAChannel::gbaDMAChannel(gbaConsole *console, gbaControl::InterruptFlag irq, u32 dstadrmask, u32 srcadrmask, u32 wordcountmask) {
+    m_console       = console;
     m_IRQ           = irq;
     m_dstadrmask    = dstadrmask;
     m_srcadrmask    = srcadrmask;
@@ -90,12 +24,12 @@ gbaDMAChannel::gbaDMAChannel(gbaControl::InterruptFlag irq, u32 dstadrmask, u32
     Reset();
 }
 
-gbaDMA0::gbaDMA0() : gbaDMAChannel(gbaControl::IRQ_DMA0, 0x07FFFFFF, 0x07FFFFFF, 0x3FFF) {}
-gbaDMA1::gbaDMA1() : gbaDMAChannel(gbaControl::IRQ_DMA1, 0x07FFFFFF, 0x0FFFFFFF, 0x3FFF) {}
-gbaDMA2::gbaDMA2() : gbaDMAChannel(gbaControl::IRQ_DMA2, 0x07FFFFFF, 0x0FFFFFFF, 0x3FFF) {}
-gbaDMA3::gbaDMA3() : gbaDMAChannel(gbaControl::IRQ_DMA3, 0x0FFFFFFF, 0x0FFFFFFF, 0xFFFF) {}
+gbaDMA::gbaDMA0::gbaDMA0(gbaConsole *console) : gbaDMAChannel(console, gbaControl::IRQ_DMA0, 0x07FFFFFF, 0x07FFFFFF, 0x3FFF) {}
+gbaDMA::gbaDMA1::gbaDMA1(gbaConsole *console) : gbaDMAChannel(console, gbaControl::IRQ_DMA1, 0x07FFFFFF, 0x0FFFFFFF, 0x3FFF) {}
+gbaDMA::gbaDMA2::gbaDMA2(gbaConsole *console) : gbaDMAChannel(console, gbaControl::IRQ_DMA2, 0x07FFFFFF, 0x0FFFFFFF, 0x3FFF) {}
+gbaDMA::gbaDMA3::gbaDMA3(gbaConsole *console) : gbaDMAChannel(console, gbaControl::IRQ_DMA3, 0x0FFFFFFF, 0x0FFFFFFF, 0xFFFF) {}
 
-void gbaDMAChannel::Reset() {
+void gbaDMA::gbaDMAChannel::Reset() {
     m_DMAXSAD.d   = 0;
     m_DMAXDAD.d   = 0;
     m_DMAXCNT.d   = 0;
@@ -106,121 +40,145 @@ void gbaDMAChannel::Reset() {
     m_active      = false;
 }
 
-void gbaDMAChannel::ReloadDAD() {m_dstadr = m_DMAXDAD.d & m_dstadrmask;}
-void gbaDMAChannel::ReloadSAD() {m_srcadr = m_DMAXSAD.d & m_srcadrmask;}
+void gbaDMA::gbaDMAChannel::ReloadDAD() {m_dstadr = m_DMAXDAD.d & m_dstadrmask;}
+void gbaDMA::gbaDMAChannel::ReloadSAD() {m_srcadr = m_DMAXSAD.d & m_srcadrmask;}
 
-void gbaDMAChannel::ReloadCNT_L() {
+void gbaDMA::gbaDMAChannel::ReloadCNT_L() {
     m_wordcount   = IsFIFOMode() ? 4 : ((((u32)m_DMAXCNT.w.w0.w - 1) & m_wordcountmask) + 1);
     m_firstaccess = true;
 }
 
-void gbaDMAChannel::ReloadOnStart() {
+void gbaDMA::gbaDMAChannel::ReloadOnStart() {
     ReloadDAD();
     ReloadSAD();
     ReloadCNT_L();
 }
 
-void gbaDMAChannel::ReloadOnRepeat() {
+void gbaDMA::gbaDMAChannel::ReloadOnRepeat() {
     ReloadCNT_L();
     if (SUBVAL(m_DMAXCNT.w.w1.w, 5, 3) == 3) {ReloadDAD();}
 }
 
-void gbaDMAChannel::Disable() {m_DMAXCNT.w.w1.w &= ~BIT(15);}
-
-void gbaDMAChannel::OnImmediate()           {if (GetTiming() == TIMING_IMMEDIATE)     {m_active = IsEnabled();}}
-void gbaDMAChannel::OnVblank()              {if (GetTiming() == TIMING_VBLANK)        {m_active = IsEnabled();}}
-void gbaDMAChannel::OnHblank()              {if (GetTiming() == TIMING_HBLANK)        {m_active = IsEnabled();}}
-void gbaDMAChannel::OnFIFORequest(u32 fifo) {if (IsFIFOMode() && fifo == m_DMAXDAD.d) {m_active = IsEnabled();}}
-void gbaDMAChannel::OnCaptureRequest()      {if (IsCaptureMode())                     {m_active = IsEnabled();}}
-
-void gbaDMAChannel::OnCaptureEnd() {if (IsCaptureMode()) {Disable();}}
+void gbaDMA::gbaDMAChannel::Disable() {m_DMAXCNT.w.w1.w &= ~BIT(15);}
+
+void gbaDMA::gbaDMAChannel::OnImmediate()           {if (GetTiming() == TIMING_IMMEDIATE)     {m_active = IsEnabled();}}
+void gbaDMA::gbaDMAChannel::OnVblank()              {if (GetTiming() == TIMING_VBLANK)        {m_active = IsEnabled();}}
+void gbaDMA::gbaDMAChannel::OnHblank()              {if (GetTiming() == TIMING_HBLANK)        {m_active = IsEnabled();}}
+void gbaDMA::gbaDMAChannel::OnFIFORequest(u32 fifo) {if (IsFIFOMode() && fifo == m_DMAXDAD.d) {m_active = IsEnabled();}}
+void gbaDMA::gbaDMAChannel::OnCaptureRequest()      {if (IsCaptureMode())                     {m_active = IsEnabled();}}
+
+void gbaDMA::gbaDMAChannel::OnCaptureEnd() {if (IsCaptureMode()) {Disable();}}
+
+bool gbaDMA::gbaDMAChannel::IsEnabled() const {return BITTEST(m_DMAXCNT.w.w1.w, 15);}
+bool gbaDMA::gbaDMAChannel::IsActive() const {return m_active;}
+s32 gbaDMA::gbaDMAChannel::GetTiming() const {return SUBVAL(m_DMAXCNT.w.w1.w, 12, 3);}
+gbaMemory::DataType gbaDMA::gbaDMAChannel::GetWidth() const {return IsFIFOMode() || BITTEST(m_DMAXCNT.w.w1.w, 10) ? gbaMemory::TYPE_WORD : gbaMemory::TYPE_HALFWORD;}
+bool gbaDMA::gbaDMAChannel::IsFIFOMode() const {return (m_IRQ == gbaControl::IRQ_DMA1 || m_IRQ == gbaControl::IRQ_DMA2) && GetTiming() == TIMING_SPECIAL;}
+bool gbaDMA::gbaDMAChannel::IsCaptureMode() const {return m_IRQ == gbaControl::IRQ_DMA3 && GetTiming() == TIMING_SPECIAL;}
+
+s32 gbaDMA::gbaDMAChannel::GetSourceStep() const {
+    s32 width = GetWidth();
+    switch (SUBVAL(m_DMAXCNT.w.w1.w, 7, 3)) {
+    case 0:  return  width;
+    case 1:  return -width;
+    default: return  0;
+    }
+}
 
-bool gbaDMAChannel::IsEnabled() const {return BITTEST(m_DMAXCNT.w.w1.w, 15);}
-bool gbaDMAChannel::IsActive() const {return m_active;}
-s32 gbaDMAChannel::GetTiming() const {return SUBVAL(m_DMAXCNT.w.w1.w, 12, 3);}
-gbaMemory::DataType gbaDMAChannel::GetWidth() const {return IsFIFOMode() || BITTEST(m_DMAXCNT.w.w1.w, 10) ? gbaMemory::TYPE_WORD : gbaMemory::TYPE_HALFWORD;}
-bool gbaDMAChannel::IsFIFOMode() const {return (m_IRQ == gbaControl::IRQ_DMA1 || m_IRQ == gbaControl::IRQ_DMA2) && GetTiming() == TIMING_SPECIAL;}
-bool gbaDMAChannel::IsCaptureMode() const {return m_IRQ == gbaControl::IRQ_DMA3 && GetTiming() == TIMING_SPECIAL;}
+s32 gbaDMA::gbaDMAChannel::GetDestinationStep() const {
+    s32 width = GetWidth();
+    if (IsFIFOMode()) {return 0;}
+    switch (SUBVAL(m_DMAXCNT.w.w1.w, 5, 3)) {
+    case 1:  return -width;
+    case 2:  return  0;
+    default: return  width;
+    }
+}
 
-s32 gbaDMAChannel::Transfer(s32 limit) {
+s32 gbaDMA::gbaDMAChannel::Transfer(s32 limit) {
     gbaMemory::DataType width;
-    s32 NR, SR, NW, SW, ret;
-    t32 data;
+    s32 NR, SR, NW, SW, ret, srcstep, dststep, cycles;
+    u32 units;
 
     if (m_wordcount == 0) {ReloadOnRepeat();}
 
-    ret = 0;
+    ret     = 0;
+    width   = GetWidth();
+    srcstep = GetSourceStep();
+    dststep = GetDestinationStep();
 
     while (ret < limit && m_wordcount > 0) {
-        width = GetWidth();
+        // Despues del primer acceso las copias entre memoria simple se hacen por bloques
+        if (!m_firstaccess) {
+            units = m_console->memory.CopyBlock(m_dstadr, m_srcadr, dststep, srcstep, width, m_wordcount, limit - ret, &cycles);
+            if (units > 0) {
+                ret         += cycles;
+                m_srcadr     = (m_srcadr + (units * srcstep)) & m_srcadrmask;
+                m_dstadr     = (m_dstadr + (units * dststep)) & m_dstadrmask;
+                m_wordcount -= units;
+                continue;
+            }
+        }
 
-        gbaMemory::Read(m_srcadr, &data, width, &NR, &SR);
-        gbaMemory::Write(m_dstadr, &data, width, &NW, &SW);
+        if (width == gbaMemory::TYPE_WORD) {
+            m_console->memory.Write32(m_dstadr, m_console->memory.Read32(m_srcadr, &NR, &SR), &NW, &SW);
+        }
+        else {
+            m_console->memory.Write16(m_dstadr, m_console->memory.Read16(m_srcadr, &NR, &SR), &NW, &SW);
+        }
 
         ret += m_firstaccess ? (NR + NW) : (SR + SW);
         m_firstaccess = false;
 
-        switch (SUBVAL(m_DMAXCNT.w.w1.w, 7, 3)) {
-        case 0: m_srcadr += width; break;
-        case 1: m_srcadr -= width; break;
-        case 2:                    break;
-        }
-
-        if (!IsFIFOMode()) {
-            switch (SUBVAL(m_DMAXCNT.w.w1.w, 5, 3)) {
-            case 0:
-            case 3: m_dstadr += width; break;
-            case 1: m_dstadr -= width; break;
-            case 2:                    break;
-            }
-        }
-
-        m_srcadr &= m_srcadrmask;
-        m_dstadr &= m_dstadrmask;
+        m_srcadr = (m_srcadr + srcstep) & m_srcadrmask;
+        m_dstadr = (m_dstadr + dststep) & m_dstadrmask;
 
         --m_wordcount;
     }
 
     if (m_wordcount == 0) {
         m_active = false;
-        if (BITTEST(m_DMAXCNT.w.w1.w, 14)) {gbaControl::RequestInterrupt(m_IRQ);}
+        if (BITTEST(m_DMAXCNT.w.w1.w, 14)) {m_console->control.RequestInterrupt(m_IRQ);}
         if (!BITTEST(m_DMAXCNT.w.w1.w, 9) || GetTiming() == TIMING_IMMEDIATE) {Disable();}
     }
 
     return ret;
 }
 
-void gbaDMAChannel::WriteDMAXSAD_B0(u8 byte) {m_DMAXSAD.w.w0.b.b0.b = byte;}
-void gbaDMAChannel::WriteDMAXSAD_B1(u8 byte) {m_DMAXSAD.w.w0.b.b1.b = byte;}
-void gbaDMAChannel::WriteDMAXSAD_B2(u8 byte) {m_DMAXSAD.w.w1.b.b0.b = byte;}
-void gbaDMAChannel::WriteDMAXSAD_B3(u8 byte) {m_DMAXSAD.w.w1.b.b1.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXSAD_B0(u8 byte) {m_DMAXSAD.w.w0.b.b0.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXSAD_B1(u8 byte) {m_DMAXSAD.w.w0.b.b1.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXSAD_B2(u8 byte) {m_DMAXSAD.w.w1.b.b0.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXSAD_B3(u8 byte) {m_DMAXSAD.w.w1.b.b1.b = byte;}
 
-void gbaDMAChannel::WriteDMAXDAD_B0(u8 byte) {m_DMAXDAD.w.w0.b.b0.b = byte;}
-void gbaDMAChannel::WriteDMAXDAD_B1(u8 byte) {m_DMAXDAD.w.w0.b.b1.b = byte;}
-void gbaDMAChannel::WriteDMAXDAD_B2(u8 byte) {m_DMAXDAD.w.w1.b.b0.b = byte;}
-void gbaDMAChannel::WriteDMAXDAD_B3(u8 byte) {m_DMAXDAD.w.w1.b.b1.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXDAD_B0(u8 byte) {m_DMAXDAD.w.w0.b.b0.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXDAD_B1(u8 byte) {m_DMAXDAD.w.w0.b.b1.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXDAD_B2(u8 byte) {m_DMAXDAD.w.w1.b.b0.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXDAD_B3(u8 byte) {m_DMAXDAD.w.w1.b.b1.b = byte;}
 
-void gbaDMAChannel::WriteDMAXCNT_B0(u8 byte) {m_DMAXCNT.w.w0.b.b0.b = byte;}
-void gbaDMAChannel::WriteDMAXCNT_B1(u8 byte) {m_DMAXCNT.w.w0.b.b1.b = byte;}
-void gbaDMAChannel::WriteDMAXCNT_B2(u8 byte) {m_DMAXCNT.w.w1.b.b0.b = byte & 0xE0;}
+void gbaDMA::gbaDMAChannel::WriteDMAXCNT_B0(u8 byte) {m_DMAXCNT.w.w0.b.b0.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXCNT_B1(u8 byte) {m_DMAXCNT.w.w0.b.b1.b = byte;}
+void gbaDMA::gbaDMAChannel::WriteDMAXCNT_B2(u8 byte) {m_DMAXCNT.w.w1.b.b0.b = byte & 0xE0;}
 
-void gbaDMAChannel::WriteDMAXCNT_B3(u8 byte) {
+void gbaDMA::gbaDMAChannel::WriteDMAXCNT_B3(u8 byte) {
     bool enable = !IsEnabled() && BITTEST(byte, 7);
     m_DMAXCNT.w.w1.b.b1.b = byte & (m_IRQ != gbaControl::IRQ_DMA3 ? 0xF7 : 0xFF);
     if (enable) {ReloadOnStart(); OnImmediate();}   
 }
 
-u8 gbaDMAChannel::ReadDMAXCNT_B2() const {return m_DMAXCNT.w.w1.b.b0.b;}
-u8 gbaDMAChannel::ReadDMAXCNT_B3() const {return m_DMAXCNT.w.w1.b.b1.b;}
+u8 gbaDMA::gbaDMAChannel::ReadDMAXCNT_B2() const {return m_DMAXCNT.w.w1.b.b0.b;}
+u8 gbaDMA::gbaDMAChannel::ReadDMAXCNT_B3() const {return m_DMAXCNT.w.w1.b.b1.b;}
 
-void Reset() {
+gbaDMA::gbaDMA(gbaConsole *console) : m_DMA0(console), m_DMA1(console), m_DMA2(console), m_DMA3(console) {
+}
+
+void gbaDMA::Reset() {
     m_DMA0.Reset();
     m_DMA1.Reset();
     m_DMA2.Reset();
     m_DMA3.Reset();
 }
 
-s32 Sync(s32 limit) {
+s32 gbaDMA::Sync(s32 limit) {
          if (m_DMA0.IsActive()) {return m_DMA0.Transfer(limit);}
     else if (m_DMA1.IsActive()) {return m_DMA1.Transfer(limit);}
     else if (m_DMA2.IsActive()) {return m_DMA2.Transfer(limit);}
@@ -228,36 +186,36 @@ s32 Sync(s32 limit) {
     else                        {return 0;}
 }
 
-bool IsSyncPending() {return m_DMA0.IsActive() || m_DMA1.IsActive() || m_DMA2.IsActive() || m_DMA3.IsActive();}
+bool gbaDMA::IsSyncPending() const {return m_DMA0.IsActive() || m_DMA1.IsActive() || m_DMA2.IsActive() || m_DMA3.IsActive();}
 
-void OnVblank() {
+void gbaDMA::OnVblank() {
     m_DMA0.OnVblank();
     m_DMA1.OnVblank();
     m_DMA2.OnVblank();
     m_DMA3.OnVblank();
 }
 
-void OnHblank() {
+void gbaDMA::OnHblank() {
     m_DMA0.OnHblank();
     m_DMA1.OnHblank();
     m_DMA2.OnHblank();
     m_DMA3.OnHblank();
 }
 
-void OnFIFORequest(u32 fifo) {
+void gbaDMA::OnFIFORequest(u32 fifo) {
     m_DMA1.OnFIFORequest(fifo);
     m_DMA2.OnFIFORequest(fifo);
 }
 
-void OnCaptureRequest() {
+void gbaDMA::OnCaptureRequest() {
     m_DMA3.OnCaptureRequest();
 }
 
-void OnCaptureEnd() {
+void gbaDMA::OnCaptureEnd() {
     m_DMA3.OnCaptureEnd();
 }
 
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
+void gbaDMA::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     UNPACK_IO_BYTES(data);
     BEGIN_IO_TABLE(base, width)
@@ -312,7 +270,7 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     END_IO_TABLE()
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
+void gbaDMA::ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     UNPACK_IO_POINTERS(data);
     BEGIN_IO_TABLE(base, width)
@@ -334,5 +292,4 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
         IO_READ_CALLBACK(0x040000DF, m_DMA3.ReadDMAXCNT_B3)
     END_IO_TABLE()
 }
-}
 //*************************************************************************************************
\ No newline at end of file
@@ -7,18 +7,95 @@
 #pragma once
 
 #include "../types.h"
+#include "gba_control.h"
 #include "gba_memory.h"
 
-namespace gbaDMA {
-void Reset();
-s32 Sync(s32 limit);
-bool IsSyncPending();
-void OnVblank();
-void OnHblank();
-void OnFIFORequest(u32 fifo);
-void OnCaptureRequest();
-void OnCaptureEnd();
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-}
+class gbaConsole;
+
+class gbaDMA {
+public:
+    gbaDMA(gbaConsole *console);
+
+    void Reset();
+    s32 Sync(s32 limit);
+    bool IsSyncPending() const;
+    void OnVblank();
+    void OnHblank();
+    void OnFIFORequest(u32 fifo);
+    void OnCaptureRequest();
+    void OnCaptureEnd();
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
+
+private:
+    class gbaDMAChannel {
+    private:
+        gbaConsole               *m_console;
+        gbaControl::InterruptFlag m_IRQ;
+        u32                       m_dstadrmask;
+        u32                       m_srcadrmask;
+        u32                       m_wordcountmask;
+
+        t32  m_DMAXSAD;
+        t32  m_DMAXDAD;
+        t32  m_DMAXCNT;
+        u32  m_srcadr;
+        u32  m_dstadr;    
+        u32  m_wordcount;
+        bool m_firstaccess;
+        bool m_active;
+
+        void ReloadDAD();
+        void ReloadSAD();
+        void ReloadCNT_L();
+        void ReloadOnStart();
+        void ReloadOnRepeat();    
+        void Disable();
+
+    protected:
+        gbaDMAChannel(gbaConsole *console, gbaControl::InterruptFlag irq, u32 dstadrmask, u32 srcadrmask, u32 wordcountmask);
+
+    public:
+        void Reset();
+        void OnImmediate();
+        void OnVblank();
+        void OnHblank();
+        void OnFIFORequest(u32 fifo);
+        void OnCaptureRequest();
+        void OnCaptureEnd();
+        bool IsEnabled() const;
+        bool IsActive() const;
+        s32 GetTiming() const;
+        gbaMemory::DataType GetWidth() const;
+        bool IsFIFOMode() const;
+        bool IsCaptureMode() const;
+        s32 GetSourceStep() const;
+        s32 GetDestinationStep() const;
+        s32 Transfer(s32 limit);
+        void WriteDMAXSAD_B0(u8 byte);
+        void WriteDMAXSAD_B1(u8 byte);
+        void WriteDMAXSAD_B2(u8 byte);
+        void WriteDMAXSAD_B3(u8 byte);
+        void WriteDMAXDAD_B0(u8 byte);
+        void WriteDMAXDAD_B1(u8 byte);
+        void WriteDMAXDAD_B2(u8 byte);
+        void WriteDMAXDAD_B3(u8 byte);
+        void WriteDMAXCNT_B0(u8 byte);
+        void WriteDMAXCNT_B1(u8 byte);
+        void WriteDMAXCNT_B2(u8 byte);
+        void WriteDMAXCNT_B3(u8 byte);
+        u8 ReadDMAXCNT_B2() const;
+        u8 ReadDMAXCNT_B3() const;
+    };
+
+    class gbaDMA0 : public gbaDMAChannel {public: gbaDMA0(gbaConsole *console);};
+    class gbaDMA1 : public gbaDMAChannel {public: gbaDMA1(gbaConsole *console);};
+    class gbaDMA2 : public gbaDMAChannel {public: gbaDMA2(gbaConsole *console);};
+    class gbaDMA3 : public gbaDMAChannel {public: gbaDMA3(gbaConsole *console);};
+
+    gbaDMA0 m_DMA0;
+    gbaDMA1 m_DMA1;
+    gbaDMA2 m_DMA2;
+    gbaDMA3 m_DMA3;
+};
 //*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,201 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "../emulator.h"
+#include "gba_image.h"
+
+namespace gbaImage {
+#ifdef _WIN32
+typedef HANDLE FileHandle;
+#else
+typedef int FileHandle;
+#endif
+
+const u32 m_mapalign = 16384; // Paginas de gbaMemory, ninguna queda entre el archivo y el relleno
+
+// Una imagen se reutiliza si el archivo y los limites coinciden
+struct Entry {
+    Image       image;
+    std::string filename;
+    u64         filetime;
+    u32         minsize;
+    u32         maxsize;
+    u32         refs;
+};
+
+std::vector<Entry *> m_entries;
+std::mutex           m_mutex;
+
+void Unmap(Entry *entry) {
+    if (entry->image.map != 0) {
+#ifdef _WIN32
+        UnmapViewOfFile(entry->image.map);
+#else
+        munmap((void *)entry->image.map, entry->image.mapsize);
+#endif
+    }
+    if (entry->image.fill != 0) {delete [] entry->image.fill;}
+    delete entry;
+}
+
+bool Map(Entry *entry, u64 filesize, FileHandle file) {
+    Image *image = &entry->image;
+
+    Emulator::LogMessage("Tama\xC3\xB1o de archivo: %d bytes", (u32)filesize);
+    image->filesize = filesize > entry->maxsize ? entry->maxsize : (u32)filesize;
+    if (image->filesize != filesize) {Emulator::LogMessage("Solo se utilizaran los primeros %d bytes del archivo", image->filesize);}
+    image->size = (image->filesize & 3) != 0 ? (image->filesize + 4) & ~3 : image->filesize;
+    if (image->size < entry->minsize) {image->size = entry->minsize;}
+    image->mapsize = image->filesize & ~(m_mapalign - 1);
+
+    if (image->mapsize > 0) {
+#ifdef _WIN32
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping != 0) {
+            image->map = (u8 const *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, image->mapsize);
+            CloseHandle(mapping);
+        }
+#else
+        void *view = mmap(0, image->mapsize, PROT_READ, MAP_PRIVATE, file, 0);
+        image->map = view != MAP_FAILED ? (u8 const *)view : 0;
+#endif
+        if (image->map == 0) {
+            Emulator::LogMessage("Error al mapear el archivo (%d bytes)", image->mapsize);
+            return false;
+        }
+    }
+
+    u32 fillsize = image->size     - image->mapsize;
+    u32 tailsize = image->filesize - image->mapsize;
+    u8 *fill = new(std::nothrow) u8[fillsize];
+    if (fill == 0) {
+        Emulator::LogMessage("Error al asignar memoria para el final del archivo (%d bytes)", fillsize);
+        return false;
+    }
+    image->fill = fill;
+    memset(fill, 0xFF, fillsize);
+    u32 done = 0;
+#ifdef _WIN32
+    LARGE_INTEGER offset;
+    offset.QuadPart = image->mapsize;
+    DWORD count = 0;
+    if (SetFilePointerEx(file, offset, 0, FILE_BEGIN) && ReadFile(file, fill, tailsize, &count, 0)) {done = count;}
+#else
+    while (done < tailsize) {
+        ssize_t count = pread(file, &fill[done], tailsize - done, image->mapsize + done);
+        if (count <= 0) {break;}
+        done += (u32)count;
+    }
+#endif
+    if (done != tailsize) {
+        Emulator::LogMessage("Error al leer el archivo (%d / %d bytes)", image->mapsize + done, image->filesize);
+        return false;
+    }
+    return true;
+}
+
+Image const *Acquire(char const *filename, u32 minsize, u32 maxsize) {
+#ifdef _WIN32
+    FileHandle file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) {
+        Emulator::LogMessage("Error al abrir el archivo");
+        return 0;
+    }
+    LARGE_INTEGER size;
+    FILETIME      time;
+    GetFileSizeEx(file, &size);
+    GetFileTime(file, 0, 0, &time);
+    u64 filesize = (u64)size.QuadPart;
+    u64 filetime = ((u64)time.dwHighDateTime << 32) | time.dwLowDateTime;
+#else
+    FileHandle file = open(filename, O_RDONLY);
+    if (file < 0) {
+        Emulator::LogMessage("Error al abrir el archivo");
+        return 0;
+    }
+    struct stat filestat;
+    fstat(file, &filestat);
+    u64 filesize = (u64)filestat.st_size;
+    u64 filetime = (u64)filestat.st_mtime;
+#endif
+
+    u32 usedsize = filesize > maxsize ? maxsize : (u32)filesize;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Entry *entry = 0;
+    for (u32 i = 0; i < m_entries.size() && entry == 0; i++) {
+        Entry *e = m_entries[i];
+        if (e->filename == filename && e->filetime == filetime && e->image.filesize == usedsize && e->minsize == minsize && e->maxsize == maxsize) {entry = e;}
+    }
+
+    if (entry != 0) {
+        entry->refs++;
+        Emulator::LogMessage("Imagen compartida (%d referencias)", entry->refs);
+    }
+    else {
+        entry = new Entry();
+        entry->filename = filename;
+        entry->filetime = filetime;
+        entry->minsize  = minsize;
+        entry->maxsize  = maxsize;
+        entry->refs     = 1;
+        if (Map(entry, filesize, file)) {
+            m_entries.push_back(entry);
+        }
+        else {
+            Unmap(entry);
+            entry = 0;
+        }
+    }
+
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+    return entry != 0 ? &entry->image : 0;
+}
+
+void Release(Image const *image) {
+    if (image == 0) {return;}
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (u32 i = 0; i < m_entries.size(); i++) {
+        Entry *entry = m_entries[i];
+        if (&entry->image != image) {continue;}
+        if (--entry->refs == 0) {
+            m_entries.erase(m_entries.begin() + i);
+            Unmap(entry);
+        }
+        return;
+    }
+}
+
+// Puntero a size bytes desde base, si cruzan del archivo mapeado al relleno se copian a temp
+u8 const *GetData(Image const *image, u32 base, u32 size, u8 *temp) {
+    if (base + size <= image->mapsize) {return &image->map[base];}
+    if (base >= image->mapsize)        {return &image->fill[base - image->mapsize];}
+    if (temp == 0)                     {return 0;}
+    for (u32 i = 0; i < size; i++) {temp[i] = (base + i) < image->mapsize ? image->map[base + i] : image->fill[base + i - image->mapsize];}
+    return temp;
+}
+}
+//*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,27 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#pragma once
+
+#include "../types.h"
+
+namespace gbaImage {
+// Imagen inmutable de un archivo (ROM o BIOS), compartida por todas las instancias del proceso
+// que abren el mismo archivo sin cambios; las paginas completas se mapean del archivo y el resto
+// mas el relleno con 0xFF hasta size van en fill
+struct Image {
+    u8 const *map;
+    u8 const *fill;
+    u32       mapsize;
+    u32       size;
+    u32       filesize;
+};
+
+Image const *Acquire(char const *filename, u32 minsize, u32 maxsize);
+void Release(Image const *image);
+u8 const *GetData(Image const *image, u32 base, u32 size, u8 *temp);
+}
+//*************************************************************************************************
\ No newline at end of file
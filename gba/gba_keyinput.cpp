@@ -5,31 +5,31 @@
 //*************************************************************************************************
 
 #include "../emulator.h"
-#include "gba_control.h"
+#include "gba_console.h"
 #include "gba_keyinput.h"
 
-namespace gbaKeyInput {
-t16  m_KEYINPUT;
-t16  m_KEYCNT;
+gbaKeyInput::gbaKeyInput(gbaConsole *console) : m_console(console) {
+    Reset();
+}
 
-void Reset() {
+void gbaKeyInput::Reset() {
     m_KEYINPUT.w = BUTTON_ALL;
     m_KEYCNT.w   = 0;
 }
 
-void Sync() {
+void gbaKeyInput::Sync() {
     u16 irqbits = m_KEYCNT.w & BUTTON_ALL;
-    m_KEYINPUT.w = Emulator::ReadKeypad() & BUTTON_ALL;
-    if ((!BITTEST(m_KEYCNT.w, 14) && gbaControl::IsHalted() != gbaControl::POWERDOWN_STOP) || (irqbits == 0)) {return;}
+    m_KEYINPUT.w = Emulator::ReadKeypad(m_console) & BUTTON_ALL;
+    if ((!BITTEST(m_KEYCNT.w, 14) && m_console->control.IsHalted() != gbaControl::POWERDOWN_STOP) || (irqbits == 0)) {return;}
     u16 irqcause = ~m_KEYINPUT.w & irqbits;
     if (!BITTEST(m_KEYCNT.w, 15) ? irqcause == 0 : irqcause != irqbits) {return;}
-    gbaControl::RequestInterrupt(gbaControl::IRQ_KEYPAD);
+    m_console->control.RequestInterrupt(gbaControl::IRQ_KEYPAD);
 }
 
-void WriteKEYCNT_B0(u8 byte) {m_KEYCNT.b.b0.b = byte;}
-void WriteKEYCNT_B1(u8 byte) {m_KEYCNT.b.b1.b = byte & 0xC3;}
+void gbaKeyInput::WriteKEYCNT_B0(u8 byte) {m_KEYCNT.b.b0.b = byte;}
+void gbaKeyInput::WriteKEYCNT_B1(u8 byte) {m_KEYCNT.b.b1.b = byte & 0xC3;}
 
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
+void gbaKeyInput::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     UNPACK_IO_BYTES(data)
     BEGIN_IO_TABLE(base, width)
@@ -38,7 +38,7 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     END_IO_TABLE()
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
+void gbaKeyInput::ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     UNPACK_IO_POINTERS(data)
     BEGIN_IO_TABLE(base, width)
@@ -48,5 +48,4 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
         IO_READ_DIRECT(0x04000133, m_KEYCNT.b.b1.b)
     END_IO_TABLE()
 }
-}
 //*************************************************************************************************
\ No newline at end of file
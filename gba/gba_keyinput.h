@@ -9,24 +9,38 @@
 #include "../types.h"
 #include "gba_memory.h"
 
-namespace gbaKeyInput {
-enum KeypadButton {
-    BUTTON_A      = BIT(0),
-    BUTTON_B      = BIT(1),
-    BUTTON_SELECT = BIT(2),
-    BUTTON_START  = BIT(3),
-    BUTTON_RIGHT  = BIT(4),
-    BUTTON_LEFT   = BIT(5),
-    BUTTON_UP     = BIT(6),
-    BUTTON_DOWN   = BIT(7),
-    BUTTON_R      = BIT(8),
-    BUTTON_L      = BIT(9),
-    BUTTON_ALL    = BIT(10) - 1
-};
+class gbaConsole;
+
+class gbaKeyInput {
+public:
+    enum KeypadButton {
+        BUTTON_A      = BIT(0),
+        BUTTON_B      = BIT(1),
+        BUTTON_SELECT = BIT(2),
+        BUTTON_START  = BIT(3),
+        BUTTON_RIGHT  = BIT(4),
+        BUTTON_LEFT   = BIT(5),
+        BUTTON_UP     = BIT(6),
+        BUTTON_DOWN   = BIT(7),
+        BUTTON_R      = BIT(8),
+        BUTTON_L      = BIT(9),
+        BUTTON_ALL    = BIT(10) - 1
+    };
+
+    gbaKeyInput(gbaConsole *console);
+
+    void Reset();
+    void Sync();
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
 
-void Reset();
-void Sync();
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-}
+private:
+    gbaConsole *m_console;
+
+    t16  m_KEYINPUT;
+    t16  m_KEYCNT;
+
+    void WriteKEYCNT_B0(u8 byte);
+    void WriteKEYCNT_B1(u8 byte);
+};
 //*************************************************************************************************
\ No newline at end of file
@@ -6,28 +6,128 @@
 
 #include <cstring>
 #include "../emulator.h"
-#include "gba_cpu.h"
-#include "gba_control.h"
-#include "gba_bios.h"
-#include "gba_cartridge.h"
-#include "gba_display.h"
-#include "gba_sound.h"
-#include "gba_dma.h"
-#include "gba_timer.h"
-#include "gba_sio.h"
-#include "gba_keyinput.h"
+#include "gba_console.h"
 #include "gba_memory.h"
 
-namespace gbaMemory {
-u8 m_WRAM256K[0x40000];
-u8 m_WRAM32K[0x8000];
+const u32 m_readonlywrites = 0;
 
-void Reset() {
+gbaMemory::gbaMemory(gbaConsole *console) : m_console(console) {
+}
+
+void gbaMemory::SetPage(u32 address, u8 const *read, u8 *write, u32 mask, u32 *writes, bool bytewrite) {
+    u32         page   = address >> m_pageshift;
+    PageAccess *access = &m_pageaccess[page];
+    DataType    width[3] = {TYPE_BYTE, TYPE_HALFWORD, TYPE_WORD};
+    s32         N;
+    s32         S;
+
+    m_readpage[page]  = read;
+    m_writepage[page] = write;
+
+    access->mask      = mask;
+    access->writes    = writes;
+    access->rom       = SUBVAL(address, 24, 0xFF) >= 0x08;
+    access->prefetch  = access->rom && m_console->control.IsGamePakPrefetchEnabled();
+    access->bytewrite = bytewrite;
+
+    for (u32 i = 0; i < 3; i++) {
+        m_console->control.GetRegionWait(address, width[i], &N, &S);
+        access->N[i] = (u8)N;
+        access->S[i] = (u8)S;
+    }
+}
+
+void gbaMemory::UpdatePageTable() {
+    u8  *palette    = m_console->display.GetPaletteRAM();
+    u8  *vram       = m_console->display.GetVRAM();
+    u32 *vramwrites = m_console->display.GetVRAMWriteCount();
+    u8  *oam        = m_console->display.GetOAM();
+
+    memset(m_readpage,  0, sizeof(m_readpage));
+    memset(m_writepage, 0, sizeof(m_writepage));
+
+    SetPage(0x00000000, m_console->bios.GetMemory(), 0, m_pagesize - 1, 0, false);
+
+    if (m_console->control.IsWRAMEnabled()) {
+        for (u32 address = 0x02000000; address < 0x04000000; address += m_pagesize) {
+            u32  base;
+            u8  *memory;
+            u32 *writes;
+            if (address < 0x03000000 && m_console->control.IsWRAM256KEnabled()) {
+                base   = address & (sizeof(m_WRAM256K) - 1);
+                memory = &m_WRAM256K[base];
+                writes = &m_WRAM256Kwrites[base >> 8];
+            }
+            else {
+                base   = address & (sizeof(m_WRAM32K) - 1);
+                memory = &m_WRAM32K[base];
+                writes = &m_WRAM32Kwrites[base >> 8];
+            }
+            SetPage(address, memory, memory, m_pagesize - 1, writes, true);
+        }
+    }
+
+    for (u32 address = 0x05000000; address < 0x06000000; address += m_pagesize) {SetPage(address, palette, palette, 0x3FF, 0, false);}
+
+    for (u32 address = 0x06000000; address < 0x07000000; address += m_pagesize) {
+        u32 base = address & ((address & 0x10000) != 0 ? 0x17FFF : 0xFFFF);
+        SetPage(address, &vram[base], &vram[base], m_pagesize - 1, &vramwrites[base >> 8], false);
+    }
+
+    for (u32 address = 0x07000000; address < 0x08000000; address += m_pagesize) {SetPage(address, oam, oam, 0x3FF, 0, true);}
+
+    for (u32 address = 0x08000000; address < 0x0E000000; address += m_pagesize) {
+        u8 const *memory = m_console->cartridge.GetROMPage(address, m_pagesize);
+        if (memory != 0) {SetPage(address, memory, 0, m_pagesize - 1, 0, false);}
+    }
+
+    UpdateDisplayPages();
+}
+
+// Mientras gbaDisplay tenga lineas pendientes, la paleta, VRAM y OAM se escriben por WriteRegion para
+// que esas lineas se dibujen antes de cada cambio
+void gbaMemory::UpdateDisplayPages() {
+    bool direct = !m_console->display.IsDeferringLines();
+    for (u32 page = 0x05000000 >> m_pageshift; page < (0x08000000 >> m_pageshift); page++) {
+        m_writepage[page] = direct ? (u8 *)m_readpage[page] : 0;
+    }
+}
+
+void gbaMemory::Reset() {
     memset(m_WRAM256K, 0, sizeof(m_WRAM256K));
     memset(m_WRAM32K,  0, sizeof(m_WRAM32K));
+    m_sideeffects = 0;
+    UpdatePageTable();
+}
+
+u32 gbaMemory::GetSideEffectCount() const {
+    return m_sideeffects;
+}
+
+u32 const *gbaMemory::GetPageWriteCount(u32 address) const {
+    switch (SUBVAL(address, 24, 0xFF)) {
+    case 0x00:
+        return (address < 0x4000) ? &m_readonlywrites : 0;
+    case 0x02:
+        if (!m_console->control.IsWRAMEnabled())     {return 0;}
+        if (!m_console->control.IsWRAM256KEnabled()) {goto _PAGE_WRAM32K;}
+        return &m_WRAM256Kwrites[(address & (sizeof(m_WRAM256K) - 1)) >> 8];
+    case 0x03:
+        if (!m_console->control.IsWRAMEnabled())     {return 0;}
+_PAGE_WRAM32K:
+        return &m_WRAM32Kwrites[(address & (sizeof(m_WRAM32K) - 1)) >> 8];
+    case 0x08:
+    case 0x09:
+    case 0x0A:
+    case 0x0B:
+    case 0x0C:
+        return (address >= 0x080000C4 && address < 0x080000CA) ? 0 : &m_readonlywrites;
+    default:
+        return 0;
+    }
 }
 
-void Write(u32 address, t32 const *data, DataType width, s32 *N_access, s32 *S_access) {
+void gbaMemory::WriteRegion(u32 address, t32 const *data, DataType width, s32 *N_access, s32 *S_access) {
     u32 base = ALIGN(address, width);
 
     switch (SUBVAL(base, 24, 0xFF)) {
@@ -37,40 +137,42 @@ _WRITE_READONLY:
         *N_access = *S_access = 1;
         break;
     case 0x02:
-        if (!gbaControl::IsWRAMEnabled())     {goto _WRITE_READONLY;}
-        if (!gbaControl::IsWRAM256KEnabled()) {goto _WRITE_WRAM32K;}
+        if (!m_console->control.IsWRAMEnabled())     {goto _WRITE_READONLY;}
+        if (!m_console->control.IsWRAM256KEnabled()) {goto _WRITE_WRAM32K;}
         base &= sizeof(m_WRAM256K) - 1;
         WRITE(m_WRAM256K, base, data, width);
-        gbaControl::GetWRAM256KRegionWait(width, N_access, S_access);
+        m_WRAM256Kwrites[base >> 8]++;
+        m_console->control.GetWRAM256KRegionWait(width, N_access, S_access);
         break;
     case 0x03:
-        if (!gbaControl::IsWRAMEnabled())     {goto _WRITE_READONLY;}
+        if (!m_console->control.IsWRAMEnabled())     {goto _WRITE_READONLY;}
 _WRITE_WRAM32K:
         base &= sizeof(m_WRAM32K) - 1;
         WRITE(m_WRAM32K, base, data, width);
+        m_WRAM32Kwrites[base >> 8]++;
         *N_access = *S_access = 1;
         break;
     case 0x04:
-             if (base < 0x04000060) {gbaDisplay::WriteIO(base, data, width);}
-        else if (base < 0x040000B0) {gbaSound::WriteIO(base, data, width);}
-        else if (base < 0x04000100) {gbaDMA::WriteIO(base, data, width);}
-        else if (base < 0x04000120) {gbaTimer::WriteIO(base, data, width);}
-        else if (base < 0x04000130) {gbaSIO::WriteIO(base, data, width);}
-        else if (base < 0x04000134) {gbaKeyInput::WriteIO(base, data, width);}
-        else if (base < 0x04000200) {gbaSIO::WriteIO(base, data, width);}
-        else                        {gbaControl::WriteIO(base, data, width);}
+             if (base < 0x04000060) {m_console->display.WriteIO(base, data, width);}
+        else if (base < 0x040000B0) {m_console->sound.WriteIO(base, data, width);}
+        else if (base < 0x04000100) {m_console->dma.WriteIO(base, data, width);}
+        else if (base < 0x04000120) {m_console->timer.WriteIO(base, data, width);}
+        else if (base < 0x04000130) {m_console->sio.WriteIO(base, data, width);}
+        else if (base < 0x04000134) {m_console->keyinput.WriteIO(base, data, width);}
+        else if (base < 0x04000200) {m_console->sio.WriteIO(base, data, width);}
+        else                        {m_console->control.WriteIO(base, data, width);}
         *N_access = *S_access = 1;
         break;
     case 0x05:
-        gbaDisplay::WritePaletteRAM(base, data, width);
+        m_console->display.WritePaletteRAM(base, data, width);
         *N_access = *S_access = (width >> 2) + 1;
         break;
     case 0x06:
-        gbaDisplay::WriteVRAM(base, data, width);
+        m_console->display.WriteVRAM(base, data, width);
         *N_access = *S_access = (width >> 2) + 1;
         break;
     case 0x07:
-        gbaDisplay::WriteOAM(base, data, width);
+        m_console->display.WriteOAM(base, data, width);
         *N_access = *S_access = 1;
         break;
     case 0x08:
@@ -79,23 +181,23 @@ _WRITE_WRAM32K:
     case 0x0B:
     case 0x0C:
     case 0x0D:
-        gbaCartridge::WriteROMRegion(base, data, width);
-        gbaControl::GetROMRegionWait(base, width, N_access, S_access);
+        m_console->cartridge.WriteROMRegion(base, data, width);
+        m_console->control.GetROMRegionWait(base, width, N_access, S_access);
         break;
     case 0x0E:
     case 0x0F:
-        gbaCartridge::WriteSRAMRegion(address, (data->d >> ((address & (width - 1)) << 3)) & 0xFF);
-        gbaControl::GetSRAMRegionWait(N_access, S_access);
+        m_console->cartridge.WriteSRAMRegion(address, (data->d >> ((address & (width - 1)) << 3)) & 0xFF);
+        m_console->control.GetSRAMRegionWait(N_access, S_access);
         break;
     default: 
         goto _WRITE_READONLY;
     }
 }
 
-void ReadCPUPrefetch(u32 address, t32 *data, DataType width) {
+void gbaMemory::ReadCPUPrefetch(u32 address, t32 *data, DataType width) {
     t32 prefetch;
 
-    prefetch.d = gbaCPU::GetPrefetch();
+    prefetch.d = m_console->cpu.GetPrefetch();
 
     switch (width) {
     case TYPE_WORD:     data->d           =  prefetch.d;                                   break;
@@ -104,7 +206,7 @@ void ReadCPUPrefetch(u32 address, t32 *data, DataType width) {
     }
 }
 
-void Read(u32 address, t32 *data, DataType width, s32 *N_access, s32 *S_access) {
+void gbaMemory::ReadRegion(u32 address, t32 *data, DataType width, bool fetch, s32 *N_access, s32 *S_access) {
     u32 base = ALIGN(address, width);
     u8  byte;
 
@@ -113,7 +215,7 @@ void Read(u32 address, t32 *data, DataType width, s32 *N_access, s32 *S_access)
     switch (SUBVAL(base, 24, 0xFF)) {
     case 0x00:
         ReadCPUPrefetch(base, data, width);
-        gbaBIOS::Read(base, data, width);
+        m_console->bios.Read(base, data, width);
         *N_access = *S_access = 1;
         break;
     case 0x01:
@@ -122,14 +224,14 @@ _READ_PREFETCH:
         *N_access = *S_access = 1;
         break;
     case 0x02:
-        if (!gbaControl::IsWRAMEnabled())     {goto _READ_PREFETCH;}
-        if (!gbaControl::IsWRAM256KEnabled()) {goto _READ_WRAM32K;}
+        if (!m_console->control.IsWRAMEnabled())     {goto _READ_PREFETCH;}
+        if (!m_console->control.IsWRAM256KEnabled()) {goto _READ_WRAM32K;}
         base &= sizeof(m_WRAM256K) - 1;
         READ(m_WRAM256K, base, data, width);
-        gbaControl::GetWRAM256KRegionWait(width, N_access, S_access);
+        m_console->control.GetWRAM256KRegionWait(width, N_access, S_access);
         break;
     case 0x03:
-        if (!gbaControl::IsWRAMEnabled())     {goto _READ_PREFETCH;}
+        if (!m_console->control.IsWRAMEnabled())     {goto _READ_PREFETCH;}
 _READ_WRAM32K:
         base &= sizeof(m_WRAM32K) - 1;
         READ(m_WRAM32K, base, data, width);
@@ -137,26 +239,26 @@ _READ_WRAM32K:
         break;
     case 0x04:
         ReadCPUPrefetch(base, data, width);
-             if (base < 0x04000060) {gbaDisplay::ReadIO(base, data, width);}
-        else if (base < 0x040000B0) {gbaSound::ReadIO(base, data, width);}
-        else if (base < 0x04000100) {gbaDMA::ReadIO(base, data, width);}
-        else if (base < 0x04000120) {gbaTimer::ReadIO(base, data, width);}
-        else if (base < 0x04000130) {gbaSIO::ReadIO(base, data, width);}
-        else if (base < 0x04000134) {gbaKeyInput::ReadIO(base, data, width);}
-        else if (base < 0x04000200) {gbaSIO::ReadIO(base, data, width);}
-        else                        {gbaControl::ReadIO(base, data, width);}
+             if (base < 0x04000060) {m_console->display.ReadIO(base, data, width);}
+        else if (base < 0x040000B0) {m_console->sound.ReadIO(base, data, width);}
+        else if (base < 0x04000100) {m_console->dma.ReadIO(base, data, width);}
+        else if (base < 0x04000120) {m_console->timer.ReadIO(base, data, width);}
+        else if (base < 0x04000130) {m_console->sio.ReadIO(base, data, width);}
+        else if (base < 0x04000134) {m_console->keyinput.ReadIO(base, data, width);}
+        else if (base < 0x04000200) {m_console->sio.ReadIO(base, data, width);}
+        else                        {m_console->control.ReadIO(base, data, width);}
         *N_access = *S_access = 1;
         break;
     case 0x05:
-        gbaDisplay::ReadPaletteRAM(base, data, width);
+        m_console->display.ReadPaletteRAM(base, data, width);
         *N_access = *S_access = (width >> 2) + 1;
         break;
     case 0x06:
-        gbaDisplay::ReadVRAM(base, data, width);
+        m_console->display.ReadVRAM(base, data, width);
         *N_access = *S_access = (width >> 2) + 1;
         break;
     case 0x07:
-        gbaDisplay::ReadOAM(base, data, width);
+        m_console->display.ReadOAM(base, data, width);
         *N_access = *S_access = 1;
         break;
     case 0x08:
@@ -165,28 +267,171 @@ _READ_WRAM32K:
     case 0x0B:
     case 0x0C:
     case 0x0D:
-        gbaCartridge::ReadROMRegion(base, data, width);
-        if (gbaControl::IsGamePakPrefetchEnabled() && gbaCPU::IsOpcodeFetch(data)) {
+        m_console->cartridge.ReadROMRegion(base, data, width);
+        if (base >= 0x0D000000 || (base >= 0x080000C4 && base < 0x080000CA)) {m_sideeffects++;}
+        if (m_console->control.IsGamePakPrefetchEnabled() && fetch) {
             *N_access = *S_access = (width >> 2) + 1;
         }
         else {
-            gbaControl::GetROMRegionWait(base, width, N_access, S_access);
+            m_console->control.GetROMRegionWait(base, width, N_access, S_access);
         }
         break;
     case 0x0E:
     case 0x0F:
-        byte = gbaCartridge::ReadSRAMRegion(address);
+        byte = m_console->cartridge.ReadSRAMRegion(address);
+        m_sideeffects++;
         switch (width) {
         case TYPE_WORD:     data->w.w1.b.b1.b = byte;
                             data->w.w1.b.b0.b = byte;
         case TYPE_HALFWORD: data->w.w0.b.b1.b = byte;
         case TYPE_BYTE:     data->w.w0.b.b0.b = byte;
         }
-        gbaControl::GetSRAMRegionWait(N_access, S_access);
+        m_console->control.GetSRAMRegionWait(N_access, S_access);
         break;
     default:
         goto _READ_PREFETCH;
     }
 }
+
+// Accesos por ancho: las paginas directas se leen y escriben con una sola carga del anfitrion
+// (little endian, como el GBA), el resto pasa por ReadRegion y WriteRegion
+template <typename T, bool fetch>
+T gbaMemory::ReadValue(u32 address, s32 *N_access, s32 *S_access) {
+    u32 base  = ALIGN(address, sizeof(T));
+    u32 page  = base >> m_pageshift;
+    u32 index = sizeof(T) >> 1;
+
+    if (page < m_pagecount && m_readpage[page] != 0) {
+        PageAccess const *access = &m_pageaccess[page];
+        if (!access->rom) {
+            *N_access = access->N[index];
+            *S_access = access->S[index];
+        }
+        else if (fetch && access->prefetch) {
+            *N_access = *S_access = (sizeof(T) >> 2) + 1;
+        }
+        else {
+            *N_access = access->N[index];
+            *S_access = ((base & 0x0001FFFF) == 0) ? access->N[index] : access->S[index];
+        }
+        return *(T const *)&m_readpage[page][base & access->mask];
+    }
+
+    t32 data;
+    ReadRegion(address, &data, (DataType)sizeof(T), fetch, N_access, S_access);
+    return (T)data.d;
+}
+
+template <typename T>
+void gbaMemory::WriteValue(u32 address, T data, s32 *N_access, s32 *S_access) {
+    u32 base  = ALIGN(address, sizeof(T));
+    u32 page  = base >> m_pageshift;
+    u32 index = sizeof(T) >> 1;
+
+    m_sideeffects++;
+
+    if (page < m_pagecount && m_writepage[page] != 0 && (sizeof(T) != 1 || m_pageaccess[page].bytewrite)) {
+        PageAccess const *access = &m_pageaccess[page];
+        u32 offset = base & access->mask;
+        *(T *)&m_writepage[page][offset] = data;
+        if (access->writes != 0) {access->writes[offset >> 8]++;}
+        *N_access = access->N[index];
+        *S_access = access->S[index];
+        return;
+    }
+
+    t32 value;
+    value.d = data;
+    WriteRegion(address, &value, (DataType)sizeof(T), N_access, S_access);
+}
+
+u8  gbaMemory::Read8  (u32 address, s32 *N_access, s32 *S_access) {return ReadValue<u8,  false>(address, N_access, S_access);}
+u16 gbaMemory::Read16 (u32 address, s32 *N_access, s32 *S_access) {return ReadValue<u16, false>(address, N_access, S_access);}
+u32 gbaMemory::Read32 (u32 address, s32 *N_access, s32 *S_access) {return ReadValue<u32, false>(address, N_access, S_access);}
+u16 gbaMemory::Fetch16(u32 address, s32 *N_access, s32 *S_access) {return ReadValue<u16, true> (address, N_access, S_access);}
+u32 gbaMemory::Fetch32(u32 address, s32 *N_access, s32 *S_access) {return ReadValue<u32, true> (address, N_access, S_access);}
+
+void gbaMemory::Write8 (u32 address, u8  data, s32 *N_access, s32 *S_access) {WriteValue<u8> (address, data, N_access, S_access);}
+void gbaMemory::Write16(u32 address, u16 data, s32 *N_access, s32 *S_access) {WriteValue<u16>(address, data, N_access, S_access);}
+void gbaMemory::Write32(u32 address, u32 data, s32 *N_access, s32 *S_access) {WriteValue<u32>(address, data, N_access, S_access);}
+
+// Unidades desde address hasta el final (step > 0) o el inicio (step < 0) del bloque directo, sin
+// salir del espejo de 1 KiB de paleta y OAM
+u32 GetBlockUnits(u32 address, s32 step, u32 mask, gbaMemory::DataType width) {
+    u32 offset = address & mask;
+    if (step > 0) {return ((mask + 1) - offset) / width;}
+    if (step < 0) {return (offset / width) + 1;}
+    return 0xFFFFFFFF;
+}
+
+template <typename T>
+void CopyUnits(u8 *dst, u8 const *src, s32 dststep, s32 srcstep, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        *(T *)dst = *(T const *)src;
+        dst += dststep;
+        src += srcstep;
+    }
+}
+
+// Copia del DMA dentro de una pagina directa de origen y otra de destino, con accesos secuenciales:
+// devuelve las unidades copiadas (hasta cubrir limit ciclos) y su costo total en cycles, o 0 si
+// alguna de las dos direcciones debe ir por el camino lento
+u32 gbaMemory::CopyBlock(u32 dst, u32 src, s32 dststep, s32 srcstep, DataType width, u32 count, s32 limit, s32 *cycles) {
+    u32 index = width >> 1;
+
+    dst = ALIGN(dst, width);
+    src = ALIGN(src, width);
+
+    u32 dstpage = dst >> m_pageshift;
+    u32 srcpage = src >> m_pageshift;
+
+    *cycles = 0;
+
+    if (limit <= 0 || dstpage >= m_pagecount || srcpage >= m_pagecount || m_writepage[dstpage] == 0 || m_readpage[srcpage] == 0) {return 0;}
+
+    PageAccess const *write = &m_pageaccess[dstpage];
+    PageAccess const *read  = &m_pageaccess[srcpage];
+
+    u32 srcunits = GetBlockUnits(src, srcstep, read->mask, width);
+
+    // En el ROM el primer acceso de cada bloque de 128 KiB es no secuencial
+    if (read->rom) {
+        if ((src & 0x0001FFFF) == 0) {return 0;}
+        if (srcstep < 0 && (ALIGN(src, m_pagesize) & 0x0001FFFF) == 0) {srcunits--;}
+    }
+
+    s32 cost  = read->S[index] + write->S[index];
+    u32 units = (u32)((limit + cost - 1) / cost);
+    u32 dstunits = GetBlockUnits(dst, dststep, write->mask, width);
+
+    if (units > count)    {units = count;}
+    if (units > srcunits) {units = srcunits;}
+    if (units > dstunits) {units = dstunits;}
+
+    u32       dstoffset = dst & write->mask;
+    u8       *to        = &m_writepage[dstpage][dstoffset];
+    u8 const *from      = &m_readpage[srcpage][src & read->mask];
+    u32       size      = units * width;
+
+    if (dststep == (s32)width && srcstep == (s32)width && (to + size <= from || from + size <= to)) {
+        memcpy(to, from, size);
+    }
+    else if (width == TYPE_WORD) {
+        CopyUnits<u32>(to, from, dststep, srcstep, units);
+    }
+    else {
+        CopyUnits<u16>(to, from, dststep, srcstep, units);
+    }
+
+    if (write->writes != 0) {
+        u32 first = dstoffset;
+        u32 last  = dstoffset + ((units - 1) * dststep);
+        if (dststep < 0) {u32 t = first; first = last; last = t;}
+        for (u32 i = first >> 8; i <= ((last + width - 1) >> 8); i++) {write->writes[i]++;}
+    }
+
+    m_sideeffects += units;
+    *cycles = (s32)units * cost;
+    return units;
 }
 //*************************************************************************************************
\ No newline at end of file
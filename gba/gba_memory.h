@@ -8,15 +8,72 @@
 
 #include "../types.h"
 
-namespace gbaMemory {
-enum DataType {
-    TYPE_BYTE     = 1,
-    TYPE_HALFWORD = 2,
-    TYPE_WORD     = 4
-};
+class gbaConsole;
+
+class gbaMemory {
+public:
+    enum DataType {
+        TYPE_BYTE     = 1,
+        TYPE_HALFWORD = 2,
+        TYPE_WORD     = 4
+    };
+
+    gbaMemory(gbaConsole *console);
+
+    void Reset();
+    void UpdatePageTable();
+    void UpdateDisplayPages();
+    u8  Read8(u32 address, s32 *N_access, s32 *S_access);
+    u16 Read16(u32 address, s32 *N_access, s32 *S_access);
+    u32 Read32(u32 address, s32 *N_access, s32 *S_access);
+    u16 Fetch16(u32 address, s32 *N_access, s32 *S_access);
+    u32 Fetch32(u32 address, s32 *N_access, s32 *S_access);
+    void Write8(u32 address, u8 data, s32 *N_access, s32 *S_access);
+    void Write16(u32 address, u16 data, s32 *N_access, s32 *S_access);
+    void Write32(u32 address, u32 data, s32 *N_access, s32 *S_access);
+    u32 CopyBlock(u32 dst, u32 src, s32 dststep, s32 srcstep, DataType width, u32 count, s32 limit, s32 *cycles);
+    u32 const *GetPageWriteCount(u32 address) const;
+    u32 GetSideEffectCount() const;
+
+private:
+    // Tabla de paginas de 16 KiB del bus de 28 bits: las regiones de memoria simple se acceden
+    // directo, I/O, SRAM/Flash, EEPROM y GPIO (pagina en 0) siguen por ReadRegion y WriteRegion
+    static const u32 m_pageshift = 14;
+    static const u32 m_pagesize  = 1 << m_pageshift;
+    static const u32 m_pagecount = 0x10000000 >> m_pageshift;
+
+    struct PageAccess {
+        u32  mask;      // Bits de la direccion dentro de la pagina (paleta y OAM se repiten cada 1 KiB)
+        u32 *writes;    // Contadores de escrituras de la pagina (codigo del CPU en cache, tiles de la VRAM) o 0
+        u8   N[3];      // Espera por ancho (byte, halfword, word), copiada de gbaControl
+        u8   S[3];
+        bool rom;       // Acceso no secuencial cada 128 KiB
+        bool prefetch;  // Prefetch del Game Pak activo, las instrucciones no esperan al ROM
+        bool bytewrite; // Paleta y VRAM expanden las escrituras de 8 bits, van por el camino lento
+    };
 
-void Reset();
-void Write(u32 address, t32 const *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access);
-void Read(u32 address, t32 *data, gbaMemory::DataType width, s32 *N_access, s32 *S_access);
-}
+    gbaConsole *m_console;
+
+    u8 m_WRAM256K[0x40000];
+    u8 m_WRAM32K[0x8000];
+
+    // Escrituras por pagina de 256 bytes, para invalidar el codigo guardado en cache por el CPU
+    u32 m_WRAM256Kwrites[sizeof(m_WRAM256K) >> 8];
+    u32 m_WRAM32Kwrites[sizeof(m_WRAM32K) >> 8];
+
+    // Escrituras y lecturas con estado (GPIO, EEPROM, SRAM/Flash), para detectar ciclos ociosos del
+    // CPU
+    u32 m_sideeffects;
+
+    u8 const  *m_readpage[m_pagecount];
+    u8        *m_writepage[m_pagecount];
+    PageAccess m_pageaccess[m_pagecount];
+
+    void SetPage(u32 address, u8 const *read, u8 *write, u32 mask, u32 *writes, bool bytewrite);
+    void WriteRegion(u32 address, t32 const *data, DataType width, s32 *N_access, s32 *S_access);
+    void ReadCPUPrefetch(u32 address, t32 *data, DataType width);
+    void ReadRegion(u32 address, t32 *data, DataType width, bool fetch, s32 *N_access, s32 *S_access);
+    template <typename T, bool fetch> T ReadValue(u32 address, s32 *N_access, s32 *S_access);
+    template <typename T> void WriteValue(u32 address, T data, s32 *N_access, s32 *S_access);
+};
 //*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,150 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#include <cstring>
+#include <mutex>
+#include "gba_pixelformat.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define GBA_PIXELFORMAT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace gbaPixelFormat
+{
+typedef void (*LineConverter)(u16 const *source, void *target);
+
+// Cada canal de 5 bits pasa a 8 bits como c << 3, igual que el frontend de Direct3D
+u32 m_ARGB8888[0x8000];
+u32 m_RGBA8888[0x8000];
+u16 m_RGB565[0x8000];
+std::once_flag m_tables; // Las tablas se comparten entre todas las consolas
+bool m_simd = true; // Conversion con SSE2 cuando esta disponible
+
+void BuildTables()
+{
+    for (u32 color = 0; color < 0x8000; ++color)
+    {
+        u32 r = SUBVAL(color,  0, 0x1F);
+        u32 g = SUBVAL(color,  5, 0x1F);
+        u32 b = SUBVAL(color, 10, 0x1F);
+
+        m_ARGB8888[color] = 0xFF000000 | (r << 19) | (g << 11) | (b << 3);
+        m_RGBA8888[color] = 0x000000FF | (r << 27) | (g << 19) | (b << 11);
+        m_RGB565[color]   = (u16)((r << 11) | (g << 6) | b);
+    }
+}
+
+void ConvertLineBGR555(u16 const *source, void *target)
+{
+    memcpy(target, source, GBA_SCREENWIDTH * sizeof(u16));
+}
+
+void ConvertLineRGB565Scalar(u16 const *source, void *target)
+{
+    for (u32 i = 0; i < GBA_SCREENWIDTH; ++i) {((u16 *)target)[i] = m_RGB565[source[i] & 0x7FFF];}
+}
+
+void ConvertLineARGB8888Scalar(u16 const *source, void *target)
+{
+    for (u32 i = 0; i < GBA_SCREENWIDTH; ++i) {((u32 *)target)[i] = m_ARGB8888[source[i] & 0x7FFF];}
+}
+
+void ConvertLineRGBA8888Scalar(u16 const *source, void *target)
+{
+    for (u32 i = 0; i < GBA_SCREENWIDTH; ++i) {((u32 *)target)[i] = m_RGBA8888[source[i] & 0x7FFF];}
+}
+
+#ifdef GBA_PIXELFORMAT_SSE2
+// Canales de 8 puntos en los 8 bits bajos de cada halfword
+void SplitChannelsSSE2(__m128i color, __m128i &r, __m128i &g, __m128i &b)
+{
+    __m128i mask = _mm_set1_epi16(0xF8);
+
+    r = _mm_and_si128(_mm_slli_epi16(color, 3), mask);
+    g = _mm_and_si128(_mm_srli_epi16(color, 2), mask);
+    b = _mm_and_si128(_mm_srli_epi16(color, 7), mask);
+}
+
+void ConvertLineRGB565SSE2(u16 const *source, void *target)
+{
+    __m128i mask = _mm_set1_epi16(0x1F);
+    __m128i green = _mm_set1_epi16(0x3E0);
+
+    for (u32 i = 0; i < GBA_SCREENWIDTH; i += 8)
+    {
+        __m128i color = _mm_loadu_si128((__m128i const *)&source[i]);
+        __m128i r     = _mm_slli_epi16(color, 11);
+        __m128i g     = _mm_slli_epi16(_mm_and_si128(color, green), 1);
+        __m128i b     = _mm_and_si128(_mm_srli_epi16(color, 10), mask);
+        _mm_storeu_si128((__m128i *)&((u16 *)target)[i], _mm_or_si128(_mm_or_si128(r, g), b));
+    }
+}
+
+void ConvertLineARGB8888SSE2(u16 const *source, void *target)
+{
+    __m128i alpha = _mm_set1_epi16((s16)0xFF00);
+    __m128i r;
+    __m128i g;
+    __m128i b;
+
+    for (u32 i = 0; i < GBA_SCREENWIDTH; i += 8)
+    {
+        SplitChannelsSSE2(_mm_loadu_si128((__m128i const *)&source[i]), r, g, b);
+        __m128i lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        __m128i hi = _mm_or_si128(r, alpha);
+        _mm_storeu_si128((__m128i *)&((u32 *)target)[i + 0], _mm_unpacklo_epi16(lo, hi));
+        _mm_storeu_si128((__m128i *)&((u32 *)target)[i + 4], _mm_unpackhi_epi16(lo, hi));
+    }
+}
+
+void ConvertLineRGBA8888SSE2(u16 const *source, void *target)
+{
+    __m128i alpha = _mm_set1_epi16(0x00FF);
+    __m128i r;
+    __m128i g;
+    __m128i b;
+
+    for (u32 i = 0; i < GBA_SCREENWIDTH; i += 8)
+    {
+        SplitChannelsSSE2(_mm_loadu_si128((__m128i const *)&source[i]), r, g, b);
+        __m128i lo = _mm_or_si128(alpha, _mm_slli_epi16(b, 8));
+        __m128i hi = _mm_or_si128(g, _mm_slli_epi16(r, 8));
+        _mm_storeu_si128((__m128i *)&((u32 *)target)[i + 0], _mm_unpacklo_epi16(lo, hi));
+        _mm_storeu_si128((__m128i *)&((u32 *)target)[i + 4], _mm_unpackhi_epi16(lo, hi));
+    }
+}
+#endif
+
+LineConverter const m_scalar[FORMAT_COUNT] = {ConvertLineBGR555, ConvertLineRGB565Scalar, ConvertLineARGB8888Scalar, ConvertLineRGBA8888Scalar};
+#ifdef GBA_PIXELFORMAT_SSE2
+LineConverter const m_sse2[FORMAT_COUNT]   = {ConvertLineBGR555, ConvertLineRGB565SSE2,   ConvertLineARGB8888SSE2,   ConvertLineRGBA8888SSE2};
+#endif
+
+void EnableSIMD(bool enable)
+{
+    m_simd = enable;
+}
+
+u32 GetPixelSize(Format format)
+{
+    return (format == FORMAT_ARGB8888 || format == FORMAT_RGBA8888) ? 4 : 2;
+}
+
+// pitch: bytes entre el inicio de cada linea en target
+void Convert(u16 const frame[GBA_SCREENHEIGHT][GBA_SCREENWIDTH], Format format, void *target, u32 pitch)
+{
+    LineConverter convert = m_scalar[format];
+#ifdef GBA_PIXELFORMAT_SSE2
+    if (m_simd) {convert = m_sse2[format];}
+#endif
+    if (format != FORMAT_BGR555 && convert == m_scalar[format]) {std::call_once(m_tables, &BuildTables);}
+
+    u8 *line = (u8 *)target;
+    for (u32 y = 0; y < GBA_SCREENHEIGHT; ++y, line += pitch) {convert(frame[y], line);}
+}
+}
+//*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,28 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#pragma once
+
+#include "../types.h"
+#include "gba_display.h"
+
+namespace gbaPixelFormat
+{
+// Formatos de salida para los frontends, los de 32 bits como valores u32 del CPU
+enum Format
+{
+    FORMAT_BGR555   = 0, // Formato del GBA, se copia sin cambios
+    FORMAT_RGB565   = 1,
+    FORMAT_ARGB8888 = 2, // 0xAARRGGBB
+    FORMAT_RGBA8888 = 3, // 0xRRGGBBAA
+    FORMAT_COUNT    = 4
+};
+
+void EnableSIMD(bool enable);
+u32 GetPixelSize(Format format);
+void Convert(u16 const frame[GBA_SCREENHEIGHT][GBA_SCREENWIDTH], Format format, void *target, u32 pitch);
+}
+//*************************************************************************************************
\ No newline at end of file
@@ -0,0 +1,112 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#include "gba_scheduler.h"
+
+gbaScheduler::gbaScheduler(gbaConsole *console) : m_console(console) {
+    Reset();
+}
+
+bool gbaScheduler::Before(s32 a, s32 b) const {return m_event[a].when < m_event[b].when || (m_event[a].when == m_event[b].when && a < b);}
+
+void gbaScheduler::Place(s32 index, s32 source) {
+    m_heap[index] = source;
+    m_event[source].position = index;
+}
+
+void gbaScheduler::SiftUp(s32 index) {
+    s32 source = m_heap[index];
+    while (index > 0) {
+        s32 parent = (index - 1) / 2;
+        if (!Before(source, m_heap[parent])) {break;}
+        Place(index, m_heap[parent]);
+        index = parent;
+    }
+    Place(index, source);
+}
+
+void gbaScheduler::SiftDown(s32 index) {
+    s32 source = m_heap[index];
+    for (;;) {
+        s32 child = (2 * index) + 1;
+        if (child >= m_heapsize) {break;}
+        if (child + 1 < m_heapsize && Before(m_heap[child + 1], m_heap[child])) {child++;}
+        if (!Before(m_heap[child], source)) {break;}
+        Place(index, m_heap[child]);
+        index = child;
+    }
+    Place(index, source);
+}
+
+void gbaScheduler::Remove(s32 source) {
+    s32 index = m_event[source].position;
+    if (index < 0) {return;}
+    m_event[source].position = -1;
+    if (--m_heapsize == index) {return;}
+    s32 last = m_heap[m_heapsize];
+    Place(index, last);
+    SiftDown(index);
+    SiftUp(m_event[last].position);
+}
+
+void gbaScheduler::Schedule(s32 source, s32 ticks) {
+    Remove(source);
+    if (ticks <= 0) {return;}
+    m_event[source].when = m_event[source].synced + ticks;
+    Place(m_heapsize, source);
+    SiftUp(m_heapsize++);
+}
+
+void gbaScheduler::Reset() {
+    m_time     = 0;
+    m_heapsize = 0;
+    for (s32 i = 0; i < EVENT_COUNT; i++) {
+        m_event[i].handler  = 0;
+        m_event[i].synced   = 0;
+        m_event[i].when     = 0;
+        m_event[i].position = -1;
+    }
+}
+
+void gbaScheduler::Register(EventSource source, EventHandler handler, s32 ticks) {
+    m_event[source].handler = handler;
+    m_event[source].synced  = m_time;
+    Schedule(source, ticks);
+}
+
+// Pone al dia la fuente (p.ej. antes de leer o escribir sus registros) y reprograma su evento
+void gbaScheduler::Sync(EventSource source) {
+    Event *e = &m_event[source];
+    s32 ticks = (s32)(m_time - e->synced);
+    e->synced = m_time;
+    Schedule(source, e->handler(m_console, ticks));
+}
+
+// Atiende el siguiente evento de la fuente sin avanzar el reloj (modo STOP)
+void gbaScheduler::Skip(EventSource source) {
+    Sync(source);
+    if (m_event[source].position < 0) {return;}
+    Schedule(source, m_event[source].handler(m_console, (s32)(m_event[source].when - m_time)));
+}
+
+// Solo se sincronizan las fuentes cuyo evento ya vencio, el resto se pone al dia cuando se accede
+// a sus registros o cuando llega su evento
+void gbaScheduler::Advance(s32 ticks) {
+    if (ticks <= 0) {return;}
+    m_time += ticks;
+
+    u32 due = 0;
+    while (m_heapsize > 0 && m_event[m_heap[0]].when <= m_time) {
+        due |= BIT(m_heap[0]);
+        Remove(m_heap[0]);
+    }
+
+    for (s32 i = 0; i < EVENT_COUNT; i++) {if (BITTEST(due, i)) {Sync((EventSource)i);}}
+}
+
+s32 gbaScheduler::GetNextEvent() const {return m_heapsize > 0 ? (s32)(m_event[m_heap[0]].when - m_time) : 0;}
+u64 gbaScheduler::GetTime() const {return m_time;}
+//*************************************************************************************************
\ No newline at end of file
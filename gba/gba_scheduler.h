@@ -0,0 +1,59 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#pragma once
+
+#include "../types.h"
+
+class gbaConsole;
+
+class gbaScheduler {
+public:
+    // El orden define la prioridad de los eventos que vencen en el mismo lote
+    enum EventSource {
+        EVENT_TIMER   = 0, // Desborde del siguiente timer
+        EVENT_SOUND   = 1, // Salida de la siguiente muestra
+        EVENT_DISPLAY = 2, // Inicio de HBlank / siguiente linea (VBlank)
+        EVENT_COUNT   = 3
+    };
+
+    // Recibe la consola, los ciclos transcurridos desde su ultima sincronizacion y devuelve los
+    // ciclos hasta su siguiente evento (0 si no tiene)
+    typedef s32 (*EventHandler)(gbaConsole *console, s32 ticks);
+
+    gbaScheduler(gbaConsole *console);
+
+    void Reset();
+    void Register(EventSource source, EventHandler handler, s32 ticks);
+    void Sync(EventSource source);
+    void Skip(EventSource source);
+    void Advance(s32 ticks);
+    s32 GetNextEvent() const;
+    u64 GetTime() const;
+
+private:
+    struct Event {
+        EventHandler handler;
+        u64          synced;   // Ultima sincronizacion de la fuente
+        u64          when;     // Ciclo absoluto del siguiente evento
+        s32          position; // Posicion en el heap, -1 si no hay evento pendiente
+    };
+
+    gbaConsole *m_console;
+
+    u64   m_time;
+    Event m_event[EVENT_COUNT];
+    s32   m_heap[EVENT_COUNT];
+    s32   m_heapsize;
+
+    bool Before(s32 a, s32 b) const;
+    void Place(s32 index, s32 source);
+    void SiftUp(s32 index);
+    void SiftDown(s32 index);
+    void Remove(s32 source);
+    void Schedule(s32 source, s32 ticks);
+};
+//*************************************************************************************************
\ No newline at end of file
@@ -6,34 +6,17 @@
 
 #include "gba_sio.h"
 
-namespace gbaSIO
-{
-enum ModeSelection
-{
-    MODE_NORMAL,
-    MODE_MULTIPLAYER,
-    MODE_UART,
-    MODE_GENERALPURPOSE,
-    MODE_JOYBUS
-};
-
 const u8 m_SC = BIT(0);
 const u8 m_SD = BIT(1);
 const u8 m_SI = BIT(2);
 const u8 m_SO = BIT(3);
 
-t16 m_SIOMULTI[4];
-t16 m_SIOCNT; // 0x0004
-t16 m_SIODATA8;
-t16 m_RCNT; // 0x800F
-t8  m_JOYCNT;
-t32 m_JOYRECV;
-t32 m_JOYTRANS;
-t8  m_JOYSTAT;
-
-ModeSelection m_mode;
+gbaSIO::gbaSIO()
+{
+    Reset();
+}
 
-void UpdateSIOState()
+void gbaSIO::UpdateSIOState()
 {
     if (BITTEST(m_RCNT.w, 15))
     {
@@ -84,7 +67,7 @@ void UpdateSIOState()
     m_SIOCNT.w = siocnt;
 }
 
-void Reset()
+void gbaSIO::Reset()
 {
     for (u32 i = 0; i < 4; i++) {m_SIOMULTI[i].w = 0;}
 
@@ -99,95 +82,95 @@ void Reset()
     UpdateSIOState();
 }
 
-void WriteSIOCNT_B0(u8 byte)
+void gbaSIO::WriteSIOCNT_B0(u8 byte)
 {
     m_SIOCNT.b.b0.b = byte & ~(BIT(4) | BIT(5) | BIT(6));
     UpdateSIOState();
 }
 
-void WriteSIOCNT_B1(u8 byte)
+void gbaSIO::WriteSIOCNT_B1(u8 byte)
 {
     m_SIOCNT.b.b1.b = byte & ~BIT(7);
     UpdateSIOState();
 }
 
-void WriteRCNT_B0(u8 byte)
+void gbaSIO::WriteRCNT_B0(u8 byte)
 {
     m_RCNT.b.b0.b = byte;
     UpdateSIOState();
 }
 
-void WriteRCNT_B1(u8 byte)
+void gbaSIO::WriteRCNT_B1(u8 byte)
 {
     m_RCNT.b.b1.b = byte & ~(BIT(1) | BIT(2) | BIT(3) | BIT(4) | BIT(5));
     UpdateSIOState();
 }
 
-void WriteJOYCNT(u8 byte)
+void gbaSIO::WriteJOYCNT(u8 byte)
 {
     m_JOYCNT.b = (m_JOYCNT.b & 0x7 & ~byte) | (byte & 0xF8);
 }
 
-void WriteJOYTRANS_B0(u8 byte)
+void gbaSIO::WriteJOYTRANS_B0(u8 byte)
 {
     m_JOYSTAT.b |= BIT(1);
     m_JOYTRANS.w.w0.b.b0.b = byte;
 }
 
-void WriteJOYTRANS_B1(u8 byte)
+void gbaSIO::WriteJOYTRANS_B1(u8 byte)
 {
     m_JOYSTAT.b |= BIT(1);
     m_JOYTRANS.w.w0.b.b1.b = byte;
 }
 
-void WriteJOYTRANS_B2(u8 byte)
+void gbaSIO::WriteJOYTRANS_B2(u8 byte)
 {
     m_JOYSTAT.b |= BIT(1);
     m_JOYTRANS.w.w1.b.b0.b = byte;
 }
 
-void WriteJOYTRANS_B3(u8 byte)
+void gbaSIO::WriteJOYTRANS_B3(u8 byte)
 {
     m_JOYSTAT.b |= BIT(1);
     m_JOYTRANS.w.w1.b.b1.b = byte;
 }
 
-u8 ReadSIOCNT_B0()
+u8 gbaSIO::ReadSIOCNT_B0()
 {
     if (m_mode == MODE_UART) {m_SIOCNT.w &= ~BIT(6);}
     return m_SIOCNT.b.b0.b;
 }
 
-u8 ReadSIOCNT_B1()
+u8 gbaSIO::ReadSIOCNT_B1()
 {
     return m_SIOCNT.b.b1.b;
 }
 
-u8 ReadJOYRECV_B0()
+u8 gbaSIO::ReadJOYRECV_B0()
 {
     m_JOYSTAT.b &= ~BIT(3);
     return m_JOYRECV.w.w0.b.b0.b;
 }
 
-u8 ReadJOYRECV_B1()
+u8 gbaSIO::ReadJOYRECV_B1()
 {
     m_JOYSTAT.b &= ~BIT(3);
     return m_JOYRECV.w.w0.b.b1.b;
 }
 
-u8 ReadJOYRECV_B2()
+u8 gbaSIO::ReadJOYRECV_B2()
 {
     m_JOYSTAT.b &= ~BIT(3);
     return m_JOYRECV.w.w1.b.b0.b;
 }
 
-u8 ReadJOYRECV_B3()
+u8 gbaSIO::ReadJOYRECV_B3()
 {
     m_JOYSTAT.b &= ~BIT(3);
     return m_JOYRECV.w.w1.b.b1.b;
 }
 
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
+void gbaSIO::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
 {
     u8  bytes[4] = {data->w.w0.b.b0.b, data->w.w0.b.b1.b, data->w.w1.b.b0.b, data->w.w1.b.b1.b};
     u32 base     = address & ~(width - 1);
@@ -224,7 +207,7 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
     }
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
+void gbaSIO::ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
 {
     u8 *bytes[4] = {&data->w.w0.b.b0.b, &data->w.w0.b.b1.b, &data->w.w1.b.b0.b, &data->w.w1.b.b1.b};
     u32 base     = address & ~(width - 1);
@@ -268,6 +251,5 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
         }
     }
 }
-}
 
 //*************************************************************************************************
\ No newline at end of file
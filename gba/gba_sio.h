@@ -9,11 +9,52 @@
 #include "../types.h"
 #include "gba_memory.h"
 
-namespace gbaSIO
+class gbaSIO
 {
-void Reset();
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-}
+public:
+    gbaSIO();
+
+    void Reset();
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
+
+private:
+    enum ModeSelection
+    {
+        MODE_NORMAL,
+        MODE_MULTIPLAYER,
+        MODE_UART,
+        MODE_GENERALPURPOSE,
+        MODE_JOYBUS
+    };
+
+    t16 m_SIOMULTI[4];
+    t16 m_SIOCNT; // 0x0004
+    t16 m_SIODATA8;
+    t16 m_RCNT; // 0x800F
+    t8  m_JOYCNT;
+    t32 m_JOYRECV;
+    t32 m_JOYTRANS;
+    t8  m_JOYSTAT;
+
+    ModeSelection m_mode;
+
+    void UpdateSIOState();
+    void WriteSIOCNT_B0(u8 byte);
+    void WriteSIOCNT_B1(u8 byte);
+    void WriteRCNT_B0(u8 byte);
+    void WriteRCNT_B1(u8 byte);
+    void WriteJOYCNT(u8 byte);
+    void WriteJOYTRANS_B0(u8 byte);
+    void WriteJOYTRANS_B1(u8 byte);
+    void WriteJOYTRANS_B2(u8 byte);
+    void WriteJOYTRANS_B3(u8 byte);
+    u8 ReadSIOCNT_B0();
+    u8 ReadSIOCNT_B1();
+    u8 ReadJOYRECV_B0();
+    u8 ReadJOYRECV_B1();
+    u8 ReadJOYRECV_B2();
+    u8 ReadJOYRECV_B3();
+};
 
 //*************************************************************************************************
\ No newline at end of file
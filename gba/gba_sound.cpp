@@ -4,277 +4,19 @@
 // 2013
 //*************************************************************************************************
 
+#include <cmath>
+#include <cstring>
 #include <queue>
 #include "../emulator.h"
-#include "gba_dma.h"
+#include "gba_console.h"
 #include "gba_sound.h"
 
-namespace gbaSound
-{
-class gbaSquarePattern
-{
-private:
-    static const s8 m_pattern[4][8];
-    s32 m_out;
-    s32 m_ticks;
-    s32 m_freq;
-    s32 m_dutycycle;
-
-    void DoReloadCounter();
-    void DoSync();
-
-public:
-    gbaSquarePattern();
-    void Sync(s32 ticks);
-    void Reset();
-    void Init();
-    s8 GetSample() const;
-    void SetDutyCycle(s32 dutycycle);
-    void SetFrequency(s32 frequency);
-    s32 GetFrequency();
-};
-
-class gbaSweepUnit
-{
-private:
-    gbaSquarePattern *m_square;
-    s32 m_ticks;
-    s32 m_time;
-    s32 m_direction;
-    s32 m_shifts;
-    s32 m_counter;
-    s32 m_freq;
-    s32 m_nextfreq;
-    bool m_off;
-    bool m_active;    
-
-    void DoReloadCounter();
-    void DoSweepFrequency();
-    bool DoSync();
-    s32 PartialSync();
-
-public:
-    gbaSweepUnit(gbaSquarePattern *square);
-    void Sync(s32 ticks);
-    void Reset();
-    void Init(s32 frequency);
-    s32 GetFrequency() const;
-    bool IsChannelOff() const;
-    void SetSweepRegister(u8 NRX0);
-};
-
-class gbaSoundLength
-{
-private:
-    s32 m_counter;
-    s32 m_maxlength;
-    bool m_off;
-    bool m_active;
-    s32 m_ticks;
-
-    void DoReloadCounter();
-    void DoSync();
-
-public:
-    gbaSoundLength();
-    void Sync(s32 ticks);
-    void Reset();
-    void Init();
-    bool IsChannelOff() const;
-    void SetMaxLength(s32 maxlength);
-    void SetCounter(s32 counter);
-    void SetEnable(s32 enable);
-};
-
-class gbaVolumeEnvelope
-{
-private:
-    s32 m_ticks;
-    s32 m_initvol;
-    s32 m_vol;
-    s32 m_direction;
-    s32 m_step;
-    s32 m_counter;
-    bool m_active;
-
-    void DoReloadCounter();
-    void DoStep();
-    void DoSync();
-
-public:
-    gbaVolumeEnvelope();
-    void Sync(s32 ticks);
-    void Reset();
-    void Init();
-    s32 GetVolume() const;
-    void SetVolumeEnvelopeRegister(u8 NRX2);
-};
-
-class gbaWavePattern
-{
-private:
-    s8 m_pattern[2][16];
-    s32 m_position;
-    s32 m_ticks;
-    s32 m_freq;
-    s8 m_sample;
-    s32 m_playbank;
-    s32 m_databank;
-    s32 m_initbank;
-    bool m_use2banks;
-    bool m_off;
-    bool m_enable;
-
-    void DoReloadCounter();
-    void DoSync();
-
-public:
-    gbaWavePattern();
-    void Sync(s32 ticks);
-    void Reset(bool preservewaveram);
-    void Init();
-    s8 GetSample() const;
-    bool IsChannelOff() const;
-    void SetOutputEnable(s32 enable);
-    void SetFrequency(s32 frequency);
-    void SetBank(s32 bank);
-    void SetDimension(bool use2banks);
-    void WriteWaveRAM(u8 offset, s8 samples);
-    s8 ReadWaveRAM(u8 offset);
-};
-
-class gbaNoisePattern
-{
-private:
-    static const u32 m_pattern[2][2];
-    u32 m_shiftreg;
-    s32 m_ratio;
-    s32 m_shiftclk;
-    s32 m_width;
-    s32 m_ticks;
-    s8 m_sample;
-
-    void DoReloadCounter();
-    void DoSync();
-
-public:
-    gbaNoisePattern();
-    void Sync(s32 ticks);
-    void Reset();
-    void Init();
-    s8 GetSample() const;
-    void SetNoiseRegister(u8 NR43);
-};
-
-class gbaSoundChannel1
-{
-private:
-    gbaSquarePattern m_square;
-    gbaSweepUnit m_sweep;
-    gbaSoundLength m_length;
-    gbaVolumeEnvelope m_volume;
-    s32 m_freq;
-    bool m_off;
-
-public:
-    gbaSoundChannel1();
-    void Sync(s32 ticks);
-    void Reset();
-    s32 GetSample() const;
-    bool IsChannelOff() const;
-    void WriteNR10(u8 NR10);
-    void WriteNR11(u8 NR11);
-    void WriteNR12(u8 NR12);
-    void WriteNR13(u8 NR13);
-    void WriteNR14(u8 NR14);
-};
+#if defined(_M_X64) || defined(__x86_64__)
+#define GBA_SOUND_SSE2
+#include <emmintrin.h>
+#endif
 
-class gbaSoundChannel2
-{
-private:
-    gbaSquarePattern m_square;
-    gbaSoundLength m_length;
-    gbaVolumeEnvelope m_volume;
-    s32 m_freq;
-    bool m_off;
-
-public:
-    gbaSoundChannel2();
-    void Sync(s32 ticks);
-    void Reset();
-    s32 GetSample() const;
-    bool IsChannelOff() const;
-    void WriteNR21(u8 NR21);
-    void WriteNR22(u8 NR22);
-    void WriteNR23(u8 NR23);
-    void WriteNR24(u8 NR24);
-};
-
-class gbaSoundChannel3
-{
-private:
-    gbaWavePattern m_wave;
-    gbaSoundLength m_length;
-    s32 m_freq;
-    s32 m_level;
-    bool m_off;
-    bool m_forcevol;
-
-public:
-    gbaSoundChannel3();
-    void Sync(s32 ticks);
-    void Reset(bool preservewaveram);
-    s32 GetSample() const;
-    bool IsChannelOff() const;
-    void WriteNR30(u8 NR30);
-    void WriteNR31(u8 NR31);
-    void WriteNR32(u8 NR32);
-    void WriteNR33(u8 NR33);
-    void WriteNR34(u8 NR34);
-    void WriteWavePattern(u8 offset, u8 byte);
-    u8 ReadWavePattern(u8 offset);
-};
-
-class gbaSoundChannel4
-{
-private:
-    gbaSoundLength m_length;
-    gbaVolumeEnvelope m_volume;
-    gbaNoisePattern m_noise;
-    bool m_off;
-
-public:
-    gbaSoundChannel4();
-    void Sync(s32 ticks);
-    void Reset();
-    s32 GetSample() const;
-    bool IsChannelOff() const;
-    void WriteNR41(u8 NR41);
-    void WriteNR42(u8 NR42);
-    void WriteNR43(u8 NR43);
-    void WriteNR44(u8 NR44);
-};
-
-class gbaDirectSound
-{
-private:
-    std::queue<s8> m_FIFO;
-    s8 m_sample;
-    gbaControl::InterruptFlag m_sampleratetimer;
-    u32 m_DMADRQ;
-
-public:
-    gbaDirectSound(u32 fifo);
-    void Reset();
-    void SetTimer(gbaControl::InterruptFlag timerid);
-    gbaControl::InterruptFlag GetTimer() const;
-    void ResetFIFO();
-    void SendNextSample();
-    s32 GetSample() const;
-    void WriteFIFOX_BX(u8 byte);
-};
-
-const s8 gbaSquarePattern::m_pattern[4][8] =
+const s8 gbaSound::gbaSquarePattern::m_pattern[4][8] =
 {
     {0, 0, 1, 0, 0, 0, 0, 0}, // 12.5%
     {0, 1, 1, 0, 0, 0, 0, 0}, // 25%
@@ -282,113 +24,122 @@ const s8 gbaSquarePattern::m_pattern[4][8] =
     {1, 0, 0, 1, 1, 1, 1, 1}  // 75%
 };
 
-const u32 gbaNoisePattern::m_pattern[2][2] =
+const u32 gbaSound::gbaNoisePattern::m_pattern[2][2] =
 {
     {0x3FFF, 0x3F},
     {14, 6}
 };
 
 const s32 m_samplerclk = 16777216 / GBA_SAMPLERATE;
-gbaSoundChannel1 m_sc1;
-gbaSoundChannel2 m_sc2;
-gbaSoundChannel3 m_sc3;
-gbaSoundChannel4 m_sc4;
-gbaDirectSound m_dsA(0x040000A0);
-gbaDirectSound m_dsB(0x040000A4);
-bool m_masterenable;
-s32 m_SOXvol[2];
-s32 m_SOXcnt[2];
-s32 m_PSGvol;
-s32 m_dsAvol;
-s32 m_dsBvol;
-s32 m_dscnt[2];
-s32 m_biaslevel;
-t8 m_SOUND1CNT_L;
-t16 m_SOUND1CNT_H;
-t16 m_SOUND1CNT_X;
-t16 m_SOUND2CNT_L;
-t16 m_SOUND2CNT_H;
-t8 m_SOUND3CNT_L;
-t16 m_SOUND3CNT_H;
-t16 m_SOUND3CNT_X;
-t16 m_SOUND4CNT_L;
-t16 m_SOUND4CNT_H;
-t16 m_SOUNDCNT_L;
-t16 m_SOUNDCNT_H;
-t8 m_SOUNDCNT_X;
-t16 m_SOUNDBIAS;
-s32 m_samplerticks;
-
-gbaSquarePattern::gbaSquarePattern()
+const s32 m_quietclk = 1 << 20; // Sin audio, ciclos acumulados antes de poner al dia los canales PSG
+
+gbaSound::gbaSound(gbaConsole *console) : m_console(console), m_sc4(&m_output), m_dsA(console, 0x040000A0), m_dsB(console, 0x040000A4)
+{
+    m_outputenable = true;
+    m_output = true;
+    m_simd = true;
+    m_samplerate = GBA_SAMPLERATE;
+    m_resamplestep = (u64)1 << 32;
+}
+
+gbaSound::gbaSquarePattern::gbaSquarePattern()
 {
     Reset();
 }
 
-void gbaSquarePattern::DoReloadCounter()
+void gbaSound::gbaSquarePattern::DoReloadCounter()
 {
     m_ticks += 16 * (2048 - m_freq);
 }
 
-void gbaSquarePattern::DoSync()
+void gbaSound::gbaSquarePattern::DoSync()
 {
     m_out = (m_out + 1) & 7;
     DoReloadCounter();
 }
 
-void gbaSquarePattern::Sync(s32 ticks)
+// Igual a llamar DoSync hasta que m_ticks sea positivo, la frecuencia no cambia entre pasos
+void gbaSound::gbaSquarePattern::Sync(s32 ticks)
 {
     m_ticks -= ticks;
-    while (m_ticks <= 0) {DoSync();}
+    if (m_ticks > 0) {return;}
+    s32 period = 16 * (2048 - m_freq);
+    s32 steps = (-m_ticks / period) + 1;
+    m_out = (m_out + steps) & 7;
+    m_ticks += steps * period;
 }
 
-void gbaSquarePattern::Reset()
+void gbaSound::gbaSquarePattern::Reset()
 {
     m_dutycycle = m_freq = m_out = m_ticks = 0;
     DoReloadCounter();
 }
 
-void gbaSquarePattern::Init()
+void gbaSound::gbaSquarePattern::Init()
 {
 }
 
-s8 gbaSquarePattern::GetSample() const
+s8 gbaSound::gbaSquarePattern::GetSample() const
 {
     return m_pattern[m_dutycycle][m_out];
 }
 
-void gbaSquarePattern::SetDutyCycle(s32 dutycycle)
+// Genera count muestras, una cada m_samplerclk ciclos, con amplitud 0 solo avanza la fase
+void gbaSound::gbaSquarePattern::Render(s16 *out, u32 count, s32 amplitude)
+{
+    if (amplitude == 0)
+    {
+        memset(out, 0, count * sizeof(s16));
+        Sync(count * m_samplerclk);
+        return;
+    }
+
+    s32 period = 16 * (2048 - m_freq);
+
+    s16 level[8];
+    for (s32 i = 0; i < 8; i++) {level[i] = m_pattern[m_dutycycle][i] != 0 ? amplitude : -amplitude;}
+
+    for (u32 i = 0; i < count; i++)
+    {
+        m_ticks -= m_samplerclk;
+        while (m_ticks <= 0) {m_out = (m_out + 1) & 7; m_ticks += period;}
+        out[i] = level[m_out];
+    }
+}
+
+void gbaSound::gbaSquarePattern::SetDutyCycle(s32 dutycycle)
 {
     m_dutycycle = dutycycle & 3;
 }
 
-void gbaSquarePattern::SetFrequency(s32 frequency)
+void gbaSound::gbaSquarePattern::SetFrequency(s32 frequency)
 {
     m_freq = frequency & 0x7FF;
 }
 
-s32 gbaSquarePattern::GetFrequency()
+s32 gbaSound::gbaSquarePattern::GetFrequency()
 {
     return m_freq;
 }
 
-gbaSweepUnit::gbaSweepUnit(gbaSquarePattern *square)
+gbaSound::gbaSweepUnit::gbaSweepUnit(gbaSquarePattern *square)
 {
     m_square = square;
     Reset();
 }
 
-void gbaSweepUnit::DoReloadCounter()
+void gbaSound::gbaSweepUnit::DoReloadCounter()
 {
     m_ticks += 131072;
 }
 
-void gbaSweepUnit::DoSweepFrequency()
+void gbaSound::gbaSweepUnit::DoSweepFrequency()
 {
     m_nextfreq = m_freq + (m_direction * (m_freq >> m_shifts));
     if (m_nextfreq > 0x7FF) {m_off = true;} else if (m_nextfreq < 0) {m_nextfreq = m_freq;}
 }
 
-bool gbaSweepUnit::DoSync()
+bool gbaSound::gbaSweepUnit::DoSync()
 {
     if (m_counter == 0) {if (m_time == 0) {return false;} else {m_counter = m_time + 1;}}
     m_counter = (m_counter - 1) & 7;
@@ -402,7 +153,7 @@ bool gbaSweepUnit::DoSync()
     return true;
 }
 
-s32 gbaSweepUnit::PartialSync()
+s32 gbaSound::gbaSweepUnit::PartialSync()
 {
     s32 ret = m_ticks;
     m_square->Sync(m_ticks);
@@ -412,7 +163,7 @@ s32 gbaSweepUnit::PartialSync()
     return ret;
 }
 
-void gbaSweepUnit::Sync(s32 ticks)
+void gbaSound::gbaSweepUnit::Sync(s32 ticks)
 {
     s32 t = ticks;
     while (m_ticks <= t) {t -= PartialSync();}
@@ -421,7 +172,7 @@ void gbaSweepUnit::Sync(s32 ticks)
     m_square->Sync(t);
 }
 
-void gbaSweepUnit::Reset()
+void gbaSound::gbaSweepUnit::Reset()
 {
     m_time = m_shifts = m_counter = m_freq = m_nextfreq = m_ticks = 0;
     m_direction = 1;
@@ -430,7 +181,7 @@ void gbaSweepUnit::Reset()
     DoReloadCounter();
 }
 
-void gbaSweepUnit::Init(s32 frequency)
+void gbaSound::gbaSweepUnit::Init(s32 frequency)
 {
     m_freq = frequency & 0x7FF;
     m_counter = m_time;
@@ -439,35 +190,46 @@ void gbaSweepUnit::Init(s32 frequency)
     if (m_shifts != 0) {DoSweepFrequency();}
 }
 
-s32 gbaSweepUnit::GetFrequency() const
+s32 gbaSound::gbaSweepUnit::GetFrequency() const
 {
     return m_freq;
 }
 
-bool gbaSweepUnit::IsChannelOff() const
+s32 gbaSound::gbaSweepUnit::GetTicks() const
+{
+    return m_ticks;
+}
+
+// Menos ciclos que GetTicks, el generador ya se sincronizo por separado
+void gbaSound::gbaSweepUnit::Advance(s32 ticks)
+{
+    m_ticks -= ticks;
+}
+
+bool gbaSound::gbaSweepUnit::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaSweepUnit::SetSweepRegister(u8 NRX0)
+void gbaSound::gbaSweepUnit::SetSweepRegister(u8 NRX0)
 {
     m_time = SUBVAL(NRX0, 4, 7);
     m_direction = (NRX0 & BIT(3)) != 0 ? -1 : 1;
     m_shifts = NRX0 & 7;
 }
 
-gbaSoundLength::gbaSoundLength()
+gbaSound::gbaSoundLength::gbaSoundLength()
 {
     m_maxlength = 0;
     Reset();
 }
 
-void gbaSoundLength::DoReloadCounter()
+void gbaSound::gbaSoundLength::DoReloadCounter()
 {
     m_ticks += 65536;
 }
 
-void gbaSoundLength::DoSync()
+void gbaSound::gbaSoundLength::DoSync()
 {
     DoReloadCounter();
     if (!m_active || m_counter <= 0) {return;}
@@ -475,13 +237,13 @@ void gbaSoundLength::DoSync()
     if (m_counter == 0) {m_off = true;}
 }
 
-void gbaSoundLength::Sync(s32 ticks)
+void gbaSound::gbaSoundLength::Sync(s32 ticks)
 {
     m_ticks -= ticks;
     while (m_ticks <= 0) {DoSync();}
 }
 
-void gbaSoundLength::Reset()
+void gbaSound::gbaSoundLength::Reset()
 {
     m_counter = m_ticks = 0;
     m_active = false;
@@ -489,50 +251,55 @@ void gbaSoundLength::Reset()
     DoReloadCounter();
 }
 
-void gbaSoundLength::Init()
+void gbaSound::gbaSoundLength::Init()
 {
     m_off = false;
     if (m_counter == 0) {m_counter = m_maxlength;}
 }
 
-bool gbaSoundLength::IsChannelOff() const
+s32 gbaSound::gbaSoundLength::GetTicks() const
+{
+    return m_ticks;
+}
+
+bool gbaSound::gbaSoundLength::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaSoundLength::SetMaxLength(s32 maxlength)
+void gbaSound::gbaSoundLength::SetMaxLength(s32 maxlength)
 {
     m_maxlength = maxlength;
 }
 
-void gbaSoundLength::SetCounter(s32 counter)
+void gbaSound::gbaSoundLength::SetCounter(s32 counter)
 {
     m_counter = counter;
 }
 
-void gbaSoundLength::SetEnable(s32 enable)
+void gbaSound::gbaSoundLength::SetEnable(s32 enable)
 {
     m_active = enable != 0;
 }
 
-gbaVolumeEnvelope::gbaVolumeEnvelope()
+gbaSound::gbaVolumeEnvelope::gbaVolumeEnvelope()
 {
     Reset();
 }
 
-void gbaVolumeEnvelope::DoReloadCounter()
+void gbaSound::gbaVolumeEnvelope::DoReloadCounter()
 {
     m_ticks += 262144;
 }
 
-void gbaVolumeEnvelope::DoStep()
+void gbaSound::gbaVolumeEnvelope::DoStep()
 {
     s32 nextvol;
     nextvol = m_vol + m_direction;
     if (nextvol < 0 || nextvol > 15) {m_active = false;} else {m_vol = nextvol;}
 }
 
-void gbaVolumeEnvelope::DoSync()
+void gbaSound::gbaVolumeEnvelope::DoSync()
 {
     DoReloadCounter();
     if (m_step == 0 || !m_active) {return;}
@@ -542,13 +309,13 @@ void gbaVolumeEnvelope::DoSync()
     DoStep();
 }
 
-void gbaVolumeEnvelope::Sync(s32 ticks)
+void gbaSound::gbaVolumeEnvelope::Sync(s32 ticks)
 {
     m_ticks -= ticks;
     while (m_ticks <= 0) {DoSync();}
 }
 
-void gbaVolumeEnvelope::Reset()
+void gbaSound::gbaVolumeEnvelope::Reset()
 {
     m_initvol = m_vol = m_step = m_counter = m_ticks = 0;
     m_direction = -1;
@@ -556,36 +323,41 @@ void gbaVolumeEnvelope::Reset()
     DoReloadCounter();
 }
 
-void gbaVolumeEnvelope::Init()
+void gbaSound::gbaVolumeEnvelope::Init()
 {
     m_vol = m_initvol;
     m_active = true;
     m_counter = m_step;
 }
 
-s32 gbaVolumeEnvelope::GetVolume() const
+s32 gbaSound::gbaVolumeEnvelope::GetTicks() const
+{
+    return m_ticks;
+}
+
+s32 gbaSound::gbaVolumeEnvelope::GetVolume() const
 {
     return m_vol;
 }
 
-void gbaVolumeEnvelope::SetVolumeEnvelopeRegister(u8 NRX2)
+void gbaSound::gbaVolumeEnvelope::SetVolumeEnvelopeRegister(u8 NRX2)
 {
     m_initvol = SUBVAL(NRX2, 4, 0x0F);
     m_direction = (NRX2 & BIT(3)) != 0 ? 1 : -1;
     m_step = NRX2 & 7;
 }
 
-gbaWavePattern::gbaWavePattern()
+gbaSound::gbaWavePattern::gbaWavePattern()
 {
     Reset(false);
 }
 
-void gbaWavePattern::DoReloadCounter()
+void gbaSound::gbaWavePattern::DoReloadCounter()
 {
     m_ticks += 8 * (2048 - m_freq);
 }
 
-void gbaWavePattern::DoSync()
+void gbaSound::gbaWavePattern::DoSync()
 {
     DoReloadCounter();
     m_position = (m_position + 1) & 0x1F;
@@ -599,14 +371,27 @@ void gbaWavePattern::DoSync()
     m_sample = SUBVAL(m_pattern[m_playbank][pos], index, 0x0F);
 }
 
-void gbaWavePattern::Sync(s32 ticks)
+// Igual a llamar DoSync hasta que m_ticks sea positivo, cada vuelta a la posicion 0 cambia de banco
+void gbaSound::gbaWavePattern::Sync(s32 ticks)
 {
     if (m_off) {return;}
     m_ticks -= ticks;
-    while (m_ticks <= 0) {DoSync();}
+    if (m_ticks > 0) {return;}
+    s32 period = 8 * (2048 - m_freq);
+    s32 steps = (-m_ticks / period) + 1;
+    m_ticks += steps * period;
+    if (m_use2banks && ((((m_position + steps) / 32) & 1) != 0))
+    {
+        m_playbank = ~m_playbank & 1;
+        m_databank = ~m_databank & 1;
+    }
+    m_position = (m_position + steps) & 0x1F;
+    s32 pos = m_position / 2;
+    s32 index = (m_position & 1) != 0 ? 0 : 4;
+    m_sample = SUBVAL(m_pattern[m_playbank][pos], index, 0x0F);
 }
 
-void gbaWavePattern::Reset(bool preservewaveram)
+void gbaSound::gbaWavePattern::Reset(bool preservewaveram)
 {
     m_position = m_playbank = m_initbank = 0;
     m_databank = 0;
@@ -616,9 +401,10 @@ void gbaWavePattern::Reset(bool preservewaveram)
     m_off = true;
     m_enable = false;
     m_use2banks = false;
+    if (!preservewaveram) {memset(m_pattern, 0, sizeof(m_pattern));}
 }
 
-void gbaWavePattern::Init()
+void gbaSound::gbaWavePattern::Init()
 {
     m_position = 0;
     m_ticks = 0;
@@ -629,58 +415,72 @@ void gbaWavePattern::Init()
     m_sample = SUBVAL(m_pattern[m_playbank][0], 4, 0x0F);
 }
 
-s8 gbaWavePattern::GetSample() const
+s8 gbaSound::gbaWavePattern::GetSample() const
 {
     return m_sample;
 }
 
-bool gbaWavePattern::IsChannelOff() const
+// level: salida del canal para cada valor de 4 bits
+void gbaSound::gbaWavePattern::Render(s16 *out, u32 count, s16 const *level)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!m_off)
+        {
+            m_ticks -= m_samplerclk;
+            while (m_ticks <= 0) {DoSync();}
+        }
+        out[i] = level[m_sample];
+    }
+}
+
+bool gbaSound::gbaWavePattern::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaWavePattern::SetOutputEnable(s32 enable)
+void gbaSound::gbaWavePattern::SetOutputEnable(s32 enable)
 {
     m_enable = enable != 0;
     if (!m_enable) {m_off = true;}
 }
 
-void gbaWavePattern::SetFrequency(s32 frequency)
+void gbaSound::gbaWavePattern::SetFrequency(s32 frequency)
 {
     m_freq = frequency & 0x7FF;
 }
 
-void gbaWavePattern::SetBank(s32 bank)
+void gbaSound::gbaWavePattern::SetBank(s32 bank)
 {
     m_initbank = bank & 1;
 }
 
-void gbaWavePattern::SetDimension(bool use2banks)
+void gbaSound::gbaWavePattern::SetDimension(bool use2banks)
 {
     m_use2banks = use2banks;
 }
 
-void gbaWavePattern::WriteWaveRAM(u8 offset, s8 samples)
+void gbaSound::gbaWavePattern::WriteWaveRAM(u8 offset, s8 samples)
 {
     m_pattern[m_databank][offset & 0x0F] = samples;
 }
 
-s8 gbaWavePattern::ReadWaveRAM(u8 offset)
+s8 gbaSound::gbaWavePattern::ReadWaveRAM(u8 offset)
 {
     return m_pattern[m_databank][offset & 0x0F];
 }
 
-gbaNoisePattern::gbaNoisePattern()
+gbaSound::gbaNoisePattern::gbaNoisePattern(bool const *output) : m_output(output)
 {
     Reset();
 }
 
-void gbaNoisePattern::DoReloadCounter()
+void gbaSound::gbaNoisePattern::DoReloadCounter()
 {
     m_ticks += (m_ratio + 1) << (m_shiftclk + 5);
 }
 
-void gbaNoisePattern::DoSync()
+void gbaSound::gbaNoisePattern::DoSync()
 {
     u32 shift = (m_shiftreg >> 1) & m_pattern[0][m_width];
     m_shiftreg = shift | (((m_shiftreg ^ shift) & 1) << m_pattern[1][m_width]);
@@ -688,45 +488,74 @@ void gbaNoisePattern::DoSync()
     m_sample = ~m_shiftreg & 1;
 }
 
-void gbaNoisePattern::Sync(s32 ticks)
+void gbaSound::gbaNoisePattern::Sync(s32 ticks)
 {
     m_ticks -= ticks;
-    while (m_ticks <= 0) {DoSync();}
+    if (*m_output) {while (m_ticks <= 0) {DoSync();} return;}
+    // Sin audio el registro de desplazamiento no es visible para el CPU
+    if (m_ticks > 0) {return;}
+    s32 period = (m_ratio + 1) << (m_shiftclk + 5);
+    m_ticks += ((-m_ticks / period) + 1) * period;
 }
 
-void gbaNoisePattern::Init()
+void gbaSound::gbaNoisePattern::Init()
 {
     m_shiftreg = 1 << m_pattern[1][m_width];
     m_ticks = 0;
     DoReloadCounter();
 }
 
-void gbaNoisePattern::Reset()
+void gbaSound::gbaNoisePattern::Reset()
 {
     m_shiftreg = 1;
     m_ratio = m_shiftclk = m_width = m_ticks = 0;
     DoReloadCounter();
 }
 
-s8 gbaNoisePattern::GetSample() const
+s8 gbaSound::gbaNoisePattern::GetSample() const
 {
     return m_sample;
 }
 
-void gbaNoisePattern::SetNoiseRegister(u8 NR43)
+void gbaSound::gbaNoisePattern::Render(s16 *out, u32 count, s32 amplitude)
+{
+    s32 period = (m_ratio + 1) << (m_shiftclk + 5);
+    u32 mask = m_pattern[0][m_width];
+    u32 feedback = m_pattern[1][m_width];
+    u32 shiftreg = m_shiftreg;
+    s8 sample = m_sample;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        m_ticks -= m_samplerclk;
+        while (m_ticks <= 0)
+        {
+            u32 shift = (shiftreg >> 1) & mask;
+            shiftreg = shift | (((shiftreg ^ shift) & 1) << feedback);
+            sample = ~shiftreg & 1;
+            m_ticks += period;
+        }
+        out[i] = sample != 0 ? amplitude : -amplitude;
+    }
+
+    m_shiftreg = shiftreg;
+    m_sample = sample;
+}
+
+void gbaSound::gbaNoisePattern::SetNoiseRegister(u8 NR43)
 {
     m_shiftclk = SUBVAL(NR43, 4, 0x0F);
     m_width = (NR43 & BIT(3)) != 0 ? 1 : 0;
     m_ratio = NR43 & 7;
 }
 
-gbaSoundChannel1::gbaSoundChannel1() : m_sweep(&m_square)
+gbaSound::gbaSoundChannel1::gbaSoundChannel1() : m_sweep(&m_square)
 {
     m_length.SetMaxLength(64);
     Reset();
 }
 
-void gbaSoundChannel1::Sync(s32 ticks)
+void gbaSound::gbaSoundChannel1::Sync(s32 ticks)
 {
     m_sweep.Sync(ticks);
     m_length.Sync(ticks);
@@ -735,7 +564,7 @@ void gbaSoundChannel1::Sync(s32 ticks)
     if (m_sweep.IsChannelOff() || m_length.IsChannelOff()) {m_off = true;}
 }
 
-void gbaSoundChannel1::Reset()
+void gbaSound::gbaSoundChannel1::Reset()
 {
     m_off = true;
     m_freq = 0;
@@ -745,39 +574,65 @@ void gbaSoundChannel1::Reset()
     m_volume.Reset();
 }
 
-s32 gbaSoundChannel1::GetSample() const
+s32 gbaSound::gbaSoundChannel1::GetSample() const
 {
     return (m_square.GetSample() != 0 ? 1 : -1) * m_volume.GetVolume();
 }
 
-bool gbaSoundChannel1::IsChannelOff() const
+// Genera count muestras a partir de first ciclos, las siguientes cada m_samplerclk ciclos; entre
+// pasos de barrido, longitud o envolvente solo corre el generador
+void gbaSound::gbaSoundChannel1::Render(s16 *out, s32 first, u32 count, bool audible)
+{
+    Sync(first);
+    out[0] = m_off ? 0 : GetSample();
+
+    for (u32 i = 1; i < count;)
+    {
+        s32 next = m_sweep.GetTicks();
+        if (m_length.GetTicks() < next) {next = m_length.GetTicks();}
+        if (m_volume.GetTicks() < next) {next = m_volume.GetTicks();}
+        u32 span = (u32)((next - 1) / m_samplerclk);
+        if (span > count - i) {span = count - i;}
+        if (span > 0)
+        {
+            m_square.Render(&out[i], span, (audible && !m_off) ? m_volume.GetVolume() : 0);
+            m_sweep.Advance(span * m_samplerclk);
+            m_length.Sync(span * m_samplerclk);
+            m_volume.Sync(span * m_samplerclk);
+            i += span;
+        }
+        if (i < count) {Sync(m_samplerclk); out[i++] = m_off ? 0 : GetSample();}
+    }
+}
+
+bool gbaSound::gbaSoundChannel1::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaSoundChannel1::WriteNR10(u8 NR10)
+void gbaSound::gbaSoundChannel1::WriteNR10(u8 NR10)
 {
     m_sweep.SetSweepRegister(NR10);
 }
 
-void gbaSoundChannel1::WriteNR11(u8 NR11)
+void gbaSound::gbaSoundChannel1::WriteNR11(u8 NR11)
 {
     m_square.SetDutyCycle(SUBVAL(NR11, 6, 3));
     m_length.SetCounter(64 - (NR11 & 63));
 }
 
-void gbaSoundChannel1::WriteNR12(u8 NR12)
+void gbaSound::gbaSoundChannel1::WriteNR12(u8 NR12)
 {
     m_volume.SetVolumeEnvelopeRegister(NR12);
 }
 
-void gbaSoundChannel1::WriteNR13(u8 NR13)
+void gbaSound::gbaSoundChannel1::WriteNR13(u8 NR13)
 {
     m_freq = (m_freq & 0x700) | NR13;
     m_square.SetFrequency(m_freq);
 }
 
-void gbaSoundChannel1::WriteNR14(u8 NR14)
+void gbaSound::gbaSoundChannel1::WriteNR14(u8 NR14)
 {
     m_length.SetEnable(NR14 & BIT(6));
     m_freq = (m_freq & 0xFF) | ((NR14 << 8) & 0x700);
@@ -790,13 +645,13 @@ void gbaSoundChannel1::WriteNR14(u8 NR14)
     m_off = m_sweep.IsChannelOff();
 }
 
-gbaSoundChannel2::gbaSoundChannel2()
+gbaSound::gbaSoundChannel2::gbaSoundChannel2()
 {
     m_length.SetMaxLength(64);
     Reset();
 }
 
-void gbaSoundChannel2::Sync(s32 ticks)
+void gbaSound::gbaSoundChannel2::Sync(s32 ticks)
 {
     m_square.Sync(ticks);
     m_length.Sync(ticks);
@@ -804,7 +659,7 @@ void gbaSoundChannel2::Sync(s32 ticks)
     if (m_length.IsChannelOff()) {m_off = true;}
 }
 
-void gbaSoundChannel2::Reset()
+void gbaSound::gbaSoundChannel2::Reset()
 {
     m_off = true;
     m_freq = 0;
@@ -813,34 +668,57 @@ void gbaSoundChannel2::Reset()
     m_volume.Reset();
 }
 
-s32 gbaSoundChannel2::GetSample() const
+s32 gbaSound::gbaSoundChannel2::GetSample() const
 {
     return (m_square.GetSample() != 0 ? 1 : -1) * m_volume.GetVolume();
 }
 
-bool gbaSoundChannel2::IsChannelOff() const
+// Genera count muestras a partir de first ciclos, las siguientes cada m_samplerclk ciclos; entre
+// pasos de longitud o envolvente solo corre el generador
+void gbaSound::gbaSoundChannel2::Render(s16 *out, s32 first, u32 count, bool audible)
+{
+    Sync(first);
+    out[0] = m_off ? 0 : GetSample();
+
+    for (u32 i = 1; i < count;)
+    {
+        s32 next = m_length.GetTicks() < m_volume.GetTicks() ? m_length.GetTicks() : m_volume.GetTicks();
+        u32 span = (u32)((next - 1) / m_samplerclk);
+        if (span > count - i) {span = count - i;}
+        if (span > 0)
+        {
+            m_square.Render(&out[i], span, (audible && !m_off) ? m_volume.GetVolume() : 0);
+            m_length.Sync(span * m_samplerclk);
+            m_volume.Sync(span * m_samplerclk);
+            i += span;
+        }
+        if (i < count) {Sync(m_samplerclk); out[i++] = m_off ? 0 : GetSample();}
+    }
+}
+
+bool gbaSound::gbaSoundChannel2::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaSoundChannel2::WriteNR21(u8 NR21)
+void gbaSound::gbaSoundChannel2::WriteNR21(u8 NR21)
 {
     m_square.SetDutyCycle(SUBVAL(NR21, 6, 3));
     m_length.SetCounter(64 - (NR21 & 63));
 }
 
-void gbaSoundChannel2::WriteNR22(u8 NR22)
+void gbaSound::gbaSoundChannel2::WriteNR22(u8 NR22)
 {
     m_volume.SetVolumeEnvelopeRegister(NR22);
 }
 
-void gbaSoundChannel2::WriteNR23(u8 NR23)
+void gbaSound::gbaSoundChannel2::WriteNR23(u8 NR23)
 {
     m_freq = (m_freq & 0x700) | NR23;
     m_square.SetFrequency(m_freq);
 }
 
-void gbaSoundChannel2::WriteNR24(u8 NR24)
+void gbaSound::gbaSoundChannel2::WriteNR24(u8 NR24)
 {
     m_length.SetEnable(NR24 & BIT(6));
     m_freq = (m_freq & 0xFF) | ((NR24 << 8) & 0x700);
@@ -852,20 +730,20 @@ void gbaSoundChannel2::WriteNR24(u8 NR24)
     m_off = false;
 }
 
-gbaSoundChannel3::gbaSoundChannel3()
+gbaSound::gbaSoundChannel3::gbaSoundChannel3()
 {
     m_length.SetMaxLength(256);
     Reset(false);
 }
 
-void gbaSoundChannel3::Sync(s32 ticks)
+void gbaSound::gbaSoundChannel3::Sync(s32 ticks)
 {
     m_wave.Sync(ticks);
     m_length.Sync(ticks);
     if (m_length.IsChannelOff()) {m_off = true;}
 }
 
-void gbaSoundChannel3::Reset(bool preservewaveram)
+void gbaSound::gbaSoundChannel3::Reset(bool preservewaveram)
 {
     m_freq = m_level = 0;
     m_off = true;
@@ -874,18 +752,47 @@ void gbaSoundChannel3::Reset(bool preservewaveram)
     m_length.Reset();
 }
 
-s32 gbaSoundChannel3::GetSample() const
+s32 gbaSound::gbaSoundChannel3::GetLevel(s32 sample) const
 {
-    s32 sample = (2 * m_wave.GetSample()) - 15 ;
+    sample = (2 * sample) - 15 ;
     return m_forcevol ? (sample * 3) / 4 : m_level != 0 ? sample >> (m_level - 1) : 0;
 }
 
-bool gbaSoundChannel3::IsChannelOff() const
+s32 gbaSound::gbaSoundChannel3::GetSample() const
+{
+    return GetLevel(m_wave.GetSample());
+}
+
+// Genera count muestras a partir de first ciclos, las siguientes cada m_samplerclk ciclos; entre
+// pasos de longitud solo corre el generador
+void gbaSound::gbaSoundChannel3::Render(s16 *out, s32 first, u32 count, bool audible)
+{
+    Sync(first);
+    out[0] = m_off ? 0 : GetSample();
+
+    for (u32 i = 1; i < count;)
+    {
+        s32 next = m_length.GetTicks();
+        u32 span = (u32)((next - 1) / m_samplerclk);
+        if (span > count - i) {span = count - i;}
+        if (span > 0)
+        {
+            s16 level[16];
+            for (s32 sample = 0; sample < 16; sample++) {level[sample] = (audible && !m_off) ? (s16)GetLevel(sample) : 0;}
+            m_wave.Render(&out[i], span, level);
+            m_length.Sync(span * m_samplerclk);
+            i += span;
+        }
+        if (i < count) {Sync(m_samplerclk); out[i++] = m_off ? 0 : GetSample();}
+    }
+}
+
+bool gbaSound::gbaSoundChannel3::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaSoundChannel3::WriteNR30(u8 NR30)
+void gbaSound::gbaSoundChannel3::WriteNR30(u8 NR30)
 {
     m_wave.SetDimension((NR30 & BIT(5)) != 0);
     m_wave.SetBank((NR30 & BIT(6)) != 0 ? 1 : 0);
@@ -893,24 +800,24 @@ void gbaSoundChannel3::WriteNR30(u8 NR30)
     if (m_wave.IsChannelOff()) {m_off = true;}
 }
 
-void gbaSoundChannel3::WriteNR31(u8 NR31)
+void gbaSound::gbaSoundChannel3::WriteNR31(u8 NR31)
 {
     m_length.SetCounter(256 - NR31);
 }
 
-void gbaSoundChannel3::WriteNR32(u8 NR32)
+void gbaSound::gbaSoundChannel3::WriteNR32(u8 NR32)
 {
     m_level = SUBVAL(NR32, 5, 3);
     m_forcevol = (NR32 & BIT(7)) != 0;
 }
 
-void gbaSoundChannel3::WriteNR33(u8 NR33)
+void gbaSound::gbaSoundChannel3::WriteNR33(u8 NR33)
 {
     m_freq = (m_freq & 0x700) | NR33;
     m_wave.SetFrequency(m_freq);
 }
 
-void gbaSoundChannel3::WriteNR34(u8 NR34)
+void gbaSound::gbaSoundChannel3::WriteNR34(u8 NR34)
 {
     m_length.SetEnable(NR34 & BIT(6));
     m_freq = (m_freq & 0xFF) | (((u32)NR34 << 8) & 0x700);
@@ -921,23 +828,23 @@ void gbaSoundChannel3::WriteNR34(u8 NR34)
     m_off = false;
 }
 
-void gbaSoundChannel3::WriteWavePattern(u8 offset, u8 byte)
+void gbaSound::gbaSoundChannel3::WriteWavePattern(u8 offset, u8 byte)
 {
     m_wave.WriteWaveRAM(offset, (s8)byte);
 }
 
-u8 gbaSoundChannel3::ReadWavePattern(u8 offset)
+u8 gbaSound::gbaSoundChannel3::ReadWavePattern(u8 offset)
 {
     return (u8)m_wave.ReadWaveRAM(offset);
 }
 
-gbaSoundChannel4::gbaSoundChannel4()
+gbaSound::gbaSoundChannel4::gbaSoundChannel4(bool const *output) : m_noise(output)
 {
     m_length.SetMaxLength(64);
     Reset();
 }
 
-void gbaSoundChannel4::Sync(s32 ticks)
+void gbaSound::gbaSoundChannel4::Sync(s32 ticks)
 {
     m_noise.Sync(ticks);
     m_length.Sync(ticks);
@@ -945,7 +852,7 @@ void gbaSoundChannel4::Sync(s32 ticks)
     if (m_length.IsChannelOff()) {m_off = true;}
 }
 
-void gbaSoundChannel4::Reset()
+void gbaSound::gbaSoundChannel4::Reset()
 {
     m_length.Reset();
     m_volume.Reset();
@@ -953,32 +860,55 @@ void gbaSoundChannel4::Reset()
     m_off = true;
 }
 
-s32 gbaSoundChannel4::GetSample() const
+s32 gbaSound::gbaSoundChannel4::GetSample() const
 {
     return (m_noise.GetSample() != 0 ? 1 : -1) * m_volume.GetVolume();
 }
 
-bool gbaSoundChannel4::IsChannelOff() const
+// Genera count muestras a partir de first ciclos, las siguientes cada m_samplerclk ciclos; entre
+// pasos de longitud o envolvente solo corre el generador
+void gbaSound::gbaSoundChannel4::Render(s16 *out, s32 first, u32 count, bool audible)
+{
+    Sync(first);
+    out[0] = m_off ? 0 : GetSample();
+
+    for (u32 i = 1; i < count;)
+    {
+        s32 next = m_length.GetTicks() < m_volume.GetTicks() ? m_length.GetTicks() : m_volume.GetTicks();
+        u32 span = (u32)((next - 1) / m_samplerclk);
+        if (span > count - i) {span = count - i;}
+        if (span > 0)
+        {
+            m_noise.Render(&out[i], span, (audible && !m_off) ? m_volume.GetVolume() : 0);
+            m_length.Sync(span * m_samplerclk);
+            m_volume.Sync(span * m_samplerclk);
+            i += span;
+        }
+        if (i < count) {Sync(m_samplerclk); out[i++] = m_off ? 0 : GetSample();}
+    }
+}
+
+bool gbaSound::gbaSoundChannel4::IsChannelOff() const
 {
     return m_off;
 }
 
-void gbaSoundChannel4::WriteNR41(u8 NR41)
+void gbaSound::gbaSoundChannel4::WriteNR41(u8 NR41)
 {
     m_length.SetCounter(64 - (NR41 & 63));
 }
 
-void gbaSoundChannel4::WriteNR42(u8 NR42)
+void gbaSound::gbaSoundChannel4::WriteNR42(u8 NR42)
 {
     m_volume.SetVolumeEnvelopeRegister(NR42);
 }
 
-void gbaSoundChannel4::WriteNR43(u8 NR43)
+void gbaSound::gbaSoundChannel4::WriteNR43(u8 NR43)
 {
     m_noise.SetNoiseRegister(NR43);
 }
 
-void gbaSoundChannel4::WriteNR44(u8 NR44)
+void gbaSound::gbaSoundChannel4::WriteNR44(u8 NR44)
 {
     m_length.SetEnable(NR44 & BIT(6));
     if ((NR44 & BIT(7)) == 0) {return;}
@@ -988,35 +918,36 @@ void gbaSoundChannel4::WriteNR44(u8 NR44)
     m_off = false;
 }
 
-gbaDirectSound::gbaDirectSound(u32 fifo)
+gbaSound::gbaDirectSound::gbaDirectSound(gbaConsole *console, u32 fifo)
 {
+    m_console = console;
     m_DMADRQ = fifo;
     Reset();
 }
 
-void gbaDirectSound::Reset()
+void gbaSound::gbaDirectSound::Reset()
 {
     m_sample = 0;
     m_sampleratetimer = gbaControl::IRQ_TIMER0;
     ResetFIFO();
 }
 
-void gbaDirectSound::SetTimer(gbaControl::InterruptFlag timerid)
+void gbaSound::gbaDirectSound::SetTimer(gbaControl::InterruptFlag timerid)
 {
     m_sampleratetimer = timerid;
 }
 
-gbaControl::InterruptFlag gbaDirectSound::GetTimer() const
+gbaControl::InterruptFlag gbaSound::gbaDirectSound::GetTimer() const
 {
     return m_sampleratetimer;
 }
 
-void gbaDirectSound::ResetFIFO()
+void gbaSound::gbaDirectSound::ResetFIFO()
 {
     while (!m_FIFO.empty()) {m_FIFO.pop();}
 }
 
-void gbaDirectSound::SendNextSample()
+void gbaSound::gbaDirectSound::SendNextSample()
 {
     if (!m_FIFO.empty())
     {
@@ -1027,20 +958,20 @@ void gbaDirectSound::SendNextSample()
     {
         m_sample = 0;
     }
-    if (m_FIFO.size() <= 16) {gbaDMA::OnFIFORequest(m_DMADRQ);}
+    if (m_FIFO.size() <= 16) {m_console->dma.OnFIFORequest(m_DMADRQ);}
 }
 
-s32 gbaDirectSound::GetSample() const
+s32 gbaSound::gbaDirectSound::GetSample() const
 {
     return m_sample;
 }
 
-void gbaDirectSound::WriteFIFOX_BX(u8 byte)
+void gbaSound::gbaDirectSound::WriteFIFOX_BX(u8 byte)
 {
     m_FIFO.push((s8)byte);
 }
 
-void SyncPSG(s32 ticks)
+void gbaSound::SyncPSG(s32 ticks)
 {
     if (!m_masterenable) {return;}
     m_sc1.Sync(ticks);
@@ -1049,7 +980,7 @@ void SyncPSG(s32 ticks)
     m_sc4.Sync(ticks);
 }
 
-void Reset(bool preservewaveram)
+void gbaSound::Reset(bool preservewaveram)
 {
     m_sc1.Reset();
     m_sc2.Reset();
@@ -1072,7 +1003,7 @@ void Reset(bool preservewaveram)
     m_SOUNDCNT_L.w = 0;
 }
 
-void Reset()
+void gbaSound::Reset()
 {
     Reset(false);
     m_PSGvol = 2;
@@ -1085,36 +1016,35 @@ void Reset()
     m_SOUNDCNT_X.b = BIT(7);
     m_SOUNDBIAS.w = 0x0200;
     m_samplerticks = m_samplerclk;
+    m_blockpos = m_psgpos = 0;
+    m_psglag = 0;
+    m_output = m_outputenable;
+    m_resamplepos = 0;
+    m_resamplelen = m_taps - 1;
+    memset(m_resamplein, 0, sizeof(m_resamplein));
+    m_console->scheduler.Register(gbaScheduler::EVENT_SOUND, SyncEvent, m_samplerticks);
+}
+
+s32 gbaSound::SyncEvent(gbaConsole *console, s32 ticks)
+{
+    return console->sound.Sync(ticks);
 }
 
-void OnTimerOverflow(gbaControl::InterruptFlag tmr)
+void gbaSound::OnTimerOverflow(gbaControl::InterruptFlag tmr)
 {
     if (!m_masterenable) {return;}
     if (m_dsA.GetTimer() == tmr) {m_dsA.SendNextSample();}
     if (m_dsB.GetTimer() == tmr) {m_dsB.SendNextSample();}
 }
 
-void GetSampleSO(s32 *m_right, s32 *m_left)
+// Solo Direct Sound, SyncChannels suma los canales PSG por bloques
+void gbaSound::GetSampleDS(s32 *m_right, s32 *m_left)
 {
     if (!m_masterenable)
     {
         *m_right = *m_left = 0;//m_biaslevel;
         return;
     }
-    bool chnon[4] = {!m_sc1.IsChannelOff(), !m_sc2.IsChannelOff(), !m_sc3.IsChannelOff(), !m_sc4.IsChannelOff()};
-    s32 sample[4] = {m_sc1.GetSample(), m_sc2.GetSample(), m_sc3.GetSample(), m_sc4.GetSample()};
-    s32 psg_r = 0;
-    if (chnon[0] && (m_SOXcnt[0] & BIT(0)) != 0) {psg_r += sample[0];}
-    if (chnon[1] && (m_SOXcnt[0] & BIT(1)) != 0) {psg_r += sample[1];}
-    if (chnon[2] && (m_SOXcnt[0] & BIT(2)) != 0) {psg_r += sample[2];}
-    if (chnon[3] && (m_SOXcnt[0] & BIT(3)) != 0) {psg_r += sample[3];}
-    psg_r = (psg_r * m_SOXvol[0]) >> m_PSGvol;
-    s32 psg_l = 0;
-    if (chnon[0] && (m_SOXcnt[1] & BIT(0)) != 0) {psg_l += sample[0];}
-    if (chnon[1] && (m_SOXcnt[1] & BIT(1)) != 0) {psg_l += sample[1];}
-    if (chnon[2] && (m_SOXcnt[1] & BIT(2)) != 0) {psg_l += sample[2];}
-    if (chnon[3] && (m_SOXcnt[1] & BIT(3)) != 0) {psg_l += sample[3];}
-    psg_l = (psg_l * m_SOXvol[1]) >> m_PSGvol;
     s32 ds_r = 0;
     if ((m_dscnt[0] & BIT(0)) != 0) {ds_r += m_dsA.GetSample() >> m_dsAvol;}
     if ((m_dscnt[0] & BIT(1)) != 0) {ds_r += m_dsB.GetSample() >> m_dsBvol;}
@@ -1131,135 +1061,208 @@ void GetSampleSO(s32 *m_right, s32 *m_left)
     //if (l < 0) {l = 0;} else if (l > 0x3FF) {l = 0x3FF;}
     //*m_right = r - m_biaslevel;
     //*m_left = l - m_biaslevel;
-    s32 r = psg_r + ds_r;
-    s32 l = psg_l + ds_l;
-    *m_right = r;
-    *m_left = l;
+    *m_right = ds_r;
+    *m_left = ds_l;
+}
+
+void gbaSound::MixPSGSample(s16 *target, u32 i)
+{
+    s32 r = 0;
+    s32 l = 0;
+    for (s32 c = 0; c < 4; c++)
+    {
+        if (BITTEST(m_SOXcnt[0], c)) {r += m_psgout[c][i];}
+        if (BITTEST(m_SOXcnt[1], c)) {l += m_psgout[c][i];}
+    }
+    target[0] += (s16)((l * m_SOXvol[1]) >> m_PSGvol);
+    target[1] += (s16)((r * m_SOXvol[0]) >> m_PSGvol);
 }
 
-void WriteSOUND1CNT_L(u8 byte)
+void gbaSound::MixPSGScalar(s16 *block, u32 count)
+{
+    for (u32 i = 0; i < count; i++) {MixPSGSample(&block[i * 2], i);}
+}
+
+#ifdef GBA_SOUND_SSE2
+// Las sumas de los 4 canales por el volumen caben en 16 bits
+void gbaSound::MixPSGSSE2(s16 *block, u32 count)
+{
+    __m128i volr  = _mm_set1_epi16((s16)m_SOXvol[0]);
+    __m128i voll  = _mm_set1_epi16((s16)m_SOXvol[1]);
+    __m128i shift = _mm_cvtsi32_si128(m_PSGvol);
+    u32 i = 0;
+
+    for (; (i + 8) <= count; i += 8)
+    {
+        __m128i r = _mm_setzero_si128();
+        __m128i l = _mm_setzero_si128();
+        for (s32 c = 0; c < 4; c++)
+        {
+            __m128i sample = _mm_loadu_si128((__m128i const *)&m_psgout[c][i]);
+            if (BITTEST(m_SOXcnt[0], c)) {r = _mm_add_epi16(r, sample);}
+            if (BITTEST(m_SOXcnt[1], c)) {l = _mm_add_epi16(l, sample);}
+        }
+        r = _mm_sra_epi16(_mm_mullo_epi16(r, volr), shift);
+        l = _mm_sra_epi16(_mm_mullo_epi16(l, voll), shift);
+        __m128i *target = (__m128i *)&block[i * 2];
+        _mm_storeu_si128(&target[0], _mm_add_epi16(_mm_loadu_si128(&target[0]), _mm_unpacklo_epi16(l, r)));
+        _mm_storeu_si128(&target[1], _mm_add_epi16(_mm_loadu_si128(&target[1]), _mm_unpackhi_epi16(l, r)));
+    }
+
+    for (; i < count; i++) {MixPSGSample(&block[i * 2], i);}
+}
+#endif
+
+// Pone al dia los canales PSG y suma su salida a los cuadros pendientes del bloque, antes de
+// acceder a sus registros y antes de enviar el bloque
+void gbaSound::SyncChannels()
+{
+    u32 pending = (m_blockpos / 2) - m_psgpos;
+    s32 elapsed = m_samplerclk - m_samplerticks;
+
+    if (pending > 0 && m_masterenable)
+    {
+        s32 first = m_psglag - elapsed - (((s32)pending - 1) * m_samplerclk);
+        s32 audible = m_SOXcnt[0] | m_SOXcnt[1];
+        m_sc1.Render(m_psgout[0], first, pending, BITTEST(audible, 0));
+        m_sc2.Render(m_psgout[1], first, pending, BITTEST(audible, 1));
+        m_sc3.Render(m_psgout[2], first, pending, BITTEST(audible, 2));
+        m_sc4.Render(m_psgout[3], first, pending, BITTEST(audible, 3));
+#ifdef GBA_SOUND_SSE2
+        if (m_simd) {MixPSGSSE2(&m_block[m_psgpos * 2], pending);} else
+#endif
+        MixPSGScalar(&m_block[m_psgpos * 2], pending);
+        m_psglag = elapsed;
+    }
+
+    SyncPSG(m_psglag);
+    m_psgpos = m_blockpos / 2;
+    m_psglag = 0;
+}
+
+void gbaSound::WriteSOUND1CNT_L(u8 byte)
 {
     m_SOUND1CNT_L.b = byte;
     m_sc1.WriteNR10(byte);
 }
 
-void WriteSOUND1CNT_H_B0(u8 byte)
+void gbaSound::WriteSOUND1CNT_H_B0(u8 byte)
 {
     m_SOUND1CNT_H.b.b0.b = byte;
     m_sc1.WriteNR11(byte);
 }
 
-void WriteSOUND1CNT_H_B1(u8 byte)
+void gbaSound::WriteSOUND1CNT_H_B1(u8 byte)
 {
     m_SOUND1CNT_H.b.b1.b = byte;
     m_sc1.WriteNR12(byte);
 }
 
-void WriteSOUND1CNT_X_B0(u8 byte)
+void gbaSound::WriteSOUND1CNT_X_B0(u8 byte)
 {
     m_SOUND1CNT_X.b.b0.b = byte;
     m_sc1.WriteNR13(byte);
 }
 
-void WriteSOUND1CNT_X_B1(u8 byte)
+void gbaSound::WriteSOUND1CNT_X_B1(u8 byte)
 {
     m_SOUND1CNT_X.b.b1.b = byte;
     m_sc1.WriteNR14(byte);
 }
 
-void WriteSOUND2CNT_L_B0(u8 byte)
+void gbaSound::WriteSOUND2CNT_L_B0(u8 byte)
 {
     m_SOUND2CNT_L.b.b0.b = byte;
     m_sc2.WriteNR21(byte);
 }
 
-void WriteSOUND2CNT_L_B1(u8 byte)
+void gbaSound::WriteSOUND2CNT_L_B1(u8 byte)
 {
     m_SOUND2CNT_L.b.b1.b = byte;
     m_sc2.WriteNR22(byte);
 }
 
-void WriteSOUND2CNT_H_B0(u8 byte)
+void gbaSound::WriteSOUND2CNT_H_B0(u8 byte)
 {
     m_SOUND2CNT_H.b.b0.b = byte;
     m_sc2.WriteNR23(byte);
 }
 
-void WriteSOUND2CNT_H_B1(u8 byte)
+void gbaSound::WriteSOUND2CNT_H_B1(u8 byte)
 {
     m_SOUND2CNT_H.b.b1.b = byte;
     m_sc2.WriteNR24(byte);
 }
 
-void WriteSOUND3CNT_L(u8 byte)
+void gbaSound::WriteSOUND3CNT_L(u8 byte)
 {
     m_SOUND3CNT_L.b = byte;
     m_sc3.WriteNR30(byte);
 }
 
-void WriteSOUND3CNT_H_B0(u8 byte)
+void gbaSound::WriteSOUND3CNT_H_B0(u8 byte)
 {
     m_SOUND3CNT_H.b.b0.b = byte;
     m_sc3.WriteNR31(byte);
 }
 
-void WriteSOUND3CNT_H_B1(u8 byte)
+void gbaSound::WriteSOUND3CNT_H_B1(u8 byte)
 {
     m_SOUND3CNT_H.b.b1.b = byte;
     m_sc3.WriteNR32(byte);
 }
 
-void WriteSOUND3CNT_X_B0(u8 byte)
+void gbaSound::WriteSOUND3CNT_X_B0(u8 byte)
 {
     m_SOUND3CNT_X.b.b0.b = byte;
     m_sc3.WriteNR33(byte);
 }
 
-void WriteSOUND3CNT_X_B1(u8 byte)
+void gbaSound::WriteSOUND3CNT_X_B1(u8 byte)
 {
     m_SOUND3CNT_X.b.b1.b = byte;
     m_sc3.WriteNR34(byte);
 }
 
-void WriteSOUND4CNT_L_B0(u8 byte)
+void gbaSound::WriteSOUND4CNT_L_B0(u8 byte)
 {
     m_SOUND4CNT_L.b.b0.b = byte;
     m_sc4.WriteNR41(byte);
 }
 
-void WriteSOUND4CNT_L_B1(u8 byte)
+void gbaSound::WriteSOUND4CNT_L_B1(u8 byte)
 {
     m_SOUND4CNT_L.b.b1.b = byte;
     m_sc4.WriteNR42(byte);
 }
 
-void WriteSOUND4CNT_H_B0(u8 byte)
+void gbaSound::WriteSOUND4CNT_H_B0(u8 byte)
 {
     m_SOUND4CNT_H.b.b0.b = byte;
     m_sc4.WriteNR43(byte);
 }
 
-void WriteSOUND4CNT_H_B1(u8 byte)
+void gbaSound::WriteSOUND4CNT_H_B1(u8 byte)
 {
     m_SOUND4CNT_H.b.b1.b = byte;
     m_sc4.WriteNR44(byte);
 }
 
-void WriteSOUNDCNT_L_B0(u8 byte)
+void gbaSound::WriteSOUNDCNT_L_B0(u8 byte)
 {
     m_SOUNDCNT_L.b.b0.b = byte;
     m_SOXvol[0] = (byte & 7) + 1;
     m_SOXvol[1] = SUBVAL(byte, 4, 7) + 1;
 }
 
-void WriteSOUNDCNT_L_B1(u8 byte)
+void gbaSound::WriteSOUNDCNT_L_B1(u8 byte)
 {
     m_SOUNDCNT_L.b.b1.b = byte;
     m_SOXcnt[0] = byte & 0x0F;
     m_SOXcnt[1] = SUBVAL(byte, 4, 0x0F);
 }
 
-void WriteSOUNDCNT_H_B0(u8 byte)
+void gbaSound::WriteSOUNDCNT_H_B0(u8 byte)
 {
     m_SOUNDCNT_H.b.b0.b = byte;
     m_PSGvol = 2 - (byte & 3);
@@ -1268,7 +1271,7 @@ void WriteSOUNDCNT_H_B0(u8 byte)
     m_dsBvol = (byte & BIT(3)) != 0 ? 0 : 1;
 }
 
-void WriteSOUNDCNT_H_B1(u8 byte)
+void gbaSound::WriteSOUNDCNT_H_B1(u8 byte)
 {
     m_SOUNDCNT_H.b.b1.b = byte & ~(0x88);
     m_dscnt[0] = ((byte & BIT(0)) != 0 ? BIT(0) : 0) | ((byte & BIT(4)) != 0 ? BIT(1) : 0);
@@ -1279,7 +1282,7 @@ void WriteSOUNDCNT_H_B1(u8 byte)
     if ((byte & BIT(7)) != 0) {m_dsB.ResetFIFO();}
 }
 
-void WriteSOUNDCNT_X(u8 byte)
+void gbaSound::WriteSOUNDCNT_X(u8 byte)
 {
     m_SOUNDCNT_X.b = byte;
     bool nextmenable = (byte & BIT(7)) != 0;
@@ -1287,19 +1290,19 @@ void WriteSOUNDCNT_X(u8 byte)
     m_masterenable = nextmenable;
 }
 
-void WriteSOUNDBIAS_B0(u8 byte)
+void gbaSound::WriteSOUNDBIAS_B0(u8 byte)
 {
     m_SOUNDBIAS.b.b0.b = byte;
     m_biaslevel = m_SOUNDBIAS.w & 0x3FF;
 }
 
-void WriteSOUNDBIAS_B1(u8 byte)
+void gbaSound::WriteSOUNDBIAS_B1(u8 byte)
 {
     m_SOUNDBIAS.b.b1.b = byte;
     m_biaslevel = m_SOUNDBIAS.w & 0x3FF;
 }
 
-u8 ReadSOUNDCNT_X()
+u8 gbaSound::ReadSOUNDCNT_X()
 {
     if (!m_masterenable) {return 0;}
     u8 f = BIT(7);
@@ -1310,10 +1313,12 @@ u8 ReadSOUNDCNT_X()
     return f;
 }
 
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
+void gbaSound::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
 {
     u8 bytes[4] = {data->w.w0.b.b0.b, data->w.w0.b.b1.b, data->w.w1.b.b0.b, data->w.w1.b.b1.b};
     u32 base = address & ~(width - 1);
+    m_console->scheduler.Sync(gbaScheduler::EVENT_SOUND);
+    SyncChannels();
 
     for (u32 i = 0; i < (u32)width; i++)
     {
@@ -1372,10 +1377,12 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width)
     }
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
+void gbaSound::ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
 {
     u8 *bytes[4] = {&data->w.w0.b.b0.b, &data->w.w0.b.b1.b, &data->w.w1.b.b0.b, &data->w.w1.b.b1.b};
     u32 base = address & ~(width - 1);
+    m_console->scheduler.Sync(gbaScheduler::EVENT_SOUND);
+    SyncChannels();
 
     for (u32 i = 0; i < (u32)width; i++)
     {
@@ -1445,29 +1452,198 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width)
     }
 }
 
-s32 PartialSync()
+// Corte en el menor de los dos Nyquist, cada fase normalizada a ganancia 1
+void gbaSound::BuildFilter()
+{
+    double const pi = 3.14159265358979323846;
+    double cutoff = 0.45 * (m_samplerate < GBA_SAMPLERATE ? (double)m_samplerate / GBA_SAMPLERATE : 1.0);
+
+    for (u32 phase = 0; phase < m_phases; phase++)
+    {
+        double h[m_taps];
+        double sum = 0.0;
+        for (u32 k = 0; k < m_taps; k++)
+        {
+            double t = (double)k - ((m_taps / 2) - 1) - ((double)phase / m_phases);
+            double x = 2.0 * pi * cutoff * t;
+            double w = (2.0 * pi * (t + (m_taps / 2))) / m_taps;
+            h[k] = (t == 0.0 ? 1.0 : sin(x) / x) * (0.42 - (0.5 * cos(w)) + (0.08 * cos(2.0 * w)));
+            sum += h[k];
+        }
+        for (u32 k = 0; k < m_taps; k++) {m_fir[phase][k] = (float)(h[k] / sum);}
+    }
+}
+
+// Devuelve los cuadros escritos en m_resampled, se guardan los ultimos m_taps - 1 de entrada
+u32 gbaSound::Resample(s16 const *samples, u32 count)
+{
+    float *in = &m_resamplein[m_resamplelen * 2];
+    for (u32 i = 0; i < count * 2; i++) {in[i] = samples[i];}
+    m_resamplelen += count;
+
+    u32 frames = 0;
+    for (;;)
+    {
+        u32 index = (u32)(m_resamplepos >> 32);
+        if (index + m_taps > m_resamplelen) {break;}
+        float const *x = &m_resamplein[index * 2];
+        float const *h = m_fir[(u32)(m_resamplepos >> 24) & (m_phases - 1)];
+        float l = 0.0f;
+        float r = 0.0f;
+        for (u32 k = 0; k < m_taps; k++)
+        {
+            l += x[(k * 2) + 0] * h[k];
+            r += x[(k * 2) + 1] * h[k];
+        }
+        s32 sl = (s32)floorf(l + 0.5f);
+        s32 sr = (s32)floorf(r + 0.5f);
+        m_resampled[(frames * 2) + 0] = (s16)(sl < -32768 ? -32768 : sl > 32767 ? 32767 : sl);
+        m_resampled[(frames * 2) + 1] = (s16)(sr < -32768 ? -32768 : sr > 32767 ? 32767 : sr);
+        frames++;
+        m_resamplepos += m_resamplestep;
+    }
+
+    u32 consumed = (u32)(m_resamplepos >> 32);
+    memmove(m_resamplein, &m_resamplein[consumed * 2], (m_resamplelen - consumed) * 2 * sizeof(float));
+    m_resamplelen -= consumed;
+    m_resamplepos -= (u64)consumed << 32;
+    return frames;
+}
+
+void gbaSound::SendBlock(u32 count)
+{
+    if (m_samplerate == GBA_SAMPLERATE) {Emulator::SendSoundBlock(m_console, m_block, count); return;}
+    u32 frames = Resample(m_block, count);
+    if (frames > 0) {Emulator::SendSoundBlock(m_console, m_resampled, frames);}
+}
+
+s32 gbaSound::PartialSync()
 {
     s32 ret = m_samplerticks;
-    SyncPSG(m_samplerticks);
+    m_psglag += m_samplerticks;
     s32 r = 0;
     s32 l = 0;
-    GetSampleSO(&r, &l);
-    Emulator::SendSoundSample(l, r);
+    GetSampleDS(&r, &l);
+    m_block[m_blockpos]     = (s16)l;
+    m_block[m_blockpos + 1] = (s16)r;
+    m_blockpos += 2;
     m_samplerticks = m_samplerclk;
+    if (m_blockpos >= GBA_SOUNDBLOCK * 2)
+    {
+        SyncChannels();
+        SendBlock(GBA_SOUNDBLOCK);
+        m_blockpos = m_psgpos = 0;
+    }
     return ret;
 }
 
-void Sync(s32 ticks)
+// Sin audio solo se mantiene lo que el CPU puede leer: canales activos (longitud, barrido),
+// banco de la onda y FIFOs, que siguen a los timers y piden DMA en OnTimerOverflow. El evento
+// conserva su periodo porque define los lotes de ejecucion del CPU
+s32 gbaSound::QuietSync(s32 ticks)
+{
+    m_psglag += ticks;
+    if (m_psglag >= m_quietclk) {SyncPSG(m_psglag); m_psglag = 0;}
+    m_samplerticks -= ticks;
+    if (m_samplerticks <= 0) {m_samplerticks = (m_samplerticks % m_samplerclk) + m_samplerclk;}
+    return m_samplerticks;
+}
+
+s32 gbaSound::Sync(s32 ticks)
 {
+    if (!m_output) {return QuietSync(ticks);}
     s32 t = ticks;
     while (m_samplerticks <= t) {t -= PartialSync();}
-    if (t <= 0) {return;}
-    m_samplerticks -= t;
-    SyncPSG(t);
+    if (t > 0)
+    {
+        m_samplerticks -= t;
+        m_psglag += t;
+    }
+    return m_samplerticks;
 }
 
-s32 GetNextEvent()
+// Envia los cuadros pendientes del bloque actual, al detener la emulacion
+void gbaSound::Flush()
 {
-    return m_samplerticks;
+    SyncChannels();
+    if (m_blockpos > 0) {SendBlock(m_blockpos / 2);}
+    m_blockpos = m_psgpos = 0;
+}
+
+void gbaSound::EnableSIMD(bool enable)
+{
+    m_simd = enable;
+}
+
+// Antes de iniciar la emulacion
+bool gbaSound::SetSampleRate(u32 rate)
+{
+    if (rate < GBA_SAMPLERATEMIN || rate > GBA_SAMPLERATEMAX)
+    {
+        Emulator::LogMessage("Frecuencia de muestreo no soportada: %u Hz (%u-%u)", rate, GBA_SAMPLERATEMIN, GBA_SAMPLERATEMAX);
+        return false;
+    }
+    m_samplerate = rate;
+    m_resamplestep = ((u64)GBA_SAMPLERATE << 32) / rate;
+    if (rate != GBA_SAMPLERATE) {BuildFilter();}
+    return true;
+}
+
+u32 gbaSound::GetSampleRate() const
+{
+    return m_samplerate;
+}
+
+// Se aplica en el siguiente Reset, sin audio no se llama a Emulator::SendSoundBlock
+void gbaSound::EnableOutput(bool enable)
+{
+    m_outputenable = enable;
+}
+
+gbaSound::SampleRing::SampleRing() : m_head(0), m_tail(0)
+{
+}
+
+// Solo cuando ni el productor ni el consumidor estan usando la cola
+void gbaSound::SampleRing::Reset()
+{
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
 }
+
+u32 gbaSound::SampleRing::GetAvailable() const
+{
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+}
+
+// Descarta los cuadros que no caben, devuelve los que se escribieron
+u32 gbaSound::SampleRing::Write(s16 const *samples, u32 count)
+{
+    u32 head  = m_head.load(std::memory_order_relaxed);
+    u32 space = GBA_SOUNDRING - (head - m_tail.load(std::memory_order_acquire));
+    if (count > space) {count = space;}
+
+    u32 index = head & (GBA_SOUNDRING - 1);
+    u32 first = (count < GBA_SOUNDRING - index) ? count : (GBA_SOUNDRING - index);
+    memcpy(&m_buffer[index * 2], samples,             first           * 2 * sizeof(s16));
+    memcpy(m_buffer,             &samples[first * 2], (count - first) * 2 * sizeof(s16));
+
+    m_head.store(head + count, std::memory_order_release);
+    return count;
+}
+
+// Devuelve los cuadros que se leyeron
+u32 gbaSound::SampleRing::Read(s16 *samples, u32 count)
+{
+    u32 tail      = m_tail.load(std::memory_order_relaxed);
+    u32 available = m_head.load(std::memory_order_acquire) - tail;
+    if (count > available) {count = available;}
+
+    u32 index = tail & (GBA_SOUNDRING - 1);
+    u32 first = (count < GBA_SOUNDRING - index) ? count : (GBA_SOUNDRING - index);
+    memcpy(samples,             &m_buffer[index * 2], first           * 2 * sizeof(s16));
+    memcpy(&samples[first * 2], m_buffer,             (count - first) * 2 * sizeof(s16));
+
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
 }
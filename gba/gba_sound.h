@@ -5,18 +5,421 @@
 //*************************************************************************************************
 
 #pragma once
+#include <atomic>
+#include <queue>
 #include "../types.h"
 #include "gba_control.h"
 #include "gba_memory.h"
 
-#define GBA_SAMPLERATE 32768
+#define GBA_SAMPLERATE    32768  // Frecuencia del mezclador, la del PWM del GBA con SOUNDBIAS por defecto
+#define GBA_SAMPLERATEMIN 8000   // Limites de SetSampleRate
+#define GBA_SAMPLERATEMAX 192000
+#define GBA_SOUNDBLOCK 512  // Cuadros estereo del mezclador por cada llamada a Emulator::SendSoundBlock
+#define GBA_SOUNDRING  8192 // Cuadros estereo de SampleRing, potencia de 2
 
-namespace gbaSound
+class gbaConsole;
+
+class gbaSound
 {
-void Sync(s32 ticks);
-void Reset();
-s32 GetNextEvent();
-void OnTimerOverflow(gbaControl::InterruptFlag timer);
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-}
+public:
+    // Cola sin bloqueos de cuadros estereo (s16 intercalados) para un solo productor, el hilo del
+    // emulador desde SendSoundBlock, y un solo consumidor, el hilo de audio del frontend
+    class SampleRing
+    {
+    private:
+        s16 m_buffer[GBA_SOUNDRING * 2];
+        std::atomic<u32> m_head; // Cuadros escritos, solo lo cambia el productor
+        std::atomic<u32> m_tail; // Cuadros leidos, solo lo cambia el consumidor
+
+    public:
+        SampleRing();
+        void Reset();
+        u32 GetAvailable() const;
+        u32 Write(s16 const *samples, u32 count);
+        u32 Read(s16 *samples, u32 count);
+    };
+
+    gbaSound(gbaConsole *console);
+
+    void Reset();
+    void Flush();
+    void EnableSIMD(bool enable);
+    bool SetSampleRate(u32 rate);
+    u32 GetSampleRate() const;
+    void EnableOutput(bool enable);
+    void OnTimerOverflow(gbaControl::InterruptFlag timer);
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
+
+private:
+    class gbaSquarePattern
+    {
+    private:
+        static const s8 m_pattern[4][8];
+        s32 m_out;
+        s32 m_ticks;
+        s32 m_freq;
+        s32 m_dutycycle;
+
+        void DoReloadCounter();
+        void DoSync();
+
+    public:
+        gbaSquarePattern();
+        void Sync(s32 ticks);
+        void Reset();
+        void Init();
+        s8 GetSample() const;
+        void Render(s16 *out, u32 count, s32 amplitude);
+        void SetDutyCycle(s32 dutycycle);
+        void SetFrequency(s32 frequency);
+        s32 GetFrequency();
+    };
+
+    class gbaSweepUnit
+    {
+    private:
+        gbaSquarePattern *m_square;
+        s32 m_ticks;
+        s32 m_time;
+        s32 m_direction;
+        s32 m_shifts;
+        s32 m_counter;
+        s32 m_freq;
+        s32 m_nextfreq;
+        bool m_off;
+        bool m_active;    
+
+        void DoReloadCounter();
+        void DoSweepFrequency();
+        bool DoSync();
+        s32 PartialSync();
+
+    public:
+        gbaSweepUnit(gbaSquarePattern *square);
+        void Sync(s32 ticks);
+        void Reset();
+        void Init(s32 frequency);
+        s32 GetFrequency() const;
+        s32 GetTicks() const;
+        void Advance(s32 ticks);
+        bool IsChannelOff() const;
+        void SetSweepRegister(u8 NRX0);
+    };
+
+    class gbaSoundLength
+    {
+    private:
+        s32 m_counter;
+        s32 m_maxlength;
+        bool m_off;
+        bool m_active;
+        s32 m_ticks;
+
+        void DoReloadCounter();
+        void DoSync();
+
+    public:
+        gbaSoundLength();
+        void Sync(s32 ticks);
+        void Reset();
+        void Init();
+        s32 GetTicks() const;
+        bool IsChannelOff() const;
+        void SetMaxLength(s32 maxlength);
+        void SetCounter(s32 counter);
+        void SetEnable(s32 enable);
+    };
+
+    class gbaVolumeEnvelope
+    {
+    private:
+        s32 m_ticks;
+        s32 m_initvol;
+        s32 m_vol;
+        s32 m_direction;
+        s32 m_step;
+        s32 m_counter;
+        bool m_active;
+
+        void DoReloadCounter();
+        void DoStep();
+        void DoSync();
+
+    public:
+        gbaVolumeEnvelope();
+        void Sync(s32 ticks);
+        void Reset();
+        void Init();
+        s32 GetTicks() const;
+        s32 GetVolume() const;
+        void SetVolumeEnvelopeRegister(u8 NRX2);
+    };
+
+    class gbaWavePattern
+    {
+    private:
+        s8 m_pattern[2][16];
+        s32 m_position;
+        s32 m_ticks;
+        s32 m_freq;
+        s8 m_sample;
+        s32 m_playbank;
+        s32 m_databank;
+        s32 m_initbank;
+        bool m_use2banks;
+        bool m_off;
+        bool m_enable;
+
+        void DoReloadCounter();
+        void DoSync();
+
+    public:
+        gbaWavePattern();
+        void Sync(s32 ticks);
+        void Reset(bool preservewaveram);
+        void Init();
+        s8 GetSample() const;
+        void Render(s16 *out, u32 count, s16 const *level);
+        bool IsChannelOff() const;
+        void SetOutputEnable(s32 enable);
+        void SetFrequency(s32 frequency);
+        void SetBank(s32 bank);
+        void SetDimension(bool use2banks);
+        void WriteWaveRAM(u8 offset, s8 samples);
+        s8 ReadWaveRAM(u8 offset);
+    };
+
+    class gbaNoisePattern
+    {
+    private:
+        static const u32 m_pattern[2][2];
+        bool const *m_output; // Salida de audio de la consola, sin ella solo se lleva el periodo
+        u32 m_shiftreg;
+        s32 m_ratio;
+        s32 m_shiftclk;
+        s32 m_width;
+        s32 m_ticks;
+        s8 m_sample;
+
+        void DoReloadCounter();
+        void DoSync();
+
+    public:
+        gbaNoisePattern(bool const *output);
+        void Sync(s32 ticks);
+        void Reset();
+        void Init();
+        s8 GetSample() const;
+        void Render(s16 *out, u32 count, s32 amplitude);
+        void SetNoiseRegister(u8 NR43);
+    };
+
+    class gbaSoundChannel1
+    {
+    private:
+        gbaSquarePattern m_square;
+        gbaSweepUnit m_sweep;
+        gbaSoundLength m_length;
+        gbaVolumeEnvelope m_volume;
+        s32 m_freq;
+        bool m_off;
+
+    public:
+        gbaSoundChannel1();
+        void Sync(s32 ticks);
+        void Reset();
+        s32 GetSample() const;
+        void Render(s16 *out, s32 first, u32 count, bool audible);
+        bool IsChannelOff() const;
+        void WriteNR10(u8 NR10);
+        void WriteNR11(u8 NR11);
+        void WriteNR12(u8 NR12);
+        void WriteNR13(u8 NR13);
+        void WriteNR14(u8 NR14);
+    };
+
+    class gbaSoundChannel2
+    {
+    private:
+        gbaSquarePattern m_square;
+        gbaSoundLength m_length;
+        gbaVolumeEnvelope m_volume;
+        s32 m_freq;
+        bool m_off;
+
+    public:
+        gbaSoundChannel2();
+        void Sync(s32 ticks);
+        void Reset();
+        s32 GetSample() const;
+        void Render(s16 *out, s32 first, u32 count, bool audible);
+        bool IsChannelOff() const;
+        void WriteNR21(u8 NR21);
+        void WriteNR22(u8 NR22);
+        void WriteNR23(u8 NR23);
+        void WriteNR24(u8 NR24);
+    };
+
+    class gbaSoundChannel3
+    {
+    private:
+        gbaWavePattern m_wave;
+        gbaSoundLength m_length;
+        s32 m_freq;
+        s32 m_level;
+        bool m_off;
+        bool m_forcevol;
+
+        s32 GetLevel(s32 sample) const;
+
+    public:
+        gbaSoundChannel3();
+        void Sync(s32 ticks);
+        void Reset(bool preservewaveram);
+        s32 GetSample() const;
+        void Render(s16 *out, s32 first, u32 count, bool audible);
+        bool IsChannelOff() const;
+        void WriteNR30(u8 NR30);
+        void WriteNR31(u8 NR31);
+        void WriteNR32(u8 NR32);
+        void WriteNR33(u8 NR33);
+        void WriteNR34(u8 NR34);
+        void WriteWavePattern(u8 offset, u8 byte);
+        u8 ReadWavePattern(u8 offset);
+    };
+
+    class gbaSoundChannel4
+    {
+    private:
+        gbaSoundLength m_length;
+        gbaVolumeEnvelope m_volume;
+        gbaNoisePattern m_noise;
+        bool m_off;
+
+    public:
+        gbaSoundChannel4(bool const *output);
+        void Sync(s32 ticks);
+        void Reset();
+        s32 GetSample() const;
+        void Render(s16 *out, s32 first, u32 count, bool audible);
+        bool IsChannelOff() const;
+        void WriteNR41(u8 NR41);
+        void WriteNR42(u8 NR42);
+        void WriteNR43(u8 NR43);
+        void WriteNR44(u8 NR44);
+    };
+
+    class gbaDirectSound
+    {
+    private:
+        gbaConsole *m_console;
+        std::queue<s8> m_FIFO;
+        s8 m_sample;
+        gbaControl::InterruptFlag m_sampleratetimer;
+        u32 m_DMADRQ;
+
+    public:
+        gbaDirectSound(gbaConsole *console, u32 fifo);
+        void Reset();
+        void SetTimer(gbaControl::InterruptFlag timerid);
+        gbaControl::InterruptFlag GetTimer() const;
+        void ResetFIFO();
+        void SendNextSample();
+        s32 GetSample() const;
+        void WriteFIFOX_BX(u8 byte);
+    };
+
+    gbaConsole *m_console;
+    bool m_outputenable; // Valor pedido con EnableOutput, se aplica en Reset
+    bool m_output;
+    s16 m_block[GBA_SOUNDBLOCK * 2];
+    u32 m_blockpos;
+    s16 m_psgout[4][GBA_SOUNDBLOCK];
+    u32 m_psgpos; // Primer cuadro del bloque sin los canales PSG
+    s32 m_psglag; // Ciclos que los canales PSG van detras del sampler
+    bool m_simd; // Mezcla de los canales PSG con SSE2 cuando esta disponible
+
+    // Remuestreo polifasico con sinc enventanada (Blackman) de GBA_SAMPLERATE a m_samplerate
+    static const u32 m_taps = 16;
+    static const u32 m_phases = 256;
+    static const u32 m_resampledmax = ((GBA_SOUNDBLOCK * (u64)GBA_SAMPLERATEMAX) / GBA_SAMPLERATE) + 2;
+    u32 m_samplerate;
+    u64 m_resamplestep;  // Cuadros de entrada por cuadro de salida, 32.32
+    u64 m_resamplepos;   // Posicion en m_resamplein, 32.32
+    u32 m_resamplelen;   // Cuadros en m_resamplein
+    float m_fir[m_phases][m_taps];
+    float m_resamplein[(GBA_SOUNDBLOCK + m_taps) * 2];
+    s16 m_resampled[m_resampledmax * 2];
+    gbaSoundChannel1 m_sc1;
+    gbaSoundChannel2 m_sc2;
+    gbaSoundChannel3 m_sc3;
+    gbaSoundChannel4 m_sc4;
+    gbaDirectSound m_dsA;
+    gbaDirectSound m_dsB;
+    bool m_masterenable;
+    s32 m_SOXvol[2];
+    s32 m_SOXcnt[2];
+    s32 m_PSGvol;
+    s32 m_dsAvol;
+    s32 m_dsBvol;
+    s32 m_dscnt[2];
+    s32 m_biaslevel;
+    t8 m_SOUND1CNT_L;
+    t16 m_SOUND1CNT_H;
+    t16 m_SOUND1CNT_X;
+    t16 m_SOUND2CNT_L;
+    t16 m_SOUND2CNT_H;
+    t8 m_SOUND3CNT_L;
+    t16 m_SOUND3CNT_H;
+    t16 m_SOUND3CNT_X;
+    t16 m_SOUND4CNT_L;
+    t16 m_SOUND4CNT_H;
+    t16 m_SOUNDCNT_L;
+    t16 m_SOUNDCNT_H;
+    t8 m_SOUNDCNT_X;
+    t16 m_SOUNDBIAS;
+    s32 m_samplerticks;
+
+    static s32 SyncEvent(gbaConsole *console, s32 ticks);
+
+    void SyncPSG(s32 ticks);
+    void Reset(bool preservewaveram);
+    void GetSampleDS(s32 *m_right, s32 *m_left);
+    void MixPSGSample(s16 *target, u32 i);
+    void MixPSGScalar(s16 *block, u32 count);
+    void MixPSGSSE2(s16 *block, u32 count);
+    void SyncChannels();
+    void WriteSOUND1CNT_L(u8 byte);
+    void WriteSOUND1CNT_H_B0(u8 byte);
+    void WriteSOUND1CNT_H_B1(u8 byte);
+    void WriteSOUND1CNT_X_B0(u8 byte);
+    void WriteSOUND1CNT_X_B1(u8 byte);
+    void WriteSOUND2CNT_L_B0(u8 byte);
+    void WriteSOUND2CNT_L_B1(u8 byte);
+    void WriteSOUND2CNT_H_B0(u8 byte);
+    void WriteSOUND2CNT_H_B1(u8 byte);
+    void WriteSOUND3CNT_L(u8 byte);
+    void WriteSOUND3CNT_H_B0(u8 byte);
+    void WriteSOUND3CNT_H_B1(u8 byte);
+    void WriteSOUND3CNT_X_B0(u8 byte);
+    void WriteSOUND3CNT_X_B1(u8 byte);
+    void WriteSOUND4CNT_L_B0(u8 byte);
+    void WriteSOUND4CNT_L_B1(u8 byte);
+    void WriteSOUND4CNT_H_B0(u8 byte);
+    void WriteSOUND4CNT_H_B1(u8 byte);
+    void WriteSOUNDCNT_L_B0(u8 byte);
+    void WriteSOUNDCNT_L_B1(u8 byte);
+    void WriteSOUNDCNT_H_B0(u8 byte);
+    void WriteSOUNDCNT_H_B1(u8 byte);
+    void WriteSOUNDCNT_X(u8 byte);
+    void WriteSOUNDBIAS_B0(u8 byte);
+    void WriteSOUNDBIAS_B1(u8 byte);
+    u8 ReadSOUNDCNT_X();
+    void BuildFilter();
+    u32 Resample(s16 const *samples, u32 count);
+    void SendBlock(u32 count);
+    s32 PartialSync();
+    s32 QuietSync(s32 ticks);
+    s32 Sync(s32 ticks);
+};
@@ -5,160 +5,132 @@
 //*************************************************************************************************
 
 #include "../emulator.h"
-#include "gba_control.h"
-#include "gba_sound.h"
+#include "gba_console.h"
 #include "gba_timer.h"
 
-namespace gbaTimer {
-class gbaTimerBase {
-private:
-    gbaControl::InterruptFlag m_IRQ;
-    gbaTimerBase             *m_cup;
-
-    t16 m_counter;
-    t16 m_reload;
-    t16 m_TMXCNT_H;
-
-    void ReloadCounter();
-    void OnOverflow();
-    void Increment();
-
-protected:
-    gbaTimerBase(gbaControl::InterruptFlag irq, gbaTimerBase *cup);
-
-public:
-    void Reset();
-    void PrescalerSync(s32 clk);
-    bool IsEnabled() const;
-    bool IsSlave() const;
-    u16 GetCounter() const;
-    u32 GetPrescaler() const;
-    void WriteTMXCNT_L_B0(u8 byte);
-    void WriteTMXCNT_L_B1(u8 byte);
-    void WriteTMXCNT_H_B0(u8 byte);
-    u8 ReadTMXCNT_L_B0() const;
-    u8 ReadTMXCNT_L_B1() const;
-    u8 ReadTMXCNT_H_B0() const;
-};
-
-class gbaTimer3 : public gbaTimerBase {public: gbaTimer3();};
-class gbaTimer2 : public gbaTimerBase {public: gbaTimer2();};
-class gbaTimer1 : public gbaTimerBase {public: gbaTimer1();};
-class gbaTimer0 : public gbaTimerBase {public: gbaTimer0();};
-
-const s32 m_prescalerclk[4] = {1, 64, 256, 1024};
-
-s32 m_prescalerticks[4];
-s32 m_prescalercount[4];
-
-gbaTimer3 m_timer3;
-gbaTimer2 m_timer2;
-gbaTimer1 m_timer1;
-gbaTimer0 m_timer0;
-
-gbaTimerBase::gbaTimerBase(gbaControl::InterruptFlag irq, gbaTimerBase *cup) {
+// El prescaler avanza en los multiplos de 1, 64, 256 y 1024 ciclos desde el reset
+const u32 m_prescalershift[4] = {0, 6, 8, 10};
+
+gbaTimer::gbaTimerBase::gbaTimerBase(gbaConsole *console, gbaControl::InterruptFlag irq, gbaTimerBase *cup) {
+    m_console = console;
     m_IRQ = irq;
     m_cup = cup;
     Reset();
 }
 
-void gbaTimerBase::ReloadCounter() {m_counter.w = m_reload.w;}
+void gbaTimer::gbaTimerBase::ReloadCounter() {m_counter.w = m_reload.w;}
 
-void gbaTimerBase::OnOverflow() {
+void gbaTimer::gbaTimerBase::OnOverflow() {
     ReloadCounter();
-    if (BITTEST(m_TMXCNT_H.w, 6)) {gbaControl::RequestInterrupt(m_IRQ);}
-    if (m_IRQ == gbaControl::IRQ_TIMER0 || m_IRQ == gbaControl::IRQ_TIMER1) {gbaSound::OnTimerOverflow(m_IRQ);}
+    if (BITTEST(m_TMXCNT_H.w, 6)) {m_console->control.RequestInterrupt(m_IRQ);}
+    if (m_IRQ == gbaControl::IRQ_TIMER0 || m_IRQ == gbaControl::IRQ_TIMER1) {m_console->sound.OnTimerOverflow(m_IRQ);}
     if (m_cup != 0 && m_cup->IsEnabled() && m_cup->IsSlave()) {m_cup->Increment();}
 }
 
-void gbaTimerBase::Increment() {if (++m_counter.w == 0) {OnOverflow();}}
+void gbaTimer::gbaTimerBase::Increment() {if (++m_counter.w == 0) {OnOverflow();}}
 
-void gbaTimerBase::Reset() {
+void gbaTimer::gbaTimerBase::Reset() {
     m_counter.w  = 0;
     m_reload.w   = 0;
     m_TMXCNT_H.w = 0;
+    m_start      = 0;
 }
 
-void gbaTimerBase::PrescalerSync(s32 clk) {
-    u32 diff;
-    if (IsEnabled() && !IsSlave()) {
-        while (clk > 0) {
-            diff = 0x10000 - m_counter.w;
-            if ((u32)clk >= diff) {
-                OnOverflow();
-                clk -= diff;
-            }
-            else {
-                m_counter.w += clk & 0xFFFF;
-                clk = 0;
-            }
+// Atiende los desbordes hasta time, los timers en cascada avanzan desde OnOverflow
+void gbaTimer::gbaTimerBase::Sync(u64 time) {
+    if (IsRunning()) {
+        u32 shift = m_prescalershift[GetPrescaler()];
+        u64 steps = (time >> shift) - (m_start >> shift);
+        while (steps >= 0x10000U - m_counter.w) {
+            steps -= 0x10000U - m_counter.w;
+            OnOverflow();
         }
+        m_counter.w += (u16)steps;
     }
+    m_start = time;
+}
+
+bool gbaTimer::gbaTimerBase::IsEnabled() const {return BITTEST(m_TMXCNT_H.w, 7);}
+bool gbaTimer::gbaTimerBase::IsSlave() const {return m_IRQ != gbaControl::IRQ_TIMER0 && BITTEST(m_TMXCNT_H.w, 2);}
+bool gbaTimer::gbaTimerBase::IsRunning() const {return IsEnabled() && !IsSlave();}
+
+// El contador se calcula a partir del reloj en lugar de incrementarse en cada sincronizacion
+u16 gbaTimer::gbaTimerBase::GetCounter(u64 time) const {
+    if (!IsRunning()) {return m_counter.w;}
+    u32 shift = m_prescalershift[GetPrescaler()];
+    u64 steps = (time >> shift) - (m_start >> shift);
+    if (steps < 0x10000U - m_counter.w) {return m_counter.w + (u16)steps;}
+    steps -= 0x10000U - m_counter.w;
+    return m_reload.w + (u16)(steps % (0x10000U - m_reload.w));
 }
 
-bool gbaTimerBase::IsEnabled() const {return BITTEST(m_TMXCNT_H.w, 7);}
-bool gbaTimerBase::IsSlave() const {return m_IRQ != gbaControl::IRQ_TIMER0 && BITTEST(m_TMXCNT_H.w, 2);}
-u16 gbaTimerBase::GetCounter() const {return m_counter.w;}
-u32 gbaTimerBase::GetPrescaler() const {return SUBVAL(m_TMXCNT_H.w, 0, 0x03);}
+u32 gbaTimer::gbaTimerBase::GetPrescaler() const {return SUBVAL(m_TMXCNT_H.w, 0, 0x03);}
 
-void gbaTimerBase::WriteTMXCNT_L_B0(u8 byte) {m_reload.b.b0.b = byte;}
-void gbaTimerBase::WriteTMXCNT_L_B1(u8 byte) {m_reload.b.b1.b = byte;}
+s32 gbaTimer::gbaTimerBase::GetNextOverflow(u64 time) const {
+    u32 shift = m_prescalershift[GetPrescaler()];
+    return (s32)((((m_start >> shift) + (0x10000U - m_counter.w)) << shift) - time);
+}
+
+void gbaTimer::gbaTimerBase::WriteTMXCNT_L_B0(u8 byte) {m_reload.b.b0.b = byte;}
+void gbaTimer::gbaTimerBase::WriteTMXCNT_L_B1(u8 byte) {m_reload.b.b1.b = byte;}
 
-void gbaTimerBase::WriteTMXCNT_H_B0(u8 byte) {
+void gbaTimer::gbaTimerBase::WriteTMXCNT_H_B0(u8 byte) {
     if (!IsEnabled() && BITTEST(byte, 7)) {ReloadCounter();}
     m_TMXCNT_H.w = byte & (m_IRQ != gbaControl::IRQ_TIMER0 ? 0xC7 : 0xC3);
 }
 
-u8 gbaTimerBase::ReadTMXCNT_L_B0() const {return m_counter.b.b0.b;}
-u8 gbaTimerBase::ReadTMXCNT_L_B1() const {return m_counter.b.b1.b;}
-u8 gbaTimerBase::ReadTMXCNT_H_B0() const {return m_TMXCNT_H.b.b0.b;}
+u8 gbaTimer::gbaTimerBase::ReadTMXCNT_L_B0() const {return GetCounter(m_console->scheduler.GetTime()) & 0xFF;}
+u8 gbaTimer::gbaTimerBase::ReadTMXCNT_L_B1() const {return GetCounter(m_console->scheduler.GetTime()) >> 8;}
+u8 gbaTimer::gbaTimerBase::ReadTMXCNT_H_B0() const {return m_TMXCNT_H.b.b0.b;}
+
+gbaTimer::gbaTimer3::gbaTimer3(gbaConsole *console, gbaTimerBase *cup) : gbaTimerBase(console, gbaControl::IRQ_TIMER3, cup) {}
+gbaTimer::gbaTimer2::gbaTimer2(gbaConsole *console, gbaTimerBase *cup) : gbaTimerBase(console, gbaControl::IRQ_TIMER2, cup) {}
+gbaTimer::gbaTimer1::gbaTimer1(gbaConsole *console, gbaTimerBase *cup) : gbaTimerBase(console, gbaControl::IRQ_TIMER1, cup) {}
+gbaTimer::gbaTimer0::gbaTimer0(gbaConsole *console, gbaTimerBase *cup) : gbaTimerBase(console, gbaControl::IRQ_TIMER0, cup) {}
+
+gbaTimer::gbaTimer(gbaConsole *console) :
+    m_console(console),
+    m_timer3(console, 0),
+    m_timer2(console, &m_timer3),
+    m_timer1(console, &m_timer2),
+    m_timer0(console, &m_timer1) {
+}
 
-gbaTimer3::gbaTimer3() : gbaTimerBase(gbaControl::IRQ_TIMER3, 0        ) {}
-gbaTimer2::gbaTimer2() : gbaTimerBase(gbaControl::IRQ_TIMER2, &m_timer3) {}
-gbaTimer1::gbaTimer1() : gbaTimerBase(gbaControl::IRQ_TIMER1, &m_timer2) {}
-gbaTimer0::gbaTimer0() : gbaTimerBase(gbaControl::IRQ_TIMER0, &m_timer1) {}
+s32 gbaTimer::SyncEvent(gbaConsole *console, s32 ticks) {return console->timer.Sync(ticks);}
 
-void ResetPrescaler() {for (s32 i = 0; i < 4; i++) {m_prescalerticks[i] = m_prescalerclk[i]; m_prescalercount[i] = 0;}}
+s32 gbaTimer::GetNextEvent() {
+    u64 time = m_console->scheduler.GetTime();
+    s32 ret  = 0;
+    s32 tov;
+    if (m_timer0.IsRunning()) {tov = m_timer0.GetNextOverflow(time);                             ret = tov; }
+    if (m_timer1.IsRunning()) {tov = m_timer1.GetNextOverflow(time); if (ret <= 0 || tov < ret) {ret = tov;}}
+    if (m_timer2.IsRunning()) {tov = m_timer2.GetNextOverflow(time); if (ret <= 0 || tov < ret) {ret = tov;}}
+    if (m_timer3.IsRunning()) {tov = m_timer3.GetNextOverflow(time); if (ret <= 0 || tov < ret) {ret = tov;}}
+    return ret;
+}
+
+// Solo se llama cuando desborda un timer o antes de escribir sus registros
+s32 gbaTimer::Sync(s32) {
+    u64 time = m_console->scheduler.GetTime();
+    m_timer0.Sync(time);
+    m_timer1.Sync(time);
+    m_timer2.Sync(time);
+    m_timer3.Sync(time);
+    return GetNextEvent();
+}
 
-void Reset() {
+void gbaTimer::Reset() {
     m_timer0.Reset();
     m_timer1.Reset();
     m_timer2.Reset();
     m_timer3.Reset();
-    ResetPrescaler();
+    m_console->scheduler.Register(gbaScheduler::EVENT_TIMER, SyncEvent, GetNextEvent());
 }
 
-void SyncPrescaler(s32 ticks) {
-    for (s32 i = 0; i < 4; i++) {
-        m_prescalerticks[i] -= ticks & (m_prescalerclk[i] - 1);
-        if (m_prescalerticks[i] > 0) {m_prescalercount[i] = 0;} else {m_prescalercount[i] = 1; m_prescalerticks[i] += m_prescalerclk[i];}
-        m_prescalercount[i] += ticks / m_prescalerclk[i];
-    }
-}
-
-void Sync(s32 ticks) {
-    if (ticks <= 0) {return;}
-    SyncPrescaler(ticks);
-    m_timer0.PrescalerSync(m_prescalercount[m_timer0.GetPrescaler()]);
-    m_timer1.PrescalerSync(m_prescalercount[m_timer1.GetPrescaler()]);
-    m_timer2.PrescalerSync(m_prescalercount[m_timer2.GetPrescaler()]);
-    m_timer3.PrescalerSync(m_prescalercount[m_timer3.GetPrescaler()]);
-}
-
-s32 GetNextEvent() {
-    s32 ret = 0;
-    u32 psc;
-    s32 tov;
-    if (m_timer0.IsEnabled())                        {psc = m_timer0.GetPrescaler(); tov = m_prescalerticks[psc] + ((0xFFFF - m_timer0.GetCounter()) * m_prescalerclk[psc]);                             ret = tov; }
-    if (m_timer1.IsEnabled() && !m_timer1.IsSlave()) {psc = m_timer1.GetPrescaler(); tov = m_prescalerticks[psc] + ((0xFFFF - m_timer1.GetCounter()) * m_prescalerclk[psc]); if (ret <= 0 || tov < ret) {ret = tov;}}
-    if (m_timer2.IsEnabled() && !m_timer2.IsSlave()) {psc = m_timer2.GetPrescaler(); tov = m_prescalerticks[psc] + ((0xFFFF - m_timer2.GetCounter()) * m_prescalerclk[psc]); if (ret <= 0 || tov < ret) {ret = tov;}}
-    if (m_timer3.IsEnabled() && !m_timer3.IsSlave()) {psc = m_timer3.GetPrescaler(); tov = m_prescalerticks[psc] + ((0xFFFF - m_timer3.GetCounter()) * m_prescalerclk[psc]); if (ret <= 0 || tov < ret) {ret = tov;}}
-    return ret;
-}
-
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
+void gbaTimer::WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     UNPACK_IO_BYTES(data)
+    m_console->scheduler.Sync(gbaScheduler::EVENT_TIMER);
     BEGIN_IO_TABLE(base, width)
         IO_WRITE_CALLBACK(0x04000100, m_timer0.WriteTMXCNT_L_B0)
         IO_WRITE_CALLBACK(0x04000101, m_timer0.WriteTMXCNT_L_B1)
@@ -173,9 +145,10 @@ void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width) {
         IO_WRITE_CALLBACK(0x0400010D, m_timer3.WriteTMXCNT_L_B1)
         IO_WRITE_CALLBACK(0x0400010E, m_timer3.WriteTMXCNT_H_B0)
     END_IO_TABLE()
+    m_console->scheduler.Sync(gbaScheduler::EVENT_TIMER);
 }
 
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
+void gbaTimer::ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
     u32 base = ALIGN(address, width);
     UNPACK_IO_POINTERS(data)
     BEGIN_IO_TABLE(base, width)
@@ -197,5 +170,4 @@ void ReadIO(u32 address, t32 *data, gbaMemory::DataType width) {
         IO_READ_DIRECT(0x0400010F, 0)
     END_IO_TABLE()
 }
-}
 //*************************************************************************************************
\ No newline at end of file
@@ -7,13 +7,70 @@
 #pragma once
 
 #include "../types.h"
+#include "gba_control.h"
 #include "gba_memory.h"
 
-namespace gbaTimer {
-void Reset();
-void Sync(s32 ticks);
-s32 GetNextEvent();
-void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
-void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
-}
+class gbaConsole;
+
+class gbaTimer {
+public:
+    gbaTimer(gbaConsole *console);
+
+    void Reset();
+    void WriteIO(u32 address, t32 const *data, gbaMemory::DataType width);
+    void ReadIO(u32 address, t32 *data, gbaMemory::DataType width);
+
+private:
+    class gbaTimerBase {
+    private:
+        gbaConsole               *m_console;
+        gbaControl::InterruptFlag m_IRQ;
+        gbaTimerBase             *m_cup;
+
+        t16 m_counter; // Valor del contador en m_start
+        t16 m_reload;
+        t16 m_TMXCNT_H;
+        u64 m_start;
+
+        void ReloadCounter();
+        void OnOverflow();
+        void Increment();
+
+    protected:
+        gbaTimerBase(gbaConsole *console, gbaControl::InterruptFlag irq, gbaTimerBase *cup);
+
+    public:
+        void Reset();
+        void Sync(u64 time);
+        bool IsEnabled() const;
+        bool IsSlave() const;
+        bool IsRunning() const;
+        u16 GetCounter(u64 time) const;
+        u32 GetPrescaler() const;
+        s32 GetNextOverflow(u64 time) const;
+        void WriteTMXCNT_L_B0(u8 byte);
+        void WriteTMXCNT_L_B1(u8 byte);
+        void WriteTMXCNT_H_B0(u8 byte);
+        u8 ReadTMXCNT_L_B0() const;
+        u8 ReadTMXCNT_L_B1() const;
+        u8 ReadTMXCNT_H_B0() const;
+    };
+
+    class gbaTimer3 : public gbaTimerBase {public: gbaTimer3(gbaConsole *console, gbaTimerBase *cup);};
+    class gbaTimer2 : public gbaTimerBase {public: gbaTimer2(gbaConsole *console, gbaTimerBase *cup);};
+    class gbaTimer1 : public gbaTimerBase {public: gbaTimer1(gbaConsole *console, gbaTimerBase *cup);};
+    class gbaTimer0 : public gbaTimerBase {public: gbaTimer0(gbaConsole *console, gbaTimerBase *cup);};
+
+    gbaConsole *m_console;
+
+    gbaTimer3 m_timer3;
+    gbaTimer2 m_timer2;
+    gbaTimer1 m_timer1;
+    gbaTimer0 m_timer0;
+
+    static s32 SyncEvent(gbaConsole *console, s32 ticks);
+
+    s32 GetNextEvent();
+    s32 Sync(s32);
+};
 //*************************************************************************************************
\ No newline at end of file
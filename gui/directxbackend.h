@@ -6,10 +6,13 @@
 
 #pragma once
 
+class gbaConsole;
+
 bool InitializeDirect3D(HWND hWnd, bool vsync);
 void ResetFrame();
 void ReleaseDirect3D();
-bool InitializeDirectSound(HWND hWnd, bool global);
+bool InitializeDirectSound(HWND hWnd, bool global, gbaConsole *console);
+void StartSound();
 void StopSound();
 void ResetSoundBuffer();
 void ReleaseDirectSound();
@@ -6,6 +6,7 @@
 
 #include <d3d9.h>
 #include "../emulator.h"
+#include "../gba/gba_pixelformat.h"
 
 #define D3DFVF_TLVERTEX (D3DFVF_XYZRHW | D3DFVF_DIFFUSE | D3DFVF_TEX1)
 
@@ -115,26 +116,14 @@ void ResetFrame()
     pDevice->Present(0, 0, 0, 0);
 }
 
-u32 ConvertColor16to32(u16 color)
-{
-    return 0xFF000000 | ((color & 0x001F) << 19) | ((color & 0x03E0) <<  6) | ((color & 0x7C00) >>  7);
-}
-
 namespace Emulator
 {
-void SendVideoFrame(u16 frame[GBA_SCREENHEIGHT][GBA_SCREENWIDTH])
+void SendVideoFrame(gbaConsole *, u16 frame[GBA_SCREENHEIGHT][GBA_SCREENWIDTH])
 {
     D3DLOCKED_RECT lockedrect;
-    u32 vpos;
     
     pTexture->LockRect(0, &lockedrect, 0, 0);
-
-    for (u32 line = 0; line < GBA_SCREENHEIGHT; line++)
-    {
-        vpos = line * 256;
-        for (u32 dot = 0; dot < GBA_SCREENWIDTH; dot++) {((u32 *)lockedrect.pBits)[vpos + dot] = ConvertColor16to32(frame[line][dot]);}
-    }
-
+    gbaPixelFormat::Convert(frame, gbaPixelFormat::FORMAT_ARGB8888, lockedrect.pBits, lockedrect.Pitch);
     pTexture->UnlockRect(0);
 
     pDevice->BeginScene();
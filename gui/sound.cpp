@@ -8,31 +8,66 @@
 #include <dsound.h>
 #include "../emulator.h"
 
-#define BUFFER_SIZE  GBA_SAMPLERATE / 2
+#define SOUND_RATE     48000                    // Frecuencia de salida, el nucleo remuestrea
+#define BUFFER_SIZE    (SOUND_RATE / 2 * 4)     // Bytes del buffer circular de DirectSound
+#define BUFFER_AHEAD   (BUFFER_SIZE / 4)        // Maximo de bytes escritos por delante del cursor de reproduccion
+#define STREAM_PERIOD  5                        // ms entre cada llenado
 
 LPDIRECTSOUND8       pDS8;
 LPDIRECTSOUNDBUFFER  pDSB_SO;
 LPDIRECTSOUNDBUFFER8 pSB8_SO8;
-s16                  SoundBuffer[BUFFER_SIZE];
-s32                  BufferPos;
-
-void PlayNextSoundFrame()
+gbaSound::SampleRing SoundRing;
+s16                  SoundBlock[GBA_SOUNDBLOCK * 2];
+DWORD                WritePos;
+HANDLE               hStream;
+volatile LONG        StreamRun;
+
+// Copia a DirectSound lo que haya en la cola, sin detener el buffer circular
+void StreamSound()
 {
-    BYTE *p_data1;
-    BYTE *p_data2;
-    DWORD p_size1;
-    DWORD p_size2;
-
-    pSB8_SO8->Stop();
-    pSB8_SO8->Lock(0, sizeof(SoundBuffer), (LPVOID *)&p_data1, &p_size1, (LPVOID *)&p_data2, &p_size2, DSBLOCK_ENTIREBUFFER);
-    memcpy(p_data1, SoundBuffer, sizeof(SoundBuffer));
-    pSB8_SO8->Unlock((LPVOID)p_data1, p_size1, (LPVOID)p_data2, p_size2);
+    DWORD play;
+    DWORD write;
+
+    if (pSB8_SO8->GetCurrentPosition(&play, &write) != DS_OK) {return;}
+
+    DWORD ahead = (WritePos + BUFFER_SIZE - play) % BUFFER_SIZE;
+    DWORD safe  = (write    + BUFFER_SIZE - play) % BUFFER_SIZE;
+    if (ahead < safe) {WritePos = write; ahead = safe;} // Se vacio la cola, se sigue desde el cursor de escritura
+
+    while (ahead < BUFFER_AHEAD)
+    {
+        u32 count = (BUFFER_AHEAD - ahead) / 4;
+        if (count > GBA_SOUNDBLOCK) {count = GBA_SOUNDBLOCK;}
+        count = SoundRing.Read(SoundBlock, count);
+        if (count == 0) {break;}
+        for (u32 i = 0; i < count * 2; i++) {SoundBlock[i] = (s16)(SoundBlock[i] * 32);}
+
+        BYTE *p_data1;
+        BYTE *p_data2;
+        DWORD p_size1;
+        DWORD p_size2;
+
+        if (pSB8_SO8->Lock(WritePos, count * 4, (LPVOID *)&p_data1, &p_size1, (LPVOID *)&p_data2, &p_size2, 0) != DS_OK) {break;}
+        memcpy(p_data1, SoundBlock, p_size1);
+        if (p_data2 != 0) {memcpy(p_data2, (BYTE *)SoundBlock + p_size1, p_size2);}
+        pSB8_SO8->Unlock((LPVOID)p_data1, p_size1, (LPVOID)p_data2, p_size2);
+
+        WritePos = (WritePos + count * 4) % BUFFER_SIZE;
+        ahead += count * 4;
+    }
+}
 
-    pSB8_SO8->SetCurrentPosition(0);
-    pSB8_SO8->Play(0, 0, 0);
+DWORD WINAPI StreamThread(void *param)
+{
+    while (StreamRun != 0)
+    {
+        StreamSound();
+        Sleep(STREAM_PERIOD);
+    }
+    return 0;
 }
 
-bool InitializeDirectSound(HWND hWnd, bool global)
+bool InitializeDirectSound(HWND hWnd, bool global, gbaConsole *console)
 {
     HRESULT      hrval;
     DSBUFFERDESC dsbd;
@@ -44,17 +79,19 @@ bool InitializeDirectSound(HWND hWnd, bool global)
     hrval = pDS8->SetCooperativeLevel(hWnd, DSSCL_PRIORITY);
     if (hrval != DS_OK) {return false;}
 
+    if (!console->sound.SetSampleRate(SOUND_RATE)) {return false;}
+
     wfex.wFormatTag      = WAVE_FORMAT_PCM;
     wfex.nChannels       = 2;
-    wfex.nSamplesPerSec  = GBA_SAMPLERATE;
-    wfex.nAvgBytesPerSec = GBA_SAMPLERATE * 2 * 2;
+    wfex.nSamplesPerSec  = SOUND_RATE;
+    wfex.nAvgBytesPerSec = SOUND_RATE * 2 * 2;
     wfex.nBlockAlign     = 4;
     wfex.wBitsPerSample  = 16;
     wfex.cbSize          = 0;
 
     dsbd.dwSize          = sizeof(DSBUFFERDESC);
-    dsbd.dwFlags         = global ? DSBCAPS_GLOBALFOCUS : 0;
-    dsbd.dwBufferBytes   = sizeof(SoundBuffer);
+    dsbd.dwFlags         = (global ? DSBCAPS_GLOBALFOCUS : 0) | DSBCAPS_GETCURRENTPOSITION2;
+    dsbd.dwBufferBytes   = BUFFER_SIZE;
     dsbd.dwReserved      = 0;
     dsbd.lpwfxFormat     = &wfex;
     dsbd.guid3DAlgorithm = DS3DALG_DEFAULT;
@@ -66,15 +103,41 @@ bool InitializeDirectSound(HWND hWnd, bool global)
     return hrval == DS_OK;
 }
 
+// Desde el hilo del emulador, antes de gbaConsole::StartEmulation
+void StartSound()
+{
+    SoundRing.Reset();
+    WritePos = 0;
+    pSB8_SO8->SetCurrentPosition(0);
+    pSB8_SO8->Play(0, 0, DSBPLAY_LOOPING);
+
+    StreamRun = 1;
+    hStream = CreateThread(0, 0, StreamThread, 0, 0, 0);
+    if (hStream == 0) {StreamRun = 0; Emulator::LogMessage("Error al crear el hilo de audio");}
+}
+
 void StopSound()
 {
+    if (hStream != 0)
+    {
+        InterlockedExchange(&StreamRun, 0);
+        WaitForSingleObject(hStream, INFINITE);
+        CloseHandle(hStream);
+        hStream = 0;
+    }
     pSB8_SO8->Stop();
 }
 
 void ResetSoundBuffer()
 {
-    memset(SoundBuffer, 0, sizeof(SoundBuffer));
-    BufferPos = 0;
+    BYTE *p_data1;
+    BYTE *p_data2;
+    DWORD p_size1;
+    DWORD p_size2;
+
+    if (pSB8_SO8->Lock(0, 0, (LPVOID *)&p_data1, &p_size1, (LPVOID *)&p_data2, &p_size2, DSBLOCK_ENTIREBUFFER) != DS_OK) {return;}
+    memset(p_data1, 0, p_size1);
+    pSB8_SO8->Unlock((LPVOID)p_data1, p_size1, (LPVOID)p_data2, p_size2);
 }
 
 void ReleaseDirectSound()
@@ -86,13 +149,9 @@ void ReleaseDirectSound()
 
 namespace Emulator
 {
-void SendSoundSample(s32 so1, s32 so2)
+// Sin hilo de audio no hay consumidor, la cola descarta lo que no cabe
+void SendSoundBlock(gbaConsole *, s16 const *samples, u32 count)
 {
-    SoundBuffer[BufferPos]     = (s16)((so1 * 32));
-    SoundBuffer[BufferPos + 1] = (s16)((so2 * 32));
-    BufferPos += 2;
-    if (BufferPos < BUFFER_SIZE) {return;}
-    BufferPos = 0;
-    PlayNextSoundFrame();
+    SoundRing.Write(samples, count);
 }
 }
@@ -93,6 +93,7 @@ DWORD                EmulatorThreadId;
 wxMutex             *LogMutex;
 std::queue<wxString> LogFIFO;
 volatile u16         KeypadState;
+gbaConsole          *Console;
 
 gbaCartridge::BackupType Battery;
 
@@ -153,7 +154,7 @@ void CloseEmulatorThread()
     if (hEmulator != 0)
     {
         Emulator::LogMessage("Esperando a que el hilo de ejecucion del emulador termine...");
-        gbaCore::StopEmulation();
+        Console->StopEmulation();
         WaitForSingleObject(hEmulator, INFINITE);
         DWORD exitcode;
         GetExitCodeThread(hEmulator, &exitcode);
@@ -165,7 +166,8 @@ void CloseEmulatorThread()
 
 DWORD WINAPI StartEmulation(void *filename)
 {
-    gbaCore::StartEmulation();
+    StartSound();
+    Console->StartEmulation();
     Emulator::LogMessage("El emulador se ha detenido");
     ResetFrame();
     StopSound();
@@ -176,7 +178,7 @@ DWORD WINAPI StartEmulation(void *filename)
 void PrepareEmulator(wxString &romfilename)
 {
     CloseEmulatorThread();
-    gbaCartridge::Load(romfilename.mb_str(wxConvUTF8), Battery, true);
+    Console->cartridge.Load(romfilename.mb_str(wxConvUTF8), Battery, true);
     hEmulator = CreateThread(0, 0, StartEmulation, 0, CREATE_SUSPENDED, &EmulatorThreadId);
     if (hEmulator == 0)
     {
@@ -373,7 +375,7 @@ bool cbaMainWindow::InitDirectX()
 {
     HWND hWnd = (HWND)GetHWND();
     if (!InitializeDirect3D(hWnd, true))    {return false;}
-    if (!InitializeDirectSound(hWnd, true)) {return false;}
+    if (!InitializeDirectSound(hWnd, true, Console)) {return false;}
     ResetFrame();
     ResetSoundBuffer();
     return true;
@@ -381,7 +383,7 @@ bool cbaMainWindow::InitDirectX()
 
 namespace Emulator
 {
-u16 ReadKeypad()
+u16 ReadKeypad(gbaConsole *)
 {
     return KeypadState;
 }
@@ -390,6 +392,7 @@ u16 ReadKeypad()
 void cbaApp::DeleteObjects()
 {
     delete LogMutex;
+    delete Console;
 }
 
 bool cbaApp::OnInit()
@@ -397,6 +400,7 @@ bool cbaApp::OnInit()
     wxString biosfilename;
 
     LogMutex = new wxMutex();
+    Console  = new gbaConsole();
     MainWnd  = new cbaMainWindow();
 
     SetTopWindow(MainWnd);
@@ -416,7 +420,7 @@ bool cbaApp::OnInit()
 
     biosfilename = wxPathOnly(wxStandardPaths::Get().GetExecutablePath()) + wxT("\\") + wxT("gba_bios.bin");
 
-    if (!gbaBIOS::Load(biosfilename.mb_str(wxConvUTF8)))
+    if (!Console->bios.Load(biosfilename.mb_str(wxConvUTF8)))
     {
         wxMessageBox(wxT("Este programa requiere una imagen del BIOS del GBA.\n")
                      wxT("El archivo debe llamarse gba_bios.bin, ")
@@ -0,0 +1,235 @@
+//*************************************************************************************************
+// Project Heron - GBA Emulator
+// jcds (jdibenes@outlook.com)
+// 2013
+//*************************************************************************************************
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "../emulator.h"
+#include "../gba/gba_pixelformat.h"
+
+// 228 lineas de 1232 ciclos
+#define GBA_FRAMECYCLES 280896
+
+char const * const FormatName[gbaPixelFormat::FORMAT_COUNT] = {"bgr555", "rgb565", "argb8888", "rgba8888"};
+
+// Resultados de cada consola, con -p se ejecutan varias a la vez sobre la misma ROM
+struct Session
+{
+    u32 FrameCount;
+    u32 FrameHash;
+    u32 SoundHash;
+    u64 SoundSamples;
+    bool Output; // Solo la primera consola escribe los archivos
+};
+
+u32   FrameLimit;
+bool  Quiet;
+FILE *VideoFile;
+gbaPixelFormat::Format VideoFormat;
+u8    VideoBuffer[GBA_SCREENHEIGHT * GBA_SCREENWIDTH * 4];
+FILE *SoundFile;
+
+u32 FNV1a(u32 hash, void const *data, size_t size)
+{
+    u8 const *p = (u8 const *)data;
+    for (size_t i = 0; i < size; i++) {hash = (hash ^ p[i]) * 16777619U;}
+    return hash;
+}
+
+namespace Emulator
+{
+void LogMessage(char const *format, ...)
+{
+    if (Quiet) {return;}
+    va_list list;
+    va_start(list, format);
+    vfprintf(stderr, format, list);
+    va_end(list);
+    fputc('\n', stderr);
+}
+
+u16 ReadKeypad(gbaConsole *)
+{
+    return gbaKeyInput::BUTTON_ALL;
+}
+
+// count cuadros estereo, SO1 y SO2 intercalados
+void SendSoundBlock(gbaConsole *console, s16 const *samples, u32 count)
+{
+    Session *session = (Session *)console->GetUserData();
+    session->SoundHash = FNV1a(session->SoundHash, samples, count * 2 * sizeof(s16));
+    session->SoundSamples += count;
+    if (session->Output && SoundFile != 0) {fwrite(samples, 2 * sizeof(s16), count, SoundFile);}
+}
+
+void SendVideoFrame(gbaConsole *console, u16 frame[GBA_SCREENHEIGHT][GBA_SCREENWIDTH])
+{
+    Session *session = (Session *)console->GetUserData();
+    session->FrameHash = FNV1a(2166136261U, frame, sizeof(u16) * GBA_SCREENHEIGHT * GBA_SCREENWIDTH);
+    if (session->Output && VideoFile != 0)
+    {
+        u32 pitch = GBA_SCREENWIDTH * gbaPixelFormat::GetPixelSize(VideoFormat);
+        gbaPixelFormat::Convert(frame, VideoFormat, VideoBuffer, pitch);
+        fwrite(VideoBuffer, pitch * GBA_SCREENHEIGHT, 1, VideoFile);
+    }
+    if (++session->FrameCount >= FrameLimit) {console->StopEmulation();}
+}
+}
+
+void Usage(char const *name)
+{
+    fprintf(stderr, "Uso: %s <bios> <rom> [frames] [-v video.raw] [-f formato] [-s sound.raw] [-a hz] [-n] [-q] [-j] [-i] [-r] [-l] [-t] [-k cuadros] [-p consolas]\n", name);
+    fprintf(stderr, "  frames    cuadros a emular (por defecto 3600)\n");
+    fprintf(stderr, "  -v        escribe cada cuadro (240x160) al archivo\n");
+    fprintf(stderr, "  -f        formato de los cuadros: bgr555 (por defecto), rgb565, argb8888, rgba8888\n");
+    fprintf(stderr, "  -s        escribe el audio (s16 estereo) al archivo\n");
+    fprintf(stderr, "  -a        frecuencia de muestreo del audio (por defecto %d Hz, sin remuestreo)\n", GBA_SAMPLERATE);
+    fprintf(stderr, "  -n        no genera audio, solo el estado del APU visible para el CPU\n");
+    fprintf(stderr, "  -q        no muestra los mensajes del emulador\n");
+    fprintf(stderr, "  -j        usa el recompilador x86-64 en lugar del interprete\n");
+    fprintf(stderr, "  -i        no adelanta los ciclos ociosos del CPU\n");
+    fprintf(stderr, "  -r        compone y convierte las lineas y mezcla el audio sin SIMD\n");
+    fprintf(stderr, "  -l        dibuja cada linea en su HBlank, sin lotes\n");
+    fprintf(stderr, "  -t        dibuja los lotes de lineas en otro hilo\n");
+    fprintf(stderr, "  -k        dibuja 1 de cada k cuadros, ninguno con 0\n");
+    fprintf(stderr, "  -p        ejecuta varias consolas a la vez, cada una en su hilo (por defecto 1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    char const *biosfilename  = 0;
+    char const *romfilename   = 0;
+    char const *videofilename = 0;
+    char const *soundfilename = 0;
+    bool        recompiler    = false;
+    bool        sound         = true;
+    bool        idleskip      = true;
+    bool        simd          = true;
+    bool        batch         = true;
+    bool        renderthread  = false;
+    u32         samplerate    = GBA_SAMPLERATE;
+    u32         frameskip     = 1;
+    u32         consoles      = 1;
+
+    FrameLimit = 3600;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp(argv[i], "-q") == 0)                  {Quiet = true;}
+        else if (strcmp(argv[i], "-j") == 0)                  {recompiler = true;}
+        else if (strcmp(argv[i], "-n") == 0)                  {sound = false;}
+        else if (strcmp(argv[i], "-i") == 0)                  {idleskip = false;}
+        else if (strcmp(argv[i], "-r") == 0)                  {simd = false; gbaPixelFormat::EnableSIMD(false);}
+        else if (strcmp(argv[i], "-l") == 0)                  {batch = false;}
+        else if (strcmp(argv[i], "-t") == 0)                  {renderthread = true;}
+        else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {videofilename = argv[++i];}
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {soundfilename = argv[++i];}
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {samplerate = (u32)strtoul(argv[++i], 0, 10);}
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {frameskip  = (u32)strtoul(argv[++i], 0, 10);}
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {consoles   = (u32)strtoul(argv[++i], 0, 10);}
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            u32 format = 0;
+            while (format < gbaPixelFormat::FORMAT_COUNT && strcmp(argv[i + 1], FormatName[format]) != 0) {format++;}
+            if (format == gbaPixelFormat::FORMAT_COUNT) {Usage(argv[0]); return EXIT_FAILURE;}
+            VideoFormat = (gbaPixelFormat::Format)format;
+            i++;
+        }
+        else if (argv[i][0] == '-')                           {Usage(argv[0]); return EXIT_FAILURE;}
+        else
+        {
+            switch (positional++)
+            {
+            case 0:  biosfilename = argv[i];                       break;
+            case 1:  romfilename  = argv[i];                       break;
+            case 2:  FrameLimit   = (u32)strtoul(argv[i], 0, 10); break;
+            default: Usage(argv[0]); return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (romfilename == 0 || FrameLimit == 0 || consoles == 0) {Usage(argv[0]); return EXIT_FAILURE;}
+
+    // Las consolas comparten las imagenes de la BIOS y la ROM, cada una con su propio estado
+    std::vector<gbaConsole *> console(consoles);
+    std::vector<Session>      session(consoles);
+
+    for (u32 i = 0; i < consoles; i++)
+    {
+        gbaConsole *gba = console[i] = new gbaConsole();
+
+        session[i].FrameCount   = 0;
+        session[i].FrameHash    = 2166136261U;
+        session[i].SoundHash    = 2166136261U;
+        session[i].SoundSamples = 0;
+        session[i].Output       = i == 0;
+
+        gba->SetUserData(&session[i]);
+        gba->EnableIdleLoopSkip(idleskip);
+        gba->display.EnableSIMD(simd);
+        gba->display.EnableBatchRendering(batch);
+        gba->display.EnableRenderThread(renderthread);
+        gba->display.SetFrameSkip(frameskip);
+        gba->sound.EnableSIMD(simd);
+        gba->sound.EnableOutput(sound);
+
+        if (!gba->sound.SetSampleRate(samplerate)) {return EXIT_FAILURE;}
+        if (recompiler && !gba->cpu.SetExecutionEngine(gbaCPU::ENGINE_RECOMPILER)) {return EXIT_FAILURE;}
+        if (!gba->bios.Load(biosfilename)) {return EXIT_FAILURE;}
+        // Sin RTC para que cada ejecucion sea identica
+        if (!gba->cartridge.Load(romfilename, gbaCartridge::BACKUP_NOID, false)) {return EXIT_FAILURE;}
+    }
+
+    if (videofilename != 0 && (VideoFile = fopen(videofilename, "wb")) == 0) {fprintf(stderr, "Error al abrir %s\n", videofilename); return EXIT_FAILURE;}
+    if (soundfilename != 0 && (SoundFile = fopen(soundfilename, "wb")) == 0) {fprintf(stderr, "Error al abrir %s\n", soundfilename); return EXIT_FAILURE;}
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (consoles == 1)
+    {
+        console[0]->StartEmulation();
+    }
+    else
+    {
+        std::vector<std::thread> thread;
+        for (u32 i = 0; i < consoles; i++) {thread.push_back(std::thread(&gbaConsole::StartEmulation, console[i]));}
+        for (u32 i = 0; i < consoles; i++) {thread[i].join();}
+    }
+    std::chrono::steady_clock::time_point end   = std::chrono::steady_clock::now();
+
+    if (VideoFile != 0) {fclose(VideoFile);}
+    if (SoundFile != 0) {fclose(SoundFile);}
+
+    double ns     = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    double s      = ns / 1e9;
+    double cycles = (double)session[0].FrameCount * GBA_FRAMECYCLES * consoles;
+
+    u32  FrameCount = session[0].FrameCount;
+    bool match      = true;
+    for (u32 i = 1; i < consoles; i++) {match = match && session[i].FrameCount == FrameCount && session[i].FrameHash == session[0].FrameHash && session[i].SoundHash == session[0].SoundHash;}
+
+    if (consoles > 1) {printf("consoles:        %u\n", consoles);}
+    printf("frames:          %u\n",   FrameCount);
+    printf("time:            %.3f s\n", s);
+    printf("frames/sec:      %.2f\n", FrameCount * consoles / s);
+    printf("ns/frame:        %.0f\n", ns / (FrameCount * consoles));
+    printf("cycles/sec:      %.0f\n", cycles / s);
+    printf("speed:           %.2fx\n", (cycles / s) / 16777216.0);
+    printf("sound samples:   %llu\n", (unsigned long long)session[0].SoundSamples);
+    printf("last frame hash: %08X\n", session[0].FrameHash);
+    printf("sound hash:      %08X\n", session[0].SoundHash);
+    if (!match) {printf("las consolas no produjeron los mismos hashes\n");}
+
+    for (u32 i = 0; i < consoles; i++) {delete console[i];}
+
+    return (FrameCount == FrameLimit && match) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//*************************************************************************************************
\ No newline at end of file
@@ -7,7 +7,11 @@
 #pragma once
 
 #include "types.h"
-#include "gba\gba_memory.h"
+#include "gba/gba_memory.h"
+
+#ifndef _MSC_VER
+#define __assume(cond) do {if (!(cond)) {__builtin_unreachable();}} while (0)
+#endif
 
 #define T32BYTES(data) {(data)->w.w0.b.b0.b, \
                         (data)->w.w0.b.b1.b, \